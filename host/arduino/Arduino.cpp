@@ -0,0 +1,127 @@
+#include "Arduino.h"
+#include "sim_board.h"
+#include "sim_clock.h"
+
+#include <utility>
+
+static std::string formatNumber(unsigned long number, unsigned char base, bool negative) {
+    if (base < 2 || base > 16) base = DEC;
+    char digits[34];
+    size_t pos = sizeof(digits);
+    digits[--pos] = '\0';
+    do {
+        digits[--pos] = "0123456789ABCDEF"[number % base];
+        number /= base;
+    } while (number > 0);
+    if (negative) digits[--pos] = '-';
+    return std::string(digits + pos);
+}
+
+String::String(unsigned char number, unsigned char base) : value(formatNumber(number, base, false)) {}
+String::String(unsigned int number, unsigned char base) : value(formatNumber(number, base, false)) {}
+String::String(unsigned long number, unsigned char base) : value(formatNumber(number, base, false)) {}
+
+// Negative numbers only print signed in decimal, like the core
+String::String(int number, unsigned char base)
+    : value(base == DEC ? formatNumber(number < 0 ? 0ul - (unsigned long)number : (unsigned long)number, base, number < 0)
+                        : formatNumber((unsigned int)number, base, false)) {}
+
+String::String(long number, unsigned char base)
+    : value(base == DEC ? formatNumber(number < 0 ? 0ul - (unsigned long)number : (unsigned long)number, base, number < 0)
+                        : formatNumber((unsigned long)number, base, false)) {}
+
+String::String(float number, unsigned char decimals) : String((double)number, decimals) {}
+
+String::String(double number, unsigned char decimals) {
+    if (isnan(number)) {
+        value = "nan";
+    } else if (isinf(number)) {
+        value = "inf";
+    } else {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, number);
+        value = buffer;
+    }
+}
+
+int String::indexOf(char c) const {
+    size_t pos = value.find(c);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from) const {
+    return substring(from, value.size());
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= value.size()) return String();
+    if (to > value.size()) to = value.size();
+    return String(value.substr(from, to - from));
+}
+
+void String::trim() {
+    size_t start = 0;
+    size_t end = value.size();
+    while (start < end && isspace((unsigned char)value[start])) start++;
+    while (end > start && isspace((unsigned char)value[end - 1])) end--;
+    value = value.substr(start, end - start);
+}
+
+void String::toUpperCase() {
+    for (char& c : value) c = (char)toupper((unsigned char)c);
+}
+
+String operator+(const String& left, const String& right) {
+    String result(left);
+    result += right;
+    return result;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    while (written < size && write(buffer[written]) == 1) written++;
+    return written;
+}
+
+// 32-bit counters that wrap like the device's
+unsigned long millis() {
+    return (uint32_t)(simClockMicros() / 1000);
+}
+
+unsigned long micros() {
+    return (uint32_t)simClockMicros();
+}
+
+// The board services pending peripheral work (flash completions) whenever
+// the firmware waits, as interrupts would on the device
+void delay(unsigned long ms) {
+    simBoardService();
+    simClockSleep((uint64_t)ms * 1000);
+    simBoardService();
+}
+
+void delayMicroseconds(unsigned int us) {
+    simClockSleep(us);
+}
+
+void yield() {
+    simBoardService();
+}
+
+void pinMode(int pin, int mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(int pin, int value) {
+    simBoardSetPin(pin, value);
+}
+
+int digitalRead(int pin) {
+    return simBoardGetPin(pin);
+}
+
+void NVIC_SystemReset() {
+    simBoardReset();
+}
@@ -0,0 +1,138 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host build stand-in for the parts of the Arduino mbed core the firmware
+// uses: String, Print/Stream, Serial, timing and GPIO. Time comes from
+// sim_clock.h, Serial from sim_serial.h and pin writes are recorded for the
+// simulator to report.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+
+using std::isnan;
+using std::abs;
+
+#define PI 3.1415926535897932384626433832795
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define DEC 10
+#define HEX 16
+
+// XIAO nRF52840 Sense LEDs (active low)
+#define LED_RED 11
+#define LED_GREEN 13
+#define LED_BLUE 12
+#define LED_BUILTIN LED_RED
+
+typedef uint8_t byte;
+
+class String {
+public:
+    String() {}
+    String(const char* text) : value(text != NULL ? text : "") {}
+    String(const std::string& text) : value(text) {}
+    String(char c) : value(1, c) {}
+    String(unsigned char number, unsigned char base = DEC);
+    String(int number, unsigned char base = DEC);
+    String(unsigned int number, unsigned char base = DEC);
+    String(long number, unsigned char base = DEC);
+    String(unsigned long number, unsigned char base = DEC);
+    String(float number, unsigned char decimals = 2);
+    String(double number, unsigned char decimals = 2);
+
+    unsigned int length() const { return value.size(); }
+    const char* c_str() const { return value.c_str(); }
+    bool reserve(unsigned int size) { value.reserve(size); return true; }
+    bool concat(const char* text, unsigned int length) { value.append(text, length); return true; }
+
+    String& operator+=(const String& other) { value += other.value; return *this; }
+    String& operator+=(const char* other) { value += other; return *this; }
+    String& operator+=(char other) { value += other; return *this; }
+    bool operator==(const String& other) const { return value == other.value; }
+    bool operator==(const char* other) const { return value == other; }
+    bool operator!=(const String& other) const { return value != other.value; }
+    bool operator!=(const char* other) const { return value != other; }
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    char charAt(unsigned int index) const { return index < value.size() ? value[index] : 0; }
+    bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    int indexOf(char c) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    long toInt() const { return atol(value.c_str()); }
+    float toFloat() const { return (float)atof(value.c_str()); }
+    void trim();
+    void toUpperCase();
+
+    friend String operator+(const String& left, const String& right);
+
+private:
+    std::string value;
+};
+
+String operator+(const String& left, const String& right);
+inline String operator+(const String& left, const char* right) { return left + String(right); }
+inline String operator+(const char* left, const String& right) { return String(left) + right; }
+inline String operator+(const String& left, char right) { return left + String(right); }
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const String& text) { return write((const uint8_t*)text.c_str(), text.length()); }
+    size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int number) { return print(String(number)); }
+    size_t print(unsigned long number) { return print(String(number)); }
+    size_t print(double number, int decimals = 2) { return print(String(number, decimals)); }
+    size_t println() { return print("\r\n"); }
+    size_t println(const String& text) { return print(text) + println(); }
+    size_t println(const char* text) { return print(text) + println(); }
+    size_t println(int number) { return print(number) + println(); }
+    size_t println(double number, int decimals = 2) { return print(number, decimals) + println(); }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    void setTimeout(unsigned long timeoutMs) { timeout = timeoutMs; }
+
+protected:
+    unsigned long timeout = 1000;
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+void NVIC_SystemReset();
+
+inline bool isDigit(char c) { return isdigit((unsigned char)c) != 0; }
+inline bool isHexadecimalDigit(char c) { return isxdigit((unsigned char)c) != 0; }
+
+#include "sim_serial.h"
+
+#endif // ARDUINO_H
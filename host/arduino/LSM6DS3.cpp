@@ -0,0 +1,258 @@
+#include "LSM6DS3.h"
+#include "sim_clock.h"
+#include "sim_imu.h"
+
+#define REG_FIFO_CTRL5 0x0A
+#define REG_WHO_AM_I 0x0F
+#define REG_CTRL1_XL 0x10
+#define REG_CTRL2_G 0x11
+#define REG_CTRL3_C 0x12
+#define REG_STATUS 0x1E
+#define REG_OUT_TEMP_L 0x20
+#define REG_OUTX_L_G 0x22
+#define REG_OUTX_L_XL 0x28
+#define REG_FIFO_STATUS1 0x3A
+#define REG_FIFO_STATUS2 0x3B
+#define REG_FIFO_STATUS3 0x3C
+#define REG_FIFO_STATUS4 0x3D
+#define REG_FIFO_DATA_OUT_L 0x3E
+#define REG_FIFO_DATA_OUT_H 0x3F
+
+#define FIFO_MODE_MASK 0x07
+#define FIFO_MODE_CONTINUOUS 0x06
+#define FIFO_STATUS2_OVER_RUN 0x40
+#define FIFO_STATUS2_EMPTY 0x10
+
+#define STREAM_ACCEL 0
+#define STREAM_GYRO 1
+#define STREAM_FIFO 2
+
+// ODR field codes 1-10: 13Hz doubling up to 6.66kHz
+static float odrHz(uint8_t code) {
+    if (code == 0 || code > 10) return 0.0f;
+    return 6.5f * (float)(1 << code);
+}
+
+static float accelRangeG(uint8_t ctrl1) {
+    static const float ranges[4] = {2.0f, 16.0f, 4.0f, 8.0f};
+    return ranges[(ctrl1 >> 2) & 0x03];
+}
+
+static float gyroRangeDps(uint8_t ctrl2) {
+    if (ctrl2 & 0x02) return 125.0f;
+    static const float ranges[4] = {245.0f, 500.0f, 1000.0f, 2000.0f};
+    return ranges[(ctrl2 >> 2) & 0x03];
+}
+
+static int16_t quantize(float value, float sensitivity) {
+    float counts = roundf(value / sensitivity);
+    if (counts > 32767.0f) return 32767;
+    if (counts < -32768.0f) return -32768;
+    return (int16_t)counts;
+}
+
+// Datasheet sensitivities: 0.061 mg/LSB at 2g and 4.375 mdps/LSB at 125dps,
+// scaling with the range (245dps is 8.75)
+static int16_t accelCounts(float g, uint8_t ctrl1) {
+    return quantize(g, 0.061e-3f * accelRangeG(ctrl1) / 2.0f);
+}
+
+static int16_t gyroCounts(float dps, uint8_t ctrl2) {
+    float range = gyroRangeDps(ctrl2);
+    return quantize(dps, 4.375e-3f * (range == 245.0f ? 2.0f : range / 125.0f));
+}
+
+static void putWord(uint8_t* registers, uint8_t offset, int16_t value) {
+    registers[offset] = (uint8_t)(value & 0xFF);
+    registers[offset + 1] = (uint8_t)((uint16_t)value >> 8);
+}
+
+LSM6DS3::LSM6DS3(uint8_t busType, uint8_t inputArg) {
+    (void)busType;
+    (void)inputArg;
+    memset(registers, 0, sizeof(registers));
+    registers[REG_WHO_AM_I] = 0x6A;
+    registers[REG_CTRL3_C] = 0x04;   // IF_INC
+    settings.accelRange = 16;
+    settings.gyroRange = 2000;
+    accelIndex = gyroIndex = 0;
+    haveOutputs = false;
+    fifoFirstIndex = fifoProduced = fifoWordsRead = 0;
+    fifoOverrun = false;
+    fifoHighByte = false;
+    fifoWord = 0;
+}
+
+bool LSM6DS3::busFailed() {
+    return simImuStateAt(simClockMicros()).failed;
+}
+
+// Library defaults: 416Hz accel and gyro, +/-16g and +/-2000dps
+status_t LSM6DS3::begin() {
+    if (busFailed()) return IMU_HW_ERROR;
+    registers[REG_CTRL1_XL] = (0x06 << 4) | (0x01 << 2) | 0x02;
+    registers[REG_CTRL2_G] = (0x06 << 4) | (0x03 << 2);
+    haveOutputs = false;
+    return IMU_SUCCESS;
+}
+
+// Output registers show the newest sample on each sensor's ODR grid
+void LSM6DS3::refreshOutputs() {
+    uint64_t now = simClockMicros();
+    float accelOdr = odrHz(registers[REG_CTRL1_XL] >> 4);
+    float gyroOdr = odrHz(registers[REG_CTRL2_G] >> 4);
+
+    if (accelOdr > 0.0f) {
+        uint64_t index = (uint64_t)(now * (double)accelOdr / 1e6);
+        if (!haveOutputs || index != accelIndex) {
+            SimImuSample sample = simImuSampleAt(index, accelOdr, STREAM_ACCEL);
+            for (int axis = 0; axis < 3; axis++) {
+                putWord(registers, REG_OUTX_L_XL + 2 * axis, accelCounts(sample.accel[axis], registers[REG_CTRL1_XL]));
+            }
+            putWord(registers, REG_OUT_TEMP_L, (int16_t)lroundf((sample.temperature - 25.0f) * 16.0f));
+            accelIndex = index;
+        }
+    }
+    if (gyroOdr > 0.0f) {
+        uint64_t index = (uint64_t)(now * (double)gyroOdr / 1e6);
+        if (!haveOutputs || index != gyroIndex) {
+            SimImuSample sample = simImuSampleAt(index, gyroOdr, STREAM_GYRO);
+            for (int axis = 0; axis < 3; axis++) {
+                putWord(registers, REG_OUTX_L_G + 2 * axis, gyroCounts(sample.gyro[axis], registers[REG_CTRL2_G]));
+            }
+            gyroIndex = index;
+        }
+    }
+    haveOutputs = true;
+}
+
+// Continuous mode keeps the newest samples; on overflow the oldest whole
+// samples go and OVER_RUN stays set until the FIFO is bypassed
+void LSM6DS3::serviceFifo() {
+    float fifoOdr = odrHz((registers[REG_FIFO_CTRL5] >> 3) & 0x0F);
+    if ((registers[REG_FIFO_CTRL5] & FIFO_MODE_MASK) != FIFO_MODE_CONTINUOUS || fifoOdr <= 0.0f) return;
+
+    uint64_t index = (uint64_t)(simClockMicros() * (double)fifoOdr / 1e6);
+    fifoProduced = index > fifoFirstIndex ? index - fifoFirstIndex : 0;
+    uint64_t unread = fifoProduced * 6 - fifoWordsRead;
+    if (unread > SIM_LSM6DS3_FIFO_WORDS) {
+        uint64_t excessSamples = (unread - SIM_LSM6DS3_FIFO_WORDS + 5) / 6;
+        fifoWordsRead += excessSamples * 6;
+        fifoOverrun = true;
+    }
+}
+
+uint8_t LSM6DS3::readByte(uint8_t offset) {
+    if (offset >= REG_FIFO_STATUS1 && offset <= REG_FIFO_DATA_OUT_H) serviceFifo();
+
+    uint64_t unread = fifoProduced * 6 - fifoWordsRead;
+    switch (offset) {
+        case REG_STATUS:
+            return 0x07;   // New accel, gyro and temperature data
+        case REG_FIFO_STATUS1:
+            return (uint8_t)(unread & 0xFF);
+        case REG_FIFO_STATUS2:
+            return (uint8_t)(((unread >> 8) & 0x0F) | (fifoOverrun ? FIFO_STATUS2_OVER_RUN : 0) |
+                             (unread == 0 ? FIFO_STATUS2_EMPTY : 0));
+        case REG_FIFO_STATUS3:
+            return (uint8_t)(fifoWordsRead % 6);
+        case REG_FIFO_STATUS4:
+            return 0;
+        case REG_FIFO_DATA_OUT_L:
+        case REG_FIFO_DATA_OUT_H: {
+            // Reading past the end of the data returns the last word again
+            if (!fifoHighByte && unread > 0) {
+                uint64_t sampleIndex = fifoFirstIndex + fifoWordsRead / 6 + 1;
+                float fifoOdr = odrHz((registers[REG_FIFO_CTRL5] >> 3) & 0x0F);
+                SimImuSample sample = simImuSampleAt(sampleIndex, fifoOdr, STREAM_FIFO);
+                int axis = fifoWordsRead % 6;
+                fifoWord = axis < 3 ? gyroCounts(sample.gyro[axis], registers[REG_CTRL2_G])
+                                    : accelCounts(sample.accel[axis - 3], registers[REG_CTRL1_XL]);
+                fifoWordsRead++;
+            }
+            uint8_t value = fifoHighByte ? (uint8_t)((uint16_t)fifoWord >> 8) : (uint8_t)(fifoWord & 0xFF);
+            fifoHighByte = !fifoHighByte;
+            return value;
+        }
+        default:
+            return registers[offset & 0x7F];
+    }
+}
+
+status_t LSM6DS3::readRegister(uint8_t* output, uint8_t offset) {
+    if (busFailed()) return IMU_HW_ERROR;
+    refreshOutputs();
+    *output = readByte(offset);
+    return IMU_SUCCESS;
+}
+
+// With IF_INC the address advances, except on FIFO_DATA_OUT where a long
+// read keeps draining consecutive words
+status_t LSM6DS3::readRegisterRegion(uint8_t* output, uint8_t offset, uint8_t length) {
+    if (busFailed()) return IMU_HW_ERROR;
+    refreshOutputs();   // Block data update: one sample for the whole read
+    for (uint8_t i = 0; i < length; i++) {
+        output[i] = readByte(offset);
+        if (offset != REG_FIFO_DATA_OUT_L && offset != REG_FIFO_DATA_OUT_H) offset++;
+    }
+    return IMU_SUCCESS;
+}
+
+status_t LSM6DS3::readRegisterInt16(int16_t* output, uint8_t offset) {
+    uint8_t bytes[2] = {0, 0};
+    status_t status = readRegisterRegion(bytes, offset, 2);
+    *output = (int16_t)(bytes[0] | ((uint16_t)bytes[1] << 8));
+    return status;
+}
+
+status_t LSM6DS3::writeRegister(uint8_t offset, uint8_t value) {
+    if (busFailed()) return IMU_HW_ERROR;
+    offset &= 0x7F;
+    registers[offset] = value;
+
+    if (offset == REG_CTRL1_XL || offset == REG_CTRL2_G) haveOutputs = false;
+    if (offset == REG_FIFO_CTRL5) {
+        // Bypass empties the FIFO; entering continuous mode starts filling it from now
+        float fifoOdr = odrHz((value >> 3) & 0x0F);
+        fifoFirstIndex = fifoOdr > 0.0f ? (uint64_t)(simClockMicros() * (double)fifoOdr / 1e6) : 0;
+        fifoProduced = 0;
+        fifoWordsRead = 0;
+        fifoHighByte = false;
+        if ((value & FIFO_MODE_MASK) != FIFO_MODE_CONTINUOUS) fifoOverrun = false;
+    }
+    return IMU_SUCCESS;
+}
+
+int16_t LSM6DS3::readRawAccelX() { int16_t value = 0; readRegisterInt16(&value, REG_OUTX_L_XL); return value; }
+int16_t LSM6DS3::readRawAccelY() { int16_t value = 0; readRegisterInt16(&value, REG_OUTX_L_XL + 2); return value; }
+int16_t LSM6DS3::readRawAccelZ() { int16_t value = 0; readRegisterInt16(&value, REG_OUTX_L_XL + 4); return value; }
+int16_t LSM6DS3::readRawGyroX() { int16_t value = 0; readRegisterInt16(&value, REG_OUTX_L_G); return value; }
+int16_t LSM6DS3::readRawGyroY() { int16_t value = 0; readRegisterInt16(&value, REG_OUTX_L_G + 2); return value; }
+int16_t LSM6DS3::readRawGyroZ() { int16_t value = 0; readRegisterInt16(&value, REG_OUTX_L_G + 4); return value; }
+int16_t LSM6DS3::readRawTemp() { int16_t value = 0; readRegisterInt16(&value, REG_OUT_TEMP_L); return value; }
+
+float LSM6DS3::readFloatAccelX() { return busFailed() ? NAN : calcAccel(readRawAccelX()); }
+float LSM6DS3::readFloatAccelY() { return busFailed() ? NAN : calcAccel(readRawAccelY()); }
+float LSM6DS3::readFloatAccelZ() { return busFailed() ? NAN : calcAccel(readRawAccelZ()); }
+float LSM6DS3::readFloatGyroX() { return busFailed() ? NAN : calcGyro(readRawGyroX()); }
+float LSM6DS3::readFloatGyroY() { return busFailed() ? NAN : calcGyro(readRawGyroY()); }
+float LSM6DS3::readFloatGyroZ() { return busFailed() ? NAN : calcGyro(readRawGyroZ()); }
+
+float LSM6DS3::readTempC() {
+    return busFailed() ? NAN : (float)readRawTemp() / 16.0f + 25.0f;
+}
+
+float LSM6DS3::readTempF() {
+    return readTempC() * 9.0f / 5.0f + 32.0f;
+}
+
+// Same scaling as the library: by the configured range, not the register
+float LSM6DS3::calcAccel(int16_t input) {
+    return (float)input * 0.061f * (settings.accelRange >> 1) / 1000.0f;
+}
+
+float LSM6DS3::calcGyro(int16_t input) {
+    uint8_t divisor = settings.gyroRange / 125;
+    if (settings.gyroRange == 245) divisor = 2;
+    return (float)input * 4.375f * divisor / 1000.0f;
+}
@@ -0,0 +1,81 @@
+#ifndef LSM6DS3_H
+#define LSM6DS3_H
+
+#include "Arduino.h"
+
+// Host stand-in for the Seeed Arduino LSM6DS3 library. The same calls reach
+// a register-level model of the chip: CTRL1_XL/CTRL2_G select output data
+// rate and full scale, the output registers hold the latest sample of the
+// scripted IMU in sim_imu.h, and FIFO_CTRL5 runs the FIFO (gx gy gz ax ay az
+// per sample) that burst captures drain through FIFO_DATA_OUT_L.
+
+#define I2C_MODE 0
+#define SPI_MODE 1
+
+#define SIM_LSM6DS3_FIFO_WORDS 4096      // 8KB FIFO
+
+typedef enum {
+    IMU_SUCCESS,
+    IMU_HW_ERROR,
+    IMU_NOT_SUPPORTED,
+    IMU_GENERIC_ERROR,
+    IMU_OUT_OF_BOUNDS,
+    IMU_ALL_ONES_WARNING
+} status_t;
+
+struct SensorSettings {
+    uint16_t accelRange;     // g, as the library configures it in begin()
+    uint16_t gyroRange;      // deg/s
+};
+
+class LSM6DS3 {
+public:
+    LSM6DS3(uint8_t busType = I2C_MODE, uint8_t inputArg = 0x6B);
+    status_t begin();
+
+    int16_t readRawAccelX();
+    int16_t readRawAccelY();
+    int16_t readRawAccelZ();
+    int16_t readRawGyroX();
+    int16_t readRawGyroY();
+    int16_t readRawGyroZ();
+    int16_t readRawTemp();
+    float readFloatAccelX();     // NaN while the script has the bus failing
+    float readFloatAccelY();
+    float readFloatAccelZ();
+    float readFloatGyroX();
+    float readFloatGyroY();
+    float readFloatGyroZ();
+    float readTempC();
+    float readTempF();
+
+    status_t readRegister(uint8_t* output, uint8_t offset);
+    status_t readRegisterRegion(uint8_t* output, uint8_t offset, uint8_t length);
+    status_t readRegisterInt16(int16_t* output, uint8_t offset);
+    status_t writeRegister(uint8_t offset, uint8_t value);
+
+    float calcAccel(int16_t input);
+    float calcGyro(int16_t input);
+
+    SensorSettings settings;
+
+private:
+    uint8_t readByte(uint8_t offset);
+    void refreshOutputs();
+    void serviceFifo();
+    bool busFailed();
+
+    uint8_t registers[0x80];
+    uint64_t accelIndex;         // Output register sample numbers on their ODR grids
+    uint64_t gyroIndex;
+    bool haveOutputs;
+
+    uint64_t fifoFirstIndex;     // First sample on the FIFO ODR grid
+    uint64_t fifoProduced;       // Samples produced since the FIFO started
+    uint64_t fifoWordsRead;
+    bool fifoOverrun;
+    bool fifoHighByte;           // Next FIFO_DATA_OUT read is the high byte
+    int16_t fifoWord;
+};
+
+#endif // LSM6DS3_H
@@ -0,0 +1,20 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "Arduino.h"
+
+// The IMU is modelled above the bus (LSM6DS3.h), so only the calls the
+// firmware makes on the I2C port itself exist here
+class TwoWire {
+public:
+    void begin() {}
+    void setClock(uint32_t frequency) { clockHz = frequency; }
+    uint32_t getClock() const { return clockHz; }
+
+private:
+    uint32_t clockHz = 100000;
+};
+
+inline TwoWire Wire;
+
+#endif // WIRE_H
@@ -0,0 +1,208 @@
+#include "nrfx_qspi.h"
+#include "sim_flash.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define QSPI_STATUS_DPM 0x00000004
+#define QSPI_STATUS_READY 0x00000008
+#define QSPI_IFCONFIG1_DPMEN 0x01000000
+
+static NRF_QSPI_Type qspiRegisters = {0, 0, QSPI_STATUS_READY, 0};
+NRF_QSPI_Type* NRF_QSPI = &qspiRegisters;
+
+static int flashFd = -1;
+static uint8_t* flash = NULL;
+static nrfx_qspi_handler_t eventHandler = NULL;
+static void* eventContext = NULL;
+static bool initialized = false;
+static bool busy = false;
+static SimFlashStats flashStats = {0, 0, 0, 0};
+static long cutBudget = -1;   // Bytes that still change before the power cut, -1: none armed
+static bool powerCut = false;
+static unsigned failPrograms = 0;   // Programs still to refuse
+static long failReadAfter = -1;     // Reads still allowed before one is refused, -1: none armed
+static bool readRefused = false;
+
+static bool mapImage(int fd) {
+    void* image = mmap(NULL, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (image == MAP_FAILED) {
+        perror("mmap flash image");
+        return false;
+    }
+    flashFd = fd;
+    flash = (uint8_t*)image;
+    return true;
+}
+
+// A new or short image reads as erased flash
+bool simFlashOpen(const char* path) {
+    int fd = path != NULL ? open(path, O_RDWR | O_CREAT, 0644) : memfd_create("park-sensor-flash", 0);
+    if (fd < 0) {
+        perror(path != NULL ? path : "memfd_create");
+        return false;
+    }
+
+    struct stat info;
+    off_t existing = fstat(fd, &info) == 0 ? info.st_size : 0;
+    if (existing > (off_t)SIM_FLASH_SIZE) existing = SIM_FLASH_SIZE;
+    if (ftruncate(fd, SIM_FLASH_SIZE) != 0 || !mapImage(fd)) {
+        close(fd);
+        return false;
+    }
+    memset(flash + existing, 0xFF, SIM_FLASH_SIZE - existing);
+    return true;
+}
+
+bool simFlashAttach(int fd) {
+    return mapImage(fd);
+}
+
+int simFlashFd() {
+    return flashFd;
+}
+
+// The operation itself happened when it was started; completion is what waits
+void simFlashService() {
+    if (qspiRegisters.IFCONFIG1 & QSPI_IFCONFIG1_DPMEN) {
+        qspiRegisters.STATUS |= QSPI_STATUS_DPM;
+    } else {
+        qspiRegisters.STATUS &= ~QSPI_STATUS_DPM;
+    }
+
+    if (!busy) return;
+    busy = false;
+    if (eventHandler != NULL) eventHandler(NRFX_QSPI_EVENT_DONE, eventContext);
+}
+
+const SimFlashStats& getSimFlashStats() {
+    return flashStats;
+}
+
+void simFlashCutPowerAfter(long bytes) {
+    cutBudget = bytes;
+    powerCut = false;
+}
+
+void simFlashRestorePower() {
+    cutBudget = -1;
+    powerCut = false;
+}
+
+bool simFlashPowerIsCut() {
+    return powerCut;
+}
+
+uint8_t* simFlashImage() {
+    return flash;
+}
+
+void simFlashFailPrograms(unsigned count) {
+    failPrograms = count;
+}
+
+void simFlashFailReadAfter(long reads) {
+    failReadAfter = reads;
+    readRefused = false;
+}
+
+bool simFlashReadRefused() {
+    return readRefused;
+}
+
+// Whether the next byte of an erase or program still reaches the cells
+static bool powered() {
+    if (cutBudget < 0) return true;
+    if (cutBudget == 0) powerCut = true;
+    if (powerCut) return false;
+    cutBudget--;
+    return true;
+}
+
+static nrfx_err_t checkAccess(uint32_t address, size_t length) {
+    if (!initialized || flash == NULL) return NRFX_ERROR_INVALID_STATE;
+    if (busy) return NRFX_ERROR_BUSY;
+    if (address > SIM_FLASH_SIZE || length > SIM_FLASH_SIZE - address) return NRFX_ERROR_INVALID_ADDR;
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_qspi_init(nrfx_qspi_config_t const* config, nrfx_qspi_handler_t handler, void* context) {
+    (void)config;
+    if (flash == NULL) return NRFX_ERROR_TIMEOUT;   // No image: behaves like a flash that never answers
+    if (initialized) return NRFX_ERROR_INVALID_STATE;
+    eventHandler = handler;
+    eventContext = context;
+    initialized = true;
+    return NRFX_SUCCESS;
+}
+
+void nrfx_qspi_uninit() {
+    initialized = false;
+    busy = false;
+    eventHandler = NULL;
+}
+
+nrfx_err_t nrfx_qspi_cinstr_xfer(nrf_qspi_cinstr_conf_t const* config, void const* txBuffer, void* rxBuffer) {
+    (void)config;
+    (void)txBuffer;
+    (void)rxBuffer;
+    return initialized ? NRFX_SUCCESS : NRFX_ERROR_INVALID_STATE;
+}
+
+nrfx_err_t nrfx_qspi_erase(nrf_qspi_erase_len_t length, uint32_t startAddress) {
+    uint32_t size = length == NRF_QSPI_ERASE_LEN_4KB ? SIM_FLASH_SECTOR
+                    : length == NRF_QSPI_ERASE_LEN_64KB ? 16 * SIM_FLASH_SECTOR : SIM_FLASH_SIZE;
+    uint32_t start = length == NRF_QSPI_ERASE_LEN_ALL ? 0 : startAddress & ~(size - 1);
+    nrfx_err_t result = checkAccess(start, size);
+    if (result != NRFX_SUCCESS) return result;
+
+    if (cutBudget < 0) {
+        memset(flash + start, 0xFF, size);
+    } else {
+        for (uint32_t i = 0; i < size && powered(); i++) flash[start + i] = 0xFF;
+    }
+    flashStats.erases++;
+    busy = true;
+    return NRFX_SUCCESS;
+}
+
+// NOR programming can only clear bits
+nrfx_err_t nrfx_qspi_write(void const* txBuffer, size_t length, uint32_t address) {
+    nrfx_err_t result = checkAccess(address, length);
+    if (result != NRFX_SUCCESS) return result;
+    if (address % 4 != 0 || length % 4 != 0) return NRFX_ERROR_INVALID_ADDR;
+    if (failPrograms > 0) {
+        failPrograms--;
+        return NRFX_ERROR_INTERNAL;
+    }
+
+    const uint8_t* source = (const uint8_t*)txBuffer;
+    for (size_t i = 0; i < length && powered(); i++) flash[address + i] &= source[i];
+    flashStats.programs++;
+    flashStats.bytesProgrammed += length;
+    busy = true;
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_qspi_read(void* rxBuffer, size_t length, uint32_t address) {
+    nrfx_err_t result = checkAccess(address, length);
+    if (result != NRFX_SUCCESS) return result;
+    if (address % 4 != 0 || length % 4 != 0) return NRFX_ERROR_INVALID_ADDR;
+    if (failReadAfter >= 0 && failReadAfter-- == 0) {
+        readRefused = true;
+        return NRFX_ERROR_INTERNAL;
+    }
+
+    memcpy(rxBuffer, flash + address, length);
+    flashStats.reads++;
+    busy = true;
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_qspi_mem_busy_check() {
+    return busy ? NRFX_ERROR_BUSY : NRFX_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#ifndef NRFX_QSPI_H
+#define NRFX_QSPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host stand-in for the nrfx QSPI driver and the registers qspi_flash.cpp
+// touches. The flash behind it is the RAM or file image in sim_flash.h;
+// operations complete on the next yield()/delay(), where the device would
+// take the QSPI interrupt.
+
+typedef int nrfx_err_t;
+#define NRFX_SUCCESS 0
+#define NRFX_ERROR_BUSY 1
+#define NRFX_ERROR_TIMEOUT 2
+#define NRFX_ERROR_INVALID_STATE 3
+#define NRFX_ERROR_INVALID_ADDR 4
+#define NRFX_ERROR_INTERNAL 5
+
+#define NRFX_QSPI_CONFIG_XIP_OFFSET 0
+#define NRFX_QSPI_CONFIG_IRQ_PRIORITY 6
+#define NRFX_QSPI_CONFIG_ADDRMODE 0
+#define NRFX_QSPI_CONFIG_MODE 0
+
+typedef int nrf_qspi_readoc_t;
+typedef int nrf_qspi_writeoc_t;
+typedef int nrf_qspi_addrmode_t;
+typedef int nrf_qspi_frequency_t;
+typedef int nrf_qspi_spi_mode_t;
+#define NRF_QSPI_READOC_READ4O 4
+#define NRF_QSPI_WRITEOC_PP4O 3
+#define NRF_QSPI_FREQ_32MDIV1 0
+
+typedef enum {
+    NRF_QSPI_ERASE_LEN_4KB,
+    NRF_QSPI_ERASE_LEN_64KB,
+    NRF_QSPI_ERASE_LEN_ALL
+} nrf_qspi_erase_len_t;
+
+typedef enum {
+    NRF_QSPI_CINSTR_LEN_1B = 1,
+    NRF_QSPI_CINSTR_LEN_2B,
+    NRF_QSPI_CINSTR_LEN_3B
+} nrf_qspi_cinstr_len_t;
+
+typedef struct {
+    uint8_t sck_pin;
+    uint8_t csn_pin;
+    uint8_t io0_pin;
+    uint8_t io1_pin;
+    uint8_t io2_pin;
+    uint8_t io3_pin;
+} nrf_qspi_pins_t;
+
+typedef struct {
+    nrf_qspi_readoc_t readoc;
+    nrf_qspi_writeoc_t writeoc;
+    nrf_qspi_addrmode_t addrmode;
+    bool dpmconfig;
+} nrf_qspi_prot_conf_t;
+
+typedef struct {
+    uint8_t sck_delay;
+    bool dpmen;
+    nrf_qspi_spi_mode_t spi_mode;
+    nrf_qspi_frequency_t sck_freq;
+} nrf_qspi_phy_conf_t;
+
+typedef struct {
+    uint32_t xip_offset;
+    nrf_qspi_pins_t pins;
+    nrf_qspi_prot_conf_t prot_if;
+    nrf_qspi_phy_conf_t phy_if;
+    uint8_t irq_priority;
+} nrfx_qspi_config_t;
+
+typedef struct {
+    uint8_t opcode;
+    nrf_qspi_cinstr_len_t length;
+    bool io2_level;
+    bool io3_level;
+    bool wipwait;
+    bool wren;
+} nrf_qspi_cinstr_conf_t;
+
+typedef enum {
+    NRFX_QSPI_EVENT_DONE
+} nrfx_qspi_evt_t;
+
+typedef void (*nrfx_qspi_handler_t)(nrfx_qspi_evt_t event, void* context);
+
+nrfx_err_t nrfx_qspi_init(nrfx_qspi_config_t const* config, nrfx_qspi_handler_t handler, void* context);
+void nrfx_qspi_uninit();
+nrfx_err_t nrfx_qspi_cinstr_xfer(nrf_qspi_cinstr_conf_t const* config, void const* txBuffer, void* rxBuffer);
+nrfx_err_t nrfx_qspi_erase(nrf_qspi_erase_len_t length, uint32_t startAddress);
+nrfx_err_t nrfx_qspi_write(void const* txBuffer, size_t length, uint32_t address);
+nrfx_err_t nrfx_qspi_read(void* rxBuffer, size_t length, uint32_t address);
+nrfx_err_t nrfx_qspi_mem_busy_check();
+
+typedef struct {
+    volatile uint32_t TASKS_ACTIVATE;
+    volatile uint32_t DPMDUR;
+    volatile uint32_t STATUS;
+    volatile uint32_t IFCONFIG1;
+} NRF_QSPI_Type;
+
+extern NRF_QSPI_Type* NRF_QSPI;
+
+#endif // NRFX_QSPI_H
@@ -0,0 +1,247 @@
+// park_sensor_sim - the park sensor firmware running natively on Linux
+//
+// Runs main.ino's setup() and loop() unchanged against the shims in host/:
+// a scriptable IMU (sim_imu.h), a RAM or file backed QSPI flash
+// (sim_flash.h) and USB serial on a pseudo-terminal or stdin/stdout
+// (sim_serial.h). Any serial client, the ASCOM driver included, can open
+// the pty as if it were the device. Each --session opens one more pty served
+// by the same command engine with its own session, the way a BLE UART link
+// is served next to USB on the device.
+//
+// Build: cmake -S . -B build && cmake --build build --target park_sensor_sim
+// Usage: park_sensor_sim [--stdio | --link PATH] [--session PATH]... [--script FILE]
+//                        [--flash FILE] [--simulated] [--run-for SECONDS] [--leds]
+//
+// In pty mode, IMU script lines typed on stdin (e.g. "slew 45 0 3") apply
+// from the moment they are entered. With --stdio --simulated the whole of
+// stdin is read first and its lines are received one every --line-interval
+// milliseconds after setup(), so the run does not depend on how fast the
+// input arrived.
+
+#include "Arduino.h"
+#include "sim_board.h"
+#include "sim_clock.h"
+#include "sim_flash.h"
+#include "sim_imu.h"
+#include "serial_interface.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+#define STDIO_LINGER_US 1000000   // Keep running after end of input so replies drain
+#define DEFAULT_LINE_INTERVAL_MS 100
+#define MAX_EXTRA_SESSIONS (MAX_COMMAND_SESSIONS - 1)   // USB serial takes the first
+
+struct SimOptions {
+    bool stdio = false;
+    const char* linkPath = NULL;
+    const char* scriptPath = NULL;
+    const char* flashPath = NULL;
+    bool simulated = false;
+    double runForSeconds = 0;       // 0: until killed
+    bool leds = false;
+    double lineIntervalMs = DEFAULT_LINE_INTERVAL_MS;
+    std::vector<const char*> sessionPaths;
+};
+
+// A pty served as one more command session
+struct PtySession {
+    HostSerial serial;
+    StreamTransport<HostSerial> transport;
+    CommandSession session;
+
+    PtySession() : transport("pty", serial) {}
+};
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [--stdio | --link PATH] [--session PATH]... [--script FILE] [--flash FILE]\n"
+            "          [--simulated] [--run-for SECONDS] [--leds] [--line-interval MS]\n"
+            "  --stdio           serial on stdin/stdout instead of a pty\n"
+            "  --link PATH       symlink to the pty (e.g. /tmp/ttyPARK)\n"
+            "  --session PATH    one more pty with its own command session (up to %d)\n"
+            "  --script FILE     IMU script (see host/sim_imu.h)\n"
+            "  --flash FILE      persistent 2MB flash image (default: fresh, in RAM)\n"
+            "  --simulated       simulated clock: deterministic, faster than real time\n"
+            "  --run-for SECONDS exit after this much device time (with --stdio, even after input ends)\n"
+            "  --leds            report LED changes on stderr\n"
+            "  --line-interval MS  spacing of stdin lines with --stdio --simulated (default %d)\n",
+            name, MAX_EXTRA_SESSIONS, DEFAULT_LINE_INTERVAL_MS);
+}
+
+static bool parseOptions(int argc, char** argv, SimOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--stdio")) opt.stdio = true;
+        else if (!strcmp(arg, "--simulated")) opt.simulated = true;
+        else if (!strcmp(arg, "--leds")) opt.leds = true;
+        else if (!strcmp(arg, "--link") && hasValue) opt.linkPath = argv[++i];
+        else if (!strcmp(arg, "--session") && hasValue) opt.sessionPaths.push_back(argv[++i]);
+        else if (!strcmp(arg, "--script") && hasValue) opt.scriptPath = argv[++i];
+        else if (!strcmp(arg, "--flash") && hasValue) opt.flashPath = argv[++i];
+        else if (!strcmp(arg, "--run-for") && hasValue) opt.runForSeconds = atof(argv[++i]);
+        else if (!strcmp(arg, "--line-interval") && hasValue) opt.lineIntervalMs = atof(argv[++i]);
+        else return false;
+    }
+    return opt.sessionPaths.size() <= MAX_EXTRA_SESSIONS;
+}
+
+// A reset hands the pty and flash image over in the environment
+static int inheritedFd(const char* variable) {
+    const char* value = getenv(variable);
+    return value != NULL ? atoi(value) : -1;
+}
+
+// Session ptys come back in --session order after a reset
+static std::vector<int> inheritedSessionFds() {
+    std::vector<int> fds;
+    const char* value = getenv(SIM_RESET_ENV_SESSIONS);
+    while (value != NULL && *value != '\0') {
+        char* end;
+        long fd = strtol(value, &end, 10);
+        if (end == value) break;
+        fds.push_back((int)fd);
+        value = *end == ',' ? end + 1 : end;
+    }
+    return fds;
+}
+
+// The ptys exist before setup() so clients can open them during its wait for
+// USB; they are served once setup() has registered the USB session
+static bool openSessionPtys(const SimOptions& opt, std::vector<PtySession*>& ptys) {
+    std::vector<int> inherited = inheritedSessionFds();
+    for (size_t i = 0; i < opt.sessionPaths.size(); i++) {
+        PtySession* pty = new PtySession();   // Served until exit
+        if (i < inherited.size()) {
+            pty->serial.attachPty(inherited[i]);
+        } else if (!pty->serial.openPty(opt.sessionPaths[i])) {
+            return false;
+        }
+        simBoardKeepSessionPty(pty->serial.ptyFd());
+        ptys.push_back(pty);
+    }
+    return true;
+}
+
+static void addSessions(const SimOptions& opt, const std::vector<PtySession*>& ptys) {
+    for (size_t i = 0; i < ptys.size(); i++) {
+        int index = addCommandSession(ptys[i]->session, ptys[i]->transport);
+        fprintf(stderr, "Session %d on %s -> %s\n", index, ptys[i]->serial.ptyName(), opt.sessionPaths[i]);
+    }
+}
+
+static std::vector<std::string> readInputLines() {
+    std::vector<std::string> lines;
+    std::string line;
+    int c;
+    while ((c = getchar()) != EOF) {
+        line += (char)c;
+        if (c == '\n') {
+            lines.push_back(line);
+            line.clear();
+        }
+    }
+    if (!line.empty()) lines.push_back(line);
+    return lines;
+}
+
+// Complete lines from stdin go to the IMU script at the current time
+static void pollImuCommands(std::string& pending) {
+    char buffer[256];
+    ssize_t count;
+    while ((count = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+        pending.append(buffer, count);
+    }
+
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+        std::string line = pending.substr(0, end);
+        pending.erase(0, end + 1);
+
+        char error[128];
+        if (!simImuRunScript(line.c_str(), simClockMicros(), error, sizeof(error))) {
+            fprintf(stderr, "imu: %s\n", error);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    SimOptions opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    simBoardInit(argc, argv);
+    simBoardTraceLeds(opt.leds);
+    simClockSetMode(opt.simulated ? SIM_CLOCK_SIMULATED : SIM_CLOCK_REAL);
+
+    char error[256];
+    if (opt.scriptPath != NULL && !simImuLoadScriptFile(opt.scriptPath, error, sizeof(error))) {
+        fprintf(stderr, "%s\n", error);
+        return 1;
+    }
+
+    int flashFd = inheritedFd(SIM_RESET_ENV_FLASH);
+    if (flashFd >= 0 ? !simFlashAttach(flashFd) : !simFlashOpen(opt.flashPath)) return 1;
+
+    // Simulated runs take their input on the simulated clock
+    bool scheduledInput = opt.stdio && opt.simulated;
+    std::vector<std::string> inputLines;
+    if (scheduledInput) inputLines = readInputLines();
+
+    int ptyFd = inheritedFd(SIM_RESET_ENV_PTY);
+    if (opt.stdio) {
+        Serial.attachStdio(!scheduledInput);
+    } else {
+        if (ptyFd >= 0) {
+            Serial.attachPty(ptyFd);
+        } else if (!Serial.openPty(opt.linkPath)) {
+            return 1;
+        }
+        fprintf(stderr, "Serial on %s%s%s\n", Serial.ptyName(), opt.linkPath != NULL ? " -> " : "",
+                opt.linkPath != NULL ? opt.linkPath : "");
+        fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    }
+
+    std::vector<PtySession*> sessionPtys;
+    if (!openSessionPtys(opt, sessionPtys)) return 1;
+
+    uint64_t runForUs = (uint64_t)(opt.runForSeconds * 1e6);
+    uint64_t lineIntervalUs = (uint64_t)(opt.lineIntervalMs * 1000);
+    uint64_t stopUs = 0;
+    std::string imuInput;
+    size_t nextLine = 0;
+
+    setup();
+    addSessions(opt, sessionPtys);
+    uint64_t nextLineUs = simClockMicros();
+    for (;;) {
+        if (scheduledInput && nextLine < inputLines.size() && simClockMicros() >= nextLineUs) {
+            Serial.inject(inputLines[nextLine].data(), inputLines[nextLine].size());
+            nextLine++;
+            nextLineUs += lineIntervalUs;
+        }
+        loop();
+
+        if (!opt.stdio) pollImuCommands(imuInput);
+        bool inputDone = scheduledInput ? nextLine >= inputLines.size() : Serial.inputEnded();
+        // End of stdio input stops the run unless it has a fixed length
+        if (opt.stdio && runForUs == 0 && inputDone && stopUs == 0) stopUs = simClockMicros() + STDIO_LINGER_US;
+        uint64_t now = simClockMicros();
+        if ((runForUs > 0 && now >= runForUs) || (stopUs > 0 && now >= stopUs)) break;
+    }
+
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "sim_board.h"
+#include "sim_clock.h"
+#include "sim_flash.h"
+#include "Arduino.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static char** savedArgv = NULL;
+static int pinStates[SIM_BOARD_PINS];
+static bool traceLeds = false;
+static int sessionPtys[SIM_BOARD_MAX_SESSION_PTYS];
+static int sessionPtyCount = 0;
+
+void simBoardInit(int argc, char** argv) {
+    (void)argc;
+    savedArgv = argv;
+    for (int pin = 0; pin < SIM_BOARD_PINS; pin++) pinStates[pin] = HIGH;   // LEDs are active low
+}
+
+void simBoardService() {
+    simFlashService();
+}
+
+static const char* ledName(int pin) {
+    switch (pin) {
+        case LED_RED: return "red";
+        case LED_GREEN: return "green";
+        case LED_BLUE: return "blue";
+        default: return NULL;
+    }
+}
+
+void simBoardSetPin(int pin, int value) {
+    if (pin < 0 || pin >= SIM_BOARD_PINS) return;
+    int previous = pinStates[pin];
+    pinStates[pin] = value;
+
+    const char* name = ledName(pin);
+    if (traceLeds && name != NULL && previous != value) {
+        fprintf(stderr, "[%10.3f] LED %s %s\n", simClockMicros() / 1e6, name, value == LOW ? "on" : "off");
+    }
+}
+
+int simBoardGetPin(int pin) {
+    return pin >= 0 && pin < SIM_BOARD_PINS ? pinStates[pin] : LOW;
+}
+
+void simBoardTraceLeds(bool enabled) {
+    traceLeds = enabled;
+}
+
+void simBoardKeepSessionPty(int fd) {
+    if (fd >= 0 && sessionPtyCount < SIM_BOARD_MAX_SESSION_PTYS) sessionPtys[sessionPtyCount++] = fd;
+}
+
+static void keepAcrossExec(int fd, const char* variable) {
+    if (fd < 0) return;
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) & ~FD_CLOEXEC);
+    char value[16];
+    snprintf(value, sizeof(value), "%d", fd);
+    setenv(variable, value, 1);
+}
+
+void simBoardReset() {
+    fprintf(stderr, "[%10.3f] System reset\n", simClockMicros() / 1e6);
+    keepAcrossExec(Serial.ptyFd(), SIM_RESET_ENV_PTY);
+    keepAcrossExec(simFlashFd(), SIM_RESET_ENV_FLASH);
+
+    char fds[SIM_BOARD_MAX_SESSION_PTYS * 12] = {0};
+    size_t length = 0;
+    for (int i = 0; i < sessionPtyCount; i++) {
+        fcntl(sessionPtys[i], F_SETFD, fcntl(sessionPtys[i], F_GETFD) & ~FD_CLOEXEC);
+        length += snprintf(fds + length, sizeof(fds) - length, "%s%d", i > 0 ? "," : "", sessionPtys[i]);
+    }
+    if (sessionPtyCount > 0) setenv(SIM_RESET_ENV_SESSIONS, fds, 1);
+
+    char count[16];
+    snprintf(count, sizeof(count), "%lu", simBoardResetCount() + 1);
+    setenv(SIM_RESET_ENV_COUNT, count, 1);
+
+    fflush(NULL);
+    execv("/proc/self/exe", savedArgv);
+    perror("execv");
+    _exit(1);
+}
+
+unsigned long simBoardResetCount() {
+    const char* count = getenv(SIM_RESET_ENV_COUNT);
+    return count != NULL ? strtoul(count, NULL, 10) : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+// The rest of the XIAO for the host build: background peripheral work, the
+// LED pins and the reset line.
+//
+// NVIC_SystemReset() re-executes the simulator with the serial pty and the
+// flash image handed over, so a connected client keeps its port and
+// settings written before the reset are there after it, as on the device.
+// Extra session ptys (park_sensor_sim --session) are handed over the same way.
+// The IMU script starts again from the top.
+
+#define SIM_BOARD_PINS 32
+
+#define SIM_RESET_ENV_PTY "PARK_SIM_PTY_FD"
+#define SIM_RESET_ENV_FLASH "PARK_SIM_FLASH_FD"
+#define SIM_RESET_ENV_COUNT "PARK_SIM_RESETS"
+#define SIM_RESET_ENV_SESSIONS "PARK_SIM_SESSION_FDS"   // Comma separated
+#define SIM_BOARD_MAX_SESSION_PTYS 8
+
+void simBoardInit(int argc, char** argv);
+void simBoardService();                  // Called whenever the firmware waits
+
+void simBoardSetPin(int pin, int value);
+int simBoardGetPin(int pin);
+void simBoardTraceLeds(bool enabled);    // Report LED changes on stderr
+void simBoardKeepSessionPty(int fd);     // Hand this pty over on reset too
+
+[[noreturn]] void simBoardReset();
+unsigned long simBoardResetCount();      // Resets since the simulator was started
+
+#endif // SIM_BOARD_H
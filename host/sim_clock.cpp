@@ -0,0 +1,51 @@
+#include "sim_clock.h"
+
+#include <time.h>
+
+static SimClockMode clockMode = SIM_CLOCK_REAL;
+static uint64_t simulatedUs = 0;
+static uint64_t realStartUs = 0;
+static bool realStarted = false;
+
+static uint64_t monotonicUs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + now.tv_nsec / 1000;
+}
+
+void simClockSetMode(SimClockMode mode) {
+    // Carry the current time over so the clock never jumps back
+    uint64_t now = simClockMicros();
+    clockMode = mode;
+    simulatedUs = now;
+    realStartUs = monotonicUs() - now;
+    realStarted = true;
+}
+
+SimClockMode simClockGetMode() {
+    return clockMode;
+}
+
+uint64_t simClockMicros() {
+    if (clockMode == SIM_CLOCK_SIMULATED) return simulatedUs;
+    if (!realStarted) {
+        realStartUs = monotonicUs();
+        realStarted = true;
+    }
+    return monotonicUs() - realStartUs;
+}
+
+void simClockAdvance(uint64_t us) {
+    if (clockMode == SIM_CLOCK_SIMULATED) simulatedUs += us;
+}
+
+void simClockSleep(uint64_t us) {
+    if (clockMode == SIM_CLOCK_SIMULATED) {
+        simulatedUs += us;
+        return;
+    }
+    struct timespec duration;
+    duration.tv_sec = us / 1000000u;
+    duration.tv_nsec = (us % 1000000u) * 1000;
+    while (nanosleep(&duration, &duration) != 0) {}
+}
@@ -0,0 +1,25 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdint.h>
+
+// Time base behind millis()/micros() in the host build.
+//
+// Real time follows the monotonic clock, for interactive use over the pty.
+// Simulated time only moves when the firmware calls delay() or the harness
+// calls simClockAdvance(), so a run is deterministic and as fast as the
+// CPU allows. millis() and micros() wrap at 32 bits like on the device.
+
+enum SimClockMode {
+    SIM_CLOCK_REAL,
+    SIM_CLOCK_SIMULATED
+};
+
+void simClockSetMode(SimClockMode mode);
+SimClockMode simClockGetMode();
+
+uint64_t simClockMicros();             // Since start, never wraps
+void simClockAdvance(uint64_t us);     // Simulated time only; real time ignores it
+void simClockSleep(uint64_t us);       // delay(): sleeps or advances
+
+#endif // SIM_CLOCK_H
@@ -0,0 +1,46 @@
+#ifndef SIM_FLASH_H
+#define SIM_FLASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The XIAO's 2MB QSPI NOR flash for the host build, behind the nrfx_qspi.h
+// shim. Programming can only clear bits and a 4KB erase sets them again, as
+// on the chip. The image lives in an anonymous memory file, or in a file
+// given on the command line so settings and the sample log survive restarts.
+
+#define SIM_FLASH_SIZE (2u * 1024 * 1024)
+#define SIM_FLASH_SECTOR 4096
+
+bool simFlashOpen(const char* path);   // NULL: fresh erased RAM image
+bool simFlashAttach(int fd);           // Image handed over by a simulated reset
+int simFlashFd();
+
+// Completes the operation in flight, calling the driver's event handler
+void simFlashService();
+
+struct SimFlashStats {
+    unsigned long erases;
+    unsigned long programs;
+    unsigned long reads;
+    unsigned long bytesProgrammed;
+};
+
+const SimFlashStats& getSimFlashStats();
+
+// Power-cut injection for tests. After `bytes` more bytes have been erased or
+// programmed (each operation in address order) the flash stops changing, as
+// if power failed part way through. The firmware still sees every operation
+// complete; simFlashRestorePower() ends the cut, like the next power-up.
+void simFlashCutPowerAfter(long bytes);
+void simFlashRestorePower();
+bool simFlashPowerIsCut();             // The cut has happened
+uint8_t* simFlashImage();              // The whole image, for tests to snapshot and restore
+
+// The next `count` programs are refused by the peripheral, as a bus error would
+void simFlashFailPrograms(unsigned count);
+// After `reads` more read transfers one is refused, -1 disarms
+void simFlashFailReadAfter(long reads);
+bool simFlashReadRefused();            // The armed read has been refused
+
+#endif // SIM_FLASH_H
@@ -0,0 +1,303 @@
+#include "sim_imu.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct PoseKey {
+    uint64_t us;
+    float pitch;
+    float roll;
+};
+
+struct TempKey {
+    uint64_t us;
+    float celsius;
+};
+
+// Noise, bias, vibration and seed change in steps
+struct SettingsKey {
+    uint64_t us;
+    float accelNoise;
+    float gyroNoise;
+    float bias[3];
+    float vibrationAmplitude;
+    float vibrationHz;
+    uint32_t seed;
+};
+
+struct FailInterval {
+    uint64_t startUs;
+    uint64_t endUs;
+};
+
+static std::vector<PoseKey> poseKeys;
+static std::vector<TempKey> tempKeys;
+static std::vector<SettingsKey> settingsKeys;
+static std::vector<FailInterval> failIntervals;
+static uint64_t scriptStartUs = 0;
+static uint64_t scriptLengthUs = 0;
+static bool scriptRepeat = false;
+
+// Index of the last key at or before us (keys are sorted, the first is at or before any query)
+template <typename Key>
+static size_t keyAt(const std::vector<Key>& keys, uint64_t us) {
+    auto next = std::upper_bound(keys.begin(), keys.end(), us,
+                                 [](uint64_t time, const Key& key) { return time < key.us; });
+    return next == keys.begin() ? 0 : (size_t)(next - keys.begin() - 1);
+}
+
+static uint64_t scriptTime(uint64_t us) {
+    if (!scriptRepeat || scriptLengthUs == 0 || us < scriptStartUs + scriptLengthUs) return us;
+    return scriptStartUs + (us - scriptStartUs) % scriptLengthUs;
+}
+
+static void resetTo(uint64_t us, const SimImuState& state) {
+    poseKeys.assign(1, PoseKey{us, state.pitch, state.roll});
+    tempKeys.assign(1, TempKey{us, state.temperature});
+    SettingsKey settings;
+    settings.us = us;
+    settings.accelNoise = state.accelNoise;
+    settings.gyroNoise = state.gyroNoise;
+    memcpy(settings.bias, state.bias, sizeof(settings.bias));
+    settings.vibrationAmplitude = state.vibrationAmplitude;
+    settings.vibrationHz = state.vibrationHz;
+    settings.seed = state.seed;
+    settingsKeys.assign(1, settings);
+    failIntervals.clear();
+    scriptStartUs = us;
+    scriptLengthUs = 0;
+    scriptRepeat = false;
+}
+
+void simImuReset() {
+    SimImuState state;
+    memset(&state, 0, sizeof(state));
+    state.temperature = SIM_IMU_DEFAULT_TEMP;
+    state.accelNoise = SIM_IMU_DEFAULT_ACCEL_NOISE;
+    state.gyroNoise = SIM_IMU_DEFAULT_GYRO_NOISE;
+    state.seed = 1;
+    resetTo(0, state);
+}
+
+SimImuState simImuStateAt(uint64_t us) {
+    if (poseKeys.empty()) simImuReset();
+    us = scriptTime(us);
+
+    SimImuState state;
+    memset(&state, 0, sizeof(state));
+
+    size_t pose = keyAt(poseKeys, us);
+    if (pose + 1 < poseKeys.size() && poseKeys[pose + 1].us > poseKeys[pose].us && us >= poseKeys[pose].us) {
+        const PoseKey& from = poseKeys[pose];
+        const PoseKey& to = poseKeys[pose + 1];
+        float seconds = (to.us - from.us) / 1e6f;
+        float fraction = (us - from.us) / 1e6f / seconds;
+        state.pitch = from.pitch + (to.pitch - from.pitch) * fraction;
+        state.roll = from.roll + (to.roll - from.roll) * fraction;
+        state.pitchRate = (to.pitch - from.pitch) / seconds;
+        state.rollRate = (to.roll - from.roll) / seconds;
+    } else {
+        state.pitch = poseKeys[pose].pitch;
+        state.roll = poseKeys[pose].roll;
+    }
+
+    size_t temp = keyAt(tempKeys, us);
+    if (temp + 1 < tempKeys.size() && tempKeys[temp + 1].us > tempKeys[temp].us && us >= tempKeys[temp].us) {
+        const TempKey& from = tempKeys[temp];
+        const TempKey& to = tempKeys[temp + 1];
+        state.temperature = from.celsius + (to.celsius - from.celsius) * (float)(us - from.us) / (float)(to.us - from.us);
+    } else {
+        state.temperature = tempKeys[temp].celsius;
+    }
+
+    const SettingsKey& settings = settingsKeys[keyAt(settingsKeys, us)];
+    state.accelNoise = settings.accelNoise;
+    state.gyroNoise = settings.gyroNoise;
+    memcpy(state.bias, settings.bias, sizeof(state.bias));
+    state.vibrationAmplitude = settings.vibrationAmplitude;
+    state.vibrationHz = settings.vibrationHz;
+    state.seed = settings.seed;
+
+    for (const FailInterval& interval : failIntervals) {
+        if (us >= interval.startUs && us < interval.endUs) state.failed = true;
+    }
+    return state;
+}
+
+// Counter-based generator: the same (seed, stream, index, channel) always
+// gives the same value, whatever order the samples are asked for in
+static uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+static float gaussian(uint32_t seed, uint32_t stream, uint64_t index, uint32_t channel) {
+    uint64_t bits = mix(mix(mix(((uint64_t)seed << 32) | stream) ^ index) ^ channel);
+    double u1 = ((bits >> 11) + 1.0) / 9007199254740993.0;       // (0, 1]
+    double u2 = (mix(bits) >> 11) / 9007199254740992.0;
+    return (float)(sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+}
+
+SimImuSample simImuSampleAt(uint64_t index, float odrHz, uint32_t stream) {
+    uint64_t us = (uint64_t)(index * 1e6 / odrHz);
+    SimImuState state = simImuStateAt(us);
+
+    SimImuSample sample;
+    sample.failed = state.failed;
+    sample.temperature = state.temperature;
+
+    // Gravity in the sensor frame; readPosition() inverts exactly this
+    float pitch = state.pitch * (float)M_PI / 180.0f;
+    float roll = state.roll * (float)M_PI / 180.0f;
+    float gravity[3] = {-sinf(pitch), cosf(pitch) * sinf(roll), cosf(pitch) * cosf(roll)};
+    float vibration = 0.0f;
+    if (state.vibrationAmplitude != 0.0f && state.vibrationHz > 0.0f) {
+        vibration = state.vibrationAmplitude * (float)sin(2.0 * M_PI * state.vibrationHz * (us / 1e6));
+    }
+    float rates[3] = {state.rollRate, state.pitchRate, 0.0f};
+
+    for (int axis = 0; axis < 3; axis++) {
+        sample.accel[axis] = gravity[axis] + state.bias[axis] + vibration +
+                             state.accelNoise * gaussian(state.seed, stream, index, axis);
+        sample.gyro[axis] = rates[axis] + state.gyroNoise * gaussian(state.seed, stream, index, 3 + axis);
+    }
+    return sample;
+}
+
+static bool parseNumbers(char* arguments, float* values, int minimum, int maximum, int& count) {
+    count = 0;
+    for (char* token = strtok(arguments, " \t"); token != NULL; token = strtok(NULL, " \t")) {
+        if (count == maximum) return false;
+        char* end;
+        values[count++] = strtof(token, &end);
+        if (*end != '\0') return false;
+    }
+    return count >= minimum;
+}
+
+bool simImuRunScript(const char* text, uint64_t startUs, char* error, size_t errorSize) {
+    // Everything after startUs is replaced, starting from the state there
+    resetTo(startUs, simImuStateAt(startUs));
+    uint64_t now = startUs;
+    bool repeat = false;
+
+    std::string script(text);
+    size_t lineStart = 0;
+    for (int lineNumber = 1; lineStart < script.size(); lineNumber++) {
+        size_t lineEnd = script.find('\n', lineStart);
+        if (lineEnd == std::string::npos) lineEnd = script.size();
+        std::string line = script.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.resize(comment);
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "%s", line.c_str());
+        char* command = strtok(buffer, " \t\r");
+        if (command == NULL) continue;
+        char* arguments = strtok(NULL, "");
+        char empty[] = "";
+        if (arguments == NULL) arguments = empty;
+
+        float values[3];
+        int count;
+        bool valid = true;
+        SimImuState current = simImuStateAt(now);
+        SettingsKey settings = settingsKeys.back();
+        settings.us = now;
+        bool settingsChanged = false;
+
+        if (strcmp(command, "pose") == 0) {
+            valid = parseNumbers(arguments, values, 2, 2, count);
+            if (valid) {
+                poseKeys.push_back(PoseKey{now, current.pitch, current.roll});
+                poseKeys.push_back(PoseKey{now, values[0], values[1]});
+            }
+        } else if (strcmp(command, "slew") == 0) {
+            valid = parseNumbers(arguments, values, 3, 3, count) && values[2] >= 0;
+            if (valid) {
+                poseKeys.push_back(PoseKey{now, current.pitch, current.roll});
+                now += (uint64_t)(values[2] * 1e6);
+                poseKeys.push_back(PoseKey{now, values[0], values[1]});
+            }
+        } else if (strcmp(command, "hold") == 0) {
+            valid = parseNumbers(arguments, values, 1, 1, count) && values[0] >= 0;
+            if (valid) now += (uint64_t)(values[0] * 1e6);
+        } else if (strcmp(command, "temp") == 0) {
+            valid = parseNumbers(arguments, values, 1, 2, count) && (count == 1 || values[1] >= 0);
+            if (valid) {
+                // A ramp runs alongside later commands
+                tempKeys.erase(tempKeys.begin() + keyAt(tempKeys, now) + 1, tempKeys.end());
+                tempKeys.push_back(TempKey{now, current.temperature});
+                uint64_t rampUs = count == 2 ? (uint64_t)(values[1] * 1e6) : 0;
+                tempKeys.push_back(TempKey{now + rampUs, values[0]});
+            }
+        } else if (strcmp(command, "noise") == 0) {
+            valid = parseNumbers(arguments, values, 1, 2, count) && values[0] >= 0;
+            if (valid) {
+                settings.accelNoise = values[0];
+                if (count == 2) settings.gyroNoise = values[1];
+                settingsChanged = true;
+            }
+        } else if (strcmp(command, "bias") == 0) {
+            valid = parseNumbers(arguments, values, 3, 3, count);
+            if (valid) {
+                memcpy(settings.bias, values, sizeof(settings.bias));
+                settingsChanged = true;
+            }
+        } else if (strcmp(command, "vibration") == 0) {
+            valid = parseNumbers(arguments, values, 2, 2, count) && values[1] >= 0;
+            if (valid) {
+                settings.vibrationAmplitude = values[0];
+                settings.vibrationHz = values[1];
+                settingsChanged = true;
+            }
+        } else if (strcmp(command, "seed") == 0) {
+            valid = parseNumbers(arguments, values, 1, 1, count) && values[0] >= 0;
+            if (valid) {
+                settings.seed = (uint32_t)values[0];
+                settingsChanged = true;
+            }
+        } else if (strcmp(command, "fail") == 0) {
+            valid = parseNumbers(arguments, values, 1, 1, count) && values[0] >= 0;
+            if (valid) failIntervals.push_back(FailInterval{now, now + (uint64_t)(values[0] * 1e6)});
+        } else if (strcmp(command, "repeat") == 0) {
+            repeat = true;
+        } else {
+            snprintf(error, errorSize, "line %d: unknown command '%s'", lineNumber, command);
+            return false;
+        }
+
+        if (!valid) {
+            snprintf(error, errorSize, "line %d: bad arguments for '%s'", lineNumber, command);
+            return false;
+        }
+        if (settingsChanged) settingsKeys.push_back(settings);
+    }
+
+    scriptLengthUs = now - startUs;
+    scriptRepeat = repeat && scriptLengthUs > 0;
+    return true;
+}
+
+bool simImuLoadScriptFile(const char* path, char* error, size_t errorSize) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        snprintf(error, errorSize, "%s: %s", path, strerror(errno));
+        return false;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, count);
+    fclose(file);
+    return simImuRunScript(text.c_str(), 0, error, errorSize);
+}
@@ -0,0 +1,69 @@
+#ifndef SIM_IMU_H
+#define SIM_IMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Scriptable model of the LSM6DS3TR-C behind the host LSM6DS3 shim.
+//
+// The model holds the sensor's pose (pitch and roll, matching readPosition's
+// convention), temperature, accelerometer noise and bias and an optional
+// vibration, all as functions of time. The LSM6DS3 shim asks for samples on
+// the IMU's own ODR grid and quantizes them to raw counts at the configured
+// full scale. Noise is derived from the sample index and the seed, which
+// makes a run in simulated time reproducible bit for bit.
+//
+// Script commands, one per line ('#' starts a comment). Times are seconds;
+// `hold` and `slew` move the script's clock forward, the rest take effect
+// at the current script time:
+//   pose PITCH ROLL              jump to an attitude (degrees)
+//   slew PITCH ROLL SECONDS      move there at constant rate
+//   hold SECONDS                 keep everything as it is
+//   temp CELSIUS [SECONDS]       set, or ramp over SECONDS in the background
+//   noise ACCEL_G [GYRO_DPS]     white noise standard deviation per sample
+//   bias X_G Y_G Z_G             constant accelerometer offset
+//   vibration AMPLITUDE_G HZ     sinusoid on all accelerometer axes (0 = off)
+//   seed N                       noise generator seed
+//   fail SECONDS                 bus errors (NaN readings) for a while
+//   repeat                       restart the script from the top when it ends
+
+#define SIM_IMU_DEFAULT_TEMP 25.0f
+#define SIM_IMU_DEFAULT_ACCEL_NOISE 0.0013f   // g, about the datasheet density over a 200Hz bandwidth
+#define SIM_IMU_DEFAULT_GYRO_NOISE 0.06f      // deg/s
+
+struct SimImuSample {
+    float accel[3];          // g, x y z
+    float gyro[3];           // deg/s
+    float temperature;       // degC
+    bool failed;             // Bus error at this time
+};
+
+// Replaces the script timeline from startUs on with the commands in text.
+// Returns false and fills error (line number and reason) on a parse error.
+bool simImuRunScript(const char* text, uint64_t startUs, char* error, size_t errorSize);
+bool simImuLoadScriptFile(const char* path, char* error, size_t errorSize);
+void simImuReset();
+
+// Model state at a time, independent of the ODR grid
+struct SimImuState {
+    float pitch;             // Degrees
+    float roll;
+    float pitchRate;         // Degrees per second, while slewing
+    float rollRate;
+    float temperature;
+    float accelNoise;
+    float gyroNoise;
+    float bias[3];
+    float vibrationAmplitude;
+    float vibrationHz;
+    uint32_t seed;
+    bool failed;
+};
+
+SimImuState simImuStateAt(uint64_t us);
+
+// Sample number index of a stream at odrHz (taken at index / odrHz seconds);
+// stream selects an independent noise sequence, e.g. output registers vs FIFO
+SimImuSample simImuSampleAt(uint64_t index, float odrHz, uint32_t stream);
+
+#endif // SIM_IMU_H
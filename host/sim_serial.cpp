@@ -0,0 +1,126 @@
+#include "sim_serial.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+HostSerial Serial;
+
+static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+bool HostSerial::openPty(const char* linkPath) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        if (master >= 0) close(master);
+        return false;
+    }
+
+    // Raw mode on the device side, so clients see the bytes the firmware sent
+    const char* name = ptsname(master);
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave >= 0) {
+        struct termios settings;
+        if (tcgetattr(slave, &settings) == 0) {
+            cfmakeraw(&settings);
+            tcsetattr(slave, TCSANOW, &settings);
+        }
+        close(slave);
+    }
+
+    if (linkPath != NULL) {
+        unlink(linkPath);
+        if (symlink(name, linkPath) != 0) perror(linkPath);
+    }
+    attachPty(master);
+    return true;
+}
+
+void HostSerial::attachPty(int masterFd) {
+    inFd = outFd = masterFd;
+    isPty = true;
+    const char* name = ptsname(masterFd);
+    snprintf(slaveName, sizeof(slaveName), "%s", name != NULL ? name : "");
+    setNonBlocking(masterFd);
+}
+
+void HostSerial::attachStdio(bool readInput) {
+    inFd = readInput ? STDIN_FILENO : -1;
+    outFd = STDOUT_FILENO;
+    isPty = false;
+    if (readInput) setNonBlocking(inFd);
+}
+
+void HostSerial::inject(const char* data, size_t length) {
+    injected.append(data, length);
+}
+
+bool HostSerial::peerConnected() {
+    if (!isPty) return outFd >= 0;
+    // The master reports a hangup while no client has the pty open
+    struct pollfd poller = {inFd, POLLOUT, 0};
+    return poll(&poller, 1, 0) >= 0 && !(poller.revents & POLLHUP);
+}
+
+HostSerial::operator bool() {
+    return peerConnected();
+}
+
+void HostSerial::refill() {
+    if (rxCount > 0) return;
+    if (!injected.empty()) {
+        rxCount = injected.copy((char*)rxBuffer, sizeof(rxBuffer));
+        injected.erase(0, rxCount);
+        rxHead = 0;
+        totalRead += rxCount;
+        return;
+    }
+    if (inFd < 0) return;
+    ssize_t count = ::read(inFd, rxBuffer, sizeof(rxBuffer));
+    // EAGAIN: nothing waiting; EIO on a pty master: no client; 0 on stdio: end of input
+    if (count == 0 && !isPty) endOfInput = true;
+    if (count <= 0) return;
+    rxHead = 0;
+    rxCount = count;
+    totalRead += count;
+}
+
+int HostSerial::available() {
+    refill();
+    return (int)rxCount;
+}
+
+int HostSerial::read() {
+    refill();
+    if (rxCount == 0) return -1;
+    rxCount--;
+    return rxBuffer[rxHead++];
+}
+
+int HostSerial::availableForWrite() {
+    if (outFd < 0 || !peerConnected()) return 0;
+    struct pollfd poller = {outFd, POLLOUT, 0};
+    if (poll(&poller, 1, 0) <= 0 || !(poller.revents & POLLOUT)) return 0;
+    return SIM_SERIAL_TX_CHUNK;
+}
+
+size_t HostSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HostSerial::write(const uint8_t* buffer, size_t size) {
+    if (outFd < 0) return 0;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t count = ::write(outFd, buffer + written, size - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;   // Full or no client; the caller sees a short write
+        written += count;
+    }
+    totalWritten += written;
+    return written;
+}
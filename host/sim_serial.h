@@ -0,0 +1,60 @@
+#ifndef SIM_SERIAL_H
+#define SIM_SERIAL_H
+
+#include "Arduino.h"
+
+#include <string>
+
+// USB CDC serial for the host build, on a pseudo-terminal or on stdin/stdout.
+// Like the device, nothing blocks: availableForWrite() is 0 while no client
+// has the pty open or its buffer is full, so TxBuffer keeps queueing (and
+// dropping by class) exactly as it would with a slow host. `!Serial` is
+// true until a client has opened the pty, which the 5s wait in initSerial()
+// relies on.
+
+#define SIM_SERIAL_RX_BUFFER 256    // Bytes pulled from the fd per refill
+#define SIM_SERIAL_TX_CHUNK 64      // One USB full-speed packet
+
+class HostSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available() override;
+    int read() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int availableForWrite() override;
+    explicit operator bool();
+
+    // Backends; the fds are kept across a simulated reset (see sim_board.h)
+    bool openPty(const char* linkPath);
+    void attachPty(int masterFd);
+    void attachStdio(bool readInput = true);
+    void inject(const char* data, size_t length);   // Received ahead of anything on the fd
+    int ptyFd() const { return isPty ? inFd : -1; }
+    const char* ptyName() const { return slaveName; }
+
+    bool inputEnded() const { return endOfInput; }   // stdio backend only
+    unsigned long bytesRead() const { return totalRead; }
+    unsigned long bytesWritten() const { return totalWritten; }
+
+private:
+    void refill();
+    bool peerConnected();
+
+    int inFd = -1;
+    int outFd = -1;
+    bool isPty = false;
+    char slaveName[64] = {0};
+    uint8_t rxBuffer[SIM_SERIAL_RX_BUFFER];
+    size_t rxHead = 0;
+    size_t rxCount = 0;
+    std::string injected;
+    unsigned long totalRead = 0;
+    unsigned long totalWritten = 0;
+    bool endOfInput = false;
+};
+
+extern HostSerial Serial;
+
+#endif // SIM_SERIAL_H
@@ -0,0 +1,4 @@
+// The Arduino IDE compiles main.ino as C++ after adding its own includes;
+// the host build does the same here.
+#include "Arduino.h"
+#include "main.ino"
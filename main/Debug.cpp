@@ -1,31 +1,36 @@
 // Debug.cpp - nRF52840 Port
 #include "Debug.h"
+#include "tx_buffer.h"
+#include "telemetry_stream.h"
+#include "helpers.h"
 #include <stdarg.h> // Include the header for variable argument functions
 
 // Runtime debug control - starts disabled
 bool DEBUG_ENABLED = false;
+uint8_t logLevel = LOG_LEVEL_DEBUG;
+bool logTraceMode = false;
 
 void DebugClass::print(const String& msg) {
   if (DEBUG && DEBUG_ENABLED) {
-    Serial.print(msg);
+    SerialTx.print(msg, TX_CLASS_DEBUG);
   }
 }
 
 void DebugClass::print(int msg) {
   if (DEBUG && DEBUG_ENABLED) {
-    Serial.print(msg);
+    SerialTx.print(String(msg), TX_CLASS_DEBUG);
   }
 }
 
 void DebugClass::println(const String& msg) {
   if (DEBUG && DEBUG_ENABLED) {
-    Serial.println(msg);
+    SerialTx.println(msg, TX_CLASS_DEBUG);
   }
 }
 
 void DebugClass::println(int msg) {
   if (DEBUG && DEBUG_ENABLED) {
-    Serial.println(msg);
+    SerialTx.println(String(msg), TX_CLASS_DEBUG);
   }
 }
 
@@ -36,8 +41,83 @@ void DebugClass::printf(const char *format, ...) {
     va_start(args, format);
     vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
-    Serial.print(buffer);
+    SerialTx.print(buffer, TX_CLASS_DEBUG);
   }
 }
 
+void DebugClass::log(uint8_t level, const char *format, ...) {
+  // Formatted on the stack and queued as one message with its line ending,
+  // so logging never touches the heap
+  (void)level;
+  char buffer[194];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer) - 2, format, args);
+  va_end(args);
+  if (length < 0) return;
+  if (length > (int)sizeof(buffer) - 3) length = sizeof(buffer) - 3;
+  buffer[length++] = '\r';
+  buffer[length++] = '\n';
+  SerialTx.write((const uint8_t*)buffer, length, TX_CLASS_DEBUG);
+}
+
+static bool traceDumpActive = false;
+static size_t traceDumpOffset = 0;
+static uint16_t traceDumpFrames = 0;
+static int traceDumpSession = TX_ALL_SESSIONS;   // Session that asked for the dump
+
+void startTraceDump() {
+  traceSetPaused(true);
+  traceDumpOffset = 0;
+  traceDumpFrames = 0;
+  traceDumpSession = SerialTx.getSelected();
+  traceDumpActive = true;
+}
+
+// Frame payload: offset into the dump (u16), then up to TRACE_DUMP_CHUNK bytes
+static bool sendTraceFrame() {
+  uint8_t frame[4 + 2 + TRACE_DUMP_CHUNK + 1];
+  size_t count = traceRead(traceDumpOffset, frame + 6, TRACE_DUMP_CHUNK);
+  uint8_t payloadLength = 2 + count;
+  if (SerialTx.available() < (size_t)(4 + payloadLength + 1)) return false;
+
+  uint16_t offset = (uint16_t)traceDumpOffset;
+  frame[0] = STREAM_SYNC_BYTE_1;
+  frame[1] = STREAM_SYNC_BYTE_2;
+  frame[2] = STREAM_FRAME_TRACE;
+  frame[3] = payloadLength;
+  memcpy(frame + 4, &offset, 2);
+  frame[4 + payloadLength] = calculateCRC8(frame + 2, 2 + payloadLength);
+  SerialTx.write(frame, 4 + payloadLength + 1);
+
+  traceDumpOffset += count;
+  traceDumpFrames++;
+  return true;
+}
+
+void serviceTraceDump() {
+  if (!traceDumpActive) return;
+  SessionScope scope(traceDumpSession);
+
+  TraceStats stats = getTraceStats();
+  for (int i = 0; i < 4 && traceDumpOffset < stats.bytes; i++) {
+    if (!sendTraceFrame()) return;
+  }
+  if (traceDumpOffset < stats.bytes) return;
+
+  traceDumpActive = false;
+  JSONBuilder json;
+  json.add("frames", (int)traceDumpFrames);
+  json.add("bytes", (unsigned long)stats.bytes);
+  json.add("records", (unsigned long)stats.records);
+  json.add("dropped", (unsigned long)stats.dropped);
+  SerialTx.println(buildJSONNotification("traceDumpComplete", json.build()));
+  traceClear();
+  traceSetPaused(false);
+}
+
+bool isTraceDumpActive() {
+  return traceDumpActive;
+}
+
 DebugClass Debug;
\ No newline at end of file
@@ -3,11 +3,26 @@
 #define DEBUG_H
 
 #include "Arduino.h"
+#include "trace_buffer.h"
 
 #define DEBUG 1
 
+// Log levels, most severe first
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// LOG_* calls above this level are compiled out
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL (DEBUG ? LOG_LEVEL_DEBUG : LOG_LEVEL_NONE)
+#endif
+
 // Runtime debug control
 extern bool DEBUG_ENABLED;
+extern uint8_t logLevel;      // Highest level output while DEBUG_ENABLED
+extern bool logTraceMode;     // Record into the binary trace ring instead of printing
 
 class DebugClass {
 public:
@@ -16,8 +31,37 @@ public:
   void println(const String& msg);
   void println(int msg);
   void printf(const char *format, ...);
+  void log(uint8_t level, const char *format, ...) __attribute__((format(printf, 3, 4)));
 };
 
 extern DebugClass Debug;
 
-#endif
\ No newline at end of file
+// Streams the trace ring as STREAM_FRAME_TRACE frames; tracing is paused
+// until the dump finishes, then the ring is cleared
+#define TRACE_DUMP_CHUNK 200
+
+void startTraceDump();
+void serviceTraceDump();      // Call every loop
+bool isTraceDumpActive();
+
+// printf-style logging. The level checks come before the arguments, so a
+// disabled call evaluates nothing and allocates nothing. The format must be a
+// string literal: trace mode identifies it by a compile-time hash. %s takes
+// a const char*, so pass String values with .c_str().
+#define LOG_AT(level, format, ...) do { \
+    if ((level) <= LOG_COMPILE_LEVEL && DEBUG_ENABLED && (level) <= logLevel) { \
+      if (logTraceMode) { \
+        constexpr uint32_t logFormatId = traceFormatId(format); \
+        traceLog((level), logFormatId, (uint32_t)micros(), ##__VA_ARGS__); \
+      } else { \
+        Debug.log((level), format, ##__VA_ARGS__); \
+      } \
+    } \
+  } while (0)
+
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define LOG_WARN(format, ...) LOG_AT(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_DEBUG(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+
+#endif
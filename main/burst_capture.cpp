@@ -0,0 +1,279 @@
+#include "burst_capture.h"
+#include "position_sensor.h"
+#include "telemetry_stream.h"
+#include "tx_buffer.h"
+#include "helpers.h"
+#include "Debug.h"
+#include "profiler.h"
+
+// LSM6DS3TR-C registers used by the capture
+#define REG_FIFO_CTRL3 0x08
+#define REG_FIFO_CTRL5 0x0A
+#define REG_CTRL1_XL 0x10
+#define REG_CTRL2_G 0x11
+#define REG_FIFO_STATUS1 0x3A
+#define REG_FIFO_STATUS2 0x3B
+#define REG_FIFO_STATUS3 0x3C
+#define REG_FIFO_DATA_OUT_L 0x3E        // Burst reads roll back here, so one read drains several words
+
+#define FIFO_STATUS2_OVER_RUN 0x40
+#define FIFO_STATUS2_DIFF_MASK 0x0F     // Unread word count bits [11:8]
+#define FIFO_MODE_BYPASS 0x00           // Also empties the FIFO
+#define FIFO_MODE_CONTINUOUS 0x06
+#define FIFO_NO_DECIMATION 0x09         // Gyro and accel both stored at the full FIFO rate
+
+#define BURST_FRAME_HEADER 3            // First sample index (u16) and sample count (u8)
+
+static int16_t burstBuffer[BURST_MAX_SAMPLES][BURST_AXES];
+static BurstState state = BURST_IDLE;
+static uint16_t odrHz = 0;
+static uint16_t requestedSamples = 0;
+static uint16_t capturedSamples = 0;
+static bool overrun = false;
+static bool streamCapture = true;
+static unsigned long captureStartMs = 0;
+
+// IMU configuration to put back afterwards
+static uint8_t savedCtrl1Xl = 0;
+static uint8_t savedCtrl2G = 0;
+static uint8_t savedFifoCtrl3 = 0;
+static uint32_t savedBusClock = 0;
+
+// Sample timing: samples produced by the IMU at each FIFO poll against micros()
+static bool haveFirstPoll = false;
+static uint32_t firstPollUs = 0;
+static uint32_t firstPollProduced = 0;
+static uint32_t lastPollUs = 0;
+static uint32_t lastPollProduced = 0;
+
+// Streaming
+static uint16_t sendNext = 0;
+static uint16_t framesSent = 0;
+static int captureSession = TX_ALL_SESSIONS;   // Session the frames and notifications go to
+
+static uint8_t odrCode(uint16_t hz) {
+    // Same 4-bit code for CTRL1_XL, CTRL2_G and the FIFO ODR
+    switch (hz) {
+        case 104: return 0x4;
+        case 208: return 0x5;
+        case 416: return 0x6;
+        case 833: return 0x7;
+        case 1666: return 0x8;
+        default: return 0;
+    }
+}
+
+bool isBurstOdrSupported(uint16_t hz) {
+    return odrCode(hz) != 0;
+}
+
+static bool writeRegister(uint8_t reg, uint8_t value) {
+    return imu.writeRegister(reg, value) == IMU_SUCCESS;
+}
+
+static bool readRegister(uint8_t reg, uint8_t& value) {
+    return imu.readRegister(&value, reg) == IMU_SUCCESS;
+}
+
+static void restoreImuConfig() {
+    writeRegister(REG_FIFO_CTRL5, FIFO_MODE_BYPASS);
+    writeRegister(REG_FIFO_CTRL3, savedFifoCtrl3);
+    writeRegister(REG_CTRL1_XL, savedCtrl1Xl);
+    writeRegister(REG_CTRL2_G, savedCtrl2G);
+    setImuBusClock(savedBusClock);
+}
+
+static float measuredPeriodUs() {
+    if (!haveFirstPoll || lastPollProduced <= firstPollProduced) return 0.0;
+    return (float)(lastPollUs - firstPollUs) / (float)(lastPollProduced - firstPollProduced);
+}
+
+static uint32_t firstSampleUs() {
+    float period = measuredPeriodUs();
+    if (period <= 0.0) period = 1000000.0 / odrHz;
+    // At the first poll the newest sample in the FIFO had just been taken
+    return firstPollUs - (uint32_t)((firstPollProduced - 1) * period);
+}
+
+bool startBurstCapture(uint16_t hz, uint16_t samples, bool stream) {
+    if (state != BURST_IDLE || !isBurstOdrSupported(hz) || samples == 0 || samples > BURST_MAX_SAMPLES) {
+        return false;
+    }
+    if (!readRegister(REG_CTRL1_XL, savedCtrl1Xl) || !readRegister(REG_CTRL2_G, savedCtrl2G) ||
+        !readRegister(REG_FIFO_CTRL3, savedFifoCtrl3)) {
+        return false;
+    }
+
+    // Fast I2C for the capture only; every way out goes through restoreImuConfig()
+    savedBusClock = getImuBusClock();
+    setImuBusClock(BURST_I2C_CLOCK_HZ);
+
+    // Only the ODR bits change, so the full-scale ranges (and the raw scale) stay as configured
+    uint8_t code = odrCode(hz);
+    bool configured = writeRegister(REG_FIFO_CTRL5, FIFO_MODE_BYPASS) &&
+                      writeRegister(REG_CTRL1_XL, (savedCtrl1Xl & 0x0F) | (code << 4)) &&
+                      writeRegister(REG_CTRL2_G, (savedCtrl2G & 0x0F) | (code << 4)) &&
+                      writeRegister(REG_FIFO_CTRL3, FIFO_NO_DECIMATION) &&
+                      writeRegister(REG_FIFO_CTRL5, (code << 3) | FIFO_MODE_CONTINUOUS);
+    if (!configured) {
+        restoreImuConfig();
+        LOG_ERROR("Burst capture: IMU configuration failed");
+        return false;
+    }
+
+    odrHz = hz;
+    requestedSamples = samples;
+    capturedSamples = 0;
+    overrun = false;
+    streamCapture = stream;
+    haveFirstPoll = false;
+    framesSent = 0;
+    captureStartMs = millis();
+    captureSession = SerialTx.getSelected();
+    state = BURST_CAPTURING;
+    LOG_DEBUG("Burst capture armed: %u samples at %uHz", samples, hz);
+    return true;
+}
+
+bool resendBurstCapture() {
+    if (state != BURST_IDLE || capturedSamples == 0) return false;
+    sendNext = 0;
+    framesSent = 0;
+    streamCapture = true;
+    captureSession = SerialTx.getSelected();
+    state = BURST_SENDING;
+    return true;
+}
+
+static void finishCapture() {
+    restoreImuConfig();
+    if (!streamCapture) {
+        state = BURST_IDLE;
+        return;
+    }
+    state = BURST_SENDING;
+    sendNext = 0;
+
+    JSONBuilder json;
+    json.add("odr", (int)odrHz);
+    json.add("samples", (int)capturedSamples);
+    json.add("complete", capturedSamples == requestedSamples);
+    json.add("overrun", overrun);
+    json.add("periodUs", measuredPeriodUs(), 3);
+    json.add("firstSampleUs", (unsigned long)firstSampleUs());
+    json.add("frames", (int)((capturedSamples + BURST_SAMPLES_PER_FRAME - 1) / BURST_SAMPLES_PER_FRAME));
+    SerialTx.println(buildJSONNotification("burstCaptured", json.build()));
+}
+
+static void drainFifo() {
+    uint8_t status1, status2;
+    if (!readRegister(REG_FIFO_STATUS1, status1) || !readRegister(REG_FIFO_STATUS2, status2)) return;
+    uint32_t now = micros();
+    if (status2 & FIFO_STATUS2_OVER_RUN) overrun = true;
+
+    uint16_t unreadWords = ((uint16_t)(status2 & FIFO_STATUS2_DIFF_MASK) << 8) | status1;
+    if (unreadWords < BURST_AXES) return;
+
+    // Samples are read whole; a partial pattern would shift every axis after it
+    if (capturedSamples == 0) {
+        uint8_t pattern;
+        if (!readRegister(REG_FIFO_STATUS3, pattern)) return;
+        for (; pattern != 0 && pattern < BURST_AXES && unreadWords > 0; pattern++, unreadWords--) {
+            uint8_t discard[2];
+            imu.readRegisterRegion(discard, REG_FIFO_DATA_OUT_L, 2);
+        }
+    }
+
+    uint16_t unreadSamples = unreadWords / BURST_AXES;
+    uint32_t produced = capturedSamples + unreadSamples;
+    if (!haveFirstPoll) {
+        haveFirstPoll = true;
+        firstPollUs = now;
+        firstPollProduced = produced;
+    }
+    lastPollUs = now;
+    lastPollProduced = produced;
+
+    uint16_t toRead = requestedSamples - capturedSamples;
+    if (unreadSamples < toRead) toRead = unreadSamples;
+    while (toRead > 0) {
+        uint8_t chunk = toRead < BURST_READ_CHUNK_SAMPLES ? toRead : BURST_READ_CHUNK_SAMPLES;
+        if (imu.readRegisterRegion((uint8_t*)burstBuffer[capturedSamples], REG_FIFO_DATA_OUT_L,
+                                   chunk * BURST_AXES * sizeof(int16_t)) != IMU_SUCCESS) {
+            return;
+        }
+        capturedSamples += chunk;
+        toRead -= chunk;
+    }
+}
+
+static bool sendFrame() {
+    uint16_t count = capturedSamples - sendNext;
+    if (count > BURST_SAMPLES_PER_FRAME) count = BURST_SAMPLES_PER_FRAME;
+
+    uint8_t payloadLength = BURST_FRAME_HEADER + count * BURST_AXES * sizeof(int16_t);
+    uint8_t frame[4 + BURST_FRAME_HEADER + BURST_SAMPLES_PER_FRAME * BURST_AXES * sizeof(int16_t) + 1];
+    if (SerialTx.available() < (size_t)(4 + payloadLength + 1)) return false;
+
+    size_t pos = 0;
+    frame[pos++] = STREAM_SYNC_BYTE_1;
+    frame[pos++] = STREAM_SYNC_BYTE_2;
+    frame[pos++] = STREAM_FRAME_BURST;
+    frame[pos++] = payloadLength;
+    memcpy(frame + pos, &sendNext, 2);
+    pos += 2;
+    frame[pos++] = (uint8_t)count;
+    memcpy(frame + pos, burstBuffer[sendNext], count * BURST_AXES * sizeof(int16_t));
+    pos += count * BURST_AXES * sizeof(int16_t);
+    frame[pos] = calculateCRC8(frame + 2, pos - 2);
+    SerialTx.write(frame, pos + 1);
+
+    sendNext += count;
+    framesSent++;
+    return true;
+}
+
+void serviceBurstCapture() {
+    PROFILE_SCOPE(PROFILE_BURST);
+    SessionScope scope(captureSession);
+    if (state == BURST_CAPTURING) {
+        drainFifo();
+
+        unsigned long expectedMs = (unsigned long)requestedSamples * 1000 / odrHz;
+        if (capturedSamples >= requestedSamples || millis() - captureStartMs > expectedMs + BURST_TIMEOUT_MS) {
+            finishCapture();
+        }
+        return;
+    }
+
+    if (state == BURST_SENDING) {
+        // A few frames per loop, only as fast as the TX ring drains
+        for (int i = 0; i < 4 && sendNext < capturedSamples; i++) {
+            if (!sendFrame()) return;
+        }
+        if (sendNext < capturedSamples) return;
+
+        state = BURST_IDLE;
+        JSONBuilder json;
+        json.add("frames", (int)framesSent);
+        json.add("samples", (int)capturedSamples);
+        SerialTx.println(buildJSONNotification("burstComplete", json.build()));
+    }
+}
+
+BurstInfo getBurstInfo() {
+    BurstInfo info;
+    info.state = state;
+    info.odrHz = odrHz;
+    info.requestedSamples = requestedSamples;
+    info.capturedSamples = capturedSamples;
+    info.overrun = overrun;
+    info.measuredPeriodUs = measuredPeriodUs();
+    info.firstSampleUs = haveFirstPoll ? firstSampleUs() : 0;
+    info.framesSent = framesSent;
+    return info;
+}
+
+const int16_t* getBurstSamples() {
+    return &burstBuffer[0][0];
+}
@@ -0,0 +1,47 @@
+#ifndef BURST_CAPTURE_H
+#define BURST_CAPTURE_H
+
+#include "Arduino.h"
+
+// Raw accelerometer/gyro capture at high ODR for mount vibration
+// characterization. The LSM6DS3 FIFO collects the samples and the main loop
+// drains it in I2C bursts into a preallocated buffer; nothing is formatted
+// until the capture is complete. The buffer is then streamed as binary frames
+// and the IMU goes back to its normal configuration. Park monitoring keeps
+// running on the output registers throughout.
+
+#define BURST_MAX_SAMPLES 4096          // 48KB of raw int16 data
+#define BURST_AXES 6                    // FIFO pattern order: gx gy gz ax ay az
+#define BURST_MAX_ODR_HZ 1666           // Highest ODR the 400kHz I2C link keeps up with
+#define BURST_I2C_CLOCK_HZ 400000       // During a capture only, 100kHz cannot move 6 axes at the higher rates
+#define BURST_TIMEOUT_MS 5000           // Capture gives up if the FIFO stops delivering
+#define BURST_SAMPLES_PER_FRAME 20      // 3 + 20 * 12 bytes stays under the 255-byte frame limit
+#define BURST_READ_CHUNK_SAMPLES 2      // Samples per I2C read, keeps transfers within the Wire buffer
+
+enum BurstState {
+    BURST_IDLE,
+    BURST_CAPTURING,
+    BURST_SENDING
+};
+
+struct BurstInfo {
+    BurstState state;
+    uint16_t odrHz;                 // Nominal ODR of the last capture
+    uint16_t requestedSamples;
+    uint16_t capturedSamples;
+    bool overrun;                   // FIFO filled up, samples were lost
+    float measuredPeriodUs;         // From FIFO levels against micros(), 0 until known
+    uint32_t firstSampleUs;         // micros() estimate for sample 0
+    uint16_t framesSent;
+};
+
+bool isBurstOdrSupported(uint16_t odrHz);
+// Arms the FIFO; false if busy or the IMU refuses. Without stream the samples
+// stay in the buffer for on-device analysis (getBurstSamples()).
+bool startBurstCapture(uint16_t odrHz, uint16_t samples, bool stream = true);
+bool resendBurstCapture();                                // Stream the last capture again
+void serviceBurstCapture();                               // Call from loop()
+BurstInfo getBurstInfo();
+const int16_t* getBurstSamples();   // Sample i axis a at [i * BURST_AXES + a]
+
+#endif // BURST_CAPTURE_H
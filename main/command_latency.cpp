@@ -0,0 +1,100 @@
+#include "command_latency.h"
+#include "memory_stats.h"
+
+static OpcodeLatency opcodes[LATENCY_MAX_OPCODES];
+static size_t opcodeCount = 0;
+static uint32_t untrackedCommands = 0;
+
+// Command in progress
+static bool receivedPending = false;
+static uint32_t receivedUs = 0;
+static bool commandActive = false;
+static uint32_t beginUs = 0;
+static uint32_t serializeUs = 0;
+static uint32_t serializeStartUs = 0;
+static uint8_t serializeDepth = 0;
+static uint32_t beginAllocations = 0;
+static char activeOpcode[3];
+
+void commandLatencyReceived() {
+    receivedUs = micros();
+    receivedPending = true;
+}
+
+void commandLatencyBegin(const String& command) {
+    beginUs = micros();
+    // Commands injected without a serial frame (host tools) have no queueing time
+    if (!receivedPending) receivedUs = beginUs;
+    receivedPending = false;
+
+    activeOpcode[0] = command.length() > 0 ? command.charAt(0) : '?';
+    activeOpcode[1] = command.length() > 1 ? command.charAt(1) : '?';
+    activeOpcode[2] = '\0';
+    serializeUs = 0;
+    serializeDepth = 0;
+    beginAllocations = getAllocationCount();
+    commandActive = true;
+}
+
+static OpcodeLatency* findOpcode(const char* opcode) {
+    for (size_t i = 0; i < opcodeCount; i++) {
+        if (opcodes[i].opcode[0] == opcode[0] && opcodes[i].opcode[1] == opcode[1]) return &opcodes[i];
+    }
+    if (opcodeCount == LATENCY_MAX_OPCODES) return NULL;
+
+    OpcodeLatency& entry = opcodes[opcodeCount++];
+    memcpy(entry.opcode, opcode, sizeof(entry.opcode));
+    for (int phase = 0; phase < LATENCY_PHASE_COUNT; phase++) latencyHistogramReset(entry.phases[phase]);
+    entry.allocations = 0;
+    entry.maxAllocations = 0;
+    return &entry;
+}
+
+void commandLatencyEnd() {
+    if (!commandActive) return;
+    uint32_t endUs = micros();
+    uint32_t allocations = getAllocationCount() - beginAllocations;
+    commandActive = false;
+    sampleMemoryStats();
+
+    OpcodeLatency* entry = findOpcode(activeOpcode);
+    if (entry == NULL) {
+        untrackedCommands++;
+        return;
+    }
+
+    uint32_t handlerUs = endUs - beginUs;
+    latencyHistogramRecord(entry->phases[LATENCY_TOTAL], endUs - receivedUs);
+    latencyHistogramRecord(entry->phases[LATENCY_QUEUE], beginUs - receivedUs);
+    latencyHistogramRecord(entry->phases[LATENCY_HANDLER], handlerUs > serializeUs ? handlerUs - serializeUs : 0);
+    latencyHistogramRecord(entry->phases[LATENCY_SERIALIZE], serializeUs);
+    entry->allocations += allocations;
+    if (allocations > entry->maxAllocations) entry->maxAllocations = allocations;
+}
+
+void commandLatencyReset() {
+    opcodeCount = 0;
+    untrackedCommands = 0;
+}
+
+void commandLatencySerializeBegin() {
+    if (!commandActive) return;
+    if (serializeDepth++ == 0) serializeStartUs = micros();
+}
+
+void commandLatencySerializeEnd() {
+    if (!commandActive || serializeDepth == 0) return;
+    if (--serializeDepth == 0) serializeUs += micros() - serializeStartUs;
+}
+
+size_t getLatencyOpcodeCount() {
+    return opcodeCount;
+}
+
+const OpcodeLatency& getOpcodeLatency(size_t index) {
+    return opcodes[index < opcodeCount ? index : 0];
+}
+
+uint32_t getLatencyUntrackedCommands() {
+    return untrackedCommands;
+}
@@ -0,0 +1,51 @@
+#ifndef COMMAND_LATENCY_H
+#define COMMAND_LATENCY_H
+
+#include "Arduino.h"
+#include "latency_histogram.h"
+
+// End-to-end latency of serial commands per opcode, from the closing '>'
+// arriving in handleSerialCommands() until processSerialCommand() returns,
+// by which point the whole synchronous response is queued for USB. The time
+// is split into queueing (frame received to handler start), serialization
+// (JSON building and queueing output) and handler (everything else,
+// including any blocking sensor reads).
+
+#define LATENCY_MAX_OPCODES 16       // Distinct opcodes tracked; later ones are only counted
+
+enum LatencyPhase {
+    LATENCY_TOTAL = 0,
+    LATENCY_QUEUE,
+    LATENCY_HANDLER,
+    LATENCY_SERIALIZE,
+    LATENCY_PHASE_COUNT
+};
+
+struct OpcodeLatency {
+    char opcode[3];              // First two characters of the command
+    LatencyHistogram phases[LATENCY_PHASE_COUNT];
+    uint32_t allocations;        // Heap allocations made by all runs, see memory_stats.h
+    uint32_t maxAllocations;     // Most made by a single run
+};
+
+void commandLatencyReceived();                   // Closing '>' of a command frame seen
+void commandLatencyBegin(const String& command); // Handler about to run
+void commandLatencyEnd();                        // Handler returned
+void commandLatencyReset();
+
+// Serialization time is only accumulated while a command runs, and nested
+// regions (a builder inside a send) count once
+void commandLatencySerializeBegin();
+void commandLatencySerializeEnd();
+
+class SerializeTimer {
+public:
+    SerializeTimer() { commandLatencySerializeBegin(); }
+    ~SerializeTimer() { commandLatencySerializeEnd(); }
+};
+
+size_t getLatencyOpcodeCount();
+const OpcodeLatency& getOpcodeLatency(size_t index);
+uint32_t getLatencyUntrackedCommands();
+
+#endif // COMMAND_LATENCY_H
@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Standard reflected CRC-32 (poly 0xEDB88320), shared by the settings log,
+// the sample log and the host tools
+uint32_t calculateCRC32(const void* data, size_t length);
+
+#endif // CRC32_H
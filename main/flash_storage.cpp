@@ -1,139 +1,86 @@
 #include "flash_storage.h"
+#include "settings_registry.h"
+#include "qspi_flash.h"
 #include "Debug.h"
-#include "nrfx_qspi.h"
+#include "profiler.h"
 
 #define SETTINGS_MAGIC 0x54454C45
-#define SETTINGS_ADDRESS 0x1000
-
-// QSPI Commands (from Seeed example)
-#define QSPI_STD_CMD_WRSR   0x01
-#define QSPI_STD_CMD_RSTEN  0x66
-#define QSPI_STD_CMD_RST    0x99
-#define QSPI_DPM_ENTER      0x0003
-#define QSPI_DPM_EXIT       0x0003
-
-// From Seeed example
-static uint32_t *QSPI_Status_Ptr = (uint32_t*) 0x40029604;
-static nrfx_qspi_config_t QSPIConfig;
-static nrf_qspi_cinstr_conf_t QSPICinstr_cfg;
-static bool QSPIWait = false;
-
-static TelescopeSettings currentSettings;
-static bool flashStorageInitialized = false;
+#define SETTINGS_ADDRESS 0x1000          // Legacy single-sector settings (read once for migration)
+
+// Log-structured settings store: append-only records in a ring of sectors
+#define SETTINGS_LOG_ADDRESS 0x2000
+#define SETTINGS_LOG_SECTORS 4
+#define FLASH_SECTOR_SIZE 4096
+#define SETTINGS_RECORD_SIZE 128         // Divides the 256-byte page, so no record straddles pages
+#define SETTINGS_RECORDS_PER_SECTOR (FLASH_SECTOR_SIZE / SETTINGS_RECORD_SIZE)
+#define SETTINGS_RECORD_MAGIC 0x31544553 // "SET1"
+#define SETTINGS_RECORD_PAYLOAD_SIZE (SETTINGS_RECORD_SIZE - 16)
+
+struct SettingsRecord {
+    uint32_t magic;
+    uint32_t sequence;        // Newest valid record wins
+    uint16_t version;         // Payload format (settings schema version)
+    uint16_t length;          // Payload bytes in use
+    uint8_t payload[SETTINGS_RECORD_PAYLOAD_SIZE];
+    uint32_t crc;             // CRC32 of everything above
+};
+
+static_assert(sizeof(SettingsRecord) == SETTINGS_RECORD_SIZE, "Settings record must fill its slot exactly");
+static_assert(sizeof(TelescopeSettings) <= SETTINGS_RECORD_PAYLOAD_SIZE, "Settings do not fit in a record");
+static_assert(SETTING_COUNT * sizeof(SettingValue) <= SETTINGS_RECORD_PAYLOAD_SIZE, "Settings registry does not fit in a record");
+
+// Settings log position
+static uint8_t logSector = SETTINGS_LOG_SECTORS - 1;   // Sector holding the newest record
+static uint8_t logNextSlot = SETTINGS_RECORDS_PER_SECTOR;  // Next free slot, full forces a sector switch
+static uint32_t logSequence = 0;        // Newest record confirmed in flash
+static uint32_t logNextSequence = 1;    // Sequence of the next record queued
+static bool logRecordFound = false;
+static bool logTailVerified = false;   // Slots from logNextSlot on are known to be erased
+static bool logScanned = false;        // A full scan found the log position; nothing is written before
 static bool persistentStorageAvailable = false;
 
-// Verbatim from Seeed example
-static nrfx_err_t QSPI_IsReady() {
-  if (((*QSPI_Status_Ptr & 8) == 8) && (*QSPI_Status_Ptr & 0x01000000) == 0) {
-    return NRFX_SUCCESS;  
-  } else {
-   return NRFX_ERROR_BUSY; 
-  }
-}
-
-// Verbatim from Seeed example
-static nrfx_err_t QSPI_WaitForReady() {
-  while (QSPI_IsReady() == NRFX_ERROR_BUSY) {
-    delay(1);
-  }
-  return NRFX_SUCCESS;
-}
-
-// Verbatim from Seeed example
-static void QSIP_Configure_Memory() {
-  uint8_t  temporary[] = {0x00, 0x02};
-  
-  QSPICinstr_cfg.opcode = QSPI_STD_CMD_RSTEN;
-  QSPICinstr_cfg.length = NRF_QSPI_CINSTR_LEN_1B;
-  QSPICinstr_cfg.io2_level = true;
-  QSPICinstr_cfg.io3_level = true;
-  QSPICinstr_cfg.wipwait = QSPIWait;
-  QSPICinstr_cfg.wren = true;
-  
-  QSPI_WaitForReady();
-  if (nrfx_qspi_cinstr_xfer(&QSPICinstr_cfg, NULL, NULL) != NRFX_SUCCESS) {
-    Debug.println("QSPI reset enable failed");
-  } else {
-    QSPICinstr_cfg.opcode = QSPI_STD_CMD_RST;
-    QSPI_WaitForReady();
-    if (nrfx_qspi_cinstr_xfer(&QSPICinstr_cfg, NULL, NULL) != NRFX_SUCCESS) {
-      Debug.println("QSPI reset failed");
-    } else {
-      QSPICinstr_cfg.opcode = QSPI_STD_CMD_WRSR;
-      QSPICinstr_cfg.length = NRF_QSPI_CINSTR_LEN_3B;
-      QSPI_WaitForReady();
-      if (nrfx_qspi_cinstr_xfer(&QSPICinstr_cfg, &temporary, NULL) != NRFX_SUCCESS) {
-        Debug.println("QSPI mode switch failed");
-      }
-    }
-  }
-}
+// Settings cache state
+static int transactionDepth = 0;
+static bool settingsDirty = false;
+static bool writeBehindEnabled = false;
+static unsigned long lastSettingsChange = 0;
+static bool settingsRetry = false;      // A save was deferred or failed and is retried from the loop
+static bool retryAfterQuiet = false;    // ...after FLASH_WRITE_BEHIND_DELAY_MS, for failures
+static FlashStorageStats storageStats = {0, 0, 0, 0, 0, 0, 0};
+
+// Records queued for programming, oldest first. Programs complete in queue
+// order, so the first entry still pending holds back the ones behind it.
+struct SettingsCommit {
+    volatile QspiOpStatus status;
+    uint32_t sequence;
+    uint8_t sector;
+    uint8_t slot;
+    unsigned long queuedMs;
+    bool timeoutCounted;
+};
+static SettingsCommit settingsCommits[QSPI_OP_QUEUE_DEPTH];
+static uint8_t commitHead = 0;
+static uint8_t commitCount = 0;
 
 bool initFlashStorage() {
-    Debug.println("Initializing QSPI (Seeed example method)...");
+    LOG_INFO("Initializing QSPI (Seeed example method)...");
     
     // Initialize defaults
-    currentSettings.magic = SETTINGS_MAGIC;
-    currentSettings.parkPitch = 0.0;
-    currentSettings.parkRoll = 0.0;
-    currentSettings.tolerance = 2.0;
-    currentSettings.cal_ax_offset = 0.0;
-    currentSettings.cal_ay_offset = 0.0;
-    currentSettings.cal_az_offset = 0.0;
-    currentSettings.cal_gx_offset = 0.0;
-    currentSettings.cal_gy_offset = 0.0;
-    currentSettings.cal_gz_offset = 0.0;
-    currentSettings.cal_timestamp = 0;
-    currentSettings.checksum = 0;
+    resetSettingsToDefaults();
     
-    // QSPI Config - Verbatim from Seeed example
-    QSPIConfig.xip_offset = NRFX_QSPI_CONFIG_XIP_OFFSET;
-    QSPIConfig.pins.sck_pin = 21;
-    QSPIConfig.pins.csn_pin = 25;
-    QSPIConfig.pins.io0_pin = 20;
-    QSPIConfig.pins.io1_pin = 24;
-    QSPIConfig.pins.io2_pin = 22;
-    QSPIConfig.pins.io3_pin = 23;
-    QSPIConfig.irq_priority = (uint8_t)NRFX_QSPI_CONFIG_IRQ_PRIORITY;
-    QSPIConfig.prot_if.readoc = (nrf_qspi_readoc_t)NRF_QSPI_READOC_READ4O;
-    QSPIConfig.prot_if.writeoc = (nrf_qspi_writeoc_t)NRF_QSPI_WRITEOC_PP4O;
-    QSPIConfig.prot_if.addrmode = (nrf_qspi_addrmode_t)NRFX_QSPI_CONFIG_ADDRMODE;
-    QSPIConfig.prot_if.dpmconfig = true;
-    QSPIConfig.phy_if.sck_freq = (nrf_qspi_frequency_t)NRF_QSPI_FREQ_32MDIV1;
-    QSPIConfig.phy_if.spi_mode = (nrf_qspi_spi_mode_t)NRFX_QSPI_CONFIG_MODE;
-    QSPIConfig.phy_if.dpmen = false;
-    
-    // DPM setup from example
-    NRF_QSPI->DPMDUR = (QSPI_DPM_ENTER << 16) | QSPI_DPM_EXIT;
-    
-    // Initialize QSPI (retry loop from example)
-    uint32_t Error_Code = 1;
-    while (Error_Code != 0) {
-        Error_Code = nrfx_qspi_init(&QSPIConfig, NULL, NULL);
-        if (Error_Code != NRFX_SUCCESS) {
-            Debug.println("QSPI init failed: " + String(Error_Code));
-        } else {
-            Debug.println("QSPI init successful");
-        }
-    }
-    
-    QSIP_Configure_Memory();
-    NRF_QSPI->TASKS_ACTIVATE = 1;
-    QSPI_WaitForReady();
-    
-    if (QSPI_IsReady() == NRFX_SUCCESS) {
+    if (qspiFlashInit()) {
         persistentStorageAvailable = true;
-        Debug.println("✓ QSPI ready");
+        LOG_INFO("✓ QSPI ready");
         
         // Try loading settings
-        if (loadSettingsFromFlash(currentSettings)) {
-            Debug.println("✓ Settings loaded from QSPI");
+        if (loadSettingsFromFlash()) {
+            LOG_INFO("✓ Settings loaded from QSPI");
         }
     } else {
-        Debug.println("⚠ QSPI not ready");
+        // Settings still work from the RAM registry, they just do not survive a power cycle
+        LOG_WARN("⚠ QSPI unavailable, settings kept in RAM only");
     }
     
-    flashStorageInitialized = true;
     return persistentStorageAvailable;
 }
 
@@ -152,116 +99,447 @@ uint32_t calculateChecksum(const TelescopeSettings& settings) {
     return checksum;
 }
 
-bool saveSettingsToFlash(const TelescopeSettings& settings) {
+bool isFlashXipAvailable() {
+    return qspiFlashIsXipAvailable();
+}
+
+bool isFlashBusy() {
+    return persistentStorageAvailable && !qspiFlashIsIdle();
+}
+
+bool canQueueFlashOps(uint8_t count) {
+    return persistentStorageAvailable && qspiFlashQueueFree() >= count;
+}
+
+const void* mapFlash(uint32_t address, size_t length) {
+    if (!persistentStorageAvailable) return NULL;
+    return qspiFlashMap(address, length);
+}
+
+bool readFlash(uint32_t address, void* buffer, size_t length) {
+    if (!persistentStorageAvailable) return false;
+    return qspiFlashRead(address, buffer, length);
+}
+
+// Zero-copy when XIP is available, otherwise read into the caller's scratch buffer
+const void* readFlashView(uint32_t address, void* scratch, size_t length) {
+    const void* mapped = mapFlash(address, length);
+    if (mapped != NULL) return mapped;
+    return readFlash(address, scratch, length) ? scratch : NULL;
+}
+
+// Program and erase are queued and finish in the background from the QSPI
+// interrupt, in the order they were issued
+bool programFlash(uint32_t address, const void* data, size_t length, volatile QspiOpStatus* status) {
     if (!persistentStorageAvailable) return false;
     
-    TelescopeSettings settingsToSave = settings;
-    settingsToSave.checksum = calculateChecksum(settingsToSave);
-    
-    QSPI_WaitForReady();
-    if (nrfx_qspi_erase(NRF_QSPI_ERASE_LEN_4KB, SETTINGS_ADDRESS) != NRFX_SUCCESS) {
-        Debug.println("QSPI erase failed");
+    storageStats.pagePrograms++;
+    if (!qspiFlashQueueProgram(address, data, length, status)) {
+        LOG_ERROR("QSPI write failed");
         return false;
     }
+    return true;
+}
+
+bool eraseFlashSector(uint32_t address) {
+    if (!persistentStorageAvailable) return false;
     
-    QSPI_WaitForReady();
-    if (nrfx_qspi_write(&settingsToSave, sizeof(TelescopeSettings), SETTINGS_ADDRESS) != NRFX_SUCCESS) {
-        Debug.println("QSPI write failed");
+    storageStats.sectorErases++;
+    if (!qspiFlashQueueErase(address)) {
+        LOG_ERROR("QSPI erase failed");
         return false;
     }
+    return true;
+}
+
+static void retireSettingsCommits();
+
+bool waitForFlashIdle() {
+    if (!persistentStorageAvailable) return true;
+    bool idle = qspiFlashWaitIdle();
+    retireSettingsCommits();
+    return idle;
+}
+
+static uint32_t settingsSlotAddress(uint8_t sector, uint8_t slot) {
+    return SETTINGS_LOG_ADDRESS + (uint32_t)sector * FLASH_SECTOR_SIZE + (uint32_t)slot * SETTINGS_RECORD_SIZE;
+}
+
+// Points straight into the XIP window when possible, so a boot scan is plain
+// memory reads; otherwise the slot is transferred into scratch
+static const SettingsRecord* readSettingsSlot(uint8_t sector, uint8_t slot, SettingsRecord& scratch) {
+    return (const SettingsRecord*)readFlashView(settingsSlotAddress(sector, slot), &scratch, sizeof(SettingsRecord));
+}
+
+static bool isSlotErased(const SettingsRecord& record) {
+    const uint32_t* words = (const uint32_t*)&record;
+    for (size_t i = 0; i < sizeof(SettingsRecord) / sizeof(uint32_t); i++) {
+        if (words[i] != 0xFFFFFFFF) return false;
+    }
+    return true;
+}
+
+static bool isRecordValid(const SettingsRecord& record) {
+    // A record torn by a power cut fails the CRC and is skipped
+    return record.magic == SETTINGS_RECORD_MAGIC &&
+           record.length <= SETTINGS_RECORD_PAYLOAD_SIZE &&
+           record.crc == calculateCRC32(&record, offsetof(SettingsRecord, crc));
+}
+
+// Bounded boot scan: every slot of every log sector is read at most once.
+// Records from newer firmware (unknown schema version) are ignored. The log
+// position only changes once every slot has been read: a failed read could
+// hide the newest record, and saving after a partial scan would reuse its
+// sequence number. Returns false on a read failure.
+static bool scanSettingsLog(bool& found) {
+    SettingsRecord scratch;
+    uint32_t newestSequence = 0;
+    uint8_t newestSector = 0;
+    uint8_t newestSlot = 0;
+    found = false;
+    logScanned = false;
+    
+    for (uint8_t sector = 0; sector < SETTINGS_LOG_SECTORS; sector++) {
+        for (uint8_t slot = 0; slot < SETTINGS_RECORDS_PER_SECTOR; slot++) {
+            const SettingsRecord* record = readSettingsSlot(sector, slot, scratch);
+            if (record == NULL) return false;
+            
+            // Records are appended in order, so the rest of the sector is free
+            if (isSlotErased(*record)) break;
+            if (!isRecordValid(*record)) continue;
+            if (record->version > SETTINGS_SCHEMA_VERSION) continue;
+            if (found && (int32_t)(record->sequence - newestSequence) <= 0) continue;
+            
+            newestSequence = record->sequence;
+            newestSector = sector;
+            newestSlot = slot;
+            found = true;
+        }
+    }
     
-    QSPI_WaitForReady();
-    Debug.println("✓ Settings saved to QSPI");
+    if (found) {
+        logSequence = newestSequence;
+        logSector = newestSector;
+        logNextSlot = newestSlot + 1;
+    }
+    logRecordFound = found;
+    logNextSequence = logSequence + 1;
+    logTailVerified = false;
+    logScanned = true;
+    commitCount = 0;
     return true;
 }
 
-bool loadSettingsFromFlash(TelescopeSettings& settings) {
-    if (!persistentStorageAvailable) return false;
+// Import settings written by firmware that used the single fixed sector
+static bool loadLegacySettings(TelescopeSettings& settings) {
+    if (!readFlash(SETTINGS_ADDRESS, &settings, sizeof(TelescopeSettings))) {
+        return false;
+    }
+    
+    return settings.magic == SETTINGS_MAGIC && settings.checksum == calculateChecksum(settings);
+}
+
+static bool eraseLogSector(uint8_t sector) {
+    return eraseFlashSector(settingsSlotAddress(sector, 0));
+}
+
+// Settle finished programs: a completed record becomes the committed one, a
+// failed one leaves the settings dirty so the loop writes them again.
+static void retireSettingsCommits() {
+    while (commitCount > 0) {
+        uint8_t tail = (commitHead + QSPI_OP_QUEUE_DEPTH - commitCount) % QSPI_OP_QUEUE_DEPTH;
+        SettingsCommit& commit = settingsCommits[tail];
+        
+        if (commit.status == QSPI_OP_PENDING) {
+            if (!commit.timeoutCounted && millis() - commit.queuedMs >= QSPI_OP_TIMEOUT_MS) {
+                commit.timeoutCounted = true;
+                storageStats.commitTimeouts++;
+                LOG_WARN("Settings record %lu still not programmed", (unsigned long)commit.sequence);
+            }
+            return;
+        }
+        
+        if (commit.status == QSPI_OP_DONE) {
+            storageStats.commits++;
+            logSequence = commit.sequence;
+            logRecordFound = true;
+        } else {
+            storageStats.failedCommits++;
+            settingsDirty = true;
+            settingsRetry = true;
+            retryAfterQuiet = true;
+            lastSettingsChange = millis();
+            LOG_ERROR("Settings record %lu failed to program", (unsigned long)commit.sequence);
+            
+            // The boot scan stops at the first erased slot, so a slot the
+            // program never reached must be filled by the retry. Check it
+            // again: reused if still erased, skipped if partly written.
+            if (commit.sector == logSector && commit.slot < logNextSlot) {
+                logNextSlot = commit.slot;
+                logTailVerified = false;
+            }
+        }
+        commitCount--;
+    }
+}
+
+// A save needs the free-slot search (reads, so an idle queue) once per boot,
+// then room for a sector erase plus the program
+static bool isSettingsSaveBlocked() {
+    retireSettingsCommits();
+    return ((!logScanned || !logTailVerified) && isFlashBusy()) || !canQueueFlashOps(2) || commitCount >= QSPI_OP_QUEUE_DEPTH;
+}
+
+bool saveSettingsToFlash() {
+    if (!persistentStorageAvailable || isSettingsSaveBlocked()) return false;
+    
+    // The boot scan failed: find the log position before writing into it
+    bool found;
+    if (!logScanned && !scanSettingsLog(found)) return false;
     
-    QSPI_WaitForReady();
-    if (nrfx_qspi_read(&settings, sizeof(TelescopeSettings), SETTINGS_ADDRESS) != NRFX_SUCCESS) {
+    SettingsRecord record;
+    memset(&record, 0xFF, sizeof(record));
+    record.magic = SETTINGS_RECORD_MAGIC;
+    record.sequence = logNextSequence;
+    record.version = SETTINGS_SCHEMA_VERSION;
+    record.length = encodeSettingsPayload(record.payload, SETTINGS_RECORD_PAYLOAD_SIZE);
+    record.crc = calculateCRC32(&record, offsetof(SettingsRecord, crc));
+    
+    // Find a free slot. A slot left dirty by an earlier power cut is skipped.
+    // Only needed once per boot: after that the tail is known to be erased,
+    // so saving never has to wait for queued flash operations to read it.
+    SettingsRecord scratch;
+    while (!logTailVerified && logNextSlot < SETTINGS_RECORDS_PER_SECTOR) {
+        const SettingsRecord* existing = readSettingsSlot(logSector, logNextSlot, scratch);
+        if (existing == NULL) return false;
+        if (isSlotErased(*existing)) {
+            logTailVerified = true;
+            break;
+        }
+        logNextSlot++;
+    }
+    
+    // Sector full: move on to the next sector in the ring. Only now is anything
+    // erased, and the newest record still sits in the previous sector, so a
+    // power cut during the erase or program loses nothing.
+    if (logNextSlot >= SETTINGS_RECORDS_PER_SECTOR) {
+        uint8_t nextSector = (logSector + 1) % SETTINGS_LOG_SECTORS;
+        if (!eraseLogSector(nextSector)) return false;
+        logSector = nextSector;
+        logNextSlot = 0;
+        logTailVerified = true;
+    }
+    
+    // The slot and sequence are spent once queued; the record only becomes the
+    // committed one when retireSettingsCommits() sees its program complete
+    SettingsCommit& commit = settingsCommits[commitHead];
+    if (!programFlash(settingsSlotAddress(logSector, logNextSlot), &record, sizeof(SettingsRecord), &commit.status)) {
         return false;
     }
+    commit.sequence = record.sequence;
+    commit.sector = logSector;
+    commit.slot = logNextSlot;
+    commit.queuedMs = millis();
+    commit.timeoutCounted = false;
+    commitHead = (commitHead + 1) % QSPI_OP_QUEUE_DEPTH;
+    commitCount++;
     
-    QSPI_WaitForReady();
+    logNextSlot++;
+    logNextSequence++;
+    LOG_DEBUG("✓ Settings record %lu queued for QSPI sector %u", (unsigned long)record.sequence, logSector);
+    return true;
+}
+
+bool loadSettingsFromFlash() {
+    if (!persistentStorageAvailable) return false;
     
-    if (settings.magic != SETTINGS_MAGIC) {
+    // Boot path: the scan reads, so let anything still queued finish first.
+    // A failed scan keeps the defaults and writes nothing, not even a legacy
+    // import, since the log may well hold newer settings.
+    waitForFlashIdle();
+    bool found;
+    if (!scanSettingsLog(found)) {
+        LOG_ERROR("Settings log scan failed, using defaults");
         return false;
     }
+    if (found) {
+        // Decode the newest record in place (slot before logNextSlot)
+        SettingsRecord scratch;
+        const SettingsRecord* record = readSettingsSlot(logSector, logNextSlot - 1, scratch);
+        if (record == NULL || !decodeSettingsPayload(record->version, record->payload, record->length)) {
+            return false;
+        }
+        
+        // Older schema: rewrite once so migration does not run on every boot
+        uint16_t version = record->version;
+        if (version != SETTINGS_SCHEMA_VERSION) {
+            LOG_INFO("Migrating settings record from schema v%u to v%d", version, SETTINGS_SCHEMA_VERSION);
+            saveSettingsToFlash();
+        }
+        return true;
+    }
     
-    if (settings.checksum != calculateChecksum(settings)) {
+    TelescopeSettings legacy;
+    if (!loadLegacySettings(legacy)) {
+        return false;
+    }
+    if (!decodeSettingsPayload(1, (const uint8_t*)&legacy, sizeof(legacy))) {
         return false;
     }
     
-    currentSettings = settings;
+    // Move legacy settings into the log so the old sector is never needed again
+    LOG_INFO("Migrating settings from legacy sector to settings log");
+    saveSettingsToFlash();
     return true;
 }
 
 bool eraseSettingsFlash() {
     if (!persistentStorageAvailable) return false;
-    QSPI_WaitForReady();
-    return nrfx_qspi_erase(NRF_QSPI_ERASE_LEN_4KB, SETTINGS_ADDRESS) == NRFX_SUCCESS;
+    
+    // More erases than the queue holds: this explicit clear waits for room
+    bool success = true;
+    for (uint8_t sector = 0; sector < SETTINGS_LOG_SECTORS; sector++) {
+        if (!canQueueFlashOps(1)) waitForFlashIdle();
+        success = eraseLogSector(sector) && success;
+    }
+    
+    // The legacy sector goes too, otherwise it would be migrated again at boot
+    if (!canQueueFlashOps(1)) waitForFlashIdle();
+    success = eraseFlashSector(SETTINGS_ADDRESS) && success;
+    
+    logSector = 0;
+    logNextSlot = 0;
+    logRecordFound = false;
+    logTailVerified = true;
+    logScanned = true;
+    settingsRetry = false;
+    return success;
+}
+
+static String formatSettingValue(SettingId id) {
+    if (SETTINGS_SCHEMA[id].type == SETTING_TYPE_FLOAT) {
+        return String(settingValues[id].f, 4);
+    }
+    return String(settingValues[id].u);
 }
 
-// Helper functions
-bool saveFloatToFlash(const char* key, float value) {
-    if (!flashStorageInitialized) return false;
+// Registry hook: decides when a changed setting reaches flash
+bool onSettingChanged(SettingId id) {
+    storageStats.valueUpdates++;
+    settingsDirty = true;
+    lastSettingsChange = millis();
     
-    String keyStr = String(key);
+    // formatSettingValue() builds a String, so it only runs when the log is enabled
+    if (!persistentStorageAvailable) {
+        LOG_DEBUG("Saved %s = %s (RAM)", getSettingName(id), formatSettingValue(id).c_str());
+        settingsDirty = false;
+        return true;
+    }
     
-    if (keyStr == "parkPitch") currentSettings.parkPitch = value;
-    else if (keyStr == "parkRoll") currentSettings.parkRoll = value;
-    else if (keyStr == "tolerance") currentSettings.tolerance = value;
-    else if (keyStr == "cal_ax_offset") currentSettings.cal_ax_offset = value;
-    else if (keyStr == "cal_ay_offset") currentSettings.cal_ay_offset = value;
-    else if (keyStr == "cal_az_offset") currentSettings.cal_az_offset = value;
-    else if (keyStr == "cal_gx_offset") currentSettings.cal_gx_offset = value;
-    else if (keyStr == "cal_gy_offset") currentSettings.cal_gy_offset = value;
-    else if (keyStr == "cal_gz_offset") currentSettings.cal_gz_offset = value;
-    else if (keyStr == "cal_timestamp") currentSettings.cal_timestamp = (uint32_t)value;
-    else return false;
+    // Inside a transaction or in write-behind mode the flash write is deferred
+    if (transactionDepth > 0 || writeBehindEnabled) {
+        LOG_DEBUG("Saved %s = %s (pending)", getSettingName(id), formatSettingValue(id).c_str());
+        return true;
+    }
     
-    if (persistentStorageAvailable) {
-        bool success = saveSettingsToFlash(currentSettings);
-        Debug.println("Saved " + String(key) + " = " + String(value, 4) + (success ? " (QSPI)" : " (failed)"));
-        return success;
-    } else {
-        Debug.println("Saved " + String(key) + " = " + String(value, 4) + " (RAM)");
+    bool success = syncFlashSettings();
+    LOG_DEBUG("Saved %s = %s (%s)", getSettingName(id), formatSettingValue(id).c_str(), success ? "QSPI" : "failed");
+    return success;
+}
+
+void beginSettingsTransaction() {
+    transactionDepth++;
+}
+
+bool commitSettingsTransaction() {
+    if (transactionDepth > 0) transactionDepth--;
+    if (transactionDepth > 0 || writeBehindEnabled) return true;
+    return syncFlashSettings();
+}
+
+bool syncFlashSettings() {
+    if (!settingsDirty) return true;
+    if (!persistentStorageAvailable) {
+        settingsDirty = false;
         return true;
     }
+    
+    // Busy flash is not a failure: the settings stay pending and the loop
+    // saves them as soon as the queue has room, without waiting here
+    if (isSettingsSaveBlocked()) {
+        storageStats.deferredSaves++;
+        settingsRetry = true;
+        return true;
+    }
+    
+    if (!saveSettingsToFlash()) {
+        storageStats.failedCommits++;
+        settingsRetry = true;
+        retryAfterQuiet = true;
+        lastSettingsChange = millis();
+        return false;
+    }
+    settingsDirty = false;
+    settingsRetry = false;
+    retryAfterQuiet = false;
+    return true;
 }
 
-float loadFloatFromFlash(const char* key, float defaultValue) {
-    if (!flashStorageInitialized) return defaultValue;
+void serviceFlashStorage() {
+    PROFILE_SCOPE(PROFILE_FLASH);
+    qspiFlashService();
+    retireSettingsCommits();
+    
+    if (!settingsDirty || transactionDepth > 0) return;
+    if (!writeBehindEnabled && !settingsRetry) return;
     
-    String keyStr = String(key);
+    // Write-behind and failed saves wait for a quiet period rather than
+    // retrying on every loop; a save deferred for a busy queue goes next loop
+    bool waitQuiet = writeBehindEnabled || retryAfterQuiet;
+    if (waitQuiet && millis() - lastSettingsChange < FLASH_WRITE_BEHIND_DELAY_MS) return;
+    if (isSettingsSaveBlocked()) return;
     
-    if (keyStr == "parkPitch") return currentSettings.parkPitch;
-    else if (keyStr == "parkRoll") return currentSettings.parkRoll;
-    else if (keyStr == "tolerance") return currentSettings.tolerance;
-    else if (keyStr == "cal_ax_offset") return currentSettings.cal_ax_offset;
-    else if (keyStr == "cal_ay_offset") return currentSettings.cal_ay_offset;
-    else if (keyStr == "cal_az_offset") return currentSettings.cal_az_offset;
-    else if (keyStr == "cal_gx_offset") return currentSettings.cal_gx_offset;
-    else if (keyStr == "cal_gy_offset") return currentSettings.cal_gy_offset;
-    else if (keyStr == "cal_gz_offset") return currentSettings.cal_gz_offset;
-    else if (keyStr == "cal_timestamp") return (float)currentSettings.cal_timestamp;
+    if (syncFlashSettings()) {
+        LOG_DEBUG("Settings queued for QSPI");
+    }
+}
+
+void setWriteBehind(bool enable) {
+    writeBehindEnabled = enable;
     
-    return defaultValue;
+    // Leaving write-behind mode must not leave changes stranded in RAM
+    if (!enable && transactionDepth == 0) {
+        syncFlashSettings();
+    }
+}
+
+bool isWriteBehindEnabled() {
+    return writeBehindEnabled;
+}
+
+bool hasPendingSettings() {
+    return settingsDirty;
+}
+
+const FlashStorageStats& getFlashStorageStats() {
+    return storageStats;
+}
+
+SettingsLogInfo getSettingsLogInfo() {
+    SettingsLogInfo info;
+    info.hasRecord = logRecordFound;
+    info.sector = logSector;
+    info.nextSlot = logNextSlot;
+    info.sequence = logSequence;
+    info.inFlight = commitCount;
+    info.sectors = SETTINGS_LOG_SECTORS;
+    info.slotsPerSector = SETTINGS_RECORDS_PER_SECTOR;
+    return info;
 }
 
 bool clearAllFlashSettings() {
-    currentSettings.magic = SETTINGS_MAGIC;
-    currentSettings.parkPitch = 0.0;
-    currentSettings.parkRoll = 0.0;
-    currentSettings.tolerance = 2.0;
-    currentSettings.cal_ax_offset = 0.0;
-    currentSettings.cal_ay_offset = 0.0;
-    currentSettings.cal_az_offset = 0.0;
-    currentSettings.cal_gx_offset = 0.0;
-    currentSettings.cal_gy_offset = 0.0;
-    currentSettings.cal_gz_offset = 0.0;
-    currentSettings.cal_timestamp = 0;
+    resetSettingsToDefaults();
+    settingsDirty = false;
     
     if (persistentStorageAvailable) {
         return eraseSettingsFlash();
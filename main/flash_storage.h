@@ -2,8 +2,11 @@
 #define FLASH_STORAGE_H
 
 #include "Arduino.h"
+#include "crc32.h"
+#include "qspi_flash.h"
 
-// Storage structure for our settings
+// Settings image written by earlier firmware (schema v1). Still read from the
+// legacy sector and from old log records, then migrated to the registry format.
 struct TelescopeSettings {
     uint32_t magic;           // Magic number to verify valid data
     float parkPitch;          // Park position pitch
@@ -19,17 +22,70 @@ struct TelescopeSettings {
     uint32_t checksum;        // Simple checksum for data integrity
 };
 
+// Write-behind: dirty settings are committed after this long without changes
+#define FLASH_WRITE_BEHIND_DELAY_MS 2000
+
+// Flash activity counters
+struct FlashStorageStats {
+    unsigned long valueUpdates;    // Settings changed in RAM
+    unsigned long commits;         // Settings records confirmed written to flash
+    unsigned long failedCommits;   // Records refused or whose program failed
+    unsigned long commitTimeouts;  // Programs still pending after QSPI_OP_TIMEOUT_MS
+    unsigned long deferredSaves;   // Saves put off because the flash queue was busy
+    unsigned long sectorErases;
+    unsigned long pagePrograms;
+};
+
+// Position of the log-structured settings store
+struct SettingsLogInfo {
+    bool hasRecord;
+    uint8_t sector;
+    uint8_t nextSlot;
+    uint32_t sequence;        // Newest record confirmed in flash
+    uint8_t inFlight;         // Records queued but not yet programmed
+    uint8_t sectors;
+    uint8_t slotsPerSector;
+};
+
 // Function prototypes
 bool initFlashStorage();
-bool saveSettingsToFlash(const TelescopeSettings& settings);
-bool loadSettingsFromFlash(TelescopeSettings& settings);
+bool saveSettingsToFlash();       // Queue the settings registry as a new log record, false if refused or busy
+bool loadSettingsFromFlash();     // Load the newest record into the settings registry
 bool eraseSettingsFlash();
 uint32_t calculateChecksum(const TelescopeSettings& settings);
 bool isFlashStorageAvailable();
 
-// Helper functions for existing interface
-bool saveFloatToFlash(const char* key, float value);
-float loadFloatFromFlash(const char* key, float defaultValue);
-bool clearAllFlashSettings();
+// Raw flash access for on-flash logs. Reads go through the QSPI execute-in-place
+// window when it is available, so mapFlash() returns a pointer straight into
+// flash (NULL without XIP) and readFlashView() falls back to copying into scratch.
+// Programs and erases are queued and complete in the background. Reads and
+// requests that find the queue busy fail at once (isFlashBusy() tells this
+// apart from an error), so callers retry from the loop instead of waiting.
+bool isFlashXipAvailable();
+bool isFlashBusy();                          // Erases or programs are pending
+bool canQueueFlashOps(uint8_t count);        // The queue takes `count` more requests now
+const void* mapFlash(uint32_t address, size_t length);
+const void* readFlashView(uint32_t address, void* scratch, size_t length);
+bool readFlash(uint32_t address, void* buffer, size_t length);
+bool programFlash(uint32_t address, const void* data, size_t length, volatile QspiOpStatus* status = NULL);
+bool eraseFlashSector(uint32_t address);     // 4KB sector containing address
+bool waitForFlashIdle();                     // Block until queued programs and erases finish (boot, reset, tests)
+bool clearAllFlashSettings();     // Reset the registry to defaults and erase the log
+
+// Transactions and write-behind: settings changed between begin and commit
+// are written to flash once. In write-behind mode the write happens after
+// FLASH_WRITE_BEHIND_DELAY_MS of quiet, or on syncFlashSettings(). A save
+// that finds the flash busy, or whose program fails, stays pending and is
+// retried by serviceFlashStorage(); a record only counts as committed once
+// its program has completed.
+void beginSettingsTransaction();
+bool commitSettingsTransaction();
+bool syncFlashSettings();
+void serviceFlashStorage();        // Call from loop() to flush write-behind settings and idle the flash
+void setWriteBehind(bool enable);
+bool isWriteBehindEnabled();
+bool hasPendingSettings();
+const FlashStorageStats& getFlashStorageStats();
+SettingsLogInfo getSettingsLogInfo();
 
 #endif // FLASH_STORAGE_H
\ No newline at end of file
@@ -2,13 +2,110 @@
 #include "constants.h"
 #include "position_sensor.h"
 #include "flash_storage.h"  // Add storage support
+#include "sample_log.h"
+#include "sample_history.h"
 #include "Debug.h"
+#include "tx_buffer.h"
+#include "profiler.h"
+#include "command_latency.h"
+#include "sample_replay.h"
 #include <math.h>
 
 // External global variables
 extern bool isParked;
 extern float currentPitch, currentRoll;
 extern float parkPitch, parkRoll, positionTolerance;
+extern unsigned long sampleSequence;
+extern float parkHysteresis;
+extern unsigned long parkEnterDwellMs, parkExitDwellMs;
+extern int parkDecisionMode;
+
+// Park state debouncing
+static bool pendingParkedStatus = false;     // Candidate state waiting out its dwell time
+static unsigned long pendingSince = 0;       // When the candidate state was first seen
+static unsigned long parkEventSequence = 0;  // Incremented on every park notification
+
+// Sequential test state (PARK_MODE_SPRT)
+static SprtConfig sprtConfig = {SPRT_DEFAULT_FALSE_UNPARK_RATE, SPRT_DEFAULT_FALSE_PARK_RATE,
+                                SPRT_DEFAULT_INDIFFERENCE, SPRT_DEFAULT_MIN_SIGMA,
+                                SPRT_DEFAULT_NOISE_WEIGHT, SPRT_DEFAULT_WARMUP_SAMPLES};
+static SprtState sprtState = {0.0, 0.0, 0.0, false, 0, 0};
+static SprtResult lastParkDecision = {PARK_DECISION_NONE, 0.0, 0};
+
+// Noise and stability statistics of the unfiltered channels (zero-initialized == reset)
+static NoiseStats noiseStats;
+
+// Sensor errors are logged once per streak of failed reads. A streak only
+// unparks once it has lasted the exit dwell, so a single bus glitch does not.
+static bool sensorErrorLogged = false;
+static unsigned long failedReads = 0;        // Consecutive failed reads
+static unsigned long sensorErrorSince = 0;   // Sample time of the first failed read of the streak
+
+static void updateSprtParkStatus() {
+    float pitchDiff = calculatePositionDifference(unfilteredPitch, parkPitch);
+    float rollDiff = calculatePositionDifference(unfilteredRoll, parkRoll);
+    float deviation = (pitchDiff > rollDiff) ? pitchDiff : rollDiff;
+    
+    // The indifference zone around the tolerance plays the role of hysteresis,
+    // and the test itself replaces the dwell time
+    SprtResult result = sprtUpdate(sprtState, sprtConfig, deviation, positionTolerance);
+    if (result.decision == PARK_DECISION_NONE) return;
+    
+    lastParkDecision = result;
+    bool decidedParked = (result.decision == PARK_DECISION_PARKED);
+    if (decidedParked != isParked) {
+        isParked = decidedParked;
+        notifyParkStateChange("sprt");
+    }
+}
+
+static void updateThresholdParkStatus() {
+    // Check if we're in park position. Entering park uses the configured
+    // tolerance, leaving it needs the wider exit tolerance (hysteresis).
+    float pitchDiff = calculatePositionDifference(currentPitch, parkPitch);
+    float rollDiff = calculatePositionDifference(currentRoll, parkRoll);
+    float activeTolerance = isParked ? getParkExitTolerance() : positionTolerance;
+    bool newParkedStatus = (pitchDiff <= activeTolerance && rollDiff <= activeTolerance);
+    
+    // Detailed debug info every 5 seconds to avoid spam
+    /*
+    static unsigned long lastDetailedDebug = 0;
+    if (millis() - lastDetailedDebug >= 5000) {
+        LOG_DEBUG("=== PARK DETECTION DEBUG ===");
+        LOG_DEBUG("  Current Pitch: %.2f°", currentPitch);
+        LOG_DEBUG("  Current Roll: %.2f°", currentRoll);
+        LOG_DEBUG("  Park Pitch: %.2f°", parkPitch);
+        LOG_DEBUG("  Park Roll: %.2f°", parkRoll);
+        LOG_DEBUG("  Pitch Difference: %.2f°", pitchDiff);
+        LOG_DEBUG("  Roll Difference: %.2f°", rollDiff);
+        LOG_DEBUG("  Tolerance: ±%.1f°", activeTolerance);
+        LOG_DEBUG("  Pitch OK: %s", (pitchDiff <= activeTolerance ? "YES" : "NO"));
+        LOG_DEBUG("  Roll OK: %s", (rollDiff <= activeTolerance ? "YES" : "NO"));
+        LOG_DEBUG("  Is Parked: %s", (newParkedStatus ? "YES" : "NO"));
+        LOG_DEBUG("  Previous Parked: %s", (isParked ? "YES" : "NO"));
+        LOG_DEBUG("============================");
+        lastDetailedDebug = millis();
+    }
+    */
+    
+    // Debounce: the new state must hold for its dwell time before it is reported.
+    // Dwell runs on sample time so replayed recordings debounce as they did live.
+    unsigned long now = getSampleTimeMs();
+    if (newParkedStatus == isParked) {
+        pendingParkedStatus = isParked;
+        return;
+    }
+    if (newParkedStatus != pendingParkedStatus) {
+        pendingParkedStatus = newParkedStatus;
+        pendingSince = now;
+    }
+    
+    unsigned long dwell = newParkedStatus ? parkEnterDwellMs : parkExitDwellMs;
+    if (now - pendingSince >= dwell) {
+        isParked = newParkedStatus;
+        notifyParkStateChange("position");
+    }
+}
 
 // Position and park status management
 void updatePositionAndParkStatus() {
@@ -16,146 +113,276 @@ void updatePositionAndParkStatus() {
     if (readPosition(pitch, roll)) {
         currentPitch = pitch;
         currentRoll = roll;
+        sampleSequence++;
+        sensorErrorLogged = false;
+        failedReads = 0;
         
-        // Check if we're in park position
-        float pitchDiff = calculatePositionDifference(currentPitch, parkPitch);
-        float rollDiff = calculatePositionDifference(currentRoll, parkRoll);
-        bool newParkedStatus = (pitchDiff <= positionTolerance && rollDiff <= positionTolerance);
-        
-        // Detailed debug info every 5 seconds to avoid spam
-        /*
-        static unsigned long lastDetailedDebug = 0;
-        if (millis() - lastDetailedDebug >= 5000) {
-            Debug.println("=== PARK DETECTION DEBUG ===");
-            Debug.println("  Current Pitch: " + String(currentPitch, 2) + "°");
-            Debug.println("  Current Roll: " + String(currentRoll, 2) + "°");
-            Debug.println("  Park Pitch: " + String(parkPitch, 2) + "°");
-            Debug.println("  Park Roll: " + String(parkRoll, 2) + "°");
-            Debug.println("  Pitch Difference: " + String(pitchDiff, 2) + "°");
-            Debug.println("  Roll Difference: " + String(rollDiff, 2) + "°");
-            Debug.println("  Tolerance: ±" + String(positionTolerance, 1) + "°");
-            Debug.println("  Pitch OK: " + String(pitchDiff <= positionTolerance ? "YES" : "NO"));
-            Debug.println("  Roll OK: " + String(rollDiff <= positionTolerance ? "YES" : "NO"));
-            Debug.println("  Is Parked: " + String(newParkedStatus ? "YES" : "NO"));
-            Debug.println("  Previous Parked: " + String(isParked ? "YES" : "NO"));
-            Debug.println("============================");
-            lastDetailedDebug = millis();
+        PROFILE_START(parkStart);
+        if (parkDecisionMode == PARK_MODE_SPRT) {
+            updateSprtParkStatus();
+        } else {
+            updateThresholdParkStatus();
         }
-        */
         
-        isParked = newParkedStatus;
+        // Replayed samples must not leak into the live history and statistics
+        if (!isReplayActive()) {
+            recordHistorySample(sampleSequence, currentPitch, currentRoll, isParked);
+            
+            const float noiseValues[NOISE_CHANNEL_COUNT] = {unfilteredPitch, unfilteredRoll,
+                                                            unfilteredAx, unfilteredAy, unfilteredAz};
+            noiseStatsAdd(noiseStats, noiseValues);
+        }
+        PROFILE_STOP(PROFILE_PARK_EVAL, parkStart);
     } else {
-        Debug.println("Failed to read position from sensor");
-        isParked = false; // Assume not parked if we can't read position
+        LOG_ERROR("Failed to read position from sensor");
+        if (!sensorErrorLogged && !isReplayActive()) {
+            logEvent(LOG_EVENT_SENSOR_ERROR);
+            sensorErrorLogged = true;
+        }
+        
+        // A failed read is no evidence either way, so the deciders keep their
+        // state. Only a persistent error (as long as the exit dwell, on sample
+        // time like the dwell itself) means the park position is unknown.
+        unsigned long now = getSampleTimeMs();
+        if (failedReads++ == 0) sensorErrorSince = now;
+        if (isParked && now - sensorErrorSince >= parkExitDwellMs) {
+            pendingParkedStatus = false;
+            sprtRestart(sprtState);
+            isParked = false;
+            notifyParkStateChange("sensorError");
+        }
     }
 }
 
+float getParkExitTolerance() {
+    return positionTolerance + parkHysteresis;
+}
+
+void setParkDecisionMode(int mode) {
+    parkDecisionMode = (mode == PARK_MODE_SPRT) ? PARK_MODE_SPRT : PARK_MODE_THRESHOLD;
+    
+    // Start both deciders from the currently reported state
+    pendingParkedStatus = isParked;
+    sprtReset(sprtState);
+    lastParkDecision.decision = PARK_DECISION_NONE;
+    lastParkDecision.confidence = 0.0;
+    lastParkDecision.samples = 0;
+}
+
+SprtConfig& getSprtConfig() {
+    return sprtConfig;
+}
+
+const SprtResult& getLastParkDecision() {
+    return lastParkDecision;
+}
+
+float getParkNoiseSigma() {
+    return sprtNoiseSigma(sprtState, sprtConfig);
+}
+
+const NoiseStats& getNoiseStats() {
+    return noiseStats;
+}
+
+void resetNoiseStats() {
+    noiseStatsReset(noiseStats);
+}
+
+ParkLogicState getParkLogicState() {
+    ParkLogicState state;
+    state.parked = isParked;
+    state.pendingParked = pendingParkedStatus;
+    state.pendingSinceMs = pendingSince;
+    state.sprt = sprtState;
+    return state;
+}
+
+void setParkLogicState(const ParkLogicState& state) {
+    isParked = state.parked;
+    pendingParkedStatus = state.pendingParked;
+    pendingSince = state.pendingSinceMs;
+    sprtState = state.sprt;
+}
+
+void notifyParkStateChange(const char* reason) {
+    parkEventSequence++;
+    
+    uint32_t reasonCode = 0;  // position
+    if (strcmp(reason, "sensorError") == 0) reasonCode = 1;
+    else if (strcmp(reason, "sprt") == 0) reasonCode = 2;
+    if (!isReplayActive()) logEvent(isParked ? LOG_EVENT_PARKED : LOG_EVENT_UNPARKED, reasonCode);
+    
+    JSONBuilder json;
+    json.add("parked", isParked);
+    json.add("reason", reason);
+    json.add("timestamp", (unsigned long)getSampleTimeMs());
+    json.add("eventSeq", parkEventSequence);
+    json.add("sampleSeq", sampleSequence);
+    json.add("pitch", currentPitch);
+    json.add("roll", currentRoll);
+    if (parkDecisionMode == PARK_MODE_SPRT) {
+        json.add("confidence", lastParkDecision.confidence, 4);
+        json.add("samplesToDecision", (unsigned long)lastParkDecision.samples);
+    }
+    if (isReplayActive()) json.add("replay", true);
+    
+    // A transition found while a command polls (<03>) is news for every link;
+    // replayed transitions stay on the session driving the replay
+    SessionScope scope(isReplayActive() ? SerialTx.getSelected() : TX_ALL_SESSIONS);
+    SerialTx.println(buildJSONNotification(isParked ? "parked" : "unparked", json.build()));
+    LOG_INFO("Park state changed: %s (%s)", (isParked ? "PARKED" : "NOT PARKED"), reason);
+}
+
 bool isCurrentlyParked() {
-    updatePositionAndParkStatus();
+    if (!isReplayActive()) updatePositionAndParkStatus();
     return isParked;
 }
 
 // Enhanced storage preferences management for v2.0.1
-bool saveFloatPreference(const char* key, float value) {
-    if (isFlashStorageAvailable()) {
-        return saveFloatToFlash(key, value);
-    } else {
-        // Fallback to simple logging
-        Debug.println("Storage: Saved " + String(key) + " = " + String(value, 2) + " (RAM only)");
-        return true; // Pretend it worked for compatibility
+// Values live in the settings registry; the storage layer decides when they reach flash
+bool saveFloatPreference(SettingId id, float value) {
+    if (!setSettingFloat(id, value)) {
+        LOG_WARN("Storage: Rejected %s = %.4f", getSettingName(id), value);
+        return false;
     }
+    return true;
 }
 
-bool saveIntPreference(const char* key, int value) {
-    return saveFloatPreference(key, (float)value);
+bool saveIntPreference(SettingId id, uint32_t value) {
+    if (!setSettingUint(id, value)) {
+        LOG_WARN("Storage: Rejected %s = %lu", getSettingName(id), (unsigned long)value);
+        return false;
+    }
+    return true;
 }
 
-float loadFloatPreference(const char* key, float defaultValue) {
-    if (isFlashStorageAvailable()) {
-        return loadFloatFromFlash(key, defaultValue);
-    } else {
-        // Fallback to default values
-        Debug.println("Storage: Using default for " + String(key) + " = " + String(defaultValue, 2));
-        return defaultValue;
-    }
+float loadFloatPreference(SettingId id) {
+    return getSettingFloat(id);
 }
 
-int loadIntPreference(const char* key, int defaultValue) {
-    return (int)loadFloatPreference(key, (float)defaultValue);
+uint32_t loadIntPreference(SettingId id) {
+    return getSettingUint(id);
 }
 
 bool clearAllPreferences() {
-    if (isFlashStorageAvailable()) {
-        return clearAllFlashSettings();
-    } else {
-        Debug.println("Storage: Cannot clear - no persistent storage available");
-        return false;
+    bool success = clearAllFlashSettings();
+    if (!isFlashStorageAvailable()) {
+        LOG_INFO("Storage: Settings reset to defaults (RAM only)");
     }
+    return success;
 }
 
-// JSON response builders (unchanged)
+void beginPreferenceTransaction() {
+    beginSettingsTransaction();
+}
+
+bool commitPreferenceTransaction() {
+    return commitSettingsTransaction();
+}
+
+// JSON response builders. Time spent here counts as serialization in
+// the command latency breakdown.
 String buildSimpleJSONResponse(const String& key, const String& value) {
+    SerializeTimer timer;
     return "{\"" + key + "\":\"" + value + "\"}";
 }
 
 String buildSimpleJSONResponse(const String& key, float value, int decimals) {
+    SerializeTimer timer;
     return "{\"" + key + "\":" + String(value, decimals) + "}";
 }
 
 String buildSimpleJSONResponse(const String& key, bool value) {
+    SerializeTimer timer;
     return "{\"" + key + "\":" + String(value ? "true" : "false") + "}";
 }
 
+// Quotes and backslashes escaped, so text echoed from a command (which may
+// hold any printable character) cannot break the JSON around it
+static String escapeJSONString(const String& value) {
+    if (value.indexOf('"') < 0 && value.indexOf('\\') < 0) return value;
+    String escaped;
+    escaped.reserve(value.length() + 8);
+    for (unsigned int i = 0; i < value.length(); i++) {
+        char c = value.charAt(i);
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
 String buildJSONError(const String& message) {
-    return "{\"status\":\"error\",\"message\":\"" + message + "\"}";
+    SerializeTimer timer;
+    return "{\"status\":\"error\",\"message\":\"" + escapeJSONString(message) + "\"}";
 }
 
 String buildJSONNotification(const String& message) {
+    SerializeTimer timer;
     return "{\"notification\":\"" + message + "\"}";
 }
 
-// JSONBuilder class implementation (unchanged)
+String buildJSONNotification(const String& message, const String& jsonData) {
+    SerializeTimer timer;
+    return "{\"notification\":\"" + message + "\",\"data\":" + jsonData + "}";
+}
+
+// JSONBuilder class implementation. Every method is timed as serialization
 JSONBuilder::JSONBuilder() : hasContent(false) {
     json = "{";
 }
 
 void JSONBuilder::add(const String& key, const String& value) {
+    SerializeTimer timer;
     if (hasContent) json += ",";
-    json += "\"" + key + "\":\"" + value + "\"";
+    json += "\"" + key + "\":\"" + escapeJSONString(value) + "\"";
     hasContent = true;
 }
 
 void JSONBuilder::add(const String& key, const char* value) {
+    SerializeTimer timer;
     if (hasContent) json += ",";
-    json += "\"" + key + "\":\"" + String(value) + "\"";
+    json += "\"" + key + "\":\"" + escapeJSONString(String(value)) + "\"";
     hasContent = true;
 }
 
 void JSONBuilder::add(const String& key, float value, int decimals) {
+    SerializeTimer timer;
     if (hasContent) json += ",";
     json += "\"" + key + "\":" + String(value, decimals);
     hasContent = true;
 }
 
 void JSONBuilder::add(const String& key, bool value) {
+    SerializeTimer timer;
     if (hasContent) json += ",";
     json += "\"" + key + "\":" + String(value ? "true" : "false");
     hasContent = true;
 }
 
 void JSONBuilder::add(const String& key, int value) {
+    SerializeTimer timer;
     if (hasContent) json += ",";
     json += "\"" + key + "\":" + String(value);
     hasContent = true;
 }
 
 void JSONBuilder::add(const String& key, unsigned long value) {
+    SerializeTimer timer;
     if (hasContent) json += ",";
     json += "\"" + key + "\":" + String(value);
     hasContent = true;
 }
 
+void JSONBuilder::addRaw(const String& key, const String& rawJson) {
+    SerializeTimer timer;
+    if (hasContent) json += ",";
+    json += "\"" + key + "\":" + rawJson;
+    hasContent = true;
+}
+
 String JSONBuilder::build() {
+    SerializeTimer timer;
     return json + "}";
 }
 
@@ -182,22 +409,20 @@ void debugPositionInfo(float pitch, float roll, bool parked) {
     
     // Only print debug info every 5 seconds to avoid spam
     if (currentTime - lastDebugTime >= 5000) {
-        Debug.println("Position: Pitch=" + String(pitch, 2) + 
-                     "° Roll=" + String(roll, 2) + 
-                     "° Parked=" + String(parked ? "Yes" : "No"));
+        LOG_DEBUG("Position: Pitch=%.2f° Roll=%.2f° Parked=%s", pitch, roll, (parked ? "Yes" : "No"));
         lastDebugTime = currentTime;
     }
 }
 
 void debugButtonAction(const String& action) {
-    Debug.println("=== BUTTON ACTION: " + action + " ===");
+    LOG_DEBUG("=== BUTTON ACTION: %s ===", action.c_str());
 }
 
 void debugSensorCalibration(int samples, int successful) {
-    Debug.println("Calibration complete!");
-    Debug.println("Successful reads: " + String(successful) + "/" + String(samples));
+    LOG_INFO("Calibration complete!");
+    LOG_DEBUG("Successful reads: %d/%d", successful, samples);
     if (successful < (samples / 2)) {
-        Debug.println("Warning: Only " + String(successful) + " successful reads out of " + String(samples));
-        Debug.println("Calibration may be inaccurate!");
+        LOG_WARN("Warning: Only %d successful reads out of %d", successful, samples);
+        LOG_WARN("Calibration may be inaccurate!");
     }
 }
\ No newline at end of file
@@ -2,28 +2,57 @@
 #define HELPERS_H
 
 #include "Arduino.h"
+#include "park_sprt.h"
+#include "noise_stats.h"
+#include "settings_registry.h"
 // Remove InternalFileSystem.h - not available with mbed core
 // We'll use a simple in-memory storage for now
 
+// Park decision modes
+#define PARK_MODE_THRESHOLD 0   // Filtered angle vs tolerance, with hysteresis and dwell
+#define PARK_MODE_SPRT 1        // Sequential probability ratio test on unfiltered angles
+
 // Position and park status management
 void updatePositionAndParkStatus();
 bool isCurrentlyParked();
+float getParkExitTolerance();
+void notifyParkStateChange(const char* reason);
+void setParkDecisionMode(int mode);
+SprtConfig& getSprtConfig();
+const SprtResult& getLastParkDecision();
+float getParkNoiseSigma();
+const NoiseStats& getNoiseStats();  // Unfiltered pitch, roll and acceleration, one sample per read
+void resetNoiseStats();
+
+// Complete decider state, saved and restored around sample replay
+struct ParkLogicState {
+    bool parked;
+    bool pendingParked;
+    unsigned long pendingSinceMs;
+    SprtState sprt;
+};
+ParkLogicState getParkLogicState();
+void setParkLogicState(const ParkLogicState& state);
 
-// Simple storage system (in-memory for mbed core)
-// Note: These will be lost on power cycle - for persistent storage,
-// we would need to implement EEPROM or Flash storage differently
-bool saveFloatPreference(const char* key, float value);
-bool saveIntPreference(const char* key, int value);
-float loadFloatPreference(const char* key, float defaultValue);
-int loadIntPreference(const char* key, int defaultValue);
+// Settings storage, keyed by the typed IDs in settings_registry.h. Values are
+// range-checked, kept in RAM and persisted to QSPI flash when available.
+bool saveFloatPreference(SettingId id, float value);
+bool saveIntPreference(SettingId id, uint32_t value);
+float loadFloatPreference(SettingId id);
+uint32_t loadIntPreference(SettingId id);
 bool clearAllPreferences();
 
+// Group several preference changes into a single flash commit
+void beginPreferenceTransaction();
+bool commitPreferenceTransaction();
+
 // JSON response builders
 String buildSimpleJSONResponse(const String& key, const String& value);
 String buildSimpleJSONResponse(const String& key, float value, int decimals = 2);
 String buildSimpleJSONResponse(const String& key, bool value);
 String buildJSONError(const String& message);
 String buildJSONNotification(const String& message);
+String buildJSONNotification(const String& message, const String& jsonData);
 
 // JSON object builder class for complex responses
 class JSONBuilder {
@@ -39,6 +68,7 @@ public:
     void add(const String& key, bool value);
     void add(const String& key, int value);
     void add(const String& key, unsigned long value);
+    void addRaw(const String& key, const String& rawJson);  // Pre-serialized value, e.g. an array
     String build();
     void reset();
 };
@@ -0,0 +1,54 @@
+#include "latency_histogram.h"
+#include <string.h>
+
+static int bucketIndex(uint32_t us) {
+    if (us < LATENCY_SUB_BUCKETS) return (int)us;
+    int exponent = 31 - __builtin_clz(us);
+    if (exponent > LATENCY_MAX_EXPONENT) return LATENCY_BUCKETS - 1;
+    uint32_t sub = (us >> (exponent - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    return LATENCY_SUB_BUCKETS + (exponent - LATENCY_SUB_BUCKET_BITS) * LATENCY_SUB_BUCKETS + (int)sub;
+}
+
+static uint32_t bucketUpperEdge(int index) {
+    if (index < (int)LATENCY_SUB_BUCKETS) return (uint32_t)index;
+    int exponent = (index - LATENCY_SUB_BUCKETS) / LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS;
+    uint32_t sub = (index - LATENCY_SUB_BUCKETS) % LATENCY_SUB_BUCKETS;
+    uint32_t width = 1u << (exponent - LATENCY_SUB_BUCKET_BITS);
+    return (1u << exponent) + (sub + 1) * width - 1;
+}
+
+void latencyHistogramReset(LatencyHistogram& histogram) {
+    memset(&histogram, 0, sizeof(histogram));
+}
+
+void latencyHistogramRecord(LatencyHistogram& histogram, uint32_t us) {
+    histogram.count++;
+    if (us > histogram.maxUs) histogram.maxUs = us;
+
+    uint16_t& bucket = histogram.buckets[bucketIndex(us)];
+    if (bucket == UINT16_MAX) {
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) histogram.buckets[i] >>= 1;
+    }
+    bucket++;
+}
+
+uint32_t latencyHistogramPercentile(const LatencyHistogram& histogram, float percentile) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) total += histogram.buckets[i];
+    if (total == 0) return 0;
+
+    // Rank of the sample at the percentile, 1-based
+    uint32_t rank = (uint32_t)(percentile / 100.0f * total + 0.5f);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+
+    uint32_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            uint32_t edge = bucketUpperEdge((int)i);
+            return edge < histogram.maxUs ? edge : histogram.maxUs;
+        }
+    }
+    return histogram.maxUs;
+}
@@ -0,0 +1,32 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+// Compact HDR-style histogram of durations in microseconds: values below 4
+// get a bucket each, above that every power of two is split into 4 linear
+// sub-buckets, so any recorded value is known to within 25% up to 2^24us
+// (16.8s); longer values share the last bucket. Counters are 16 bits; when
+// one would overflow, all buckets are halved, which keeps the percentiles
+// and ages out old samples. Kept free of Arduino dependencies like
+// park_sprt.
+
+#include <stdint.h>
+
+#define LATENCY_SUB_BUCKET_BITS 2
+#define LATENCY_SUB_BUCKETS (1u << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_EXPONENT 23
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS + (LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+struct LatencyHistogram {
+    uint32_t count;              // Exact, unlike the halved buckets
+    uint32_t maxUs;
+    uint16_t buckets[LATENCY_BUCKETS];
+};
+
+void latencyHistogramReset(LatencyHistogram& histogram);
+void latencyHistogramRecord(LatencyHistogram& histogram, uint32_t us);
+
+// Upper edge of the bucket holding the given percentile (0-100), capped at
+// the maximum; 0 when empty
+uint32_t latencyHistogramPercentile(const LatencyHistogram& histogram, float percentile);
+
+#endif // LATENCY_HISTOGRAM_H
@@ -1,4 +1,5 @@
 #include "led_control.h"
+#include "profiler.h"
 
 // LED state tracking
 static bool currentLEDState = false;
@@ -10,7 +11,7 @@ void initLED() {
     
     pinMode(LED_BLUE, OUTPUT);
     digitalWrite(LED_BUILTIN, HIGH); // Start with LED off (active low, not parked initially)
-    Debug.println("nRF52840 - BLUE LED initialized on GPIO " + String(LED_BLUE));
+    LOG_DEBUG("nRF52840 - BLUE LED initialized on GPIO %d", (int)LED_BLUE);
     
     // Quick test blink to show LED is working
     digitalWrite(LED_BLUE, LOW);   // ON
@@ -21,11 +22,12 @@ void initLED() {
     delay(200);
     digitalWrite(LED_BLUE, HIGH);  // OFF
     
-    Debug.println("nRF52840 - RED LED test blink complete (2 blinks)");
-    Debug.println("LED Behavior: BLUE ON = PARKED, BLUE OFF = NOT PARKED (active low)");
+    LOG_DEBUG("nRF52840 - RED LED test blink complete (2 blinks)");
+    LOG_DEBUG("LED Behavior: BLUE ON = PARKED, BLUE OFF = NOT PARKED (active low)");
 }
 
 void updateLEDStatus(bool isParked) {
+    PROFILE_SCOPE(PROFILE_LED);
     // FIXED: LED is active LOW on XIAO nRF52840 Sense
     // LOW = LED ON, HIGH = LED OFF
     
@@ -37,22 +39,22 @@ void updateLEDStatus(bool isParked) {
     
     /*
     // Show status for debugging
-    Debug.println("=== LED STATUS UPDATE (ACTIVE LOW) ===");
-    Debug.println("  Input isParked: " + String(isParked ? "TRUE" : "FALSE"));
-    Debug.println("  Park status: " + String(isParked ? "PARKED" : "NOT PARKED"));
-    Debug.println("  BLUE LED should be: " + String(isParked ? "ON" : "OFF"));
-    Debug.println("  BLUE LED set to: " + String(isParked ? "LOW (ON)" : "HIGH (OFF)"));
-    Debug.println("  LED_BLUE pin: " + String(LED_BLUE));
-    Debug.println("  Note: LED is active LOW on this board");
-    Debug.println("=======================================");
+    LOG_DEBUG("=== LED STATUS UPDATE (ACTIVE LOW) ===");
+    LOG_DEBUG("  Input isParked: %s", (isParked ? "TRUE" : "FALSE"));
+    LOG_DEBUG("  Park status: %s", (isParked ? "PARKED" : "NOT PARKED"));
+    LOG_DEBUG("  BLUE LED should be: %s", (isParked ? "ON" : "OFF"));
+    LOG_DEBUG("  BLUE LED set to: %s", (isParked ? "LOW (ON)" : "HIGH (OFF)"));
+    LOG_DEBUG("  LED_BLUE pin: %d", (int)LED_BLUE);
+    LOG_DEBUG("  Note: LED is active LOW on this board");
+    LOG_DEBUG("=======================================");
     */
     
     lastParkedState = isParked;
 }
 
 void ledErrorPattern() {
-    Debug.println("nRF52840 - Starting LED error pattern - sensor initialization failed");
-    Debug.println("Using BLUE LED for error indication (same as park status)");
+    LOG_ERROR("nRF52840 - Starting LED error pattern - sensor initialization failed");
+    LOG_DEBUG("Using BLUE LED for error indication (same as park status)");
     
     // Use the same RED LED for error pattern
     // Run error pattern continuously until reset
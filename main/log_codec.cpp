@@ -0,0 +1,323 @@
+#include "log_codec.h"
+#include "crc32.h"
+#include <string.h>
+#include <math.h>
+
+static int16_t quantize(float value, float scale) {
+    float scaled = roundf(value * scale);
+    if (scaled > 32767.0f) return 32767;
+    if (scaled < -32768.0f) return -32768;
+    return (int16_t)scaled;
+}
+
+LogSample logQuantizeSample(float pitch, float roll, float temperature, bool parked) {
+    LogSample sample;
+    sample.pitch = quantize(pitch, LOG_ANGLE_SCALE);
+    sample.roll = quantize(roll, LOG_ANGLE_SCALE);
+    sample.temperature = quantize(temperature, LOG_TEMP_SCALE);
+    sample.parked = parked ? 1 : 0;
+    return sample;
+}
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static size_t varintLength(uint32_t value) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+// Encoder
+
+static uint8_t* payload(LogEncoder& encoder) {
+    return encoder.block + LOG_BLOCK_HEADER_SIZE;
+}
+
+static size_t freeSpace(const LogEncoder& encoder) {
+    return LOG_BLOCK_PAYLOAD_SIZE - encoder.length;
+}
+
+static void putByte(LogEncoder& encoder, uint8_t value) {
+    payload(encoder)[encoder.length++] = value;
+}
+
+static void putVarint(LogEncoder& encoder, uint32_t value) {
+    while (value >= 0x80) {
+        putByte(encoder, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    putByte(encoder, (uint8_t)value);
+}
+
+// Short runs are cheaper as plain zero-delta sample bytes
+static size_t runCost(uint32_t run) {
+    if (run == 0) return 0;
+    if (run <= 2) return run;
+    return 2 + varintLength(run);
+}
+
+static void flushRun(LogEncoder& encoder) {
+    if (encoder.runLength == 0) return;
+    if (encoder.runLength <= 2) {
+        for (uint32_t i = 0; i < encoder.runLength; i++) putByte(encoder, 0x00);
+    } else {
+        putByte(encoder, LOG_TOKEN_EXTENDED);
+        putByte(encoder, LOG_TOKEN_RUN);
+        putVarint(encoder, encoder.runLength);
+    }
+    encoder.runLength = 0;
+}
+
+void logEncoderStart(LogEncoder& encoder, uint32_t sequence, uint32_t startMs, uint16_t bootCount,
+                     uint16_t periodMs, const LogSample& base) {
+    memset(encoder.block, 0xFF, sizeof(encoder.block));
+
+    LogBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LOG_BLOCK_MAGIC;
+    header.version = LOG_FORMAT_VERSION;
+    header.sequence = sequence;
+    header.startMs = startMs;
+    header.bootCount = bootCount;
+    header.periodMs = periodMs;
+    header.basePitch = base.pitch;
+    header.baseRoll = base.roll;
+    header.baseTemperature = base.temperature;
+    header.baseParked = base.parked;
+    memcpy(encoder.block, &header, sizeof(header));
+
+    encoder.length = 0;
+    encoder.last = base;
+    encoder.sampleCount = 0;
+    encoder.runLength = 0;
+    encoder.nextSampleMs = 0;
+    encoder.open = true;
+}
+
+bool logEncoderAddSample(LogEncoder& encoder, const LogSample& sample, uint32_t timeMs) {
+    if (!encoder.open) return false;
+
+    LogBlockHeader header;
+    memcpy(&header, encoder.block, sizeof(header));
+    uint32_t offsetMs = timeMs - header.startMs;
+
+    // Samples are timed by count; only a late or early sample costs a time token
+    int32_t timeError = (int32_t)(offsetMs - encoder.nextSampleMs);
+    bool needTime = encoder.sampleCount > 0 &&
+                    (timeError > LOG_TIME_TOLERANCE_MS || timeError < -LOG_TIME_TOLERANCE_MS);
+    if (encoder.sampleCount == 0 && offsetMs > LOG_TIME_TOLERANCE_MS) needTime = true;
+
+    bool stateChanged = sample.temperature != encoder.last.temperature || sample.parked != encoder.last.parked;
+    int32_t deltaPitch = sample.pitch - encoder.last.pitch;
+    int32_t deltaRoll = sample.roll - encoder.last.roll;
+
+    // Unchanged sample: extend the run if its encoding still fits
+    if (!needTime && !stateChanged && deltaPitch == 0 && deltaRoll == 0) {
+        if (runCost(encoder.runLength + 1) > freeSpace(encoder)) return false;
+        encoder.runLength++;
+        encoder.sampleCount++;
+        encoder.nextSampleMs += header.periodMs;
+        return true;
+    }
+
+    uint32_t zigPitch = zigzag(deltaPitch);
+    uint32_t zigRoll = zigzag(deltaRoll);
+    bool widePitch = zigPitch >= 15;
+    bool wideRoll = zigRoll >= 15;
+    uint32_t zigTemperature = zigzag(sample.temperature - encoder.last.temperature);
+
+    size_t needed = runCost(encoder.runLength);
+    if (needTime) needed += 2 + varintLength(offsetMs);
+    if (stateChanged) needed += 3 + varintLength(zigTemperature);
+    if (widePitch && wideRoll) {
+        needed += 2 + varintLength(zigPitch) + varintLength(zigRoll);
+    } else {
+        needed += 1 + (widePitch ? varintLength(zigPitch) : 0) + (wideRoll ? varintLength(zigRoll) : 0);
+    }
+    if (needed > freeSpace(encoder)) return false;
+
+    flushRun(encoder);
+    if (needTime) {
+        putByte(encoder, LOG_TOKEN_EXTENDED);
+        putByte(encoder, LOG_TOKEN_TIME);
+        putVarint(encoder, offsetMs);
+        encoder.nextSampleMs = offsetMs;
+    }
+    if (stateChanged) {
+        putByte(encoder, LOG_TOKEN_EXTENDED);
+        putByte(encoder, LOG_TOKEN_STATE);
+        putVarint(encoder, zigTemperature);
+        putByte(encoder, sample.parked);
+    }
+    if (widePitch && wideRoll) {
+        putByte(encoder, LOG_TOKEN_EXTENDED);
+        putByte(encoder, LOG_TOKEN_WIDE_SAMPLE);
+        putVarint(encoder, zigPitch);
+        putVarint(encoder, zigRoll);
+    } else {
+        putByte(encoder, (uint8_t)(((widePitch ? 15 : zigPitch) << 4) | (wideRoll ? 15 : zigRoll)));
+        if (widePitch) putVarint(encoder, zigPitch);
+        if (wideRoll) putVarint(encoder, zigRoll);
+    }
+
+    encoder.last = sample;
+    encoder.sampleCount++;
+    encoder.nextSampleMs += header.periodMs;
+    return true;
+}
+
+bool logEncoderAddEvent(LogEncoder& encoder, uint8_t code, uint32_t timeMs, uint32_t value) {
+    if (!encoder.open) return false;
+
+    LogBlockHeader header;
+    memcpy(&header, encoder.block, sizeof(header));
+    uint32_t offsetMs = timeMs - header.startMs;
+
+    size_t needed = runCost(encoder.runLength) + 3 + varintLength(offsetMs) + varintLength(value);
+    if (needed > freeSpace(encoder)) return false;
+
+    flushRun(encoder);
+    putByte(encoder, LOG_TOKEN_EXTENDED);
+    putByte(encoder, LOG_TOKEN_EVENT);
+    putByte(encoder, code);
+    putVarint(encoder, offsetMs);
+    putVarint(encoder, value);
+    return true;
+}
+
+bool logEncoderIsEmpty(const LogEncoder& encoder) {
+    return !encoder.open || (encoder.length == 0 && encoder.runLength == 0);
+}
+
+const uint8_t* logEncoderFinish(LogEncoder& encoder) {
+    flushRun(encoder);
+
+    LogBlockHeader header;
+    memcpy(&header, encoder.block, sizeof(header));
+    header.sampleCount = encoder.sampleCount;
+    header.payloadLength = (uint16_t)encoder.length;
+    memcpy(encoder.block, &header, sizeof(header));
+
+    uint32_t crc = calculateCRC32(encoder.block, LOG_BLOCK_SIZE - 4);
+    memcpy(encoder.block + LOG_BLOCK_SIZE - 4, &crc, 4);
+
+    encoder.open = false;
+    return encoder.block;
+}
+
+// Decoder
+
+bool logBlockIsErased(const uint8_t* block) {
+    for (size_t i = 0; i < LOG_BLOCK_SIZE; i++) {
+        if (block[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+bool logBlockIsValid(const uint8_t* block) {
+    LogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    if (header.magic != LOG_BLOCK_MAGIC || header.version != LOG_FORMAT_VERSION) return false;
+    if (header.payloadLength > LOG_BLOCK_PAYLOAD_SIZE) return false;
+
+    uint32_t crc;
+    memcpy(&crc, block + LOG_BLOCK_SIZE - 4, 4);
+    return crc == calculateCRC32(block, LOG_BLOCK_SIZE - 4);
+}
+
+static bool getVarint(const uint8_t* data, size_t length, size_t& pos, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= length) return false;
+        uint8_t byte = data[pos++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool logDecodeBlock(const uint8_t* block, LogRecordHandler handler, void* context) {
+    if (!logBlockIsValid(block)) return false;
+
+    LogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    const uint8_t* data = block + LOG_BLOCK_HEADER_SIZE;
+    size_t length = header.payloadLength;
+
+    LogRecord record;
+    memset(&record, 0, sizeof(record));
+    LogSample current;
+    current.pitch = header.basePitch;
+    current.roll = header.baseRoll;
+    current.temperature = header.baseTemperature;
+    current.parked = header.baseParked;
+    uint32_t nextSampleMs = 0;
+
+    size_t pos = 0;
+    while (pos < length) {
+        uint8_t token = data[pos++];
+        uint32_t count = 1;
+        uint32_t zigPitch = 0;
+        uint32_t zigRoll = 0;
+
+        if (token == LOG_TOKEN_EXTENDED) {
+            if (pos >= length) return false;
+            uint8_t type = data[pos++];
+            uint32_t value;
+
+            switch (type) {
+                case LOG_TOKEN_STATE:
+                    if (!getVarint(data, length, pos, value) || pos >= length) return false;
+                    current.temperature = (int16_t)(current.temperature + unzigzag(value));
+                    current.parked = data[pos++];
+                    continue;
+                case LOG_TOKEN_TIME:
+                    if (!getVarint(data, length, pos, nextSampleMs)) return false;
+                    continue;
+                case LOG_TOKEN_EVENT:
+                    if (pos >= length) return false;
+                    record.type = LOG_RECORD_EVENT;
+                    record.eventCode = data[pos++];
+                    if (!getVarint(data, length, pos, record.offsetMs)) return false;
+                    if (!getVarint(data, length, pos, record.eventValue)) return false;
+                    handler(header, record, context);
+                    continue;
+                case LOG_TOKEN_RUN:
+                    if (!getVarint(data, length, pos, count)) return false;
+                    break;
+                case LOG_TOKEN_WIDE_SAMPLE:
+                    if (!getVarint(data, length, pos, zigPitch)) return false;
+                    if (!getVarint(data, length, pos, zigRoll)) return false;
+                    break;
+                default:
+                    return false;     // Unknown token: newer format
+            }
+        } else {
+            zigPitch = token >> 4;
+            zigRoll = token & 0x0F;
+            if (zigPitch == 15 && !getVarint(data, length, pos, zigPitch)) return false;
+            if (zigRoll == 15 && !getVarint(data, length, pos, zigRoll)) return false;
+        }
+
+        current.pitch = (int16_t)(current.pitch + unzigzag(zigPitch));
+        current.roll = (int16_t)(current.roll + unzigzag(zigRoll));
+
+        record.type = LOG_RECORD_SAMPLE;
+        record.sample = current;
+        for (uint32_t i = 0; i < count; i++) {
+            record.offsetMs = nextSampleMs;
+            handler(header, record, context);
+            nextSampleMs += header.periodMs;
+        }
+    }
+    return true;
+}
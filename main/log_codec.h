@@ -0,0 +1,124 @@
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+// Block format for the on-flash sample and event log. Kept free of Arduino
+// dependencies so the host decoder in tools/log_decode uses the same code.
+//
+// Each 256-byte block (one flash page) is self-contained: a header with the
+// block sequence, start time and the absolute values the first sample is
+// encoded against, a delta-coded payload and a CRC32. Samples are quantized
+// (0.01 degree, 0.1 C) and each one normally costs a single byte holding the
+// zigzag pitch and roll deltas as two nibbles. Runs of unchanged samples
+// collapse into one run token, so a parked telescope logs at well under a
+// byte per sample.
+//
+// Payload tokens:
+//   PR          sample, nibbles are zigzag deltas 0-14; 15 means a zigzag
+//               varint follows for that field (pitch first)
+//   FF 01 T P   temperature delta (zigzag varint) and parked flag for the
+//               following samples
+//   FF 02 P R   sample with both deltas as zigzag varints
+//   FF 03 N     N samples identical to the previous one
+//   FF 04 T     next sample was taken T ms after the block start
+//   FF 10 C T V event C at T ms after the block start with value V (varints)
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_BLOCK_SIZE 256
+#define LOG_BLOCK_MAGIC 0x474C          // "LG"
+#define LOG_FORMAT_VERSION 1
+#define LOG_BLOCK_HEADER_SIZE 32
+#define LOG_BLOCK_PAYLOAD_SIZE (LOG_BLOCK_SIZE - LOG_BLOCK_HEADER_SIZE - 4)
+
+#define LOG_ANGLE_SCALE 100             // Stored in hundredths of a degree
+#define LOG_TEMP_SCALE 10               // Stored in tenths of a degree C
+#define LOG_TIME_TOLERANCE_MS 40        // Sample time error before an explicit time token
+
+#define LOG_TOKEN_EXTENDED 0xFF
+#define LOG_TOKEN_STATE 0x01
+#define LOG_TOKEN_WIDE_SAMPLE 0x02
+#define LOG_TOKEN_RUN 0x03
+#define LOG_TOKEN_TIME 0x04
+#define LOG_TOKEN_EVENT 0x10
+
+enum LogEventCode : uint8_t {
+    LOG_EVENT_BOOT = 1,          // Value: reset reason register
+    LOG_EVENT_PARKED = 2,        // Value: 0 position, 2 sequential test
+    LOG_EVENT_UNPARKED = 3,      // Value: 0 position, 1 sensor error, 2 sequential test
+    LOG_EVENT_CALIBRATION = 4,
+    LOG_EVENT_RESET = 5,         // Value: 0 reset command, 1 factory reset
+    LOG_EVENT_SENSOR_ERROR = 6,
+    LOG_EVENT_DECIMATION = 7     // Value: new decimation (0 = samples off)
+};
+
+// Quantized sample as stored
+struct LogSample {
+    int16_t pitch;               // 0.01 degree
+    int16_t roll;                // 0.01 degree
+    int16_t temperature;         // 0.1 C
+    uint8_t parked;
+};
+
+struct LogBlockHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t reserved;
+    uint32_t sequence;           // Block number, increases by one per block written
+    uint32_t startMs;            // millis() when the block was opened
+    uint16_t bootCount;          // millis() restarts at each boot
+    uint16_t periodMs;           // Nominal time between samples
+    uint32_t sampleCount;
+    uint16_t payloadLength;
+    int16_t basePitch;           // The first sample is a delta from these
+    int16_t baseRoll;
+    int16_t baseTemperature;
+    uint8_t baseParked;
+    uint8_t reserved2[3];
+};
+
+static_assert(sizeof(LogBlockHeader) == LOG_BLOCK_HEADER_SIZE, "Log block header size changed");
+
+struct LogEncoder {
+    uint8_t block[LOG_BLOCK_SIZE];
+    size_t length;               // Payload bytes used
+    LogSample last;
+    uint32_t sampleCount;
+    uint32_t runLength;          // Unchanged samples not yet written
+    uint32_t nextSampleMs;       // Expected offset of the next sample from startMs
+    bool open;
+};
+
+// Decoded record, times in ms relative to the block's startMs
+enum LogRecordType : uint8_t {
+    LOG_RECORD_SAMPLE,
+    LOG_RECORD_EVENT
+};
+
+struct LogRecord {
+    LogRecordType type;
+    uint32_t offsetMs;
+    LogSample sample;            // LOG_RECORD_SAMPLE
+    uint8_t eventCode;           // LOG_RECORD_EVENT
+    uint32_t eventValue;
+};
+
+typedef void (*LogRecordHandler)(const LogBlockHeader& header, const LogRecord& record, void* context);
+
+LogSample logQuantizeSample(float pitch, float roll, float temperature, bool parked);
+
+// Encoding. Add functions return false when the block is full; finish it,
+// start a new block and add the item again.
+void logEncoderStart(LogEncoder& encoder, uint32_t sequence, uint32_t startMs, uint16_t bootCount,
+                     uint16_t periodMs, const LogSample& base);
+bool logEncoderAddSample(LogEncoder& encoder, const LogSample& sample, uint32_t timeMs);
+bool logEncoderAddEvent(LogEncoder& encoder, uint8_t code, uint32_t timeMs, uint32_t value);
+bool logEncoderIsEmpty(const LogEncoder& encoder);
+const uint8_t* logEncoderFinish(LogEncoder& encoder);   // Complete block image, unused bytes left 0xFF
+
+// Decoding
+bool logBlockIsErased(const uint8_t* block);
+bool logBlockIsValid(const uint8_t* block);
+bool logDecodeBlock(const uint8_t* block, LogRecordHandler handler, void* context);
+
+#endif // LOG_CODEC_H
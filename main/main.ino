@@ -10,6 +10,14 @@
 #include "serial_interface.h"
 #include "led_control.h"
 #include "flash_storage.h"
+#include "telemetry_stream.h"
+#include "tx_buffer.h"
+#include "sample_log.h"
+#include "burst_capture.h"
+#include "vibration_analysis.h"
+#include "profiler.h"
+#include "memory_stats.h"
+#include "sample_replay.h"
 
 // Device Information definitions (updated to v2.0.1)
 const char* DEVICE_MANUFACTURER = "Corey Smart";
@@ -23,6 +31,11 @@ float currentRoll = 0.0;
 float parkPitch = 0.0;
 float parkRoll = 0.0;
 float positionTolerance = 2.0;  // DEFAULT_POSITION_TOLERANCE equivalent
+float parkHysteresis = 0.10;       // Extra margin beyond tolerance before leaving park
+unsigned long parkEnterDwellMs = 500;  // Time inside tolerance before reporting parked
+unsigned long parkExitDwellMs = 200;   // Time outside exit tolerance before reporting unparked
+int parkDecisionMode = PARK_MODE_THRESHOLD;  // Threshold + dwell, or sequential test
+unsigned long sampleSequence = 0;  // Incremented on every successful sensor sample
 
 // Timing variables
 unsigned long lastSensorRead = 0;
@@ -31,21 +44,30 @@ unsigned long lastSensorRead = 0;
 void loadDeviceSettings();
 
 void setup() {
+    // Paint the stacks for high-water marks while they are still shallow
+    initMemoryStats();
+    
+    // Start the cycle counter before anything is timed
+    profilerInit();
+    
     // Initialize serial interface FIRST
     initSerial();
     
-    Debug.println("Starting Telescope Park Sensor v" + String(DEVICE_VERSION) + " for XIAO Sense...");
-    Debug.println("Platform: XIAO nRF52840 Sense (mbed core)");
-    Debug.println("IMU: Built-in LSM6DS3TR-C");
-    Debug.println("Interface: Software Only (No External Components)");
+    LOG_INFO("Starting Telescope Park Sensor v%s for XIAO Sense...", DEVICE_VERSION);
+    LOG_DEBUG("Platform: XIAO nRF52840 Sense (mbed core)");
+    LOG_DEBUG("IMU: Built-in LSM6DS3TR-C");
+    LOG_DEBUG("Interface: Software Only (No External Components)");
     
     // Initialize storage system
     if (initFlashStorage()) {
-        Debug.println("✓ Persistent storage initialized - settings will persist across reboots");
+        LOG_INFO("✓ Persistent storage initialized - settings will persist across reboots");
     } else {
-        Debug.println("⚠ Using RAM storage - settings will be lost on reboot");
+        LOG_WARN("⚠ Using RAM storage - settings will be lost on reboot");
     }
     
+    // Find the head of the on-flash sample log
+    initSampleLog();
+    
     // Initialize LED (fixed active-low logic)
     initLED();
     
@@ -54,16 +76,17 @@ void setup() {
     
     // Initialize position sensor (built-in LSM6DS3TR-C)
     if (!initPositionSensor()) {
-        Debug.println("Failed to initialize built-in IMU!");
-        Serial.println(buildJSONError("Built-in IMU initialization failed - check hardware"));
+        LOG_ERROR("Failed to initialize built-in IMU!");
+        SerialTx.println(buildJSONError("Built-in IMU initialization failed - check hardware"));
+        SerialTx.drain(1000);
         
         // Enter LED error pattern (this will loop forever)
         ledErrorPattern();
     }
     
-    Debug.println("Setup complete!");
-    Serial.println("Device ready - type <00> for commands");
-    Serial.println("XIAO Sense v2.0.1 features: Built-in IMU, Software interface, Enhanced storage");
+    LOG_INFO("Setup complete!");
+    SerialTx.println("Device ready - type <00> for commands");
+    SerialTx.println("XIAO Sense v2.0.1 features: Built-in IMU, Software interface, Enhanced storage");
     
     // Initial position reading and LED update
     updatePositionAndParkStatus();
@@ -72,16 +95,53 @@ void setup() {
 
 void loop() {
     unsigned long currentMillis = millis();
+    PROFILE_START(loopStart);
     
     // Handle serial commands
     handleSerialCommands();
     
+    // Push queued output to USB without blocking on a slow host
+    SerialTx.service();
+    
+    // Commit write-behind settings once they have been quiet for a while
+    serviceFlashStorage();
+    
+    // Stream sample log blocks while a download is in progress
+    serviceSampleLog();
+    
+    // Drain the IMU FIFO during a burst capture, then stream it out
+    serviceBurstCapture();
+    
+    // Advance a vibration spectrum by one FFT step
+    serviceVibrationAnalysis();
+    
+    // Stream the trace ring while a dump is in progress
+    serviceTraceDump();
+    
+    // Give live detection back if the host driving a replay went away
+    serviceSampleReplay();
+    
     // Read sensor periodically (every 50ms)
     if (currentMillis - lastSensorRead >= 50) {
-        updatePositionAndParkStatus();
+        // While a recording is replayed, the <25> command feeds the pipeline instead
+        if (!isReplayActive()) {
+            updatePositionAndParkStatus();
+            logSample();
+        }
         updateLEDStatus(isParked);
-        lastSensorRead = currentMillis;
+        serviceTelemetryStream();
+        
+        // Fixed-rate schedule so logged samples stay on their nominal times;
+        // after a long stall, resynchronize instead of catching up
+        lastSensorRead += 50;
+        if (currentMillis - lastSensorRead >= 50) {
+            lastSensorRead = currentMillis;
+        }
     }
+    PROFILE_STOP(PROFILE_LOOP, loopStart);
+    
+    // Track the heap high-water mark between commands
+    sampleMemoryStats();
     
     // Small delay to prevent issues
     delay(10);
@@ -91,16 +151,28 @@ void loop() {
 }
 
 void loadDeviceSettings() {
-    parkPitch = loadFloatPreference("parkPitch", 0.0);
-    parkRoll = loadFloatPreference("parkRoll", 0.0);
-    positionTolerance = loadFloatPreference("tolerance", 2.0);
+    parkPitch = loadFloatPreference(SETTING_PARK_PITCH);
+    parkRoll = loadFloatPreference(SETTING_PARK_ROLL);
+    positionTolerance = loadFloatPreference(SETTING_TOLERANCE);
+    
+    // Park detection tuning
+    parkHysteresis = loadFloatPreference(SETTING_PARK_HYSTERESIS);
+    parkEnterDwellMs = loadIntPreference(SETTING_PARK_ENTER_DWELL);
+    parkExitDwellMs = loadIntPreference(SETTING_PARK_EXIT_DWELL);
+    SprtConfig& sprtConfig = getSprtConfig();
+    sprtConfig.falseUnparkRate = loadFloatPreference(SETTING_SPRT_FALSE_UNPARK);
+    sprtConfig.falseParkRate = loadFloatPreference(SETTING_SPRT_FALSE_PARK);
+    setParkDecisionMode(loadIntPreference(SETTING_PARK_DECISION_MODE));
+    
+    // Sensor filter
+    use_filtering = loadIntPreference(SETTING_FILTER_ENABLED) != 0;
+    alpha = loadFloatPreference(SETTING_FILTER_ALPHA);
     
-    Debug.println("Loaded park position: Pitch=" + String(parkPitch, 2) + 
-                  "° Roll=" + String(parkRoll, 2) + "° Tolerance=±" + String(positionTolerance, 1) + "°");
+    LOG_DEBUG("Loaded park position: Pitch=%.2f° Roll=%.2f° Tolerance=±%.1f°", parkPitch, parkRoll, positionTolerance);
     
     if (isFlashStorageAvailable()) {
-        Debug.println("Settings loaded from persistent storage");
+        LOG_INFO("Settings loaded from persistent storage");
     } else {
-        Debug.println("Using default/RAM settings");
+        LOG_DEBUG("Using default/RAM settings");
     }
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "memory_stats.h"
+#include <malloc.h>
+#include <stdlib.h>
+
+#if defined(ARDUINO_ARCH_MBED)
+
+#include "mbed.h"
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include("rtx_os.h")
+#include "rtx_os.h"
+#define MEMORY_HAVE_RTX 1
+#endif
+#endif
+
+#if defined(MBED_HEAP_STATS_ENABLED) && MBED_HEAP_STATS_ENABLED
+#define MEMORY_HAVE_HEAP_STATS 1
+#endif
+
+extern "C" {
+extern uint32_t __StackLimit;            // Interrupt (MSP) stack bounds from the linker script
+extern uint32_t __StackTop;
+extern unsigned char* mbed_heap_start;   // Heap region handed to _sbrk by mbed_boot
+extern uint32_t mbed_heap_size;
+}
+
+#elif !defined(ARDUINO)
+
+// Host builds: count every C++ allocation (Arduino String included) through a
+// size header in front of each block
+#include <new>
+#define MEMORY_HOST_COUNTING 1
+
+static uint32_t hostAllocations = 0;
+static uint32_t hostFailures = 0;
+static uint32_t hostUsedBytes = 0;
+static const size_t HOST_HEADER = 16;    // Keeps the block max_align_t aligned
+
+void* operator new(size_t size) {
+    uint8_t* block = (uint8_t*)malloc(size + HOST_HEADER);
+    if (block == NULL) {
+        hostFailures++;
+        throw std::bad_alloc();
+    }
+    memcpy(block, &size, sizeof(size));
+    hostAllocations++;
+    hostUsedBytes += size;
+    return block + HOST_HEADER;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer == NULL) return;
+    uint8_t* block = (uint8_t*)pointer - HOST_HEADER;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    hostUsedBytes -= size;
+    free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+#endif
+
+static uint32_t sampledPeakBytes = 0;
+
+#if defined(ARDUINO_ARCH_MBED)
+
+static uint32_t* mainStackBottom = NULL;
+static uint32_t* mainStackTop = NULL;
+static uint32_t* isrStackBottom = NULL;
+static uint32_t* isrStackTop = NULL;
+
+static inline uint32_t* stackPointer() {
+    uint32_t* sp;
+    asm volatile("mov %0, sp" : "=r"(sp));
+    return sp;
+}
+
+static inline uint32_t* mainStackPointer() {
+    uint32_t* msp;
+    asm volatile("mrs %0, msp" : "=r"(msp));
+    return msp;
+}
+
+static void paint(uint32_t* from, uint32_t* to) {
+    while (from < to) *from++ = MEMORY_STACK_PAINT;
+}
+
+static uint32_t deepestUse(const uint32_t* bottom, const uint32_t* top) {
+    const uint32_t* p = bottom;
+    while (p < top && *p == MEMORY_STACK_PAINT) p++;
+    return (uint32_t)((top - p) * sizeof(uint32_t));
+}
+
+// Trial allocations made by the largest-block probe, kept out of the counts.
+// A probe briefly holds most of the heap, so mbed's all-time peak is only
+// trusted up to the first one.
+static uint32_t probeAllocations = 0;
+static uint32_t probeFailures = 0;
+#ifdef MEMORY_HAVE_HEAP_STATS
+static bool probed = false;
+static uint32_t peakBeforeProbe = 0;
+#endif
+
+static uint32_t probeLargestBlock(uint32_t upperBound) {
+    // Binary search on 16-byte granularity; every step is one malloc/free pair
+    uint32_t low = 0;
+    uint32_t high = upperBound / 16;
+    while (low < high) {
+        uint32_t mid = (low + high + 1) / 2;
+        void* block = malloc(mid * 16);
+        probeAllocations++;
+        if (block != NULL) {
+            free(block);
+            low = mid;
+        } else {
+            probeFailures++;
+            high = mid - 1;
+        }
+    }
+    return low * 16;
+}
+
+#endif
+
+void initMemoryStats() {
+#if defined(ARDUINO_ARCH_MBED)
+#ifdef MEMORY_HAVE_RTX
+    // loop() runs in the RTX main thread; its first word is RTX's overflow check
+    osRtxThread_t* thread = (osRtxThread_t*)osThreadGetId();
+    if (thread != NULL && thread->stack_mem != NULL) {
+        mainStackBottom = (uint32_t*)thread->stack_mem + 1;
+        mainStackTop = (uint32_t*)((uint8_t*)thread->stack_mem + thread->stack_size);
+        paint(mainStackBottom, stackPointer() - MEMORY_STACK_PAINT_MARGIN / sizeof(uint32_t));
+    }
+#endif
+
+    // Interrupts use the MSP stack, so hold them off while it is painted
+    isrStackBottom = &__StackLimit;
+    isrStackTop = &__StackTop;
+    __disable_irq();
+    paint(isrStackBottom, mainStackPointer() - MEMORY_STACK_PAINT_MARGIN / sizeof(uint32_t));
+    __enable_irq();
+#endif
+    sampledPeakBytes = 0;
+    sampleMemoryStats();
+}
+
+static uint32_t heapUsedBytes() {
+#ifdef MEMORY_HOST_COUNTING
+    return hostUsedBytes;
+#else
+    return (uint32_t)mallinfo().uordblks;
+#endif
+}
+
+void sampleMemoryStats() {
+    uint32_t used = heapUsedBytes();
+    if (used > sampledPeakBytes) sampledPeakBytes = used;
+}
+
+HeapStats getHeapStats(bool probeLargestBlockSize) {
+    HeapStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.available = true;
+    stats.usedBytes = heapUsedBytes();
+    sampleMemoryStats();
+    stats.peakBytes = sampledPeakBytes;
+
+#if defined(ARDUINO_ARCH_MBED)
+    struct mallinfo info = mallinfo();
+    uint8_t* heapEnd = mbed_heap_start + mbed_heap_size;
+    uint8_t* brk = (uint8_t*)sbrk(0);
+    stats.sizeBytes = mbed_heap_size;
+    stats.freeBytes = (uint32_t)info.fordblks + (brk < heapEnd ? (uint32_t)(heapEnd - brk) : 0);
+#ifdef MEMORY_HAVE_HEAP_STATS
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    if (!probed) peakBeforeProbe = heap.max_size;
+    if (peakBeforeProbe > stats.peakBytes) stats.peakBytes = peakBeforeProbe;
+    stats.countsAllocations = true;
+    stats.allocations = heap.alloc_cnt - probeAllocations;
+    stats.failures = heap.alloc_fail_cnt - probeFailures;
+#endif
+    if (probeLargestBlockSize) {
+#ifdef MEMORY_HAVE_HEAP_STATS
+        probed = true;
+#endif
+        stats.largestFreeBlock = probeLargestBlock(stats.freeBytes);
+    }
+#else
+    (void)probeLargestBlockSize;
+#if defined(MEMORY_HOST_COUNTING)
+    stats.countsAllocations = true;
+    stats.allocations = hostAllocations;
+    stats.failures = hostFailures;
+#endif
+#endif
+    return stats;
+}
+
+StackStats getMainStackStats() {
+    StackStats stats = {false, 0, 0};
+#if defined(ARDUINO_ARCH_MBED)
+    if (mainStackBottom != NULL) {
+        stats.available = true;
+        stats.sizeBytes = (uint32_t)((mainStackTop - mainStackBottom + 1) * sizeof(uint32_t));
+        stats.peakBytes = deepestUse(mainStackBottom, mainStackTop);
+    }
+#endif
+    return stats;
+}
+
+StackStats getInterruptStackStats() {
+    StackStats stats = {false, 0, 0};
+#if defined(ARDUINO_ARCH_MBED)
+    if (isrStackBottom != NULL) {
+        stats.available = true;
+        stats.sizeBytes = (uint32_t)((isrStackTop - isrStackBottom) * sizeof(uint32_t));
+        stats.peakBytes = deepestUse(isrStackBottom, isrStackTop);
+    }
+#endif
+    return stats;
+}
+
+uint32_t getAllocationCount() {
+#if defined(MEMORY_HAVE_HEAP_STATS)
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    return heap.alloc_cnt - probeAllocations;
+#elif defined(MEMORY_HOST_COUNTING)
+    return hostAllocations;
+#else
+    return 0;
+#endif
+}
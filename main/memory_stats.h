@@ -0,0 +1,51 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include "Arduino.h"
+
+// Heap and stack usage for long-uptime monitoring.
+//
+// Heap: newlib mallinfo() for the bytes in use, plus the untouched space
+// above the break. Allocation and failure counts come from mbed's heap
+// statistics when the core is built with MBED_HEAP_STATS_ENABLED; host
+// builds count through a replacement operator new/delete instead. Without
+// either, the peak is the highest usage seen by sampleMemoryStats().
+//
+// Stacks: initMemoryStats() paints the unused part of the main thread stack
+// and of the interrupt (MSP) stack with a pattern; the high-water mark is
+// the deepest word no longer holding it.
+
+#define MEMORY_STACK_PAINT 0xC5C5C5C5u
+#define MEMORY_STACK_PAINT_MARGIN 64     // Bytes left unpainted below the live stack pointer
+
+struct HeapStats {
+    bool available;
+    bool countsAllocations;      // allocations/failures are real counts
+    uint32_t usedBytes;
+    uint32_t peakBytes;
+    uint32_t sizeBytes;          // Whole heap region, 0 if unknown
+    uint32_t freeBytes;          // Free chunks plus the space above the break
+    uint32_t largestFreeBlock;   // Only filled in by a probing read
+    uint32_t allocations;        // Since boot
+    uint32_t failures;
+};
+
+struct StackStats {
+    bool available;
+    uint32_t sizeBytes;
+    uint32_t peakBytes;          // Deepest use since boot
+};
+
+void initMemoryStats();          // Call first in setup(), before the stacks have been deep
+void sampleMemoryStats();        // Once per loop; tracks the sampled heap peak
+
+// probeLargestBlock finds the largest allocatable block by trial allocation,
+// which takes a few hundred microseconds, so only on request
+HeapStats getHeapStats(bool probeLargestBlock);
+StackStats getMainStackStats();
+StackStats getInterruptStackStats();
+
+// Monotonic allocation counter for per-command deltas; 0 when not counted
+uint32_t getAllocationCount();
+
+#endif // MEMORY_STATS_H
@@ -0,0 +1,264 @@
+#include "microbench.h"
+#include "helpers.h"
+#include "position_sensor.h"
+#include "serial_interface.h"
+#include "flash_storage.h"
+#include "settings_registry.h"
+#include "sample_replay.h"
+#include "tx_buffer.h"
+#include "profiler.h"
+#include <string.h>
+
+// External global variables
+extern bool isParked;
+extern float parkPitch, parkRoll, positionTolerance;
+
+// Results are stored here so the compiler cannot drop the work
+static volatile float benchSinkFloat;
+static volatile uint32_t benchSinkWord;
+
+// Replayed sample the sensor cases start from: level, about 2048 counts of gravity
+static ReplaySample benchSample;
+static uint32_t benchRandom;
+static bool benchWasParked;
+
+static int16_t benchJitter() {
+    benchRandom = benchRandom * 1664525u + 1013904223u;
+    return (int16_t)((benchRandom >> 28) & 0x07) - 3;   // -3..+4 counts, a few tenths of a mg
+}
+
+static void startReplayBench(int decisionMode) {
+    benchWasParked = isParked;
+    startSampleReplay(getSampleTimeMs());
+
+    // Known settings, all put back when the replay stops
+    ax_offset = ay_offset = az_offset = 0.0;
+    parkPitch = 0.0;
+    parkRoll = 0.0;
+    positionTolerance = 2.0;
+    setParkDecisionMode(decisionMode);
+
+    // Start parked, so the loop measures the steady decision without notifications
+    ParkLogicState park = getParkLogicState();
+    park.parked = true;
+    park.pendingParked = true;
+    setParkLogicState(park);
+
+    benchRandom = 1;
+    benchSample.timeMs = getSampleTimeMs();
+    benchSample.counts[0] = 12;
+    benchSample.counts[1] = -8;
+    benchSample.counts[2] = 2040;
+    benchSample.failed = false;
+    replaySample(benchSample);
+}
+
+static void stopReplayBench() {
+    // Report the live state again without a notification for the bench's own park state
+    ParkLogicState park = getParkLogicState();
+    park.parked = benchWasParked;
+    setParkLogicState(park);
+    stopSampleReplay();
+}
+
+static void setupReadPosition() { startReplayBench(PARK_MODE_THRESHOLD); }
+static void setupParkThreshold() { startReplayBench(PARK_MODE_THRESHOLD); }
+static void setupParkSprt() { startReplayBench(PARK_MODE_SPRT); }
+
+static void runReadPosition(const char* arg, uint32_t iterations) {
+    (void)arg;
+    float pitch = 0.0, roll = 0.0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        readPosition(pitch, roll);
+    }
+    benchSinkFloat = pitch + roll;
+}
+
+static void runParkDecision(const char* arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) {
+        ReplaySample sample = benchSample;
+        sample.timeMs = getSampleReplayStats().replayTimeMs + 50;
+        sample.counts[0] += benchJitter();
+        sample.counts[1] += benchJitter();
+        sample.counts[2] += benchJitter();
+        replaySample(sample);
+    }
+}
+
+static void runJSONBuilder(const char* arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) {
+        // The shape of a typical status response: strings, floats, flags and counters
+        JSONBuilder json;
+        json.add("parked", true);
+        json.add("pitch", 12.34f);
+        json.add("roll", -5.67f);
+        json.add("parkPitch", 0.0f);
+        json.add("parkRoll", 0.0f);
+        json.add("tolerance", 2.0f);
+        json.add("filterEnabled", true);
+        json.add("uptime", (unsigned long)123456);
+        json.add("version", "2.0.2");
+        benchSinkWord = json.build().length();
+    }
+}
+
+static void runCommand(const char* arg, uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; i++) {
+        processSerialCommand(arg);
+        SerialTx.service();
+    }
+}
+
+// The whole engine, framing and session TX included, over an in-memory link
+static LoopbackTransport benchLink("loopback");
+static CommandSession benchSession;
+static int benchSessionIndex = -1;
+
+static void setupEngine() {
+    // Registered once and kept: sessions are never removed
+    if (benchSessionIndex < 0) benchSessionIndex = addCommandSession(benchSession, benchLink);
+}
+
+static void runEngine(const char* arg, uint32_t iterations) {
+    if (benchSessionIndex < 0) return;
+    for (uint32_t i = 0; i < iterations; i++) {
+        benchLink.feed(arg);
+        handleSerialCommands();
+        SerialTx.service();
+    }
+    benchSinkWord = benchLink.written();
+}
+
+static TelescopeSettings benchSettings;
+
+static void setupChecksum() {
+    memset(&benchSettings, 0, sizeof(benchSettings));
+    benchSettings.magic = 0x54454C45;
+    benchSettings.parkPitch = 1.5;
+    benchSettings.parkRoll = -2.5;
+    benchSettings.tolerance = 2.0;
+    benchSettings.cal_az_offset = 0.01;
+}
+
+static void runChecksum(const char* arg, uint32_t iterations) {
+    (void)arg;
+    uint32_t checksum = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        benchSettings.cal_timestamp = i;
+        checksum += calculateChecksum(benchSettings);
+    }
+    benchSinkWord = checksum;
+}
+
+static void runEncodeSettings(const char* arg, uint32_t iterations) {
+    (void)arg;
+    // The RAM side of a settings save: registry image plus record CRC
+    uint8_t payload[SETTING_COUNT * sizeof(SettingValue) + 16];
+    uint32_t crc = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        size_t length = encodeSettingsPayload(payload, sizeof(payload));
+        crc += calculateCRC32(payload, length);
+    }
+    benchSinkWord = crc;
+}
+
+static void runSaveSettings(const char* arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) {
+        // A full queue refuses the save; the bench pays for the wait instead
+        if (!saveSettingsToFlash()) {
+            waitForFlashIdle();
+            saveSettingsToFlash();
+        }
+    }
+    waitForFlashIdle();
+}
+
+static float savedOffsets[6];
+
+static void setupCalibrate() {
+    savedOffsets[0] = ax_offset; savedOffsets[1] = ay_offset; savedOffsets[2] = az_offset;
+    savedOffsets[3] = gx_offset; savedOffsets[4] = gy_offset; savedOffsets[5] = gz_offset;
+}
+
+static void teardownCalibrate() {
+    ax_offset = savedOffsets[0]; ay_offset = savedOffsets[1]; az_offset = savedOffsets[2];
+    gx_offset = savedOffsets[3]; gy_offset = savedOffsets[4]; gz_offset = savedOffsets[5];
+}
+
+static void runCalibrate(const char* arg, uint32_t iterations) {
+    (void)arg;
+    for (uint32_t i = 0; i < iterations; i++) {
+        calibrateSensor();
+    }
+}
+
+static const BenchCase BENCH_CASES[] = {
+    // name                       arg    flags            setup               run                teardown
+    {"sensor/readPosition",       NULL,  0,               setupReadPosition,  runReadPosition,   stopReplayBench},
+    {"park/threshold",            NULL,  0,               setupParkThreshold, runParkDecision,   stopReplayBench},
+    {"park/sprt",                 NULL,  0,               setupParkSprt,      runParkDecision,   stopReplayBench},
+    {"json/builder",              NULL,  0,               NULL,               runJSONBuilder,    NULL},
+    {"storage/checksum",          NULL,  0,               setupChecksum,      runChecksum,       NULL},
+    {"storage/encodeSettings",    NULL,  0,               NULL,               runEncodeSettings, NULL},
+    {"storage/saveSettings",      NULL,  BENCH_HOST_ONLY, NULL,               runSaveSettings,   NULL},
+    {"calibrate/sensor",          NULL,  BENCH_HOST_ONLY, setupCalibrate,     runCalibrate,      teardownCalibrate},
+    // Dispatch plus handler plus JSON response, for the read-only commands
+    {"command/01",                "01",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/02",                "02",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/03",                "03",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/05",                "05",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/08",                "08",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/0B",                "0B",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/0C",                "0C",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/11",                "11",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/16",                "16",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/1A",                "1A",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/1B",                "1B",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/20",                "20",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/21",                "21",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/22",                "22",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/23",                "23",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/24",                "24",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/25",                "25",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"command/unknown",           "FF",  BENCH_HOST_ONLY, NULL,               runCommand,        NULL},
+    {"engine/03",                 "<03>", BENCH_HOST_ONLY, setupEngine,       runEngine,         NULL},
+    {"engine/pipelined",          "<03><0B><08>", BENCH_HOST_ONLY, setupEngine, runEngine,         NULL},
+};
+
+#define BENCH_CASE_COUNT (sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]))
+
+size_t getBenchCaseCount() {
+    return BENCH_CASE_COUNT;
+}
+
+const BenchCase& getBenchCase(size_t index) {
+    return BENCH_CASES[index < BENCH_CASE_COUNT ? index : 0];
+}
+
+uint32_t benchCalibrate(const BenchCase& bench, uint32_t targetTicks) {
+    // Double the batch until it is long enough to time reliably
+    uint32_t iterations = 1;
+    for (;;) {
+        uint32_t start = profileNow();
+        bench.run(bench.arg, iterations);
+        uint32_t ticks = profileNow() - start;
+        if (ticks >= targetTicks || iterations >= (1u << 24)) return iterations;
+        // Jump close to the target once a batch is measurable at all
+        if (ticks > targetTicks / 64) {
+            uint64_t scaled = (uint64_t)iterations * targetTicks / ticks + 1;
+            return scaled > (1u << 24) ? (1u << 24) : (uint32_t)scaled;
+        }
+        iterations *= 2;
+    }
+}
+
+void benchMeasure(const BenchCase& bench, uint32_t iterations, uint32_t* batchTicks, size_t batches) {
+    for (size_t i = 0; i < batches; i++) {
+        uint32_t start = profileNow();
+        bench.run(bench.arg, iterations);
+        batchTicks[i] = profileNow() - start;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Microbenchmark suite for the sensor, protocol and storage hot paths.
+//
+// One table of cases runs in two places: natively in tools/bench, which
+// adds warm-up, repeated batches, robust statistics and JSON output for
+// regression tracking, and on the device through <26>, which reports DWT
+// cycles per operation. Timing uses profileNow() from profiler.h (CPU
+// cycles on the nRF52840, nanoseconds elsewhere).
+//
+// Sensor cases feed fixed raw samples through the sample replay path, so
+// the bus is stubbed out and the live filter and park state are restored
+// afterwards. Cases that send output, write flash or take seconds on the
+// device are marked BENCH_HOST_ONLY.
+
+#define BENCH_HOST_ONLY 0x01
+
+struct BenchCase {
+    const char* name;
+    const char* arg;                             // Passed to run(), e.g. the command to dispatch
+    uint8_t flags;
+    void (*setup)();                             // Optional
+    void (*run)(const char* arg, uint32_t iterations);
+    void (*teardown)();                          // Optional
+};
+
+size_t getBenchCaseCount();
+const BenchCase& getBenchCase(size_t index);
+
+// Iterations per batch so one batch takes at least targetTicks
+uint32_t benchCalibrate(const BenchCase& bench, uint32_t targetTicks);
+
+// Ticks taken by each of `batches` runs of `iterations`; setup/teardown are the caller's
+void benchMeasure(const BenchCase& bench, uint32_t iterations, uint32_t* batchTicks, size_t batches);
+
+#endif // MICROBENCH_H
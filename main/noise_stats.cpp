@@ -0,0 +1,100 @@
+#include "noise_stats.h"
+#include <math.h>
+#include <string.h>
+
+const uint32_t NOISE_WINDOW_SAMPLES[NOISE_WINDOW_COUNT] = {20, 200, 1200, 12000};
+
+// Resolution of the Allan phase sums: 0.0001 degree and 0.00001 g. A sum
+// over 2 * NOISE_ALLAN_MAX_M samples stays far inside int32 at these scales.
+static const float NOISE_QUANTUM[NOISE_CHANNEL_COUNT] = {1.0e4f, 1.0e4f, 1.0e5f, 1.0e5f, 1.0e5f};
+
+static void welfordAdd(WelfordBlock& block, float value) {
+    block.count++;
+    float delta = value - block.mean;
+    block.mean += delta / block.count;
+    block.m2 += delta * (value - block.mean);
+}
+
+// Chan et al. parallel combination, in double so long windows keep their precision
+static void welfordMerge(uint32_t& count, double& mean, double& m2, const WelfordBlock& block) {
+    if (block.count == 0) return;
+    uint32_t total = count + block.count;
+    double delta = block.mean - mean;
+    mean += delta * block.count / total;
+    m2 += block.m2 + delta * delta * (double)count * block.count / total;
+    count = total;
+}
+
+void noiseStatsReset(NoiseStats& stats) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+static void addToWindow(NoiseWindow& window, uint32_t blockSamples, float value) {
+    welfordAdd(window.current, value);
+    if (window.current.count < blockSamples) return;
+
+    window.blocks[window.next] = window.current;
+    window.next = (window.next + 1) % (NOISE_WINDOW_BLOCKS - 1);
+    if (window.filled < NOISE_WINDOW_BLOCKS - 1) window.filled++;
+    memset(&window.current, 0, sizeof(window.current));
+}
+
+void noiseStatsAdd(NoiseStats& stats, const float values[NOISE_CHANNEL_COUNT]) {
+    stats.samples++;
+    stats.phaseIndex = (stats.phaseIndex + 1) % NOISE_ALLAN_HISTORY;
+
+    for (int c = 0; c < NOISE_CHANNEL_COUNT; c++) {
+        NoiseChannelState& channel = stats.channels[c];
+
+        for (int w = 0; w < NOISE_WINDOW_COUNT; w++) {
+            addToWindow(channel.windows[w], NOISE_WINDOW_SAMPLES[w] / NOISE_WINDOW_BLOCKS, values[c]);
+        }
+
+        // Wrapping int32 arithmetic; only differences of the sums are used
+        channel.cumulative = (int32_t)((uint32_t)channel.cumulative + (uint32_t)lroundf(values[c] * NOISE_QUANTUM[c]));
+        channel.phase[stats.phaseIndex] = channel.cumulative;
+
+        for (int level = 0; level < NOISE_ALLAN_LEVELS; level++) {
+            uint32_t m = 1u << level;
+            if (stats.samples < 2 * m) break;    // Needs x[k-2m]; x[0] = 0 is the first phase point
+
+            uint16_t older = (stats.phaseIndex + NOISE_ALLAN_HISTORY - m) % NOISE_ALLAN_HISTORY;
+            uint16_t oldest = (stats.phaseIndex + NOISE_ALLAN_HISTORY - 2 * m) % NOISE_ALLAN_HISTORY;
+            int32_t second = (int32_t)((uint32_t)channel.cumulative - 2u * (uint32_t)channel.phase[older] +
+                                       (uint32_t)channel.phase[oldest]);
+            double difference = second / (double)NOISE_QUANTUM[c];
+            channel.allanSum[level] += difference * difference;
+            channel.allanTerms[level]++;
+        }
+    }
+}
+
+NoiseWindowResult noiseStatsWindow(const NoiseStats& stats, NoiseChannel channel, int window) {
+    NoiseWindowResult result = {0, 0.0f, 0.0f};
+    if (channel < 0 || channel >= NOISE_CHANNEL_COUNT || window < 0 || window >= NOISE_WINDOW_COUNT) return result;
+
+    const NoiseWindow& source = stats.channels[channel].windows[window];
+    uint32_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    for (uint8_t i = 0; i < source.filled; i++) welfordMerge(count, mean, m2, source.blocks[i]);
+    welfordMerge(count, mean, m2, source.current);
+
+    result.count = count;
+    result.mean = (float)mean;
+    result.stddev = count > 1 ? (float)sqrt(m2 / (count - 1)) : 0.0f;
+    return result;
+}
+
+bool noiseStatsAllan(const NoiseStats& stats, NoiseChannel channel, int level, float& deviation) {
+    deviation = 0.0f;
+    if (channel < 0 || channel >= NOISE_CHANNEL_COUNT || level < 0 || level >= NOISE_ALLAN_LEVELS) return false;
+
+    const NoiseChannelState& source = stats.channels[channel];
+    if (source.allanTerms[level] == 0) return false;
+
+    // Each term is m^2 times the difference of adjacent m-sample averages
+    double m = (double)(1u << level);
+    deviation = (float)sqrt(source.allanSum[level] / (2.0 * m * m * source.allanTerms[level]));
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef NOISE_STATS_H
+#define NOISE_STATS_H
+
+// Online noise and stability statistics for the sensor channels, updated
+// once per sample in constant time and fixed memory. Kept free of Arduino
+// dependencies like park_sprt.
+//
+// Sliding mean/standard deviation: each window is a ring of Welford
+// accumulators over sub-blocks of a tenth of the window, merged (Chan et al.)
+// only when read. The window therefore slides in steps of one sub-block and
+// covers between 90% and 100% of its nominal length once full.
+//
+// Overlapping Allan deviation at octave-spaced averaging times m * tau0,
+// m = 1, 2, 4 ... 256: the cumulative sum of each channel is kept as a ring
+// of quantized int32 values, so the second difference
+// x[k] - 2 x[k-m] + x[k-2m] is exact even after the sums wrap around.
+// Allan sums accumulate since the last reset.
+
+#include <stdint.h>
+
+enum NoiseChannel {
+    NOISE_PITCH = 0,             // Degrees
+    NOISE_ROLL,
+    NOISE_ACCEL_X,               // g
+    NOISE_ACCEL_Y,
+    NOISE_ACCEL_Z,
+    NOISE_CHANNEL_COUNT
+};
+
+#define NOISE_WINDOW_COUNT 4
+#define NOISE_WINDOW_BLOCKS 10
+#define NOISE_ALLAN_LEVELS 9
+#define NOISE_ALLAN_MAX_M (1u << (NOISE_ALLAN_LEVELS - 1))
+#define NOISE_ALLAN_HISTORY (2 * NOISE_ALLAN_MAX_M + 1)
+
+// Window lengths in samples (1s, 10s, 1min, 10min at 20Hz); multiples of NOISE_WINDOW_BLOCKS
+extern const uint32_t NOISE_WINDOW_SAMPLES[NOISE_WINDOW_COUNT];
+
+struct WelfordBlock {
+    uint32_t count;
+    float mean;
+    float m2;                    // Sum of squared deviations from the mean
+};
+
+struct NoiseWindow {
+    WelfordBlock blocks[NOISE_WINDOW_BLOCKS - 1];   // Completed sub-blocks, oldest overwritten
+    WelfordBlock current;
+    uint8_t next;                // Slot the current block goes to when complete
+    uint8_t filled;
+};
+
+struct NoiseChannelState {
+    NoiseWindow windows[NOISE_WINDOW_COUNT];
+    int32_t phase[NOISE_ALLAN_HISTORY];             // Quantized cumulative sums, ring
+    int32_t cumulative;
+    double allanSum[NOISE_ALLAN_LEVELS];            // Sum of squared second differences
+    uint32_t allanTerms[NOISE_ALLAN_LEVELS];
+};
+
+struct NoiseStats {
+    NoiseChannelState channels[NOISE_CHANNEL_COUNT];
+    uint32_t samples;            // Since reset
+    uint16_t phaseIndex;         // Ring slot of the newest cumulative sum
+};
+
+struct NoiseWindowResult {
+    uint32_t count;
+    float mean;
+    float stddev;                // Sample standard deviation, 0 below two samples
+};
+
+void noiseStatsReset(NoiseStats& stats);
+void noiseStatsAdd(NoiseStats& stats, const float values[NOISE_CHANNEL_COUNT]);
+NoiseWindowResult noiseStatsWindow(const NoiseStats& stats, NoiseChannel channel, int window);
+
+// Allan deviation at m = 2^level samples, in channel units; returns false
+// (and 0) until there are enough samples for that level
+bool noiseStatsAllan(const NoiseStats& stats, NoiseChannel channel, int level, float& deviation);
+
+#endif // NOISE_STATS_H
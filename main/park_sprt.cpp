@@ -0,0 +1,84 @@
+#include "park_sprt.h"
+#include <math.h>
+
+void sprtDefaultConfig(SprtConfig& config) {
+    config.falseUnparkRate = SPRT_DEFAULT_FALSE_UNPARK_RATE;
+    config.falseParkRate = SPRT_DEFAULT_FALSE_PARK_RATE;
+    config.indifference = SPRT_DEFAULT_INDIFFERENCE;
+    config.minSigma = SPRT_DEFAULT_MIN_SIGMA;
+    config.noiseWeight = SPRT_DEFAULT_NOISE_WEIGHT;
+    config.warmupSamples = SPRT_DEFAULT_WARMUP_SAMPLES;
+}
+
+void sprtReset(SprtState& state) {
+    state.noiseVariance = 0.0f;
+    state.lastDeviation = 0.0f;
+    state.haveLast = false;
+    state.noiseSamples = 0;
+    sprtRestart(state);
+}
+
+void sprtRestart(SprtState& state) {
+    state.llr = 0.0f;
+    state.samples = 0;
+}
+
+float sprtNoiseSigma(const SprtState& state, const SprtConfig& config) {
+    float sigma = sqrtf(state.noiseVariance);
+    return sigma > config.minSigma ? sigma : config.minSigma;
+}
+
+SprtResult sprtUpdate(SprtState& state, const SprtConfig& config, float deviation, float tolerance) {
+    SprtResult result = {PARK_DECISION_NONE, 0.0f, 0};
+
+    // Estimate per-sample noise from successive differences, which cancels
+    // any steady offset from the park position: Var(x[k] - x[k-1]) = 2 sigma^2.
+    // Differences are clipped at SPRT_NOISE_CLIP sigma so the motion of a slew
+    // is not mistaken for noise; genuine noise increases still get through
+    // at a bounded rate per sample. The first warmupSamples differences are a
+    // plain mean instead: the EWMA would start biased towards zero, and the
+    // clip would hold the estimate near the minSigma floor.
+    bool warmingUp = state.noiseSamples < config.warmupSamples;
+    if (state.haveLast) {
+        float diff = deviation - state.lastDeviation;
+        float diffSquared = diff * diff;
+        if (warmingUp) {
+            state.noiseSamples++;
+            state.noiseVariance += (0.5f * diffSquared - state.noiseVariance) / state.noiseSamples;
+        } else {
+            float clip = SPRT_NOISE_CLIP * sprtNoiseSigma(state, config);
+            if (diffSquared > clip * clip) diffSquared = clip * clip;
+            state.noiseVariance += config.noiseWeight * (0.5f * diffSquared - state.noiseVariance);
+        }
+    }
+    state.lastDeviation = deviation;
+    state.haveLast = true;
+    
+    // Until then sigma is the floor or a guess from a few samples, and each
+    // sample would move the LLR far more than it is worth: no evidence yet
+    if (warmingUp) return result;
+
+    // Gaussian mean test, H0: mu = tol - d (parked) vs H1: mu = tol + d (unparked)
+    // Per-sample log-likelihood ratio is (mu1 - mu0) / sigma^2 * (x - (mu0 + mu1) / 2)
+    float sigma = sprtNoiseSigma(state, config);
+    float delta = config.indifference;
+    state.llr += (2.0f * delta / (sigma * sigma)) * (deviation - tolerance);
+    state.samples++;
+
+    float upper = logf((1.0f - config.falseParkRate) / config.falseUnparkRate);
+    float lower = logf(config.falseParkRate / (1.0f - config.falseUnparkRate));
+
+    if (state.llr >= upper) {
+        result.decision = PARK_DECISION_UNPARKED;
+        result.confidence = 1.0f / (1.0f + expf(-state.llr));
+    } else if (state.llr <= lower) {
+        result.decision = PARK_DECISION_PARKED;
+        result.confidence = 1.0f / (1.0f + expf(state.llr));
+    } else {
+        return result;
+    }
+
+    result.samples = state.samples;
+    sprtRestart(state);
+    return result;
+}
@@ -0,0 +1,59 @@
+#ifndef PARK_SPRT_H
+#define PARK_SPRT_H
+
+// Wald sequential probability ratio test for the park decision.
+// Kept free of Arduino dependencies so the host simulator in
+// tools/sprt_sim can run exactly the same code.
+
+#include <stdint.h>
+
+enum ParkDecision {
+    PARK_DECISION_NONE = 0,      // Evidence still inside the thresholds
+    PARK_DECISION_PARKED = 1,
+    PARK_DECISION_UNPARKED = 2
+};
+
+struct SprtConfig {
+    float falseUnparkRate;   // alpha: P(decide unparked | parked)
+    float falseParkRate;     // beta:  P(decide parked | unparked)
+    float indifference;      // Half-width (degrees) of the zone around tolerance where either answer is fine
+    float minSigma;          // Floor on the noise estimate (degrees)
+    float noiseWeight;       // EWMA weight for the noise estimate
+    uint8_t warmupSamples;   // Differences averaged into the noise estimate before any decision
+};
+
+struct SprtState {
+    float llr;               // Log-likelihood ratio, positive favours unparked
+    float noiseVariance;     // Running estimate of per-sample variance (deg^2)
+    float lastDeviation;
+    bool haveLast;
+    uint32_t samples;        // Samples in the current test
+    uint8_t noiseSamples;    // Differences in the noise estimate, saturates at warmupSamples
+};
+
+struct SprtResult {
+    ParkDecision decision;
+    float confidence;        // Posterior probability of the decided state (equal priors)
+    uint32_t samples;        // Samples the decision took
+};
+
+#define SPRT_DEFAULT_FALSE_UNPARK_RATE 0.001
+#define SPRT_DEFAULT_FALSE_PARK_RATE 0.001
+#define SPRT_DEFAULT_INDIFFERENCE 0.05
+#define SPRT_DEFAULT_MIN_SIGMA 0.005
+#define SPRT_DEFAULT_NOISE_WEIGHT 0.05
+#define SPRT_DEFAULT_WARMUP_SAMPLES 10   // Half a second at 20Hz
+#define SPRT_NOISE_CLIP 4.0          // Successive differences beyond this many sigma are clipped
+
+void sprtDefaultConfig(SprtConfig& config);
+void sprtReset(SprtState& state);
+void sprtRestart(SprtState& state);  // New test, keeps the noise estimate
+float sprtNoiseSigma(const SprtState& state, const SprtConfig& config);
+
+// Feed one sample of deviation from the park position (degrees, >= 0).
+// Returns a decision once the evidence crosses either threshold; the
+// test then restarts automatically. After sprtReset() the first
+// warmupSamples samples only train the noise estimate.
+SprtResult sprtUpdate(SprtState& state, const SprtConfig& config, float deviation, float tolerance);
+
+#endif // PARK_SPRT_H
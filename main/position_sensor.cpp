@@ -1,6 +1,10 @@
 #include "position_sensor.h"
 #include "helpers.h"
 #include "flash_storage.h" 
+#include "tx_buffer.h"
+#include "sample_log.h"
+#include "profiler.h"
+#include "sample_replay.h"
 #include <math.h>
 
 // Use the same approach as the working example
@@ -10,6 +14,8 @@
 // Create IMU instance exactly like the working example
 LSM6DS3 imu(I2C_MODE, 0x6A);
 
+#define REG_OUTX_L_XL 0x28              // X, Y, Z accelerometer outputs, little-endian
+
 // Calibration offsets for LSM6DS3TR-C
 float ax_offset = 0.0, ay_offset = 0.0, az_offset = 0.0;
 float gx_offset = 0.0, gy_offset = 0.0, gz_offset = 0.0;
@@ -22,59 +28,79 @@ float filtered_ax = 0, filtered_ay = 0, filtered_az = 0;
 // Add option to disable filtering entirely for testing
 bool use_filtering = true;
 
+// Magnitude of the last filtered acceleration vector (g), for telemetry
+float lastAccelMagnitude = 0.0;
+
+// Angles from the last calibrated but unfiltered sample. The EMA output is
+// autocorrelated, so statistical park decisions use these instead.
+float unfilteredPitch = 0.0, unfilteredRoll = 0.0;
+float unfilteredAx = 0.0, unfilteredAy = 0.0, unfilteredAz = 0.0;
+
+// Wire starts at the core default, I2C_CLOCK_SPEED in constants.h
+static uint32_t imuBusClockHz = 100000;
+
+void setImuBusClock(uint32_t hz) {
+    Wire.setClock(hz);
+    imuBusClockHz = hz;
+}
+
+uint32_t getImuBusClock() {
+    return imuBusClockHz;
+}
+
 bool initPositionSensor() {
-    Debug.println("Initializing built-in LSM6DS3TR-C IMU on XIAO Sense Plus...");
-    Debug.println("Using Seeed Arduino LSM6DS3 library (working example approach)");
+    LOG_INFO("Initializing built-in LSM6DS3TR-C IMU on XIAO Sense Plus...");
+    LOG_DEBUG("Using Seeed Arduino LSM6DS3 library (working example approach)");
     
     // Initialize exactly like the working example
     if (imu.begin() != 0) {
-        Debug.println("✗ Device error - IMU initialization failed");
+        LOG_ERROR("✗ Device error - IMU initialization failed");
         return false;
     } else {
-        Debug.println("✓ Device OK! - IMU initialized successfully");
+        LOG_INFO("✓ Device OK! - IMU initialized successfully");
     }
     
     // Test basic readings to make sure it's working
-    Debug.println("Testing basic sensor readings...");
+    LOG_DEBUG("Testing basic sensor readings...");
     float ax = imu.readFloatAccelX();
     float ay = imu.readFloatAccelY(); 
     float az = imu.readFloatAccelZ();
     float temp = imu.readTempC();
     
-    Debug.println("Initial readings:");
-    Debug.println("  Accel X: " + String(ax, 4));
-    Debug.println("  Accel Y: " + String(ay, 4));
-    Debug.println("  Accel Z: " + String(az, 4));
-    Debug.println("  Temperature: " + String(temp, 2) + "°C");
+    LOG_DEBUG("Initial readings:");
+    LOG_DEBUG("  Accel X: %.4f", ax);
+    LOG_DEBUG("  Accel Y: %.4f", ay);
+    LOG_DEBUG("  Accel Z: %.4f", az);
+    LOG_DEBUG("  Temperature: %.2f°C", temp);
     
     if (ax == 0 && ay == 0 && az == 0) {
-        Debug.println("⚠ All accelerometer readings are zero - sensor may not be working");
+        LOG_WARN("⚠ All accelerometer readings are zero - sensor may not be working");
         return false;
     }
     
-    Debug.println("✓ Sensor is providing valid data");
-    Debug.println("Filter alpha: " + String(alpha, 2) + " (lower = more responsive)");
-    Debug.println("Filter enabled: " + String(use_filtering ? "YES" : "NO"));
+    LOG_INFO("✓ Sensor is providing valid data");
+    LOG_DEBUG("Filter alpha: %.2f (lower = more responsive)", alpha);
+    LOG_DEBUG("Filter enabled: %s", (use_filtering ? "YES" : "NO"));
     
     // Load or perform calibration
     if (hasStoredCalibration()) {
-        Debug.println("Found stored calibration data, loading...");
+        LOG_DEBUG("Found stored calibration data, loading...");
         loadCalibration();
-        Debug.println("Stored calibration loaded successfully!");
+        LOG_INFO("Stored calibration loaded successfully!");
     } else {
-        Debug.println("No stored calibration found, performing initial calibration...");
+        LOG_DEBUG("No stored calibration found, performing initial calibration...");
         calibrateSensor();
         saveCalibration();
-        Debug.println("Initial calibration complete and saved!");
+        LOG_INFO("Initial calibration complete and saved!");
     }
 
-    Debug.println("✓ Built-in LSM6DS3TR-C IMU ready!");
+    LOG_INFO("✓ Built-in LSM6DS3TR-C IMU ready!");
     return true;
 }
 
 void calibrateSensor() {
-    Debug.println("Calibrating LSM6DS3TR-C... Keep XIAO Sense Plus still!");
-    Debug.println("This will take about 5 seconds...");
+    LOG_INFO("Calibrating LSM6DS3TR-C... Keep XIAO Sense Plus still!");
+    LOG_DEBUG("This will take about 5 seconds...");
     
     float ax_sum = 0, ay_sum = 0, az_sum = 0;
     float gx_sum = 0, gy_sum = 0, gz_sum = 0;
@@ -106,15 +132,16 @@ void calibrateSensor() {
             
             successful_reads++;
         } else {
-            Debug.println("Warning: Invalid reading during calibration at sample " + String(i));
+            LOG_WARN("Warning: Invalid reading during calibration at sample %d", i);
         }
         
         delay(sample_delay);
         
         if (i % 50 == 0) {
-            Debug.println("Calibration progress: " + String((i * 100) / total_samples) + "% (" + String(successful_reads) + " successful reads)");
+            LOG_DEBUG("Calibration progress: %d%% (%d successful reads)", (i * 100) / total_samples, successful_reads);
         }
         
+        SerialTx.service(); // Keep queued output moving during the 5 second run
         yield(); // For mbed core
     }
     
@@ -130,24 +157,37 @@ void calibrateSensor() {
         gz_offset = gz_sum / successful_reads;
     }
     
-    Debug.println("LSM6DS3TR-C (XIAO Sense Plus) - Accelerometer offsets: X=" + String(ax_offset, 4) + 
-                  " Y=" + String(ay_offset, 4) + " Z=" + String(az_offset, 4));
-    Debug.println("LSM6DS3TR-C (XIAO Sense Plus) - Gyroscope offsets: X=" + String(gx_offset, 4) + 
-                  " Y=" + String(gy_offset, 4) + " Z=" + String(gz_offset, 4));
+    LOG_DEBUG("LSM6DS3TR-C (XIAO Sense Plus) - Accelerometer offsets: X=%.4f Y=%.4f Z=%.4f", ax_offset, ay_offset, az_offset);
+    LOG_DEBUG("LSM6DS3TR-C (XIAO Sense Plus) - Gyroscope offsets: X=%.4f Y=%.4f Z=%.4f", gx_offset, gy_offset, gz_offset);
+}
+
+// All three axes in one bus transaction, so they come from the same sample
+static bool readAccelCounts(int16_t counts[3]) {
+    uint8_t raw[6];
+    if (imu.readRegisterRegion(raw, REG_OUTX_L_XL, sizeof(raw)) != IMU_SUCCESS) return false;
+    for (int i = 0; i < 3; i++) {
+        counts[i] = (int16_t)(raw[2 * i] | ((uint16_t)raw[2 * i + 1] << 8));
+    }
+    return true;
 }
 
 bool readPosition(float &pitch, float &roll) {
-    // Read accelerometer data using the same methods as working example
-    float ax = imu.readFloatAccelX();
-    float ay = imu.readFloatAccelY();
-    float az = imu.readFloatAccelZ();
+    PROFILE_SCOPE(PROFILE_SENSOR_READ);
+    // Raw counts come from the sensor, or from a recording while replaying
+    int16_t counts[3] = {0, 0, 0};
+    bool valid = isReplayActive() ? takeReplaySample(counts) : readAccelCounts(counts);
+    recordSample(counts, valid);
     
     // Check if readings are valid
-    if (isnan(ax) || isnan(ay) || isnan(az)) {
-        Debug.println("Error: Invalid readings from LSM6DS3TR-C");
+    if (!valid) {
+        LOG_ERROR("Error: Invalid readings from LSM6DS3TR-C");
         return false;
     }
     
+    float ax = imu.calcAccel(counts[0]);
+    float ay = imu.calcAccel(counts[1]);
+    float az = imu.calcAccel(counts[2]);
+    
     // Apply calibration offsets
     ax -= ax_offset;
     ay -= ay_offset;
@@ -175,31 +215,43 @@ bool readPosition(float &pitch, float &roll) {
     // Calculate magnitude and validate
     float magnitude = sqrt(final_ax * final_ax + final_ay * final_ay + final_az * final_az);
     if (magnitude < 0.1) {  // Was POSITION_MAGNITUDE_THRESHOLD
-        Debug.println("Warning: Low accelerometer magnitude detected: " + String(magnitude, 4));
+        LOG_WARN("Warning: Low accelerometer magnitude detected: %.4f", magnitude);
         return false;
     }
+    lastAccelMagnitude = magnitude;
     
     // IMPROVED: Better pitch and roll calculation with proper handling
     // Standard aerospace convention pitch and roll calculations
     pitch = atan2(-final_ax, sqrt(final_ay * final_ay + final_az * final_az)) * 180.0 / PI;
     roll = atan2(final_ay, final_az) * 180.0 / PI;
     
+    unfilteredAx = ax;
+    unfilteredAy = ay;
+    unfilteredAz = az;
+    if (use_filtering) {
+        unfilteredPitch = atan2(-ax, sqrt(ay * ay + az * az)) * 180.0 / PI;
+        unfilteredRoll = atan2(ay, az) * 180.0 / PI;
+    } else {
+        unfilteredPitch = pitch;
+        unfilteredRoll = roll;
+    }
+    
     // Additional debug output every 2 seconds when debug enabled
     /*
     static unsigned long lastDebugOutput = 0;
     if (millis() - lastDebugOutput >= 2000) {
-        Debug.println("Sensor data - Raw: ax=" + String(ax, 3) + " ay=" + String(ay, 3) + " az=" + String(az, 3));
-        Debug.println("Sensor data - Final: ax=" + String(final_ax, 3) + " ay=" + String(final_ay, 3) + " az=" + String(final_az, 3));
-        Debug.println("Calculated angles - Pitch=" + String(pitch, 2) + "° Roll=" + String(roll, 2) + "°");
-        Debug.println("Filter enabled: " + String(use_filtering ? "YES" : "NO") + " Alpha: " + String(alpha, 2));
+        LOG_DEBUG("Sensor data - Raw: ax=%.3f ay=%.3f az=%.3f", ax, ay, az);
+        LOG_DEBUG("Sensor data - Final: ax=%.3f ay=%.3f az=%.3f", final_ax, final_ay, final_az);
+        LOG_DEBUG("Calculated angles - Pitch=%.2f° Roll=%.2f°", pitch, roll);
+        LOG_DEBUG("Filter enabled: %s Alpha: %.2f", (use_filtering ? "YES" : "NO"), alpha);
         lastDebugOutput = millis();
     }
     */
 
     // Validate calculated values
     if (!isValidPosition(pitch, roll)) {
-        Debug.println("Error: Invalid pitch/roll values calculated from LSM6DS3TR-C");
-        Debug.println("Pitch: " + String(pitch, 4) + " Roll: " + String(roll, 4));
+        LOG_ERROR("Error: Invalid pitch/roll values calculated from LSM6DS3TR-C");
+        LOG_ERROR("Pitch: %.4f Roll: %.4f", pitch, roll);
         return false;
     }
     
@@ -209,11 +261,11 @@ bool readPosition(float &pitch, float &roll) {
 // Simple function to toggle filtering for testing
 void setFiltering(bool enable) {
     use_filtering = enable;
-    Debug.println("Filtering " + String(enable ? "ENABLED" : "DISABLED"));
+    LOG_DEBUG("Filtering %s", (enable ? "ENABLED" : "DISABLED"));
     if (enable) {
-        Debug.println("Filter alpha: " + String(alpha, 2) + " (lower = more responsive)");
+        LOG_DEBUG("Filter alpha: %.2f (lower = more responsive)", alpha);
     } else {
-        Debug.println("Using raw sensor data (maximum responsiveness)");
+        LOG_DEBUG("Using raw sensor data (maximum responsiveness)");
     }
 }
 
@@ -221,52 +273,52 @@ void setFiltering(bool enable) {
 void setFilterAlpha(float new_alpha) {
     if (new_alpha >= 0.0 && new_alpha <= 1.0) {
         alpha = new_alpha;
-        Debug.println("Filter alpha set to: " + String(alpha, 2));
-        Debug.println("(0.0 = no filtering, 1.0 = maximum filtering)");
+        LOG_DEBUG("Filter alpha set to: %.2f", alpha);
+        LOG_DEBUG("(0.0 = no filtering, 1.0 = maximum filtering)");
     } else {
-        Debug.println("Invalid alpha value. Must be 0.0 to 1.0");
+        LOG_WARN("Invalid alpha value. Must be 0.0 to 1.0");
     }
 }
 
 bool hasStoredCalibration() {
-    // Check if calibration values exist in our simple storage
-    return (loadFloatPreference("cal_ax_offset", -999.0) != -999.0 && 
-            loadFloatPreference("cal_ay_offset", -999.0) != -999.0 && 
-            loadFloatPreference("cal_az_offset", -999.0) != -999.0);
+    // Check if calibration values were loaded from storage or saved since boot
+    return (isSettingStored(SETTING_CAL_AX_OFFSET) && 
+            isSettingStored(SETTING_CAL_AY_OFFSET) && 
+            isSettingStored(SETTING_CAL_AZ_OFFSET));
 }
 
 void loadCalibration() {
-    ax_offset = loadFloatPreference("cal_ax_offset", 0.0);
-    ay_offset = loadFloatPreference("cal_ay_offset", 0.0);
-    az_offset = loadFloatPreference("cal_az_offset", 0.0);
-    gx_offset = loadFloatPreference("cal_gx_offset", 0.0);
-    gy_offset = loadFloatPreference("cal_gy_offset", 0.0);
-    gz_offset = loadFloatPreference("cal_gz_offset", 0.0);
+    ax_offset = loadFloatPreference(SETTING_CAL_AX_OFFSET);
+    ay_offset = loadFloatPreference(SETTING_CAL_AY_OFFSET);
+    az_offset = loadFloatPreference(SETTING_CAL_AZ_OFFSET);
+    gx_offset = loadFloatPreference(SETTING_CAL_GX_OFFSET);
+    gy_offset = loadFloatPreference(SETTING_CAL_GY_OFFSET);
+    gz_offset = loadFloatPreference(SETTING_CAL_GZ_OFFSET);
     
-    Debug.println("LSM6DS3TR-C (XIAO Sense Plus) - Loaded calibration offsets:");
-    Debug.println("Accelerometer: X=" + String(ax_offset, 4) + 
-                  " Y=" + String(ay_offset, 4) + " Z=" + String(az_offset, 4));
-    Debug.println("Gyroscope: X=" + String(gx_offset, 4) + 
-                  " Y=" + String(gy_offset, 4) + " Z=" + String(gz_offset, 4));
+    LOG_DEBUG("LSM6DS3TR-C (XIAO Sense Plus) - Loaded calibration offsets:");
+    LOG_DEBUG("Accelerometer: X=%.4f Y=%.4f Z=%.4f", ax_offset, ay_offset, az_offset);
+    LOG_DEBUG("Gyroscope: X=%.4f Y=%.4f Z=%.4f", gx_offset, gy_offset, gz_offset);
 }
 
 void saveCalibration() {
-    saveFloatPreference("cal_ax_offset", ax_offset);
-    saveFloatPreference("cal_ay_offset", ay_offset);
-    saveFloatPreference("cal_az_offset", az_offset);
-    saveFloatPreference("cal_gx_offset", gx_offset);
-    saveFloatPreference("cal_gy_offset", gy_offset);
-    saveFloatPreference("cal_gz_offset", gz_offset);
+    // All seven values go to flash in one commit
+    beginPreferenceTransaction();
+    saveFloatPreference(SETTING_CAL_AX_OFFSET, ax_offset);
+    saveFloatPreference(SETTING_CAL_AY_OFFSET, ay_offset);
+    saveFloatPreference(SETTING_CAL_AZ_OFFSET, az_offset);
+    saveFloatPreference(SETTING_CAL_GX_OFFSET, gx_offset);
+    saveFloatPreference(SETTING_CAL_GY_OFFSET, gy_offset);
+    saveFloatPreference(SETTING_CAL_GZ_OFFSET, gz_offset);
     
     // Also save a timestamp for reference
-    saveFloatPreference("cal_timestamp", millis());
+    saveIntPreference(SETTING_CAL_TIMESTAMP, millis());
+    commitPreferenceTransaction();
+    logEvent(LOG_EVENT_CALIBRATION);
     
-    Debug.println("LSM6DS3TR-C (XIAO Sense Plus) - Calibration data saved");
+    LOG_INFO("LSM6DS3TR-C (XIAO Sense Plus) - Calibration data saved");
     // Remove the isFlashStorageAvailable() check, just always show RAM message
-    Debug.println("⚠ Calibration saved to enhanced RAM only - will be lost on power cycle");
-    Debug.println("Note: Enhanced RAM storage includes validation and checksums");
-    Debug.println("Accelerometer offsets: X=" + String(ax_offset, 4) + 
-                  " Y=" + String(ay_offset, 4) + " Z=" + String(az_offset, 4));
-    Debug.println("Gyroscope offsets: X=" + String(gx_offset, 4) + 
-                  " Y=" + String(gy_offset, 4) + " Z=" + String(gz_offset, 4));
+    LOG_WARN("⚠ Calibration saved to enhanced RAM only - will be lost on power cycle");
+    LOG_DEBUG("Note: Enhanced RAM storage includes validation and checksums");
+    LOG_DEBUG("Accelerometer offsets: X=%.4f Y=%.4f Z=%.4f", ax_offset, ay_offset, az_offset);
+    LOG_DEBUG("Gyroscope offsets: X=%.4f Y=%.4f Z=%.4f", gx_offset, gy_offset, gz_offset);
 }
\ No newline at end of file
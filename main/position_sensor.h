@@ -22,6 +22,11 @@ bool hasStoredCalibration();
 void setFiltering(bool enable);
 void setFilterAlpha(float new_alpha);
 
+// I2C clock of the IMU bus. The mbed core cannot report it, so changes go
+// through here and the last one set is remembered.
+void setImuBusClock(uint32_t hz);
+uint32_t getImuBusClock();
+
 // Calibration values (using float for LSM6DS3TR-C)
 extern float ax_offset, ay_offset, az_offset;
 extern float gx_offset, gy_offset, gz_offset;
@@ -29,5 +34,9 @@ extern float gx_offset, gy_offset, gz_offset;
 // Filter control variables
 extern bool use_filtering;
 extern float alpha;  // Removed const so we can change it
+extern float filtered_ax, filtered_ay, filtered_az;  // EMA filter state
+extern float lastAccelMagnitude;  // Filtered accelerometer magnitude (g)
+extern float unfilteredPitch, unfilteredRoll;  // Angles before the EMA filter
+extern float unfilteredAx, unfilteredAy, unfilteredAz;  // Calibrated acceleration before the EMA filter (g)
 
 #endif // POSITION_SENSOR_H
\ No newline at end of file
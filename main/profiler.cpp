@@ -0,0 +1,39 @@
+#include "profiler.h"
+#include <string.h>
+
+const char* const PROFILE_STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+    "loop", "serialRx", "command", "usbTx", "sensorRead", "parkEval",
+    "led", "telemetry", "sampleLog", "flash", "burst", "vibration"
+};
+
+static ProfileStats stats[PROFILE_STAGE_COUNT];
+
+void profilerInit() {
+#if defined(ARDUINO_ARCH_MBED)
+    PROFILE_DEMCR |= (1u << 24);     // TRCENA: power the DWT unit
+    PROFILE_DWT_CYCCNT = 0;
+    PROFILE_DWT_CTRL |= 1u;          // CYCCNTENA
+#endif
+    profilerReset();
+}
+
+void profilerReset() {
+    memset(stats, 0, sizeof(stats));
+}
+
+void profileRecord(ProfileStage stage, uint32_t ticks) {
+    ProfileStats& s = stats[stage];
+    s.count++;
+    s.totalTicks += ticks;
+    if (s.count == 1 || ticks < s.minTicks) s.minTicks = ticks;
+    if (ticks > s.maxTicks) s.maxTicks = ticks;
+
+    // floor(log2(ticks)) with one CLZ instruction; 0 and 1 tick share bucket 0
+    int bucket = ticks > 1 ? 31 - __builtin_clz(ticks) : 0;
+    if (bucket >= PROFILE_BUCKETS) bucket = PROFILE_BUCKETS - 1;
+    s.histogram[bucket]++;
+}
+
+const ProfileStats& getProfileStats(ProfileStage stage) {
+    return stats[stage];
+}
@@ -0,0 +1,104 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Scoped cycle profiler for the main loop stages. On the nRF52840 durations
+// come from the Cortex-M4 DWT cycle counter (one tick per CPU cycle, a single
+// register read per probe); elsewhere from std::chrono::steady_clock in
+// nanoseconds, so the same probes work in host builds. Kept free of Arduino
+// dependencies like park_sprt.
+//
+// Each stage keeps count, min, max, total and a log2 histogram: bucket k
+// counts durations of [2^k, 2^(k+1)) ticks, the last bucket everything longer.
+//
+// Set PROFILING to 0 (here or with -DPROFILING=0) to compile every probe out.
+
+#include <stdint.h>
+
+#ifndef PROFILING
+#define PROFILING 1
+#endif
+
+enum ProfileStage {
+    PROFILE_LOOP = 0,            // Whole loop() body, without the trailing delay
+    PROFILE_SERIAL_RX,           // Reading and framing incoming command bytes
+    PROFILE_COMMAND,             // Command handlers, including building the JSON response
+    PROFILE_USB_TX,              // Handing queued output to USB
+    PROFILE_SENSOR_READ,         // readPosition(): I2C transfer and angle math
+    PROFILE_PARK_EVAL,           // Park decision, history and noise statistics
+    PROFILE_LED,
+    PROFILE_TELEMETRY,           // Subscription check and frame formatting
+    PROFILE_SAMPLE_LOG,          // Logging a sample and servicing downloads
+    PROFILE_FLASH,               // Write-behind settings commit
+    PROFILE_BURST,               // Burst capture FIFO drain and streaming
+    PROFILE_VIBRATION,           // One vibration FFT step
+    PROFILE_STAGE_COUNT
+};
+
+#define PROFILE_BUCKETS 28       // 2^27 cycles is about 2s at 64MHz
+
+struct ProfileStats {
+    uint32_t count;
+    uint32_t minTicks;
+    uint32_t maxTicks;
+    uint64_t totalTicks;
+    uint32_t histogram[PROFILE_BUCKETS];
+};
+
+extern const char* const PROFILE_STAGE_NAMES[PROFILE_STAGE_COUNT];
+
+#if defined(ARDUINO_ARCH_MBED)
+
+// Core debug and DWT registers (ARMv7-M architecture reference, C1.6 and C1.8)
+#define PROFILE_DEMCR (*(volatile uint32_t*)0xE000EDFC)
+#define PROFILE_DWT_CTRL (*(volatile uint32_t*)0xE0001000)
+#define PROFILE_DWT_CYCCNT (*(volatile uint32_t*)0xE0001004)
+#define PROFILE_TICKS_PER_US 64.0f   // nRF52840 core clock
+
+inline uint32_t profileNow() {
+    return PROFILE_DWT_CYCCNT;
+}
+
+#else
+
+#include <chrono>
+#define PROFILE_TICKS_PER_US 1000.0f
+
+inline uint32_t profileNow() {
+    // Wraps every 4.3s, which only matters for durations longer than that
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
+
+void profilerInit();                 // Starts the cycle counter on the target
+void profilerReset();
+void profileRecord(ProfileStage stage, uint32_t ticks);
+const ProfileStats& getProfileStats(ProfileStage stage);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileStage stage) : stage(stage), start(profileNow()) {}
+    ~ProfileScope() { profileRecord(stage, profileNow() - start); }
+
+private:
+    ProfileStage stage;
+    uint32_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILING
+// Times the rest of the enclosing block
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+// Times a stretch of statements that is not a block of its own
+#define PROFILE_START(name) uint32_t name = profileNow()
+#define PROFILE_STOP(stage, name) profileRecord(stage, profileNow() - name)
+#else
+#define PROFILE_SCOPE(stage) do {} while (0)
+#define PROFILE_START(name) do {} while (0)
+#define PROFILE_STOP(stage, name) do {} while (0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,386 @@
+#include "qspi_flash.h"
+#include "Debug.h"
+#include "nrfx_qspi.h"
+
+// Execute-in-place window: external flash address N reads at QSPI_XIP_BASE + N
+#define QSPI_XIP_BASE 0x12000000
+#define QSPI_XIP_SIZE 0x08000000
+
+// QSPI Commands (from Seeed example)
+#define QSPI_STD_CMD_WRSR   0x01
+#define QSPI_STD_CMD_RSTEN  0x66
+#define QSPI_STD_CMD_RST    0x99
+#define QSPI_DPM_ENTER      0x0003
+#define QSPI_DPM_EXIT       0x0003
+
+// QSPI register bits
+#define QSPI_STATUS_DPM     0x00000004   // Memory is in deep power-down
+#define QSPI_STATUS_READY   0x00000008   // Peripheral ready for a new task
+#define QSPI_STATUS_WIP     0x01000000   // Flash status register: write in progress
+#define QSPI_IFCONFIG1_DPMEN 0x01000000  // Enter deep power-down
+
+enum QspiOpType : uint8_t {
+    QSPI_OP_ERASE,
+    QSPI_OP_PROGRAM,
+    QSPI_OP_READ
+};
+
+struct QspiOp {
+    QspiOpType type;
+    uint32_t address;
+    size_t length;
+    volatile QspiOpStatus* status;       // Set on completion, for callers that wait
+    uint32_t data[QSPI_PAGE_SIZE / 4];   // Program source or read destination (word aligned for EasyDMA)
+};
+
+static nrfx_qspi_config_t QSPIConfig;
+static nrf_qspi_cinstr_conf_t QSPICinstr_cfg;
+static bool QSPIWait = false;
+
+// Operation ring: the main loop adds at opHead, the QSPI interrupt retires at opTail
+static QspiOp opQueue[QSPI_OP_QUEUE_DEPTH];
+static volatile uint8_t opHead = 0;
+static volatile uint8_t opTail = 0;
+static volatile uint8_t opCount = 0;
+static volatile bool opInFlight = false;
+
+static bool qspiReady = false;
+static bool xipAvailable = false;
+static bool poweredDown = false;
+static unsigned long lastActivity = 0;
+static QspiFlashStats qspiStats = {0, 0, 0, 0, 0, 0, 0, 0};
+
+static bool QSPI_IsReady() {
+    uint32_t status = NRF_QSPI->STATUS;
+    return (status & QSPI_STATUS_READY) && !(status & QSPI_STATUS_WIP);
+}
+
+// Seeed example spun here forever; a flash that never answers now times out
+static bool QSPI_WaitForReady() {
+    unsigned long start = millis();
+    while (!QSPI_IsReady()) {
+        if (millis() - start >= QSPI_READY_TIMEOUT_MS) return false;
+        delay(1);
+    }
+    return true;
+}
+
+// From Seeed example
+static void QSIP_Configure_Memory() {
+  uint8_t  temporary[] = {0x00, 0x02};
+
+  QSPICinstr_cfg.opcode = QSPI_STD_CMD_RSTEN;
+  QSPICinstr_cfg.length = NRF_QSPI_CINSTR_LEN_1B;
+  QSPICinstr_cfg.io2_level = true;
+  QSPICinstr_cfg.io3_level = true;
+  QSPICinstr_cfg.wipwait = QSPIWait;
+  QSPICinstr_cfg.wren = true;
+
+  QSPI_WaitForReady();
+  if (nrfx_qspi_cinstr_xfer(&QSPICinstr_cfg, NULL, NULL) != NRFX_SUCCESS) {
+    LOG_ERROR("QSPI reset enable failed");
+  } else {
+    QSPICinstr_cfg.opcode = QSPI_STD_CMD_RST;
+    QSPI_WaitForReady();
+    if (nrfx_qspi_cinstr_xfer(&QSPICinstr_cfg, NULL, NULL) != NRFX_SUCCESS) {
+      LOG_ERROR("QSPI reset failed");
+    } else {
+      QSPICinstr_cfg.opcode = QSPI_STD_CMD_WRSR;
+      QSPICinstr_cfg.length = NRF_QSPI_CINSTR_LEN_3B;
+      QSPI_WaitForReady();
+      if (nrfx_qspi_cinstr_xfer(&QSPICinstr_cfg, &temporary, NULL) != NRFX_SUCCESS) {
+        LOG_ERROR("QSPI mode switch failed");
+      }
+    }
+  }
+}
+
+// Flash contents seen through XIP can sit in the CPU cache, so drop the cache
+// after anything that changes the flash behind it
+static void invalidateXipCache() {
+#if defined(ARDUINO_ARCH_MBED)
+    uint32_t cacheConfig = NRF_NVMC->ICACHECNF;
+    if (cacheConfig & NVMC_ICACHECNF_CACHEEN_Msk) {
+        NRF_NVMC->ICACHECNF = cacheConfig & ~NVMC_ICACHECNF_CACHEEN_Msk;
+        NRF_NVMC->ICACHECNF = cacheConfig;
+    }
+#endif
+}
+
+// Start queued operations until one is accepted. Runs from the main loop with
+// interrupts off, or from the QSPI interrupt.
+static void startNextOp() {
+    while (!opInFlight && opCount > 0) {
+        QspiOp& op = opQueue[opTail];
+        nrfx_err_t result;
+
+        opInFlight = true;
+        switch (op.type) {
+            case QSPI_OP_ERASE:
+                result = nrfx_qspi_erase(NRF_QSPI_ERASE_LEN_4KB, op.address);
+                break;
+            case QSPI_OP_PROGRAM:
+                result = nrfx_qspi_write(op.data, op.length, op.address);
+                break;
+            default:
+                result = nrfx_qspi_read(op.data, op.length, op.address);
+                break;
+        }
+
+        // Accepted: the completion event retires it (and may already have)
+        if (result == NRFX_SUCCESS) return;
+
+        opInFlight = false;
+        qspiStats.opsFailed++;
+        if (op.status != NULL) *op.status = QSPI_OP_FAILED;
+        opTail = (opTail + 1) % QSPI_OP_QUEUE_DEPTH;
+        opCount--;
+    }
+}
+
+static void qspiEventHandler(nrfx_qspi_evt_t event, void* context) {
+    (void)context;
+    if (event != NRFX_QSPI_EVENT_DONE || !opInFlight) return;
+
+    QspiOp& op = opQueue[opTail];
+    if (op.type != QSPI_OP_READ) invalidateXipCache();
+    if (op.status != NULL) *op.status = QSPI_OP_DONE;
+
+    qspiStats.opsCompleted++;
+    opTail = (opTail + 1) % QSPI_OP_QUEUE_DEPTH;
+    opCount--;
+    opInFlight = false;
+    startNextOp();
+}
+
+static bool wakeFlash() {
+    if (!poweredDown) return true;
+
+    NRF_QSPI->IFCONFIG1 &= ~QSPI_IFCONFIG1_DPMEN;
+    unsigned long start = millis();
+    while (NRF_QSPI->STATUS & QSPI_STATUS_DPM) {
+        if (millis() - start >= QSPI_READY_TIMEOUT_MS) return false;
+        delay(1);
+    }
+
+    poweredDown = false;
+    qspiStats.wakeups++;
+    return true;
+}
+
+// Claim the next free queue slot. A full queue refuses rather than waiting
+// for a sector erase to finish.
+static QspiOp* reserveOp(QspiOpType type, uint32_t address, size_t length) {
+    if (!qspiReady) return NULL;
+    if (opCount >= QSPI_OP_QUEUE_DEPTH) {
+        qspiStats.queueFullRefusals++;
+        return NULL;
+    }
+    if (!wakeFlash()) return NULL;
+
+    QspiOp* op = &opQueue[opHead];
+    op->type = type;
+    op->address = address;
+    op->length = length;
+    op->status = NULL;
+    return op;
+}
+
+static void submitOp() {
+    noInterrupts();
+    opHead = (opHead + 1) % QSPI_OP_QUEUE_DEPTH;
+    opCount++;
+    if (opCount > qspiStats.queueHighWater) qspiStats.queueHighWater = opCount;
+    qspiStats.opsQueued++;
+    startNextOp();
+    interrupts();
+
+    lastActivity = millis();
+}
+
+// Compare an XIP read against a normal transfer before trusting the window
+static bool verifyXipWindow() {
+#if defined(ARDUINO_ARCH_MBED)
+    uint32_t transferred[4];
+    if (!qspiFlashRead(0, transferred, sizeof(transferred))) return false;
+
+    invalidateXipCache();
+    return memcmp(transferred, (const void*)(uintptr_t)QSPI_XIP_BASE, sizeof(transferred)) == 0;
+#else
+    return false;
+#endif
+}
+
+bool qspiFlashInit() {
+    // QSPI Config - from Seeed example
+    QSPIConfig.xip_offset = NRFX_QSPI_CONFIG_XIP_OFFSET;
+    QSPIConfig.pins.sck_pin = 21;
+    QSPIConfig.pins.csn_pin = 25;
+    QSPIConfig.pins.io0_pin = 20;
+    QSPIConfig.pins.io1_pin = 24;
+    QSPIConfig.pins.io2_pin = 22;
+    QSPIConfig.pins.io3_pin = 23;
+    QSPIConfig.irq_priority = (uint8_t)NRFX_QSPI_CONFIG_IRQ_PRIORITY;
+    QSPIConfig.prot_if.readoc = (nrf_qspi_readoc_t)NRF_QSPI_READOC_READ4O;
+    QSPIConfig.prot_if.writeoc = (nrf_qspi_writeoc_t)NRF_QSPI_WRITEOC_PP4O;
+    QSPIConfig.prot_if.addrmode = (nrf_qspi_addrmode_t)NRFX_QSPI_CONFIG_ADDRMODE;
+    QSPIConfig.prot_if.dpmconfig = true;
+    QSPIConfig.phy_if.sck_freq = (nrf_qspi_frequency_t)NRF_QSPI_FREQ_32MDIV1;
+    QSPIConfig.phy_if.spi_mode = (nrf_qspi_spi_mode_t)NRFX_QSPI_CONFIG_MODE;
+    QSPIConfig.phy_if.dpmen = false;     // Start awake; qspiFlashService() powers down when idle
+
+    // DPM enter/exit durations from example
+    NRF_QSPI->DPMDUR = (QSPI_DPM_ENTER << 16) | QSPI_DPM_EXIT;
+
+    // With a handler every erase/program/read completes through qspiEventHandler
+    nrfx_err_t result = NRFX_ERROR_TIMEOUT;
+    for (int attempt = 1; attempt <= QSPI_INIT_MAX_RETRIES; attempt++) {
+        qspiStats.initAttempts++;
+        result = nrfx_qspi_init(&QSPIConfig, qspiEventHandler, NULL);
+        if (result == NRFX_SUCCESS) break;
+
+        LOG_ERROR("QSPI init failed: %d (attempt %d)", (int)result, attempt);
+        delay(10);
+    }
+
+    if (result != NRFX_SUCCESS) {
+        LOG_WARN("⚠ QSPI init gave up after %d attempts", QSPI_INIT_MAX_RETRIES);
+        return false;
+    }
+    LOG_INFO("QSPI init successful");
+
+    QSIP_Configure_Memory();
+    NRF_QSPI->TASKS_ACTIVATE = 1;
+
+    if (!QSPI_WaitForReady()) {
+        LOG_WARN("⚠ QSPI not ready");
+        nrfx_qspi_uninit();
+        return false;
+    }
+
+    qspiReady = true;
+    lastActivity = millis();
+
+    xipAvailable = verifyXipWindow();
+    if (xipAvailable) {
+        LOG_INFO("✓ QSPI XIP reads enabled");
+    } else {
+        LOG_WARN("QSPI XIP unavailable, using transfers");
+    }
+    return true;
+}
+
+bool qspiFlashIsReady() {
+    return qspiReady;
+}
+
+bool qspiFlashQueueErase(uint32_t address) {
+    QspiOp* op = reserveOp(QSPI_OP_ERASE, address & ~(uint32_t)0xFFF, 0);
+    if (op == NULL) return false;
+
+    submitOp();
+    return true;
+}
+
+bool qspiFlashQueueProgram(uint32_t address, const void* data, size_t length, volatile QspiOpStatus* status) {
+    if (length == 0 || length % 4 != 0 || address % 4 != 0) return false;
+    if ((address % QSPI_PAGE_SIZE) + length > QSPI_PAGE_SIZE) return false;
+
+    QspiOp* op = reserveOp(QSPI_OP_PROGRAM, address, length);
+    if (op == NULL) return false;
+
+    memcpy(op->data, data, length);
+    op->status = status;
+    if (status != NULL) *status = QSPI_OP_PENDING;
+    submitOp();
+    return true;
+}
+
+uint8_t qspiFlashQueueFree() {
+    return QSPI_OP_QUEUE_DEPTH - opCount;
+}
+
+bool qspiFlashIsIdle() {
+    return opCount == 0;
+}
+
+bool qspiFlashWaitIdle(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    while (opCount > 0) {
+        if (millis() - start >= timeoutMs) return false;
+        yield();
+    }
+    return true;
+}
+
+bool qspiFlashIsXipAvailable() {
+    return xipAvailable;
+}
+
+const void* qspiFlashMap(uint32_t address, size_t length) {
+    if (!xipAvailable || address + length > QSPI_XIP_SIZE) return NULL;
+
+    // Reading while an erase or program is running returns garbage
+    if (opCount > 0 || !wakeFlash()) return NULL;
+    lastActivity = millis();
+    return (const void*)(uintptr_t)(QSPI_XIP_BASE + address);
+}
+
+bool qspiFlashRead(uint32_t address, void* buffer, size_t length) {
+    if (!qspiReady || opCount > 0) return false;
+
+    const void* mapped = qspiFlashMap(address, length);
+    if (mapped != NULL) {
+        memcpy(buffer, mapped, length);
+        return true;
+    }
+
+    // Transfers need word-aligned addresses and lengths, so read whole words
+    // into the queue slot and copy out the requested bytes
+    uint8_t* destination = (uint8_t*)buffer;
+    while (length > 0) {
+        uint32_t alignedAddress = address & ~(uint32_t)3;
+        size_t offset = address - alignedAddress;
+        size_t chunk = QSPI_PAGE_SIZE - offset;
+        if (chunk > length) chunk = length;
+        size_t transferLength = (offset + chunk + 3) & ~(size_t)3;
+
+        volatile QspiOpStatus status = QSPI_OP_PENDING;
+        QspiOp* op = reserveOp(QSPI_OP_READ, alignedAddress, transferLength);
+        if (op == NULL) return false;
+        op->status = &status;
+        submitOp();
+
+        // Nothing else is queued behind a read, so the slot is still ours when it completes
+        if (!qspiFlashWaitIdle() || status != QSPI_OP_DONE) return false;
+        memcpy(destination, (const uint8_t*)op->data + offset, chunk);
+
+        destination += chunk;
+        address += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+void qspiFlashService() {
+    if (!qspiReady || poweredDown) return;
+
+    if (opCount > 0) {
+        lastActivity = millis();
+        return;
+    }
+
+    if (millis() - lastActivity >= QSPI_IDLE_POWER_DOWN_MS) {
+        NRF_QSPI->IFCONFIG1 |= QSPI_IFCONFIG1_DPMEN;
+        poweredDown = true;
+        qspiStats.powerDowns++;
+    }
+}
+
+bool qspiFlashIsPoweredDown() {
+    return poweredDown;
+}
+
+const QspiFlashStats& getQspiFlashStats() {
+    return qspiStats;
+}
@@ -0,0 +1,65 @@
+#ifndef QSPI_FLASH_H
+#define QSPI_FLASH_H
+
+#include "Arduino.h"
+
+// Event-driven driver for the external QSPI flash. Erase and program requests
+// are queued and return immediately; each operation is started from the QSPI
+// interrupt when the previous one completes, so the main loop never waits on
+// a 50ms sector erase. Nothing waits behind the queue either: a request that
+// finds it full is refused, and reads fail at once while erases or programs
+// are pending (qspiFlashIsIdle() tells busy from an error), for the caller
+// to retry from the loop. Reads go through the XIP window or a transfer.
+
+#define QSPI_INIT_MAX_RETRIES 5         // nrfx_qspi_init() attempts before falling back to RAM storage
+#define QSPI_READY_TIMEOUT_MS 100       // Longest wait for the peripheral to become ready
+#define QSPI_OP_QUEUE_DEPTH 4
+#define QSPI_PAGE_SIZE 256              // Largest single program operation
+#define QSPI_OP_TIMEOUT_MS 500          // Longest wait for queued operations (covers a sector erase)
+#define QSPI_IDLE_POWER_DOWN_MS 100     // Idle time before the flash enters deep power-down
+
+struct QspiFlashStats {
+    unsigned long initAttempts;
+    unsigned long opsQueued;
+    unsigned long opsCompleted;
+    unsigned long opsFailed;         // Operations the peripheral refused to start
+    unsigned long queueFullRefusals; // Requests refused because the queue was full
+    unsigned long powerDowns;
+    unsigned long wakeups;
+    uint8_t queueHighWater;
+};
+
+// Completion of a queued operation, for callers that track it
+enum QspiOpStatus : uint8_t {
+    QSPI_OP_PENDING,
+    QSPI_OP_DONE,
+    QSPI_OP_FAILED
+};
+
+bool qspiFlashInit();                   // false after QSPI_INIT_MAX_RETRIES failed attempts
+bool qspiFlashIsReady();
+
+// Queued operations. Program data is copied, must be a multiple of 4 bytes and
+// must not cross a page boundary. Returns false if the operation was refused
+// (queue full included); otherwise `status`, if given, is set when it completes.
+bool qspiFlashQueueErase(uint32_t address);
+bool qspiFlashQueueProgram(uint32_t address, const void* data, size_t length,
+                           volatile QspiOpStatus* status = NULL);
+uint8_t qspiFlashQueueFree();           // Operations the queue takes right now
+bool qspiFlashIsIdle();
+bool qspiFlashWaitIdle(unsigned long timeoutMs = QSPI_OP_TIMEOUT_MS);   // Boot and reset paths only
+
+// Reads, refused while erases or programs are pending. qspiFlashMap() returns
+// a pointer into the XIP window (NULL without XIP or while busy) that stays
+// valid until the next erase or program is queued. qspiFlashRead() waits only
+// for its own transfers.
+const void* qspiFlashMap(uint32_t address, size_t length);
+bool qspiFlashRead(uint32_t address, void* buffer, size_t length);
+bool qspiFlashIsXipAvailable();
+
+// Call from loop(): puts the flash in deep power-down once it has been idle
+void qspiFlashService();
+bool qspiFlashIsPoweredDown();
+const QspiFlashStats& getQspiFlashStats();
+
+#endif // QSPI_FLASH_H
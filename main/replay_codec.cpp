@@ -0,0 +1,82 @@
+#include "replay_codec.h"
+#include <string.h>
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static size_t putVarint(uint8_t* out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+// Returns the bytes used, 0 when the data ends first or the value overflows
+static size_t getVarint(const uint8_t* data, size_t length, uint32_t& value) {
+    value = 0;
+    for (size_t i = 0; i < length && i < 5; i++) {
+        value |= (uint32_t)(data[i] & 0x7F) << (7 * i);
+        if (!(data[i] & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+void replayCodecStart(ReplayCodecState& state, const ReplayHeader& header) {
+    state.lastMs = header.startMs;
+    memset(state.lastCounts, 0, sizeof(state.lastCounts));
+}
+
+bool replayHeaderIsValid(const ReplayHeader& header) {
+    return header.magic == REPLAY_MAGIC && header.version == REPLAY_FORMAT_VERSION && header.accelScale > 0.0f;
+}
+
+size_t replayEncodeSample(ReplayCodecState& state, const ReplaySample& sample, uint8_t* out) {
+    uint32_t dt = sample.timeMs - state.lastMs;
+    state.lastMs = sample.timeMs;
+
+    size_t length = putVarint(out, (dt << 1) | (sample.failed ? 1 : 0));
+    if (sample.failed) return length;
+
+    for (int axis = 0; axis < 3; axis++) {
+        length += putVarint(out + length, zigzag((int32_t)sample.counts[axis] - state.lastCounts[axis]));
+        state.lastCounts[axis] = sample.counts[axis];
+    }
+    return length;
+}
+
+size_t replayDecodeSample(ReplayCodecState& state, const uint8_t* data, size_t length, ReplaySample& sample) {
+    uint32_t value;
+    size_t used = getVarint(data, length, value);
+    if (used == 0) return 0;
+
+    sample.timeMs = state.lastMs + (value >> 1);
+    sample.failed = (value & 1) != 0;
+    if (sample.failed) {
+        memset(sample.counts, 0, sizeof(sample.counts));
+        state.lastMs = sample.timeMs;
+        return used;
+    }
+
+    int16_t counts[3];
+    for (int axis = 0; axis < 3; axis++) {
+        size_t fieldLength = getVarint(data + used, length - used, value);
+        if (fieldLength == 0) return 0;
+        int32_t count = state.lastCounts[axis] + unzigzag(value);
+        if (count < -32768 || count > 32767) return 0;
+        counts[axis] = (int16_t)count;
+        used += fieldLength;
+    }
+
+    state.lastMs = sample.timeMs;
+    memcpy(state.lastCounts, counts, sizeof(counts));
+    memcpy(sample.counts, counts, sizeof(counts));
+    return used;
+}
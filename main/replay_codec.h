@@ -0,0 +1,84 @@
+#ifndef REPLAY_CODEC_H
+#define REPLAY_CODEC_H
+
+// Recorded accelerometer sample format for deterministic replay of the
+// position pipeline. Kept free of Arduino dependencies so tools/replay uses
+// the same code.
+//
+// A recording is a ReplayHeader followed by one record per sensor sample.
+// The header holds everything readPosition() and the park deciders carry
+// from one sample to the next (calibration, filter and park settings, and
+// the filter and park state when recording started), so replaying the
+// records from it reproduces every decision exactly. Samples are the raw
+// accelerometer counts and the time since the previous sample:
+//
+//   varint (dtMs << 1 | failed)   failed: the read itself returned an error
+//   zigzag varint x3              count deltas from the previous good sample
+//
+// Counts of a parked telescope change by a few LSB, so a sample is normally
+// four bytes.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define REPLAY_MAGIC 0x50525350         // "PSRP"
+#define REPLAY_FORMAT_VERSION 1
+#define REPLAY_HEADER_SIZE 96
+#define REPLAY_MAX_RECORD_SIZE 14       // Time varint plus three count varints
+
+// ReplayHeader.flags
+#define REPLAY_FLAG_PARKED 0x01         // Reported park state
+#define REPLAY_FLAG_PENDING_PARKED 0x02 // Candidate state waiting out its dwell
+#define REPLAY_FLAG_SPRT_HAVE_LAST 0x04
+#define REPLAY_FLAG_SPRT_NOISE_SHIFT 4  // Bits 4-7: SPRT noise warm-up count (0 before it was recorded)
+
+struct ReplayHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t filterEnabled;
+    uint8_t decisionMode;        // PARK_MODE_THRESHOLD or PARK_MODE_SPRT
+    uint8_t flags;
+    uint32_t startMs;            // millis() when recording started
+    float accelScale;            // g per raw count
+    float offset[3];             // Calibration subtracted before the filter (g)
+    float filterAlpha;
+    float filterState[3];        // EMA state before the first sample (g)
+    float parkPitch;
+    float parkRoll;
+    float tolerance;
+    float hysteresis;
+    uint32_t enterDwellMs;
+    uint32_t exitDwellMs;
+    float sprtFalseUnpark;
+    float sprtFalsePark;
+    uint32_t pendingAgeMs;       // How long the pending state had been seen at startMs
+    float sprtLlr;
+    float sprtNoiseVariance;
+    float sprtLastDeviation;
+    uint32_t sprtSamples;
+};
+
+static_assert(sizeof(ReplayHeader) == REPLAY_HEADER_SIZE, "Replay header size changed");
+
+struct ReplaySample {
+    uint32_t timeMs;             // Absolute, on the recording device's millis() clock
+    int16_t counts[3];
+    bool failed;
+};
+
+// Previous sample, which the next record is a delta from
+struct ReplayCodecState {
+    uint32_t lastMs;
+    int16_t lastCounts[3];
+};
+
+void replayCodecStart(ReplayCodecState& state, const ReplayHeader& header);
+bool replayHeaderIsValid(const ReplayHeader& header);
+
+// Returns the record length (at most REPLAY_MAX_RECORD_SIZE)
+size_t replayEncodeSample(ReplayCodecState& state, const ReplaySample& sample, uint8_t* out);
+
+// Returns the bytes consumed, or 0 if the record is truncated or malformed
+size_t replayDecodeSample(ReplayCodecState& state, const uint8_t* data, size_t length, ReplaySample& sample);
+
+#endif // REPLAY_CODEC_H
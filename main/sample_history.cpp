@@ -0,0 +1,55 @@
+#include "sample_history.h"
+
+static HistorySample history[SAMPLE_HISTORY_SIZE];
+static size_t historyCount = 0;
+static uint32_t newestSequence = 0;
+
+void recordHistorySample(uint32_t sequence, float pitch, float roll, bool parked) {
+    // A gap (sequence reset) would break the slot mapping, so start over
+    if (historyCount > 0 && sequence != newestSequence + 1) historyCount = 0;
+
+    HistorySample& sample = history[sequence % SAMPLE_HISTORY_SIZE];
+    sample.sequence = sequence;
+    sample.timeMs = millis();
+    sample.pitch = pitch;
+    sample.roll = roll;
+    sample.parked = parked;
+
+    newestSequence = sequence;
+    if (historyCount < SAMPLE_HISTORY_SIZE) historyCount++;
+}
+
+size_t getHistoryCount() {
+    return historyCount;
+}
+
+uint32_t getHistoryOldestSequence() {
+    return newestSequence - (uint32_t)historyCount + 1;
+}
+
+uint32_t getHistoryNewestSequence() {
+    return newestSequence;
+}
+
+const HistorySample* getHistorySample(uint32_t sequence) {
+    if (historyCount == 0) return NULL;
+    if (newestSequence - sequence >= historyCount) return NULL;  // Also catches sequence > newest
+    return &history[sequence % SAMPLE_HISTORY_SIZE];
+}
+
+uint32_t findHistorySequenceAt(uint32_t timeMs) {
+    // Times increase with sequence, so binary search over the held range
+    uint32_t low = getHistoryOldestSequence();
+    uint32_t high = newestSequence + 1;
+    if (historyCount == 0) return high;
+
+    while (low != high) {
+        uint32_t mid = low + (high - low) / 2;
+        if ((int32_t)(history[mid % SAMPLE_HISTORY_SIZE].timeMs - timeMs) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
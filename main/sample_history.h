@@ -0,0 +1,31 @@
+#ifndef SAMPLE_HISTORY_H
+#define SAMPLE_HISTORY_H
+
+#include "Arduino.h"
+
+// RAM ring of the most recent processed samples, written by the sampling
+// routine. Sample sequence numbers are contiguous, so sequence N always sits
+// in slot N % SAMPLE_HISTORY_SIZE and lookups need no search.
+
+#define SAMPLE_HISTORY_SIZE 512         // 25.6s at the 50ms sensor period
+#define SAMPLE_HISTORY_MAX_QUERY 128    // Samples per <1D> response, keeps it within the TX ring
+
+struct HistorySample {
+    uint32_t sequence;
+    uint32_t timeMs;
+    float pitch;
+    float roll;
+    bool parked;
+};
+
+void recordHistorySample(uint32_t sequence, float pitch, float roll, bool parked);
+
+size_t getHistoryCount();
+uint32_t getHistoryOldestSequence();    // Only meaningful while getHistoryCount() > 0
+uint32_t getHistoryNewestSequence();
+const HistorySample* getHistorySample(uint32_t sequence);   // NULL once overwritten or not yet taken
+
+// First held sequence taken at or after timeMs; newest + 1 if there is none
+uint32_t findHistorySequenceAt(uint32_t timeMs);
+
+#endif // SAMPLE_HISTORY_H
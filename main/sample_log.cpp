@@ -0,0 +1,346 @@
+#include "sample_log.h"
+#include "flash_storage.h"
+#include "position_sensor.h"
+#include "telemetry_stream.h"
+#include "tx_buffer.h"
+#include "helpers.h"
+#include "Debug.h"
+#include "profiler.h"
+
+// External variables
+extern bool isParked;
+extern float currentPitch, currentRoll;
+
+static LogEncoder encoder;
+static bool logAvailable = false;
+static uint16_t logDecimation = 20;
+static uint16_t samplesUntilLog = 0;
+static uint32_t blockOpenedMs = 0;
+static uint16_t bootCount = 0;
+static float lastTemperature = 0.0;
+
+// Ring position
+static uint32_t nextSequence = 0;       // Sequence of the next block written
+static bool haveBlocks = false;
+static uint32_t oldestSequence = 0;
+static uint32_t newestSequence = 0;
+
+// Counters since boot
+static uint32_t samplesLogged = 0;
+static uint32_t eventsLogged = 0;
+static uint32_t blocksWritten = 0;
+static uint32_t writeFailures = 0;
+
+// A finished block the flash queue could not take yet, written from the loop
+static uint8_t heldBlock[LOG_BLOCK_SIZE];
+static uint32_t heldSequence = 0;
+static bool blockHeld = false;
+
+// Download in progress
+static bool downloadActive = false;
+static uint32_t downloadNext = 0;
+static uint32_t downloadRemaining = 0;
+static uint32_t downloadSent = 0;
+static uint32_t downloadSkipped = 0;
+static int downloadSession = TX_ALL_SESSIONS;   // Session that asked for the download
+
+static uint32_t blockAddress(uint32_t sequence) {
+    return SAMPLE_LOG_ADDRESS + (sequence % SAMPLE_LOG_BLOCKS) * LOG_BLOCK_SIZE;
+}
+
+static const LogBlockHeader* blockHeader(const uint8_t* block) {
+    return (const LogBlockHeader*)block;
+}
+
+// Every slot is checked once at boot. With XIP these are plain memory reads
+// of the flash, without it one transfer per block.
+static bool scanSampleLog() {
+    static uint8_t scratch[LOG_BLOCK_SIZE];
+    haveBlocks = false;
+
+    for (uint32_t slot = 0; slot < SAMPLE_LOG_BLOCKS; slot++) {
+        const uint8_t* block = (const uint8_t*)readFlashView(SAMPLE_LOG_ADDRESS + slot * LOG_BLOCK_SIZE,
+                                                             scratch, LOG_BLOCK_SIZE);
+        if (block == NULL) return false;
+        if (!logBlockIsValid(block)) continue;
+
+        // A block only counts in the slot its sequence maps to
+        const LogBlockHeader* header = blockHeader(block);
+        if (header->sequence % SAMPLE_LOG_BLOCKS != slot) continue;
+
+        if (!haveBlocks || (int32_t)(header->sequence - newestSequence) > 0) {
+            newestSequence = header->sequence;
+            bootCount = header->bootCount;
+        }
+        if (!haveBlocks || (int32_t)(header->sequence - oldestSequence) < 0) {
+            oldestSequence = header->sequence;
+        }
+        haveBlocks = true;
+    }
+
+    nextSequence = haveBlocks ? newestSequence + 1 : 0;
+
+    // A block torn by a power cut leaves its slot dirty. Slots later in an
+    // already-erased sector are skipped; a new sector is erased before use.
+    while (nextSequence % SAMPLE_LOG_BLOCKS_PER_SECTOR != 0) {
+        const uint8_t* block = (const uint8_t*)readFlashView(blockAddress(nextSequence), scratch, LOG_BLOCK_SIZE);
+        if (block == NULL) return false;
+        if (logBlockIsErased(block)) break;
+        nextSequence++;
+    }
+    return true;
+}
+
+static LogSample currentLogSample() {
+    return logQuantizeSample(currentPitch, currentRoll, lastTemperature, isParked);
+}
+
+static void openBlock(uint32_t timeMs, const LogSample& base) {
+    uint16_t periodMs = (uint16_t)(logDecimation * SAMPLE_LOG_SAMPLE_INTERVAL_MS);
+    blockOpenedMs = timeMs;
+    logEncoderStart(encoder, nextSequence, timeMs, bootCount, periodMs, base);
+}
+
+static uint8_t flashOpsForBlock(uint32_t sequence) {
+    return sequence % SAMPLE_LOG_BLOCKS_PER_SECTOR == 0 ? 2 : 1;
+}
+
+static bool queueBlock(uint32_t sequence, const uint8_t* image) {
+    uint32_t address = blockAddress(sequence);
+
+    // Entering a sector: erase it, which drops the oldest blocks in the ring.
+    // The program is queued behind the erase, so neither blocks the loop.
+    bool success = true;
+    if (sequence % SAMPLE_LOG_BLOCKS_PER_SECTOR == 0) {
+        success = eraseFlashSector(address);
+        if (haveBlocks && sequence + SAMPLE_LOG_BLOCKS_PER_SECTOR > SAMPLE_LOG_BLOCKS) {
+            uint32_t firstSurviving = sequence + SAMPLE_LOG_BLOCKS_PER_SECTOR - SAMPLE_LOG_BLOCKS;
+            if ((int32_t)(oldestSequence - firstSurviving) < 0) oldestSequence = firstSurviving;
+        }
+    }
+    success = success && programFlash(address, image, LOG_BLOCK_SIZE);
+
+    if (!success) {
+        writeFailures++;
+        return false;
+    }
+
+    if (!haveBlocks) oldestSequence = sequence;
+    newestSequence = sequence;
+    haveBlocks = true;
+    blocksWritten++;
+    return true;
+}
+
+// Queue the held block once the flash has room for it
+static void writeHeldBlock() {
+    if (!blockHeld || !canQueueFlashOps(flashOpsForBlock(heldSequence))) return;
+    blockHeld = false;
+    queueBlock(heldSequence, heldBlock);
+}
+
+// A full flash queue (settings saves, a sector erase) must not stall the
+// loop, so the block waits in RAM. Only one waits: if the flash is still
+// behind when the next block closes, that block is dropped and counted.
+static bool writeBlock() {
+    const uint8_t* image = logEncoderFinish(encoder);
+    uint32_t sequence = nextSequence++;
+
+    writeHeldBlock();
+    if (canQueueFlashOps(flashOpsForBlock(sequence)) && !blockHeld) {
+        return queueBlock(sequence, image);
+    }
+    if (blockHeld || !isFlashStorageAvailable()) {
+        writeFailures++;
+        return false;
+    }
+    memcpy(heldBlock, image, LOG_BLOCK_SIZE);
+    heldSequence = sequence;
+    blockHeld = true;
+    return true;
+}
+
+void initSampleLog() {
+    logDecimation = (uint16_t)loadIntPreference(SETTING_LOG_DECIMATION);
+    encoder.open = false;
+
+    if (!isFlashStorageAvailable()) {
+        LOG_DEBUG("Sample log disabled - no persistent storage");
+        return;
+    }
+
+    // Boot path: the scan reads, so let queued settings writes finish first
+    waitForFlashIdle();
+    blockHeld = false;
+    unsigned long scanStart = millis();
+    if (!scanSampleLog()) {
+        LOG_WARN("⚠ Sample log scan failed");
+        return;
+    }
+
+    logAvailable = true;
+    bootCount++;
+    LOG_INFO("✓ Sample log ready: %lu blocks, next %lu, scan %lums", (unsigned long)(haveBlocks ? newestSequence - oldestSequence + 1 : 0), (unsigned long)nextSequence, (unsigned long)(millis() - scanStart));
+
+    uint32_t resetReason = 0;
+#if defined(ARDUINO_ARCH_MBED)
+    resetReason = NRF_POWER->RESETREAS;
+    NRF_POWER->RESETREAS = resetReason;  // Write-one-to-clear, so the next boot reports its own cause
+#endif
+    logEvent(LOG_EVENT_BOOT, resetReason);
+}
+
+void logSample() {
+    PROFILE_SCOPE(PROFILE_SAMPLE_LOG);
+    if (!logAvailable || logDecimation == 0) return;
+    if (samplesUntilLog > 0) {
+        samplesUntilLog--;
+        return;
+    }
+    samplesUntilLog = logDecimation - 1;
+
+    lastTemperature = imu.readTempC();
+    LogSample sample = currentLogSample();
+    uint32_t now = millis();
+
+    // A parked telescope adds only to a run, which would keep the block in RAM indefinitely
+    if (encoder.open && now - blockOpenedMs >= SAMPLE_LOG_MAX_BLOCK_MS) flushSampleLog();
+
+    if (!encoder.open) openBlock(now, sample);
+    if (!logEncoderAddSample(encoder, sample, now)) {
+        writeBlock();
+        openBlock(now, sample);
+        logEncoderAddSample(encoder, sample, now);
+    }
+    samplesLogged++;
+}
+
+void logEvent(LogEventCode code, uint32_t value) {
+    if (!logAvailable) return;
+
+    uint32_t now = millis();
+    if (!encoder.open) openBlock(now, currentLogSample());
+    if (!logEncoderAddEvent(encoder, code, now, value)) {
+        writeBlock();
+        openBlock(now, currentLogSample());
+        logEncoderAddEvent(encoder, code, now, value);
+    }
+    eventsLogged++;
+
+    // Transitions, errors and resets are what a post-mortem looks for, so they
+    // go to flash straight away instead of waiting for the block to fill
+    if (code != LOG_EVENT_BOOT && code != LOG_EVENT_DECIMATION) {
+        flushSampleLog();
+    }
+}
+
+bool flushSampleLog() {
+    if (!logAvailable || logEncoderIsEmpty(encoder)) return true;
+    return writeBlock();
+}
+
+void setSampleLogDecimation(uint16_t decimation) {
+    if (decimation == logDecimation) return;
+
+    // The sample period is per block, so close the current one first
+    flushSampleLog();
+    encoder.open = false;
+    logDecimation = decimation;
+    samplesUntilLog = 0;
+    logEvent(LOG_EVENT_DECIMATION, decimation);
+}
+
+uint32_t startSampleLogDownload(uint32_t fromSequence, uint16_t count) {
+    // Include everything logged so far
+    flushSampleLog();
+
+    downloadSent = 0;
+    downloadSkipped = 0;
+    downloadSession = SerialTx.getSelected();
+    downloadActive = logAvailable;
+    downloadNext = fromSequence;
+    downloadRemaining = 0;
+    if (!haveBlocks) return fromSequence;   // Still completes, with nothing sent
+
+    // Anything older than the oldest block has been overwritten
+    if ((int32_t)(fromSequence - oldestSequence) < 0) fromSequence = oldestSequence;
+
+    uint32_t available = (int32_t)(newestSequence - fromSequence) >= 0 ? newestSequence - fromSequence + 1 : 0;
+    downloadNext = fromSequence;
+    downloadRemaining = count < available ? count : available;
+    return fromSequence;
+}
+
+static void sendBlockFrames(uint32_t sequence, const uint8_t* block) {
+    uint8_t frame[4 + 5 + SAMPLE_LOG_FRAME_PART_SIZE + 1];
+
+    for (uint8_t part = 0; part < LOG_BLOCK_SIZE / SAMPLE_LOG_FRAME_PART_SIZE; part++) {
+        size_t pos = 0;
+        frame[pos++] = STREAM_SYNC_BYTE_1;
+        frame[pos++] = STREAM_SYNC_BYTE_2;
+        frame[pos++] = STREAM_FRAME_LOG_BLOCK;
+        frame[pos++] = 5 + SAMPLE_LOG_FRAME_PART_SIZE;
+        memcpy(frame + pos, &sequence, 4);
+        pos += 4;
+        frame[pos++] = part;
+        memcpy(frame + pos, block + part * SAMPLE_LOG_FRAME_PART_SIZE, SAMPLE_LOG_FRAME_PART_SIZE);
+        pos += SAMPLE_LOG_FRAME_PART_SIZE;
+        frame[pos] = calculateCRC8(frame + 2, pos - 2);
+        SerialTx.write(frame, pos + 1);
+    }
+}
+
+void serviceSampleLog() {
+    PROFILE_SCOPE(PROFILE_SAMPLE_LOG);
+    writeHeldBlock();
+    if (!downloadActive) return;
+    SessionScope scope(downloadSession);
+
+    // One block per loop, and only when the TX ring can take all of it.
+    // Reads are refused while erases or programs are queued, so a busy
+    // flash just means trying the same block again next loop.
+    if (downloadRemaining > 0) {
+        size_t frameBytes = (4 + 5 + SAMPLE_LOG_FRAME_PART_SIZE + 1) * (LOG_BLOCK_SIZE / SAMPLE_LOG_FRAME_PART_SIZE);
+        if (SerialTx.available() < frameBytes || isFlashBusy()) return;
+
+        static uint8_t scratch[LOG_BLOCK_SIZE];
+        const uint8_t* block = (const uint8_t*)readFlashView(blockAddress(downloadNext), scratch, LOG_BLOCK_SIZE);
+        if (block != NULL && logBlockIsValid(block) && blockHeader(block)->sequence == downloadNext) {
+            sendBlockFrames(downloadNext, block);
+            downloadSent++;
+        } else {
+            downloadSkipped++;
+        }
+
+        downloadNext++;
+        downloadRemaining--;
+        return;
+    }
+
+    downloadActive = false;
+    JSONBuilder json;
+    json.add("next", (unsigned long)downloadNext);
+    json.add("sent", (unsigned long)downloadSent);
+    json.add("skipped", (unsigned long)downloadSkipped);
+    SerialTx.println(buildJSONNotification("logDownloadComplete", json.build()));
+}
+
+SampleLogInfo getSampleLogInfo() {
+    SampleLogInfo info;
+    info.available = logAvailable;
+    info.decimation = logDecimation;
+    info.bootCount = bootCount;
+    info.hasBlocks = haveBlocks;
+    info.oldestSequence = oldestSequence;
+    info.newestSequence = newestSequence;
+    info.capacityBlocks = SAMPLE_LOG_BLOCKS;
+    info.samplesLogged = samplesLogged;
+    info.eventsLogged = eventsLogged;
+    info.blocksWritten = blocksWritten;
+    info.writeFailures = writeFailures;
+    info.pendingSamples = encoder.open ? encoder.sampleCount : 0;
+    info.downloadActive = downloadActive;
+    info.downloadNext = downloadNext;
+    info.downloadRemaining = downloadRemaining;
+    return info;
+}
@@ -0,0 +1,52 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include "Arduino.h"
+#include "log_codec.h"
+
+// On-flash ring of processed samples and events, so a park failure overnight
+// can be examined afterwards. Blocks are encoded by log_codec and stored one
+// per flash page; block N always lives in slot N % SAMPLE_LOG_BLOCKS, so a
+// download can seek straight to any block sequence. The oldest sector is
+// erased when the ring wraps.
+
+#define SAMPLE_LOG_ADDRESS 0x10000          // Below this: settings log and legacy settings
+#define SAMPLE_LOG_END 0x200000             // 2MB QSPI flash on the XIAO nRF52840 Sense
+#define SAMPLE_LOG_BLOCKS ((SAMPLE_LOG_END - SAMPLE_LOG_ADDRESS) / LOG_BLOCK_SIZE)
+#define SAMPLE_LOG_BLOCKS_PER_SECTOR (4096 / LOG_BLOCK_SIZE)
+#define SAMPLE_LOG_SAMPLE_INTERVAL_MS 50    // Sensor loop period the decimation applies to
+#define SAMPLE_LOG_MAX_BLOCK_MS 600000      // Bounds what a power cut loses while runs keep a block open
+#define SAMPLE_LOG_MAX_DOWNLOAD 999         // Blocks per download request
+#define SAMPLE_LOG_FRAME_PART_SIZE 128      // Each block goes out as two binary frames
+
+struct SampleLogInfo {
+    bool available;
+    uint16_t decimation;            // Sensor samples per logged sample, 0 = events only
+    uint16_t bootCount;
+    bool hasBlocks;
+    uint32_t oldestSequence;
+    uint32_t newestSequence;
+    uint32_t capacityBlocks;
+    uint32_t samplesLogged;         // Since boot
+    uint32_t eventsLogged;
+    uint32_t blocksWritten;
+    uint32_t writeFailures;
+    uint32_t pendingSamples;        // In the open block, not yet in flash
+    bool downloadActive;
+    uint32_t downloadNext;
+    uint32_t downloadRemaining;
+};
+
+void initSampleLog();                // After initFlashStorage(); finds the head of the ring
+void logSample();                    // Call once per sensor sample
+void logEvent(LogEventCode code, uint32_t value = 0);
+bool flushSampleLog();               // Write the open block now
+void setSampleLogDecimation(uint16_t decimation);
+
+// Streams blocks [fromSequence, fromSequence + count) as binary frames from
+// serviceSampleLog(). Returns the first sequence that will be sent.
+uint32_t startSampleLogDownload(uint32_t fromSequence, uint16_t count);
+void serviceSampleLog();             // Call from loop()
+SampleLogInfo getSampleLogInfo();
+
+#endif // SAMPLE_LOG_H
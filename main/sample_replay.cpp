@@ -0,0 +1,268 @@
+#include "sample_replay.h"
+#include "helpers.h"
+#include "position_sensor.h"
+#include "telemetry_stream.h"
+#include "tx_buffer.h"
+#include "Debug.h"
+#include <string.h>
+
+// External global variables
+extern bool isParked;
+extern float currentPitch, currentRoll;
+extern float parkPitch, parkRoll, positionTolerance;
+extern float parkHysteresis;
+extern unsigned long parkEnterDwellMs, parkExitDwellMs;
+extern int parkDecisionMode;
+extern unsigned long sampleSequence;
+
+static_assert(SPRT_DEFAULT_WARMUP_SAMPLES < (1 << (8 - REPLAY_FLAG_SPRT_NOISE_SHIFT)),
+              "SPRT warm-up count does not fit the replay header flags");
+
+static SampleReplayStats replayStats = {false, 0, 0, false, 0, 0};
+static uint16_t recordSequence = 0;
+static int recordSession = TX_ALL_SESSIONS;  // Session the recording streams to
+
+static ReplaySample pendingSample;           // Sample replaySample() is running through the pipeline
+static ReplayHeader liveState;               // Restored when replay stops
+static float livePitch = 0.0, liveRoll = 0.0;
+static unsigned long liveSequence = 0;
+static unsigned long lastReplayCommandMs = 0;
+static int replaySession = TX_ALL_SESSIONS;  // Session driving the replay
+
+static int16_t lastCounts[3] = {0, 0, 0};
+static bool lastReadFailed = false;
+static uint32_t lastSampleMs = 0;
+
+bool takeReplaySample(int16_t counts[3]) {
+    memcpy(counts, pendingSample.counts, sizeof(pendingSample.counts));
+    return !pendingSample.failed;
+}
+
+static bool sendFrame(const uint8_t* payload, uint8_t length, TxClass cls) {
+    SessionScope scope(recordSession);
+    uint8_t frame[4 + REPLAY_HEADER_SIZE + 1 + 1];
+    frame[0] = STREAM_SYNC_BYTE_1;
+    frame[1] = STREAM_SYNC_BYTE_2;
+    frame[2] = STREAM_FRAME_REPLAY;
+    frame[3] = length;
+    memcpy(frame + 4, payload, length);
+    frame[4 + length] = calculateCRC8(frame + 2, length + 2);
+    return SerialTx.write(frame, length + 5, cls);
+}
+
+void recordSample(const int16_t counts[3], bool valid) {
+    lastSampleMs = getSampleTimeMs();
+    memcpy(lastCounts, counts, sizeof(lastCounts));
+    lastReadFailed = !valid;
+    if (!replayStats.recording || replayStats.replaying) return;
+
+    uint8_t payload[REPLAY_SAMPLE_PAYLOAD];
+    payload[0] = REPLAY_FRAME_KIND_SAMPLE;
+    memcpy(payload + 1, &recordSequence, 2);
+    memcpy(payload + 3, &lastSampleMs, 4);
+    payload[7] = valid ? 0 : 1;
+    memcpy(payload + 8, counts, 6);
+    recordSequence++;
+
+    // Sequence numbers let the converter report what the link dropped
+    if (sendFrame(payload, sizeof(payload), TX_CLASS_TELEMETRY)) {
+        replayStats.recorded++;
+    } else {
+        replayStats.recordDropped++;
+    }
+}
+
+uint32_t getSampleTimeMs() {
+    return replayStats.replaying ? replayStats.replayTimeMs : millis();
+}
+
+void fillReplayHeader(ReplayHeader& header) {
+    memset(&header, 0, sizeof(header));
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_FORMAT_VERSION;
+    header.filterEnabled = use_filtering ? 1 : 0;
+    header.decisionMode = (uint8_t)parkDecisionMode;
+    header.startMs = getSampleTimeMs();
+    header.accelScale = imu.calcAccel(1);
+    header.offset[0] = ax_offset;
+    header.offset[1] = ay_offset;
+    header.offset[2] = az_offset;
+    header.filterAlpha = alpha;
+    header.filterState[0] = filtered_ax;
+    header.filterState[1] = filtered_ay;
+    header.filterState[2] = filtered_az;
+    header.parkPitch = parkPitch;
+    header.parkRoll = parkRoll;
+    header.tolerance = positionTolerance;
+    header.hysteresis = parkHysteresis;
+    header.enterDwellMs = parkEnterDwellMs;
+    header.exitDwellMs = parkExitDwellMs;
+    const SprtConfig& sprtConfig = getSprtConfig();
+    header.sprtFalseUnpark = sprtConfig.falseUnparkRate;
+    header.sprtFalsePark = sprtConfig.falseParkRate;
+
+    ParkLogicState park = getParkLogicState();
+    if (park.parked) header.flags |= REPLAY_FLAG_PARKED;
+    if (park.pendingParked) header.flags |= REPLAY_FLAG_PENDING_PARKED;
+    if (park.sprt.haveLast) header.flags |= REPLAY_FLAG_SPRT_HAVE_LAST;
+    header.flags |= (uint8_t)(park.sprt.noiseSamples << REPLAY_FLAG_SPRT_NOISE_SHIFT);
+    header.pendingAgeMs = header.startMs - park.pendingSinceMs;
+    header.sprtLlr = park.sprt.llr;
+    header.sprtNoiseVariance = park.sprt.noiseVariance;
+    header.sprtLastDeviation = park.sprt.lastDeviation;
+    header.sprtSamples = park.sprt.samples;
+}
+
+void applyReplayHeader(const ReplayHeader& header) {
+    use_filtering = header.filterEnabled != 0;
+    ax_offset = header.offset[0];
+    ay_offset = header.offset[1];
+    az_offset = header.offset[2];
+    alpha = header.filterAlpha;
+    filtered_ax = header.filterState[0];
+    filtered_ay = header.filterState[1];
+    filtered_az = header.filterState[2];
+    parkPitch = header.parkPitch;
+    parkRoll = header.parkRoll;
+    positionTolerance = header.tolerance;
+    parkHysteresis = header.hysteresis;
+    parkEnterDwellMs = header.enterDwellMs;
+    parkExitDwellMs = header.exitDwellMs;
+    SprtConfig& sprtConfig = getSprtConfig();
+    sprtConfig.falseUnparkRate = header.sprtFalseUnpark;
+    sprtConfig.falseParkRate = header.sprtFalsePark;
+    setParkDecisionMode(header.decisionMode);
+
+    ParkLogicState park;
+    park.parked = (header.flags & REPLAY_FLAG_PARKED) != 0;
+    park.pendingParked = (header.flags & REPLAY_FLAG_PENDING_PARKED) != 0;
+    park.pendingSinceMs = header.startMs - header.pendingAgeMs;
+    park.sprt.llr = header.sprtLlr;
+    park.sprt.noiseVariance = header.sprtNoiseVariance;
+    park.sprt.lastDeviation = header.sprtLastDeviation;
+    park.sprt.haveLast = (header.flags & REPLAY_FLAG_SPRT_HAVE_LAST) != 0;
+    park.sprt.samples = header.sprtSamples;
+    park.sprt.noiseSamples = header.flags >> REPLAY_FLAG_SPRT_NOISE_SHIFT;
+    // Recorded before the count existed: the estimate then was already in use
+    if (park.sprt.noiseSamples == 0 && header.sprtNoiseVariance > 0.0f) {
+        park.sprt.noiseSamples = sprtConfig.warmupSamples;
+    }
+    setParkLogicState(park);
+}
+
+bool startSampleRecording() {
+    recordSession = SerialTx.getSelected();
+    ReplayHeader header;
+    fillReplayHeader(header);
+
+    uint8_t payload[1 + REPLAY_HEADER_SIZE];
+    payload[0] = REPLAY_FRAME_KIND_HEADER;
+    memcpy(payload + 1, &header, REPLAY_HEADER_SIZE);
+    if (!sendFrame(payload, sizeof(payload), TX_CLASS_RESPONSE)) return false;
+
+    replayStats.recording = true;
+    replayStats.recorded = 0;
+    replayStats.recordDropped = 0;
+    recordSequence = 0;
+    LOG_DEBUG("Sample recording started");
+    return true;
+}
+
+void stopSampleRecording() {
+    replayStats.recording = false;
+}
+
+void startSampleReplay(uint32_t startMs) {
+    if (replayStats.replaying) return;
+    fillReplayHeader(liveState);
+    livePitch = currentPitch;
+    liveRoll = currentRoll;
+    liveSequence = sampleSequence;
+    replayStats.replaying = true;
+    replayStats.replayed = 0;
+    replayStats.replayTimeMs = startMs;
+    replaySession = SerialTx.getSelected();
+    lastReplayCommandMs = millis();
+    LOG_DEBUG("Sample replay started");
+}
+
+void stopSampleReplay() {
+    if (!replayStats.replaying) return;
+    bool replayParked = isParked;
+    replayStats.replaying = false;
+
+    // The live pipeline carries on as if the replay never happened
+    applyReplayHeader(liveState);
+    currentPitch = livePitch;
+    currentRoll = liveRoll;
+    sampleSequence = liveSequence;
+    if (isParked != replayParked) notifyParkStateChange("position");
+    LOG_DEBUG("Sample replay stopped after %lu samples", (unsigned long)replayStats.replayed);
+}
+
+bool isReplayActive() {
+    return replayStats.replaying;
+}
+
+// The accelerometer scale is not a setting: counts recorded at another range
+// would be replayed as different accelerations
+bool loadReplayHeader(const ReplayHeader& header) {
+    if (!replayStats.replaying || !replayHeaderIsValid(header)) return false;
+    if (header.accelScale != imu.calcAccel(1)) return false;
+    lastReplayCommandMs = millis();
+    replayStats.replayTimeMs = header.startMs;
+    applyReplayHeader(header);
+    return true;
+}
+
+bool replaySample(const ReplaySample& sample) {
+    if (!replayStats.replaying) return false;
+    lastReplayCommandMs = millis();
+    pendingSample = sample;
+    replayStats.replayTimeMs = sample.timeMs;
+    updatePositionAndParkStatus();
+    replayStats.replayed++;
+    return true;
+}
+
+void serviceSampleReplay() {
+    if (!replayStats.replaying || millis() - lastReplayCommandMs < REPLAY_IDLE_TIMEOUT_MS) return;
+
+    SessionScope scope(replaySession);
+    LOG_WARN("Sample replay idle for %lums, restoring live detection", (unsigned long)REPLAY_IDLE_TIMEOUT_MS);
+    stopSampleReplay();
+    JSONBuilder json;
+    json.add("reason", "timeout");
+    json.add("replayed", (unsigned long)replayStats.replayed);
+    SerialTx.println(buildJSONNotification("replayStopped", json.build()));
+}
+
+PipelineState getPipelineState() {
+    PipelineState state;
+    state.sampleMs = lastSampleMs;
+    memcpy(state.counts, lastCounts, sizeof(state.counts));
+    state.failed = lastReadFailed;
+    state.accel[0] = unfilteredAx;
+    state.accel[1] = unfilteredAy;
+    state.accel[2] = unfilteredAz;
+    state.filtered[0] = filtered_ax;
+    state.filtered[1] = filtered_ay;
+    state.filtered[2] = filtered_az;
+    state.magnitude = lastAccelMagnitude;
+    state.pitch = currentPitch;
+    state.roll = currentRoll;
+    state.unfilteredPitch = unfilteredPitch;
+    state.unfilteredRoll = unfilteredRoll;
+
+    ParkLogicState park = getParkLogicState();
+    state.parked = park.parked;
+    state.pendingParked = park.pendingParked;
+    state.pendingMs = park.pendingParked != park.parked ? lastSampleMs - park.pendingSinceMs : 0;
+    state.sprtLlr = park.sprt.llr;
+    state.noiseSigma = getParkNoiseSigma();
+    return state;
+}
+
+const SampleReplayStats& getSampleReplayStats() {
+    return replayStats;
+}
@@ -0,0 +1,77 @@
+#ifndef SAMPLE_REPLAY_H
+#define SAMPLE_REPLAY_H
+
+#include "Arduino.h"
+#include "replay_codec.h"
+
+// Recording and replay of the accelerometer samples behind readPosition().
+//
+// Recording streams every raw sample as a binary frame, after a header frame
+// with the settings and filter/park state in effect, so a field problem can
+// be reproduced exactly (tools/replay turns a capture into a recording).
+// Replay feeds recorded samples through the unchanged readPosition() and
+// updatePositionAndParkStatus() instead of the IMU. Dwell times follow the
+// recorded sample times rather than millis(). A replay left without commands
+// for REPLAY_IDLE_TIMEOUT_MS stops by itself and live detection resumes.
+//
+// Frames (STREAM_FRAME_REPLAY), first payload byte is the kind:
+//   00 ReplayHeader                                   recording started
+//   01 seq(u16) timeMs(u32) flags(u8) x y z(i16)      one sample, flags bit 0 = read failed
+
+#define REPLAY_FRAME_KIND_HEADER 0x00
+#define REPLAY_FRAME_KIND_SAMPLE 0x01
+#define REPLAY_SAMPLE_PAYLOAD 14
+#define REPLAY_IDLE_TIMEOUT_MS 30000    // A replay abandoned by its host gives live detection back
+
+struct SampleReplayStats {
+    bool recording;
+    uint32_t recorded;           // Sample frames sent since recording started
+    uint32_t recordDropped;      // TX ring could not take the frame
+    bool replaying;
+    uint32_t replayed;           // Samples replayed since replay started
+    uint32_t replayTimeMs;       // Time of the last replayed sample
+};
+
+// Everything the pipeline computed for the last sample
+struct PipelineState {
+    uint32_t sampleMs;
+    int16_t counts[3];
+    bool failed;                 // The sensor read itself failed
+    float accel[3];              // Calibrated, before the filter (g)
+    float filtered[3];           // EMA state (g)
+    float magnitude;
+    float pitch;                 // Reported (filtered) angles
+    float roll;
+    float unfilteredPitch;
+    float unfilteredRoll;
+    bool parked;
+    bool pendingParked;
+    uint32_t pendingMs;          // How long the pending state has been seen
+    float sprtLlr;
+    float noiseSigma;
+};
+
+// For readPosition()
+bool takeReplaySample(int16_t counts[3]);                 // false for a recorded read failure
+void recordSample(const int16_t counts[3], bool valid);   // No-op unless recording
+uint32_t getSampleTimeMs();                               // When the current sample was taken
+
+bool startSampleRecording();     // false if the header frame does not fit in the TX ring
+void stopSampleRecording();
+
+// Settings and carried state, live or from a recording
+void fillReplayHeader(ReplayHeader& header);
+void applyReplayHeader(const ReplayHeader& header);
+
+// Replay keeps the live state aside and restores it when it stops
+void startSampleReplay(uint32_t startMs);
+void stopSampleReplay();
+bool isReplayActive();
+bool loadReplayHeader(const ReplayHeader& header);        // Recorded settings and state, false if invalid
+bool replaySample(const ReplaySample& sample);            // One pass of updatePositionAndParkStatus()
+void serviceSampleReplay();                               // Call from loop() for the idle timeout
+
+PipelineState getPipelineState();
+const SampleReplayStats& getSampleReplayStats();
+
+#endif // SAMPLE_REPLAY_H
@@ -1,16 +1,35 @@
 #include "serial_interface.h"
 #include "position_sensor.h"
 #include "helpers.h"
+#include "telemetry_stream.h"
+#include "tx_buffer.h"
+#include "flash_storage.h"
+#include "qspi_flash.h"
+#include "sample_log.h"
+#include "sample_history.h"
+#include "burst_capture.h"
+#include "vibration_analysis.h"
+#include "profiler.h"
+#include "command_latency.h"
+#include "memory_stats.h"
+#include "sample_replay.h"
+#include "microbench.h"
 
-// Serial command buffer
-String serialBuffer = "";
-bool commandReady = false;
-bool inCommand = false;
+// Start of the current profiling window
+static unsigned long profileResetMs = 0;
+
+// Sessions served by the command engine; the first is USB CDC
+static StreamTransport<decltype(Serial)> usbTransport("usb", Serial);
+static CommandSession usbSession;
+static CommandSession* sessions[MAX_COMMAND_SESSIONS];
+static int sessionCount = 0;
 
 // External variables
 extern bool isParked;
 extern float currentPitch, currentRoll;
 extern float parkPitch, parkRoll, positionTolerance;
+extern float parkHysteresis;
+extern unsigned long parkEnterDwellMs, parkExitDwellMs;
 
 // External device info
 extern const char* DEVICE_NAME;
@@ -20,97 +39,149 @@ extern const char* DEVICE_MANUFACTURER;
 void initSerial() {
     Serial.begin(115200);  // SERIAL_BAUD_RATE
     Serial.setTimeout(1000);  // SERIAL_TIMEOUT
+    addCommandSession(usbSession, usbTransport);
     
     // Wait for serial port to be ready (for debugging)
     // Note: nRF52840 USB serial is different from ESP32
     unsigned long startTime = millis();
-    while (!Serial && (millis() - startTime) < 5000) {
+    while (!usbTransport.connected() && (millis() - startTime) < 5000) {
         delay(10);
     }
     
-    Serial.println();
-    Serial.println("===========================================");
-    Serial.println("Telescope Park Sensor - XIAO Sense Edition");
-    Serial.println("Version: " + String(DEVICE_VERSION));
-    Serial.println("Platform: XIAO nRF52840 Sense");
-    Serial.println("IMU: Built-in LSM6DS3TR-C");
-    Serial.println("===========================================");
-    Serial.println("Command Protocol: <CODE> where CODE is 2-digit hex");
-    Serial.println("Example: <00> for help");
-    Serial.println("Type <00> for available commands");
-    Serial.println();
+    SerialTx.println();
+    SerialTx.println("===========================================");
+    SerialTx.println("Telescope Park Sensor - XIAO Sense Edition");
+    SerialTx.println("Version: " + String(DEVICE_VERSION));
+    SerialTx.println("Platform: XIAO nRF52840 Sense");
+    SerialTx.println("IMU: Built-in LSM6DS3TR-C");
+    SerialTx.println("===========================================");
+    SerialTx.println("Command Protocol: <CODE> where CODE is 2-digit hex");
+    SerialTx.println("Example: <00> for help");
+    SerialTx.println("Type <00> for available commands");
+    SerialTx.println();
+}
+
+int addCommandSession(CommandSession& session, Transport& transport) {
+    // Session and TX router indexes are the same
+    int index = SerialTx.attach(session.tx);
+    if (index < 0) return -1;
     
-    // Clear any existing buffer
-    serialBuffer.reserve(32);  // MAX_COMMAND_LENGTH
-    serialBuffer = "";
+    session.transport = &transport;
+    session.tx.attach(&transport);
+    session.rxBuffer.reserve(32);  // MAX_COMMAND_LENGTH
+    session.rxBuffer = "";
+    sessions[index] = &session;
+    sessionCount = index + 1;
+    return index;
 }
 
-void handleSerialCommands() {
-    // Read incoming serial data
-    while (Serial.available()) {
-        char inChar = (char)Serial.read();
-        
-        if (inChar == '<') {  // CMD_START_CHAR
-            serialBuffer = "";
-            inCommand = true;
-        } else if (inChar == '>' && inCommand) {  // CMD_END_CHAR
-            if (serialBuffer.length() > 0) {
-                commandReady = true;
-            }
-            inCommand = false;
-        } else if (inCommand && inChar >= 32 && inChar <= 126) { // Printable characters only
-            if (serialBuffer.length() < 31) {  // MAX_COMMAND_LENGTH - 1
-                serialBuffer += inChar;
-            }
-        }
+int getCommandSessionCount() {
+    return sessionCount;
+}
+
+CommandSession& getCommandSession(int index) {
+    return *sessions[index >= 0 && index < sessionCount ? index : 0];
+}
+
+bool hasTransport(const char* name) {
+    for (int i = 0; i < sessionCount; i++) {
+        if (strcmp(sessions[i]->transport->name(), name) == 0) return true;
     }
+    return false;
+}
+
+static void serviceSession(CommandSession& session) {
+    Transport& link = *session.transport;
     
-    // Process command if ready
-    if (commandReady) {
-        serialBuffer.trim();
-        serialBuffer.toUpperCase();
+    // Several commands can arrive in one USB packet (pipelining clients, or
+    // a hub multiplexing several); each is processed as soon as it is framed,
+    // so none is overwritten by the next one in the same read
+    for (;;) {
+        // Read incoming data up to the end of the next command
+        PROFILE_START(rxStart);
+        while (!session.commandReady && link.available()) {
+            char inChar = (char)link.read();
+            session.rxBytes++;
+            
+            if (inChar == '<') {  // CMD_START_CHAR
+                session.rxBuffer = "";
+                session.inCommand = true;
+            } else if (inChar == '>' && session.inCommand) {  // CMD_END_CHAR
+                if (session.rxBuffer.length() > 0) {
+                    session.commandReady = true;
+                    commandLatencyReceived();
+                }
+                session.inCommand = false;
+            } else if (session.inCommand && inChar >= 32 && inChar <= 126) { // Printable characters only
+                if (session.rxBuffer.length() < 31) {  // MAX_COMMAND_LENGTH - 1
+                    session.rxBuffer += inChar;
+                }
+            }
+        }
+        PROFILE_STOP(PROFILE_SERIAL_RX, rxStart);
+        
+        if (!session.commandReady) return;
         
-        if (serialBuffer.length() > 0) {
-            Debug.println("Serial command received: " + serialBuffer);
-            processSerialCommand(serialBuffer);
+        // Process command if ready
+        session.rxBuffer.trim();
+        session.rxBuffer.toUpperCase();
+        
+        if (session.rxBuffer.length() > 0) {
+            LOG_DEBUG("Serial command received: %s", session.rxBuffer.c_str());
+            session.commands++;
+            processSerialCommand(session.rxBuffer);
         }
         
-        serialBuffer = "";
-        commandReady = false;
+        session.rxBuffer = "";
+        session.commandReady = false;
+    }
+}
+
+void handleSerialCommands() {
+    for (int i = 0; i < sessionCount; i++) {
+        // Acks, responses and debug output of its commands go back on the same link
+        SessionScope scope(i);
+        serviceSession(*sessions[i]);
     }
 }
 
 void sendSerialResponse(String response) {
-    Serial.println(response);
-    Debug.println("Serial response: " + response);
+    SerializeTimer timer;
+    SerialTx.println(response);
+    LOG_DEBUG("Serial response: %s", response.c_str());
 }
 
 void sendSerialError(String error) {
-    Serial.println(buildJSONError(error));
-    Debug.println("Serial error: " + error);
+    SerializeTimer timer;
+    SerialTx.println(buildJSONError(error));
+    LOG_DEBUG("Serial error: %s", error.c_str());
 }
 
 void sendSerialAck(String command) {
+    SerializeTimer timer;
     JSONBuilder json;
     json.add("status", "ack");
     json.add("command", command);
-    Serial.println(json.build());
-    Debug.println("Serial ACK: " + command);
+    SerialTx.println(json.build());
+    LOG_DEBUG("Serial ACK: %s", command.c_str());
 }
 
 void sendSerialJSONResponse(String jsonData) {
+    SerializeTimer timer;
     JSONBuilder response;
     response.add("status", "ok");
     // Note: This is a simplified approach. For complex nested JSON,
     // we would need a more sophisticated approach
     String fullResponse = "{\"status\":\"ok\",\"data\":" + jsonData + "}";
-    Serial.println(fullResponse);
-    Debug.println("Serial JSON response: " + fullResponse);
+    SerialTx.println(fullResponse);
+    LOG_DEBUG("Serial JSON response: %s", fullResponse.c_str());
 }
 
 void processSerialCommand(String command) {
+    PROFILE_SCOPE(PROFILE_COMMAND);
     command.trim();
     command.toUpperCase();
+    commandLatencyBegin(command);
     
     sendSerialAck(command);
     
@@ -174,53 +245,162 @@ void processSerialCommand(String command) {
     else if (command == "13") {  // CMD_SENSOR_DIAGNOSTIC
         handleSensorDiagnosticCommand();
     }
+    else if (command.startsWith("14")) {  // CMD_SUBSCRIBE
+        handleSubscribeCommand(command);
+    }
+    else if (command == "15") {  // CMD_UNSUBSCRIBE
+        handleUnsubscribeCommand();
+    }
+    else if (command.startsWith("16")) {  // CMD_TX_STATUS
+        handleTxStatusCommand(command);
+    }
+    else if (command.startsWith("17")) {  // CMD_SET_HYSTERESIS
+        handleSetHysteresisCommand(command);
+    }
+    else if (command.startsWith("18")) {  // CMD_SET_PARK_DWELL
+        handleSetParkDwellCommand(command);
+    }
+    else if (command.startsWith("19")) {  // CMD_PARK_DECISION_MODE
+        handleParkDecisionModeCommand(command);
+    }
+    else if (command.startsWith("1A")) {  // CMD_STORAGE_SYNC
+        handleStorageSyncCommand(command);
+    }
+    else if (command.startsWith("1B")) {  // CMD_SAMPLE_LOG
+        handleSampleLogCommand(command);
+    }
+    else if (command.startsWith("1C")) {  // CMD_LOG_DOWNLOAD
+        handleLogDownloadCommand(command);
+    }
+    else if (command.startsWith("1D")) {  // CMD_SAMPLE_HISTORY
+        handleSampleHistoryCommand(command);
+    }
+    else if (command.startsWith("1E")) {  // CMD_BURST_CAPTURE
+        handleBurstCaptureCommand(command);
+    }
+    else if (command.startsWith("1F")) {  // CMD_VIBRATION_SPECTRUM
+        handleVibrationCommand(command);
+    }
+    else if (command.startsWith("20")) {  // CMD_NOISE_STATS
+        handleNoiseStatsCommand(command);
+    }
+    else if (command.startsWith("21")) {  // CMD_PROFILE
+        handleProfileCommand(command);
+    }
+    else if (command.startsWith("22")) {  // CMD_COMMAND_LATENCY
+        handleCommandLatencyCommand(command);
+    }
+    else if (command.startsWith("23")) {  // CMD_MEMORY_STATS
+        handleMemoryStatsCommand(command);
+    }
+    else if (command.startsWith("24")) {  // CMD_LOG_CONTROL
+        handleLogControlCommand(command);
+    }
+    else if (command.startsWith("25")) {  // CMD_SAMPLE_REPLAY
+        handleSampleReplayCommand(command);
+    }
+    else if (command.startsWith("26")) {  // CMD_BENCHMARK
+        handleBenchmarkCommand(command);
+    }
+    else if (command == "27") {  // CMD_SESSIONS
+        handleSessionsCommand();
+    }
     else {
         sendSerialError("Unknown command: " + command + ". Use <00> for help.");
     }
+    
+    commandLatencyEnd();
 }
 
 void printSerialHelp() {
-    Serial.println("Available Commands (use <CODE> format):");
-    Serial.println("---------------------------------------");
-    Serial.println("<00> - Show this help message");
-    Serial.println("<01> - Get device status and sensor info");
-    Serial.println("<02> - Get current pitch and roll values");
-    Serial.println("<03> - Check if telescope is in park position");
-    Serial.println("<04> - Set current position as park position");
-    Serial.println("<05> - Get saved park position values");
-    Serial.println("<06> - Recalibrate the position sensor");
-    Serial.println("<07> - Toggle debug messages on/off");
-    Serial.println("<08> - Get firmware version");
-    Serial.println("<09> - Reset the device");
-    Serial.println("<0AXXX> - Set tolerance (XXX = hundredths of degrees)");
-    Serial.println("<0B> - Get current tolerance setting");
-    Serial.println("<0C> - Get system information (XIAO Sense specific)");
-    Serial.println("<0D> - Software set park position (no button needed)");
-    Serial.println("<0E> - Factory reset (clear all settings)");
-    Serial.println("<0F> - Toggle sensor filtering on/off");
-    Serial.println("<10XX> - Set filter alpha (XX = alpha*100, 00-99)");
-    Serial.println("<11> - Get raw sensor data");
-    Serial.println("<12> - Test persistent storage");
-    Serial.println("<13> - Comprehensive sensor diagnostic");
-    Serial.println();
-    Serial.println("Command format: <XX> where XX is 2-digit hex code");
-    Serial.println("Example: <02> to get current position");
-    Serial.println("Example: <0A050> to set tolerance to 0.50 degrees");
-    Serial.println("Example: <1020> to set filter alpha to 0.20");
-    Serial.println("Tolerance range: <0A001> to <0A999> (0.01° to 9.99°)");
-    Serial.println("Filter alpha range: <1000> to <1099> (0.00 to 0.99)");
-    Serial.println();
-    Serial.println("XIAO Sense Features:");
-    Serial.println("- Built-in LSM6DS3TR-C IMU (no external wiring needed)");
-    Serial.println("- Internal LED status indication");
-    Serial.println("- Software-only interface (no physical buttons)");
-    Serial.println("- Enhanced storage system (v2.0.1)");
-    Serial.println("- Advanced sensor filtering and diagnostics");
-    Serial.println();
-    Serial.println("Response format: JSON");
-    Serial.println("Success: {\"status\":\"ok\",\"data\":{...}}");
-    Serial.println("Error:   {\"status\":\"error\",\"message\":\"...\"}");
-    Serial.println("ACK:     {\"status\":\"ack\",\"command\":\"...\"}");
+    SerialTx.println("Available Commands (use <CODE> format):");
+    SerialTx.println("---------------------------------------");
+    SerialTx.println("<00> - Show this help message");
+    SerialTx.println("<01> - Get device status and sensor info");
+    SerialTx.println("<02> - Get current pitch and roll values");
+    SerialTx.println("<03> - Check if telescope is in park position");
+    SerialTx.println("<04> - Set current position as park position");
+    SerialTx.println("<05> - Get saved park position values");
+    SerialTx.println("<06> - Recalibrate the position sensor");
+    SerialTx.println("<07> - Toggle debug messages on/off");
+    SerialTx.println("<08> - Get firmware version");
+    SerialTx.println("<09> - Reset the device");
+    SerialTx.println("<0AXXX> - Set tolerance (XXX = hundredths of degrees)");
+    SerialTx.println("<0B> - Get current tolerance setting");
+    SerialTx.println("<0C> - Get system information (XIAO Sense specific)");
+    SerialTx.println("<0D> - Software set park position (no button needed)");
+    SerialTx.println("<0E> - Factory reset (clear all settings)");
+    SerialTx.println("<0F> - Toggle sensor filtering on/off");
+    SerialTx.println("<10XX> - Set filter alpha (XX = alpha*100, 00-99)");
+    SerialTx.println("<11> - Get raw sensor data");
+    SerialTx.println("<12> - Test persistent storage");
+    SerialTx.println("<13> - Comprehensive sensor diagnostic");
+    SerialTx.println("<14FFEUNNNN> - Subscribe to telemetry stream (see below)");
+    SerialTx.println("<15> - Unsubscribe from telemetry stream");
+    SerialTx.println("<16> - Get TX buffer counters");
+    SerialTx.println("<16DDTT> - Set TX reserve (DD = % kept free from debug, TT = from telemetry)");
+    SerialTx.println("<17HHH> - Set park exit hysteresis (HHH = hundredths of degrees)");
+    SerialTx.println("<18EEEEXXXX> - Set park dwell (EEEE = enter ms, XXXX = exit ms)");
+    SerialTx.println("<19> - Get park decision mode and last decision");
+    SerialTx.println("<19M> or <19MAAABBB> - Set mode (M = 0 threshold, 1 sequential test),");
+    SerialTx.println("  AAA/BBB = false unpark/park rates in thousandths (001-500)");
+    SerialTx.println("<1A> - Commit pending settings to flash and show storage counters");
+    SerialTx.println("<1AW> - Set write-behind mode (W = 1 on, 0 off)");
+    SerialTx.println("<1B> - Get sample log status");
+    SerialTx.println("<1BDDDD> - Set sample log decimation (DDDD = log every Nth sample, 0000 = events only)");
+    SerialTx.println("<1CSSSSSSSNNN> - Download NNN log blocks starting at block SSSSSSS (binary frames)");
+    SerialTx.println("<1D> - Get sample history range");
+    SerialTx.println("<1DSNNNNNNNNNN> - Get history samples from sequence NNNNNNNNNN (10 digits)");
+    SerialTx.println("<1DTNNNNN> - Get history samples from the last NNNNN ms");
+    SerialTx.println("<1E> - Get burst capture status");
+    SerialTx.println("<1EFFFFNNNN> - Capture NNNN raw samples at FFFF Hz (0104/0208/0416/0833/1666)");
+    SerialTx.println("<1ER> - Stream the last burst capture again");
+    SerialTx.println("<1F> - Get the last vibration spectrum");
+    SerialTx.println("<1FFFFF> - Measure vibration spectrum at FFFF Hz (0104/0208/0416/0833/1666)");
+    SerialTx.println("<20> - Get noise statistics (window std dev, Allan deviation)");
+    SerialTx.println("<20R> - Reset noise statistics");
+    SerialTx.println("<21> - Get main loop stage timing profile");
+    SerialTx.println("<21R> - Get the profile and start a new one");
+    SerialTx.println("<22> - Get per-command latency (p50/p99/max in us)");
+    SerialTx.println("<22R> - Reset command latency statistics");
+    SerialTx.println("<23> - Get heap, stack and buffer usage");
+    SerialTx.println("<24> - Get log level, mode and trace buffer status");
+    SerialTx.println("<24LN> - Set log level (N = 0 none, 1 error, 2 warn, 3 info, 4 debug)");
+    SerialTx.println("<24TM> - Set log mode (M = 1 binary trace, 0 text)");
+    SerialTx.println("<24D> - Dump the trace buffer (binary frames) and clear it");
+    SerialTx.println("<25> - Get sample recording and replay status");
+    SerialTx.println("<25RM> - Record raw samples as binary frames (M = 1 start, 0 stop)");
+    SerialTx.println("<25PM> - Replay mode (M = 1 enter, 0 leave and restore live state)");
+    SerialTx.println("<25HOODD..> - Upload recording header bytes at hex offset OO (up to 12 bytes)");
+    SerialTx.println("<25HA> - Apply the uploaded header (recorded settings and state)");
+    SerialTx.println("<25SXXXXYYYYZZZZTTTT> - Replay one sample (hex counts, hex ms since last)");
+    SerialTx.println("<25SETTTT> - Replay one failed sensor read");
+    SerialTx.println("<26> - List microbenchmark cases");
+    SerialTx.println("<26NN> - Run benchmark case NN (hex) and report cycles per operation");
+    SerialTx.println("<27> - List the links served (USB, BLE, host ptys) with their counters");
+    SerialTx.println();
+    SerialTx.println("Command format: <XX> where XX is 2-digit hex code");
+    SerialTx.println("Example: <02> to get current position");
+    SerialTx.println("Example: <0A050> to set tolerance to 0.50 degrees");
+    SerialTx.println("Example: <1020> to set filter alpha to 0.20");
+    SerialTx.println("Tolerance range: <0A001> to <0A999> (0.01° to 9.99°)");
+    SerialTx.println("Filter alpha range: <1000> to <1099> (0.00 to 0.99)");
+    SerialTx.println("Subscribe: FF = hex field mask (01 pitch, 02 roll, 04 gravity,");
+    SerialTx.println("  08 parked, 10 temp, 20 sequence), E = J (JSON) or B (binary),");
+    SerialTx.println("  U = M (NNNN is period in ms) or D (every NNNN samples)");
+    SerialTx.println("Example: <143FJM0100> streams all fields as JSON every 100ms");
+    SerialTx.println();
+    SerialTx.println("XIAO Sense Features:");
+    SerialTx.println("- Built-in LSM6DS3TR-C IMU (no external wiring needed)");
+    SerialTx.println("- Internal LED status indication");
+    SerialTx.println("- Software-only interface (no physical buttons)");
+    SerialTx.println("- Enhanced storage system (v2.0.1)");
+    SerialTx.println("- Advanced sensor filtering and diagnostics");
+    SerialTx.println();
+    SerialTx.println("Response format: JSON");
+    SerialTx.println("Success: {\"status\":\"ok\",\"data\":{...}}");
+    SerialTx.println("Error:   {\"status\":\"error\",\"message\":\"...\"}");
+    SerialTx.println("ACK:     {\"status\":\"ack\",\"command\":\"...\"}");
 }
 
 void handleStatusCommand() {
@@ -237,6 +417,7 @@ void handleStatusCommand() {
     json.add("calibrated", hasCalibration);
     json.add("ledStatus", ledStatus);
     json.add("uptime", (unsigned long)millis());
+    json.add("heapUsed", (unsigned long)getHeapStats(false).usedBytes);
     
     sendSerialJSONResponse(json.build());
 }
@@ -254,7 +435,16 @@ void handlePositionCommand() {
     }
 }
 
+// Commands that read the sensor would run the live pipeline on the replayed
+// sample and report or save replay state as if it were live
+static bool refuseDuringReplay() {
+    if (!isReplayActive()) return false;
+    sendSerialError("Replay mode is active. Use <25P0> first");
+    return true;
+}
+
 void handleParkedCommand() {
+    if (refuseDuringReplay()) return;
     updatePositionAndParkStatus(); // Use helper function
     
     JSONBuilder json;
@@ -264,22 +454,37 @@ void handleParkedCommand() {
     json.add("parkPitch", parkPitch);
     json.add("parkRoll", parkRoll);
     json.add("tolerance", positionTolerance, 1);
+    json.add("exitTolerance", getParkExitTolerance());
     json.add("pitchDiff", calculatePositionDifference(currentPitch, parkPitch));
     json.add("rollDiff", calculatePositionDifference(currentRoll, parkRoll));
     
+    extern int parkDecisionMode;
+    if (parkDecisionMode == PARK_MODE_SPRT) {
+        const SprtResult& decision = getLastParkDecision();
+        json.add("decisionMode", "sprt");
+        json.add("confidence", decision.confidence, 4);
+        json.add("samplesToDecision", (unsigned long)decision.samples);
+        json.add("noiseSigma", getParkNoiseSigma(), 4);
+    } else {
+        json.add("decisionMode", "threshold");
+    }
+    
     sendSerialJSONResponse(json.build());
 }
 
 void handleSetParkCommand() {
+    if (refuseDuringReplay()) return;
     updatePositionAndParkStatus(); // Use helper function
     
     if (isValidPosition(currentPitch, currentRoll)) {
         parkPitch = currentPitch;
         parkRoll = currentRoll;
         
-        // Save using helper functions
-        bool success = saveFloatPreference("parkPitch", parkPitch) && 
-                      saveFloatPreference("parkRoll", parkRoll);
+        // Save using helper functions, both values in one flash commit
+        beginPreferenceTransaction();
+        bool success = saveFloatPreference(SETTING_PARK_PITCH, parkPitch) && 
+                      saveFloatPreference(SETTING_PARK_ROLL, parkRoll);
+        success = commitPreferenceTransaction() && success;
         
         JSONBuilder json;
         json.add("parkPitch", parkPitch);
@@ -287,7 +492,7 @@ void handleSetParkCommand() {
         json.add("saved", success);
         sendSerialJSONResponse(json.build());
         
-        Debug.println("Park position updated and saved");
+        LOG_INFO("Park position updated and saved");
     } else {
         sendSerialError("Failed to read current position from sensor");
     }
@@ -319,7 +524,7 @@ void handleToggleDebugCommand() {
     DEBUG_ENABLED = !DEBUG_ENABLED;
     
     String status = DEBUG_ENABLED ? "ENABLED" : "DISABLED";
-    Debug.println("Debug messages " + status + " via serial command");
+    LOG_DEBUG("Debug messages %s via serial command", status.c_str());
     
     JSONBuilder json;
     json.add("debugEnabled", DEBUG_ENABLED);
@@ -334,12 +539,17 @@ void handleVersionCommand() {
     json.add("manufacturer", DEVICE_MANUFACTURER);
     json.add("platform", "XIAO nRF52840 Sense");
     json.add("imu", "LSM6DS3TR-C");
-    json.add("bluetoothReady", true);
+    json.add("bluetoothReady", hasTransport("ble"));
     sendSerialJSONResponse(json.build());
 }
 
 void handleResetCommand() {
     sendSerialJSONResponse(buildSimpleJSONResponse("message", "Resetting device in 3 seconds"));
+    logEvent(LOG_EVENT_RESET, 0);
+    waitForFlashIdle();   // Room in the queue, so the save below is not deferred
+    syncFlashSettings();  // Don't lose write-behind settings
+    waitForFlashIdle();
+    SerialTx.drain(1000);
     delay(3000);
     // nRF52840 reset method
     NVIC_SystemReset();
@@ -371,7 +581,7 @@ void handleSetToleranceCommand(String command) {
     float newTolerance = toleranceHundredths / 100.0;
     positionTolerance = newTolerance;
     
-    bool success = saveFloatPreference("tolerance", positionTolerance);
+    bool success = saveFloatPreference(SETTING_TOLERANCE, positionTolerance);
     
     JSONBuilder json;
     json.add("tolerance", positionTolerance);
@@ -379,7 +589,7 @@ void handleSetToleranceCommand(String command) {
     json.add("saved", success);
     sendSerialJSONResponse(json.build());
     
-    Debug.println("Tolerance updated to " + String(positionTolerance, 2) + "° and saved");
+    LOG_DEBUG("Tolerance updated to %.2f° and saved", positionTolerance);
 }
 
 void handleGetToleranceCommand() {
@@ -389,11 +599,15 @@ void handleGetToleranceCommand() {
     json.add("tolerance", positionTolerance);
     json.add("toleranceHundredths", toleranceHundredths);
     json.add("toleranceString", String(positionTolerance, 2) + "°");
+    json.add("hysteresis", parkHysteresis);
+    json.add("exitTolerance", getParkExitTolerance());
+    json.add("enterDwellMs", parkEnterDwellMs);
+    json.add("exitDwellMs", parkExitDwellMs);
     sendSerialJSONResponse(json.build());
 }
 
 void handleSystemInfoCommand() {
-    Debug.println("=== SYSTEM INFO COMMAND ===");
+    LOG_DEBUG("=== SYSTEM INFO COMMAND ===");
     
     JSONBuilder json;
     json.add("platform", "XIAO nRF52840 Sense");
@@ -408,14 +622,16 @@ void handleSystemInfoCommand() {
     json.add("builtinIMU", true);
     json.add("externalButton", false);
     json.add("uptime", (unsigned long)millis());
+    json.add("heapUsed", (unsigned long)getHeapStats(false).usedBytes);
     
     sendSerialJSONResponse(json.build());
     
-    Debug.println("System info command complete");
+    LOG_DEBUG("System info command complete");
 }
 
 void handleSoftwareSetParkCommand() {
-    Debug.println("=== SOFTWARE SET PARK COMMAND ===");
+    LOG_DEBUG("=== SOFTWARE SET PARK COMMAND ===");
+    if (refuseDuringReplay()) return;
     
     updatePositionAndParkStatus();
     
@@ -423,9 +639,11 @@ void handleSoftwareSetParkCommand() {
         parkPitch = currentPitch;
         parkRoll = currentRoll;
         
-        // Save using helper functions
-        bool success = saveFloatPreference("parkPitch", parkPitch) && 
-                      saveFloatPreference("parkRoll", parkRoll);
+        // Save using helper functions, both values in one flash commit
+        beginPreferenceTransaction();
+        bool success = saveFloatPreference(SETTING_PARK_PITCH, parkPitch) && 
+                      saveFloatPreference(SETTING_PARK_ROLL, parkRoll);
+        success = commitPreferenceTransaction() && success;
         
         JSONBuilder json;
         json.add("message", "Park position set via software command");
@@ -434,26 +652,29 @@ void handleSoftwareSetParkCommand() {
         json.add("saved", success);
         sendSerialJSONResponse(json.build());
         
-        Debug.println("Park position set via software command and saved");
+        LOG_INFO("Park position set via software command and saved");
     } else {
         sendSerialError("Failed to read current position from sensor");
     }
 }
 
 void handleFactoryResetCommand() {
-    Debug.println("=== FACTORY RESET COMMAND ===");
+    LOG_DEBUG("=== FACTORY RESET COMMAND ===");
     
     sendSerialJSONResponse(buildSimpleJSONResponse("message", "Factory reset initiated - clearing all stored data"));
     
+    logEvent(LOG_EVENT_RESET, 1);  // The sample log itself survives a factory reset
     clearAllPreferences();
+    waitForFlashIdle();
     
-    Debug.println("All stored data cleared via software command");
+    LOG_INFO("All stored data cleared via software command");
     
     JSONBuilder json;
     json.add("message", "Factory reset complete - device will restart in 3 seconds");
     json.add("resetMethod", "software");
     sendSerialJSONResponse(json.build());
     
+    SerialTx.drain(1000);
     delay(3000);
     NVIC_SystemReset();
 }
@@ -462,9 +683,11 @@ void handleToggleFilterCommand() {
     extern bool use_filtering;
     use_filtering = !use_filtering;
     setFiltering(use_filtering);
+    bool success = saveIntPreference(SETTING_FILTER_ENABLED, use_filtering ? 1 : 0);
     
     JSONBuilder json;
     json.add("filterEnabled", use_filtering);
+    json.add("saved", success);
     json.add("message", "Sensor filtering " + String(use_filtering ? "ENABLED" : "DISABLED"));
     json.add("note", "Disabling filter improves responsiveness but increases noise");
     sendSerialJSONResponse(json.build());
@@ -495,17 +718,19 @@ void handleSetFilterAlphaCommand(String command) {
     
     float newAlpha = alphaHundredths / 100.0;
     setFilterAlpha(newAlpha);
+    bool success = saveFloatPreference(SETTING_FILTER_ALPHA, newAlpha);
     
     JSONBuilder json;
     json.add("filterAlpha", newAlpha);
     json.add("alphaHundredths", alphaHundredths);
+    json.add("saved", success);
     json.add("message", "Filter alpha set to " + String(newAlpha, 2));
     json.add("note", "Lower alpha = more responsive, higher alpha = more filtering");
     sendSerialJSONResponse(json.build());
 }
 
 void handleRawSensorDataCommand() {
-    Debug.println("=== RAW SENSOR DATA COMMAND ===");
+    LOG_DEBUG("=== RAW SENSOR DATA COMMAND ===");
     
     // Read raw data directly from IMU
     extern LSM6DS3 imu;
@@ -551,7 +776,7 @@ void handleRawSensorDataCommand() {
 }
 
 void handleStorageTestCommand() {
-    Debug.println("=== STORAGE TEST COMMAND ===");
+    LOG_DEBUG("=== STORAGE TEST COMMAND ===");
     
     // Use the helper functions instead of direct flash functions
     JSONBuilder json;
@@ -559,8 +784,8 @@ void handleStorageTestCommand() {
     
     // Test enhanced RAM storage instead
     float testValue = millis() / 1000.0;
-    bool saveSuccess = saveFloatPreference("test_key", testValue);
-    float loadedValue = loadFloatPreference("test_key", -999.0);
+    bool saveSuccess = saveFloatPreference(SETTING_STORAGE_TEST, testValue);
+    float loadedValue = loadFloatPreference(SETTING_STORAGE_TEST);
     bool loadSuccess = (abs(loadedValue - testValue) < 0.001);
     
     json.add("testSaveSuccess", saveSuccess);
@@ -574,35 +799,38 @@ void handleStorageTestCommand() {
 }
 
 void handleSensorDiagnosticCommand() {
-    Debug.println("=== COMPREHENSIVE SENSOR DIAGNOSTIC ===");
+    LOG_DEBUG("=== COMPREHENSIVE SENSOR DIAGNOSTIC ===");
     
     extern LSM6DS3 imu;
     extern bool use_filtering;
     extern float alpha;  // REMOVE const from this line
     
-    // Take multiple readings for stability analysis
+    // Stability is judged on the last 10 samples from the history ring
+    // (the last 500ms) instead of pausing the sensor loop to take new ones
     const int numReadings = 10;
     float pitchReadings[numReadings];
     float rollReadings[numReadings];
-    bool allReadingsValid = true;
-    
-    Debug.println("Taking " + String(numReadings) + " readings for stability analysis...");
+    bool allReadingsValid = getHistoryCount() >= numReadings;
+    unsigned long readingsSpanMs = 0;
     
-    for (int i = 0; i < numReadings; i++) {
-        float pitch, roll;
-        if (readPosition(pitch, roll)) {
-            pitchReadings[i] = pitch;
-            rollReadings[i] = roll;
-        } else {
-            allReadingsValid = false;
-            break;
+    if (allReadingsValid) {
+        uint32_t first = getHistoryNewestSequence() - numReadings + 1;
+        for (int i = 0; i < numReadings; i++) {
+            const HistorySample* sample = getHistorySample(first + i);
+            pitchReadings[i] = sample->pitch;
+            rollReadings[i] = sample->roll;
         }
-        delay(50);
+        
+        // Failed reads leave no sample, so a stretched window means sensor errors
+        const HistorySample* oldest = getHistorySample(first);
+        readingsSpanMs = millis() - oldest->timeMs;
+        if (readingsSpanMs > (numReadings + 1) * 50) allReadingsValid = false;
     }
     
     JSONBuilder json;
     json.add("diagnosticTime", millis());
     json.add("readingsRequested", numReadings);
+    json.add("readingsSpanMs", readingsSpanMs);
     json.add("allReadingsValid", allReadingsValid);
     
     if (allReadingsValid) {
@@ -634,6 +862,11 @@ void handleSensorDiagnosticCommand() {
         json.add("rollStability", (rollRange < 0.5) ? "GOOD" : (rollRange < 1.0) ? "FAIR" : "POOR");
     }
     
+    // Unfiltered noise over the last 10s, from the running statistics
+    const NoiseStats& noise = getNoiseStats();
+    json.add("pitchStdDev10s", noiseStatsWindow(noise, NOISE_PITCH, 1).stddev, 4);
+    json.add("rollStdDev10s", noiseStatsWindow(noise, NOISE_ROLL, 1).stddev, 4);
+    
     // Hardware and configuration info
     json.add("imuModel", "LSM6DS3TR-C");
     json.add("filterEnabled", use_filtering);
@@ -647,4 +880,1159 @@ void handleSensorDiagnosticCommand() {
     json.add("temperatureStatus", (temperature > 15 && temperature < 50) ? "NORMAL" : "CHECK");
     
     sendSerialJSONResponse(json.build());
-}
\ No newline at end of file
+}
+
+void handleSubscribeCommand(String command) {
+    if (command.length() != 10) {
+        sendSerialError("Invalid subscribe command format. Use <14FFEUNNNN> (FF=field mask, E=J/B, U=M/D, NNNN=value)");
+        return;
+    }
+    
+    String maskStr = command.substring(2, 4);
+    char encoding = command.charAt(4);
+    char unit = command.charAt(5);
+    String valueStr = command.substring(6);
+    
+    // Validate field mask (2 hex digits)
+    for (int i = 0; i < maskStr.length(); i++) {
+        if (!isHexadecimalDigit(maskStr.charAt(i))) {
+            sendSerialError("Invalid field mask. Must be 2 hex digits (01-3F)");
+            return;
+        }
+    }
+    
+    // Validate value (4 decimal digits)
+    for (int i = 0; i < valueStr.length(); i++) {
+        if (!isDigit(valueStr.charAt(i))) {
+            sendSerialError("Invalid stream rate. Must be 4 digits (0001-9999)");
+            return;
+        }
+    }
+    
+    if (encoding != 'J' && encoding != 'B') {
+        sendSerialError("Invalid encoding. Use J (JSON lines) or B (binary frames)");
+        return;
+    }
+    
+    if (unit != 'M' && unit != 'D') {
+        sendSerialError("Invalid rate unit. Use M (period in ms) or D (sample decimation)");
+        return;
+    }
+    
+    uint8_t fieldMask = (uint8_t)strtol(maskStr.c_str(), NULL, 16);
+    int value = valueStr.toInt();
+    
+    if (fieldMask == 0 || (fieldMask & ~STREAM_FIELD_ALL) != 0) {
+        sendSerialError("Field mask out of range. Must be 01-3F");
+        return;
+    }
+    
+    if (value < 1) {
+        sendSerialError("Stream rate out of range. Must be 0001-9999");
+        return;
+    }
+    
+    // Samples are only taken every 50ms (SENSOR_READ_INTERVAL), so faster periods are clamped
+    unsigned long periodMs = 0;
+    unsigned long decimation = 0;
+    if (unit == 'M') {
+        periodMs = (value < 50) ? 50 : value;
+    } else {
+        decimation = value;
+    }
+    
+    startTelemetryStream(fieldMask, encoding == 'B', periodMs, decimation);
+    
+    JSONBuilder json;
+    json.add("streaming", true);
+    json.add("fieldMask", (int)fieldMask);
+    json.add("encoding", encoding == 'B' ? "binary" : "json");
+    if (periodMs > 0) {
+        json.add("periodMs", periodMs);
+    } else {
+        json.add("decimation", decimation);
+        json.add("periodMs", (unsigned long)(decimation * 50));  // SENSOR_READ_INTERVAL
+    }
+    sendSerialJSONResponse(json.build());
+}
+
+void handleUnsubscribeCommand() {
+    bool wasActive = isTelemetryStreamActive();
+    stopTelemetryStream();
+    
+    const TelemetryStreamStats& stats = getTelemetryStreamStats();
+    
+    JSONBuilder json;
+    json.add("streaming", false);
+    json.add("wasActive", wasActive);
+    json.add("framesSent", stats.framesSent);
+    json.add("framesDropped", stats.framesDropped);
+    json.add("samplesMissed", stats.samplesMissed);
+    json.add("bytesSent", stats.bytesSent);
+    sendSerialJSONResponse(json.build());
+}
+
+void handleTxStatusCommand(String command) {
+    if (command.length() != 2 && command.length() != 6) {
+        sendSerialError("Invalid TX status command format. Use <16> or <16DDTT> (DD/TT = reserve %)");
+        return;
+    }
+    
+    if (command.length() == 6) {
+        String reserveStr = command.substring(2);
+        
+        // Validate that it's all digits
+        for (int i = 0; i < reserveStr.length(); i++) {
+            if (!isDigit(reserveStr.charAt(i))) {
+                sendSerialError("Invalid TX reserve value. Must be 4 digits (DDTT)");
+                return;
+            }
+        }
+        
+        int debugReserve = reserveStr.substring(0, 2).toInt();
+        int telemetryReserve = reserveStr.substring(2).toInt();
+        
+        if (!SerialTx.setReserve(debugReserve, telemetryReserve)) {
+            sendSerialError("TX reserve out of range. Debug reserve must be >= telemetry reserve");
+            return;
+        }
+        
+        LOG_DEBUG("TX reserve set: debug=%d%% telemetry=%d%%", debugReserve, telemetryReserve);
+    }
+    
+    const TxBufferStats& stats = SerialTx.getStats();
+    
+    JSONBuilder json;
+    json.add("bufferSize", (int)TX_BUFFER_SIZE);
+    json.add("bytesPending", (unsigned long)SerialTx.used());
+    json.add("highWater", (unsigned long)stats.highWater);
+    json.add("bytesQueued", stats.bytesQueued);
+    json.add("bytesFlushed", stats.bytesFlushed);
+    json.add("responseBytesDropped", stats.bytesDropped[TX_CLASS_RESPONSE]);
+    json.add("telemetryBytesDropped", stats.bytesDropped[TX_CLASS_TELEMETRY]);
+    json.add("debugBytesDropped", stats.bytesDropped[TX_CLASS_DEBUG]);
+    json.add("responsesDropped", stats.messagesDropped[TX_CLASS_RESPONSE]);
+    json.add("telemetryDropped", stats.messagesDropped[TX_CLASS_TELEMETRY]);
+    json.add("debugDropped", stats.messagesDropped[TX_CLASS_DEBUG]);
+    json.add("responseWaits", stats.responseWaits);
+    json.add("debugReserve", SerialTx.getReservePercent(TX_CLASS_DEBUG));
+    json.add("telemetryReserve", SerialTx.getReservePercent(TX_CLASS_TELEMETRY));
+    sendSerialJSONResponse(json.build());
+}
+
+void handleSetHysteresisCommand(String command) {
+    if (command.length() != 5) {
+        sendSerialError("Invalid hysteresis command format. Use <17HHH> where HHH is hysteresis in hundredths of degrees");
+        return;
+    }
+    
+    String hysteresisStr = command.substring(2);
+    
+    // Validate that it's all digits
+    for (int i = 0; i < hysteresisStr.length(); i++) {
+        if (!isDigit(hysteresisStr.charAt(i))) {
+            sendSerialError("Invalid hysteresis value. Must be 3 digits (000-999)");
+            return;
+        }
+    }
+    
+    int hysteresisHundredths = hysteresisStr.toInt();
+    parkHysteresis = hysteresisHundredths / 100.0;
+    bool success = saveFloatPreference(SETTING_PARK_HYSTERESIS, parkHysteresis);
+    
+    JSONBuilder json;
+    json.add("hysteresis", parkHysteresis);
+    json.add("hysteresisHundredths", hysteresisHundredths);
+    json.add("enterTolerance", positionTolerance);
+    json.add("exitTolerance", getParkExitTolerance());
+    json.add("saved", success);
+    sendSerialJSONResponse(json.build());
+    
+    LOG_DEBUG("Park hysteresis set to %.2f°", parkHysteresis);
+}
+
+void handleSetParkDwellCommand(String command) {
+    if (command.length() != 10) {
+        sendSerialError("Invalid dwell command format. Use <18EEEEXXXX> where EEEE/XXXX are enter/exit dwell in ms");
+        return;
+    }
+    
+    String dwellStr = command.substring(2);
+    
+    // Validate that it's all digits
+    for (int i = 0; i < dwellStr.length(); i++) {
+        if (!isDigit(dwellStr.charAt(i))) {
+            sendSerialError("Invalid dwell value. Must be 8 digits (EEEEXXXX)");
+            return;
+        }
+    }
+    
+    parkEnterDwellMs = dwellStr.substring(0, 4).toInt();
+    parkExitDwellMs = dwellStr.substring(4).toInt();
+    
+    // Both values in one flash commit
+    beginPreferenceTransaction();
+    bool success = saveIntPreference(SETTING_PARK_ENTER_DWELL, parkEnterDwellMs) &&
+                  saveIntPreference(SETTING_PARK_EXIT_DWELL, parkExitDwellMs);
+    success = commitPreferenceTransaction() && success;
+    
+    JSONBuilder json;
+    json.add("enterDwellMs", parkEnterDwellMs);
+    json.add("exitDwellMs", parkExitDwellMs);
+    json.add("saved", success);
+    sendSerialJSONResponse(json.build());
+    
+    LOG_DEBUG("Park dwell set: enter=%lums exit=%lums", parkEnterDwellMs, parkExitDwellMs);
+}
+
+void handleParkDecisionModeCommand(String command) {
+    extern int parkDecisionMode;
+    
+    if (command.length() != 2 && command.length() != 3 && command.length() != 9) {
+        sendSerialError("Invalid decision mode command format. Use <19>, <19M> or <19MAAABBB>");
+        return;
+    }
+    
+    if (command.length() > 2) {
+        String argStr = command.substring(2);
+        
+        // Validate that it's all digits
+        for (int i = 0; i < argStr.length(); i++) {
+            if (!isDigit(argStr.charAt(i))) {
+                sendSerialError("Invalid decision mode value. Must be digits only");
+                return;
+            }
+        }
+        
+        int mode = argStr.substring(0, 1).toInt();
+        if (mode != PARK_MODE_THRESHOLD && mode != PARK_MODE_SPRT) {
+            sendSerialError("Decision mode out of range. Use 0 (threshold) or 1 (sequential test)");
+            return;
+        }
+        
+        if (command.length() == 9) {
+            int falseUnpark = argStr.substring(1, 4).toInt();
+            int falsePark = argStr.substring(4).toInt();
+            if (falseUnpark < 1 || falseUnpark > 500 || falsePark < 1 || falsePark > 500) {
+                sendSerialError("Error rates out of range. Must be 001-500 (0.001 to 0.500)");
+                return;
+            }
+            
+            SprtConfig& config = getSprtConfig();
+            config.falseUnparkRate = falseUnpark / 1000.0;
+            config.falseParkRate = falsePark / 1000.0;
+        }
+        
+        setParkDecisionMode(mode);
+        
+        const SprtConfig& saved = getSprtConfig();
+        beginPreferenceTransaction();
+        saveIntPreference(SETTING_PARK_DECISION_MODE, mode);
+        saveFloatPreference(SETTING_SPRT_FALSE_UNPARK, saved.falseUnparkRate);
+        saveFloatPreference(SETTING_SPRT_FALSE_PARK, saved.falseParkRate);
+        commitPreferenceTransaction();
+        LOG_DEBUG("Park decision mode set to %s", (mode == PARK_MODE_SPRT ? "SPRT" : "threshold"));
+    }
+    
+    const SprtConfig& config = getSprtConfig();
+    const SprtResult& decision = getLastParkDecision();
+    
+    JSONBuilder json;
+    json.add("decisionMode", parkDecisionMode == PARK_MODE_SPRT ? "sprt" : "threshold");
+    json.add("falseUnparkRate", config.falseUnparkRate, 3);
+    json.add("falseParkRate", config.falseParkRate, 3);
+    json.add("indifference", config.indifference, 3);
+    json.add("noiseSigma", getParkNoiseSigma(), 4);
+    json.add("parked", isParked);
+    if (decision.decision != PARK_DECISION_NONE) {
+        json.add("lastDecision", decision.decision == PARK_DECISION_PARKED ? "parked" : "unparked");
+        json.add("confidence", decision.confidence, 4);
+        json.add("samplesToDecision", (unsigned long)decision.samples);
+    }
+    sendSerialJSONResponse(json.build());
+}
+
+void handleStorageSyncCommand(String command) {
+    if (command.length() != 2 && command.length() != 3) {
+        sendSerialError("Invalid storage sync command format. Use <1A> or <1AW> (W = 0/1)");
+        return;
+    }
+    
+    if (command.length() == 3) {
+        char mode = command.charAt(2);
+        if (mode != '0' && mode != '1') {
+            sendSerialError("Invalid write-behind value. Use 0 (off) or 1 (on)");
+            return;
+        }
+        setWriteBehind(mode == '1');
+        LOG_DEBUG("Write-behind %s", (mode == '1' ? "ENABLED" : "DISABLED"));
+    }
+    
+    bool synced = syncFlashSettings();
+    const FlashStorageStats& stats = getFlashStorageStats();
+    
+    JSONBuilder json;
+    json.add("synced", synced);
+    json.add("pending", hasPendingSettings());
+    json.add("writeBehind", isWriteBehindEnabled());
+    json.add("writeBehindDelayMs", (unsigned long)FLASH_WRITE_BEHIND_DELAY_MS);
+    json.add("valueUpdates", stats.valueUpdates);
+    json.add("commits", stats.commits);
+    json.add("failedCommits", stats.failedCommits);
+    json.add("commitTimeouts", stats.commitTimeouts);
+    json.add("deferredSaves", stats.deferredSaves);
+    json.add("sectorErases", stats.sectorErases);
+    json.add("pagePrograms", stats.pagePrograms);
+    
+    SettingsLogInfo logInfo = getSettingsLogInfo();
+    json.add("logSequence", (unsigned long)logInfo.sequence);
+    json.add("logSector", (int)logInfo.sector);
+    json.add("logNextSlot", (int)logInfo.nextSlot);
+    json.add("logInFlight", (int)logInfo.inFlight);
+    json.add("logSectors", (int)logInfo.sectors);
+    json.add("logSlotsPerSector", (int)logInfo.slotsPerSector);
+    
+    const QspiFlashStats& qspiStats = getQspiFlashStats();
+    json.add("flashXip", isFlashXipAvailable());
+    json.add("flashPoweredDown", qspiFlashIsPoweredDown());
+    json.add("flashOpsQueued", qspiStats.opsQueued);
+    json.add("flashOpsCompleted", qspiStats.opsCompleted);
+    json.add("flashOpsFailed", qspiStats.opsFailed);
+    json.add("flashQueueHighWater", (int)qspiStats.queueHighWater);
+    json.add("flashQueueFull", qspiStats.queueFullRefusals);
+    json.add("flashPowerDowns", qspiStats.powerDowns);
+    sendSerialJSONResponse(json.build());
+}
+
+void handleSampleLogCommand(String command) {
+    if (command.length() != 2 && command.length() != 6) {
+        sendSerialError("Invalid sample log command format. Use <1B> or <1BDDDD> (DDDD = 0000-1200)");
+        return;
+    }
+    
+    if (command.length() == 6) {
+        String decimationStr = command.substring(2);
+        for (int i = 0; i < decimationStr.length(); i++) {
+            if (!isDigit(decimationStr.charAt(i))) {
+                sendSerialError("Invalid decimation format. Use <1BDDDD> with digits only");
+                return;
+            }
+        }
+        
+        int decimation = decimationStr.toInt();
+        if (!saveIntPreference(SETTING_LOG_DECIMATION, decimation)) {
+            sendSerialError("Decimation out of range. Use 0000-1200 (0000 = events only)");
+            return;
+        }
+        setSampleLogDecimation((uint16_t)decimation);
+        LOG_DEBUG("Sample log decimation set to %d", decimation);
+    }
+    
+    SampleLogInfo info = getSampleLogInfo();
+    
+    JSONBuilder json;
+    json.add("available", info.available);
+    json.add("decimation", (int)info.decimation);
+    json.add("logIntervalMs", (unsigned long)info.decimation * SAMPLE_LOG_SAMPLE_INTERVAL_MS);
+    json.add("saved", isSettingStored(SETTING_LOG_DECIMATION));
+    json.add("bootCount", (int)info.bootCount);
+    json.add("blocks", (unsigned long)(info.hasBlocks ? info.newestSequence - info.oldestSequence + 1 : 0));
+    json.add("oldestBlock", (unsigned long)info.oldestSequence);
+    json.add("newestBlock", (unsigned long)info.newestSequence);
+    json.add("capacityBlocks", (unsigned long)info.capacityBlocks);
+    json.add("blockSize", LOG_BLOCK_SIZE);
+    json.add("samplesLogged", (unsigned long)info.samplesLogged);
+    json.add("eventsLogged", (unsigned long)info.eventsLogged);
+    json.add("blocksWritten", (unsigned long)info.blocksWritten);
+    json.add("writeFailures", (unsigned long)info.writeFailures);
+    json.add("pendingSamples", (unsigned long)info.pendingSamples);
+    json.add("downloadActive", info.downloadActive);
+    sendSerialJSONResponse(json.build());
+}
+
+void handleLogDownloadCommand(String command) {
+    // Format: <1CSSSSSSSNNN> - SSSSSSS = first block, NNN = block count
+    if (command.length() != 12) {
+        sendSerialError("Invalid log download format. Use <1CSSSSSSSNNN> (7-digit block, 3-digit count)");
+        return;
+    }
+    
+    String argsStr = command.substring(2);
+    for (int i = 0; i < argsStr.length(); i++) {
+        if (!isDigit(argsStr.charAt(i))) {
+            sendSerialError("Invalid log download format. Use <1CSSSSSSSNNN> with digits only");
+            return;
+        }
+    }
+    
+    unsigned long fromSequence = argsStr.substring(0, 7).toInt();
+    int count = argsStr.substring(7).toInt();
+    if (count < 1 || count > SAMPLE_LOG_MAX_DOWNLOAD) {
+        sendSerialError("Block count out of range. Use 001-999");
+        return;
+    }
+    
+    SampleLogInfo info = getSampleLogInfo();
+    if (!info.available) {
+        sendSerialError("Sample log not available - no persistent storage");
+        return;
+    }
+    
+    uint32_t first = startSampleLogDownload(fromSequence, count);
+    info = getSampleLogInfo();
+    
+    // Frames follow this response; logDownloadComplete marks the end
+    JSONBuilder json;
+    json.add("from", (unsigned long)first);
+    json.add("count", (unsigned long)info.downloadRemaining);
+    json.add("blockSize", LOG_BLOCK_SIZE);
+    json.add("frameType", STREAM_FRAME_LOG_BLOCK);
+    sendSerialJSONResponse(json.build());
+}
+
+void handleSampleHistoryCommand(String command) {
+    // Formats: <1D>, <1DSNNNNNNNNNN> (from sequence), <1DTNNNNN> (last NNNNN ms)
+    char mode = command.length() > 2 ? command.charAt(2) : ' ';
+    if (command.length() != 2 && !(mode == 'S' && command.length() == 13) && !(mode == 'T' && command.length() == 8)) {
+        sendSerialError("Invalid history command format. Use <1D>, <1DSNNNNNNNNNN> or <1DTNNNNN>");
+        return;
+    }
+    
+    String valueStr = command.substring(3);
+    for (int i = 0; i < valueStr.length(); i++) {
+        if (!isDigit(valueStr.charAt(i))) {
+            sendSerialError("Invalid history range. Sequence (S) and time (T) must be digits only");
+            return;
+        }
+    }
+    
+    size_t held = getHistoryCount();
+    uint32_t oldest = getHistoryOldestSequence();
+    uint32_t newest = getHistoryNewestSequence();
+    
+    JSONBuilder json;
+    json.add("held", (unsigned long)held);
+    json.add("capacity", SAMPLE_HISTORY_SIZE);
+    json.add("oldestSeq", (unsigned long)(held > 0 ? oldest : 0));
+    json.add("newestSeq", (unsigned long)(held > 0 ? newest : 0));
+    
+    if (command.length() == 2) {
+        sendSerialJSONResponse(json.build());
+        return;
+    }
+    
+    // sampleSequence is unsigned long, so this parse must not go through a signed long
+    uint32_t first;
+    if (mode == 'S') {
+        first = strtoul(valueStr.c_str(), NULL, 10);
+    } else {
+        unsigned long windowMs = valueStr.toInt();
+        first = findHistorySequenceAt(millis() - windowMs);
+    }
+    
+    // A client that fell too far behind resumes at the oldest sample held
+    uint32_t missed = 0;
+    if (held == 0) {
+        first = newest + 1;
+    } else if ((int32_t)(first - oldest) < 0) {
+        missed = oldest - first;
+        first = oldest;
+    }
+    
+    uint32_t available = (int32_t)(newest + 1 - first) > 0 ? newest + 1 - first : 0;
+    if (held == 0) available = 0;
+    uint32_t count = available < SAMPLE_HISTORY_MAX_QUERY ? available : SAMPLE_HISTORY_MAX_QUERY;
+    
+    // Packed as parallel arrays; times are deltas from t0 (the first sample)
+    String dt = "[";
+    String pitch = "[";
+    String roll = "[";
+    String parked = "";
+    uint32_t t0 = 0;
+    uint32_t previousMs = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const HistorySample* sample = getHistorySample(first + i);
+        if (i == 0) {
+            t0 = sample->timeMs;
+            previousMs = t0;
+        } else {
+            dt += ",";
+            pitch += ",";
+            roll += ",";
+        }
+        dt += String(sample->timeMs - previousMs);
+        pitch += String(sample->pitch, 2);
+        roll += String(sample->roll, 2);
+        parked += sample->parked ? '1' : '0';
+        previousMs = sample->timeMs;
+    }
+    
+    json.add("first", (unsigned long)first);
+    json.add("count", (unsigned long)count);
+    json.add("next", (unsigned long)(first + count));
+    json.add("more", count < available);
+    json.add("missed", (unsigned long)missed);
+    json.add("t0", (unsigned long)t0);
+    json.addRaw("dt", dt + "]");
+    json.addRaw("pitch", pitch + "]");
+    json.addRaw("roll", roll + "]");
+    json.add("parked", parked);
+    sendSerialJSONResponse(json.build());
+}
+
+void handleBurstCaptureCommand(String command) {
+    // Formats: <1E> status, <1EFFFFNNNN> capture, <1ER> resend
+    if (getVibrationState() != VIBRATION_IDLE && command.length() != 2) {
+        sendSerialError("Vibration analysis in progress - burst buffer in use");
+        return;
+    }
+    
+    if (command == "1ER") {
+        if (!resendBurstCapture()) {
+            sendSerialError("No burst capture to send, or one is still in progress");
+            return;
+        }
+    } else if (command.length() == 10) {
+        String argsStr = command.substring(2);
+        for (int i = 0; i < argsStr.length(); i++) {
+            if (!isDigit(argsStr.charAt(i))) {
+                sendSerialError("Invalid burst capture format. Use <1EFFFFNNNN> with digits only");
+                return;
+            }
+        }
+        
+        int odr = argsStr.substring(0, 4).toInt();
+        int samples = argsStr.substring(4).toInt();
+        if (!isBurstOdrSupported(odr)) {
+            sendSerialError("Unsupported ODR. Use 0104, 0208, 0416, 0833 or 1666 Hz");
+            return;
+        }
+        if (samples < 1 || samples > BURST_MAX_SAMPLES) {
+            sendSerialError("Sample count out of range. Use 0001-4096");
+            return;
+        }
+        if (!startBurstCapture(odr, samples)) {
+            sendSerialError("Burst capture not started - capture already running or IMU not responding");
+            return;
+        }
+    } else if (command.length() != 2) {
+        sendSerialError("Invalid burst capture format. Use <1E>, <1EFFFFNNNN> or <1ER>");
+        return;
+    }
+    
+    BurstInfo info = getBurstInfo();
+    const char* stateName = info.state == BURST_CAPTURING ? "capturing" :
+                            info.state == BURST_SENDING ? "sending" : "idle";
+    
+    // Raw counts times these scales give g and degrees/s
+    JSONBuilder json;
+    json.add("state", stateName);
+    json.add("odr", (int)info.odrHz);
+    json.add("requested", (int)info.requestedSamples);
+    json.add("captured", (int)info.capturedSamples);
+    json.add("overrun", info.overrun);
+    json.add("periodUs", info.measuredPeriodUs, 3);
+    json.add("i2cClockHz", (unsigned long)getImuBusClock());
+    json.add("accelScaleG", imu.calcAccel(1), 7);
+    json.add("gyroScaleDps", imu.calcGyro(1), 5);
+    json.add("axes", "gx,gy,gz,ax,ay,az");
+    json.add("frameType", STREAM_FRAME_BURST);
+    sendSerialJSONResponse(json.build());
+}
+
+void handleVibrationCommand(String command) {
+    // Formats: <1F> last result, <1FFFFF> start at FFFF Hz
+    if (command.length() != 2 && command.length() != 6) {
+        sendSerialError("Invalid vibration command format. Use <1F> or <1FFFFF> (FFFF = ODR in Hz)");
+        return;
+    }
+    
+    if (command.length() == 6) {
+        String odrStr = command.substring(2);
+        for (int i = 0; i < odrStr.length(); i++) {
+            if (!isDigit(odrStr.charAt(i))) {
+                sendSerialError("Invalid ODR format. Use <1FFFFF> with digits only");
+                return;
+            }
+        }
+        
+        int odr = odrStr.toInt();
+        if (!isBurstOdrSupported(odr)) {
+            sendSerialError("Unsupported ODR. Use 0104, 0208, 0416, 0833 or 1666 Hz");
+            return;
+        }
+        if (!startVibrationAnalysis(odr)) {
+            sendSerialError("Vibration analysis not started - a capture or analysis is already running");
+            return;
+        }
+        
+        // The spectrum follows as a vibrationSpectrum notification
+        JSONBuilder json;
+        json.add("state", "capturing");
+        json.add("odr", odr);
+        json.add("windowSamples", VIBRATION_FFT_SIZE);
+        sendSerialJSONResponse(json.build());
+        return;
+    }
+    
+    if (!hasVibrationResult()) {
+        VibrationState state = getVibrationState();
+        JSONBuilder json;
+        json.add("state", state == VIBRATION_CAPTURING ? "capturing" :
+                          state == VIBRATION_TRANSFORMING ? "transforming" : "idle");
+        json.add("hasResult", false);
+        sendSerialJSONResponse(json.build());
+        return;
+    }
+    sendSerialJSONResponse(buildVibrationJSON());
+}
+
+static String noiseChannelJSON(const NoiseStats& stats, NoiseChannel channel, int decimals) {
+    String mean = "[";
+    String stddev = "[";
+    String count = "[";
+    for (int w = 0; w < NOISE_WINDOW_COUNT; w++) {
+        NoiseWindowResult window = noiseStatsWindow(stats, channel, w);
+        if (w > 0) {
+            mean += ",";
+            stddev += ",";
+            count += ",";
+        }
+        mean += String(window.mean, decimals);
+        stddev += String(window.stddev, decimals + 1);
+        count += String(window.count);
+    }
+    
+    // Levels without enough samples yet are null
+    String adev = "[";
+    for (int level = 0; level < NOISE_ALLAN_LEVELS; level++) {
+        float deviation;
+        if (level > 0) adev += ",";
+        adev += noiseStatsAllan(stats, channel, level, deviation) ? String(deviation, decimals + 1) : String("null");
+    }
+    
+    JSONBuilder json;
+    json.addRaw("mean", mean + "]");
+    json.addRaw("stddev", stddev + "]");
+    json.addRaw("count", count + "]");
+    json.addRaw("adev", adev + "]");
+    return json.build();
+}
+
+void handleNoiseStatsCommand(String command) {
+    // Formats: <20> read, <20R> reset
+    if (command.length() == 3 && command.charAt(2) == 'R') {
+        resetNoiseStats();
+        JSONBuilder json;
+        json.add("reset", true);
+        sendSerialJSONResponse(json.build());
+        return;
+    }
+    if (command.length() != 2) {
+        sendSerialError("Invalid noise statistics command format. Use <20> or <20R>");
+        return;
+    }
+    
+    const NoiseStats& stats = getNoiseStats();
+    String windowSec = "[";
+    for (int w = 0; w < NOISE_WINDOW_COUNT; w++) {
+        if (w > 0) windowSec += ",";
+        windowSec += String(NOISE_WINDOW_SAMPLES[w] / 20);  // 20Hz sensor loop
+    }
+    String tauSec = "[";
+    for (int level = 0; level < NOISE_ALLAN_LEVELS; level++) {
+        if (level > 0) tauSec += ",";
+        tauSec += String((1u << level) * 0.05, 2);
+    }
+    
+    // Angles in degrees, accelerations in g; all from unfiltered samples
+    JSONBuilder json;
+    json.add("samples", (unsigned long)stats.samples);
+    json.addRaw("windowSec", windowSec + "]");
+    json.addRaw("allanTauSec", tauSec + "]");
+    json.addRaw("pitch", noiseChannelJSON(stats, NOISE_PITCH, 4));
+    json.addRaw("roll", noiseChannelJSON(stats, NOISE_ROLL, 4));
+    json.addRaw("ax", noiseChannelJSON(stats, NOISE_ACCEL_X, 5));
+    json.addRaw("ay", noiseChannelJSON(stats, NOISE_ACCEL_Y, 5));
+    json.addRaw("az", noiseChannelJSON(stats, NOISE_ACCEL_Z, 5));
+    sendSerialJSONResponse(json.build());
+}
+
+static String profileStageJSON(const ProfileStats& stats) {
+    // Histogram up to the highest occupied bucket; bucket k is [2^k, 2^(k+1)) ticks
+    int buckets = PROFILE_BUCKETS;
+    while (buckets > 0 && stats.histogram[buckets - 1] == 0) buckets--;
+    String histogram = "[";
+    for (int i = 0; i < buckets; i++) {
+        if (i > 0) histogram += ",";
+        histogram += String((unsigned long)stats.histogram[i]);
+    }
+    
+    float mean = stats.count > 0 ? (float)stats.totalTicks / stats.count : 0.0;
+    JSONBuilder json;
+    json.add("count", (unsigned long)stats.count);
+    json.add("minUs", stats.minTicks / PROFILE_TICKS_PER_US, 2);
+    json.add("meanUs", mean / PROFILE_TICKS_PER_US, 2);
+    json.add("maxUs", stats.maxTicks / PROFILE_TICKS_PER_US, 2);
+    json.add("totalMs", (float)(stats.totalTicks / PROFILE_TICKS_PER_US / 1000.0), 1);
+    json.addRaw("log2Hist", histogram + "]");
+    return json.build();
+}
+
+void handleProfileCommand(String command) {
+    // Formats: <21> dump, <21R> dump and reset
+    bool reset = command.length() == 3 && command.charAt(2) == 'R';
+    if (command.length() != 2 && !reset) {
+        sendSerialError("Invalid profile command format. Use <21> or <21R>");
+        return;
+    }
+    
+    // The response itself is built inside the command stage, so it lands in the next window
+    JSONBuilder json;
+    json.add("enabled", PROFILING != 0);
+    json.add("ticksPerUs", PROFILE_TICKS_PER_US, 1);
+    json.add("windowMs", millis() - profileResetMs);
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        json.addRaw(PROFILE_STAGE_NAMES[i], profileStageJSON(getProfileStats((ProfileStage)i)));
+    }
+    sendSerialJSONResponse(json.build());
+    
+    if (reset) {
+        profilerReset();
+        profileResetMs = millis();
+    }
+}
+
+static String latencyPercentiles(const LatencyHistogram& histogram) {
+    return "[" + String((unsigned long)latencyHistogramPercentile(histogram, 50.0)) + "," +
+           String((unsigned long)latencyHistogramPercentile(histogram, 99.0)) + "," +
+           String((unsigned long)histogram.maxUs) + "]";
+}
+
+void handleCommandLatencyCommand(String command) {
+    // Formats: <22> report, <22R> reset
+    if (command.length() == 3 && command.charAt(2) == 'R') {
+        commandLatencyReset();
+        JSONBuilder json;
+        json.add("reset", true);
+        sendSerialJSONResponse(json.build());
+        return;
+    }
+    if (command.length() != 2) {
+        sendSerialError("Invalid command latency format. Use <22> or <22R>");
+        return;
+    }
+    
+    // One object per opcode seen; each phase is [p50, p99, max] in microseconds.
+    // This command's own latency is recorded after the report is built.
+    JSONBuilder opcodes;
+    for (size_t i = 0; i < getLatencyOpcodeCount(); i++) {
+        const OpcodeLatency& entry = getOpcodeLatency(i);
+        JSONBuilder phases;
+        phases.add("count", (unsigned long)entry.phases[LATENCY_TOTAL].count);
+        phases.addRaw("total", latencyPercentiles(entry.phases[LATENCY_TOTAL]));
+        phases.addRaw("queue", latencyPercentiles(entry.phases[LATENCY_QUEUE]));
+        phases.addRaw("handler", latencyPercentiles(entry.phases[LATENCY_HANDLER]));
+        phases.addRaw("serialize", latencyPercentiles(entry.phases[LATENCY_SERIALIZE]));
+        opcodes.addRaw(entry.opcode, phases.build());
+    }
+    
+    JSONBuilder json;
+    json.add("units", "us");
+    json.add("fields", "p50,p99,max");
+    json.addRaw("opcodes", opcodes.build());
+    json.add("untracked", (unsigned long)getLatencyUntrackedCommands());
+    sendSerialJSONResponse(json.build());
+}
+
+static String stackJSON(const StackStats& stack) {
+    if (!stack.available) return "null";
+    JSONBuilder json;
+    json.add("size", (unsigned long)stack.sizeBytes);
+    json.add("peak", (unsigned long)stack.peakBytes);
+    json.add("headroom", (unsigned long)(stack.sizeBytes - stack.peakBytes));
+    return json.build();
+}
+
+void handleMemoryStatsCommand(String command) {
+    if (command.length() != 2) {
+        sendSerialError("Invalid memory command format. Use <23>");
+        return;
+    }
+    
+    HeapStats heap = getHeapStats(true);
+    JSONBuilder heapJson;
+    heapJson.add("used", (unsigned long)heap.usedBytes);
+    heapJson.add("peak", (unsigned long)heap.peakBytes);
+    heapJson.add("size", (unsigned long)heap.sizeBytes);
+    heapJson.add("free", (unsigned long)heap.freeBytes);
+    if (heap.sizeBytes > 0) {
+        heapJson.add("largestFree", (unsigned long)heap.largestFreeBlock);
+        // Share of free memory not usable as one block
+        float fragmentation = heap.freeBytes > 0 ? 100.0 * (1.0 - (float)heap.largestFreeBlock / heap.freeBytes) : 0.0;
+        heapJson.add("fragmentationPct", fragmentation, 1);
+    } else {
+        // No heap bounds to probe against (host builds)
+        heapJson.addRaw("largestFree", "null");
+        heapJson.addRaw("fragmentationPct", "null");
+    }
+    heapJson.add("countsAllocations", heap.countsAllocations);
+    heapJson.add("allocations", (unsigned long)heap.allocations);
+    heapJson.add("failures", (unsigned long)heap.failures);
+    
+    const TxBufferStats& tx = SerialTx.getStats();
+    JSONBuilder buffers;
+    buffers.add("txUsed", (unsigned long)SerialTx.used());
+    buffers.add("txHighWater", (unsigned long)tx.highWater);
+    buffers.add("txSize", TX_BUFFER_SIZE);
+    buffers.add("usbRxPending", usbTransport.available());
+    buffers.add("commandSize", 32);  // MAX_COMMAND_LENGTH
+    
+    // Heap allocations per run of each opcode seen by the latency tracker: [mean, max]
+    JSONBuilder perCommand;
+    for (size_t i = 0; i < getLatencyOpcodeCount(); i++) {
+        const OpcodeLatency& entry = getOpcodeLatency(i);
+        uint32_t runs = entry.phases[LATENCY_TOTAL].count;
+        float mean = runs > 0 ? (float)entry.allocations / runs : 0.0;
+        perCommand.addRaw(entry.opcode, "[" + String(mean, 1) + "," + String((unsigned long)entry.maxAllocations) + "]");
+    }
+    
+    JSONBuilder json;
+    json.addRaw("heap", heapJson.build());
+    json.addRaw("mainStack", stackJSON(getMainStackStats()));
+    json.addRaw("isrStack", stackJSON(getInterruptStackStats()));
+    json.addRaw("buffers", buffers.build());
+    json.addRaw("commandAllocations", perCommand.build());
+    sendSerialJSONResponse(json.build());
+}
+
+static void sendLogStatus() {
+    TraceStats stats = getTraceStats();
+    JSONBuilder trace;
+    trace.add("records", (unsigned long)stats.records);
+    trace.add("bytes", (unsigned long)stats.bytes);
+    trace.add("size", TRACE_BUFFER_SIZE);
+    trace.add("written", (unsigned long)stats.written);
+    trace.add("overwritten", (unsigned long)stats.overwritten);
+    trace.add("dropped", (unsigned long)stats.dropped);
+    trace.add("dumping", isTraceDumpActive());
+    
+    JSONBuilder json;
+    json.add("debugEnabled", DEBUG_ENABLED);
+    json.add("level", (int)logLevel);
+    json.add("compiledLevel", LOG_COMPILE_LEVEL);
+    json.add("mode", logTraceMode ? "trace" : "text");
+    json.addRaw("trace", trace.build());
+    sendSerialJSONResponse(json.build());
+}
+
+void handleLogControlCommand(String command) {
+    // Formats: <24> status, <24LN> level, <24TM> trace mode, <24D> dump
+    if (command.length() == 2) {
+        sendLogStatus();
+        return;
+    }
+    
+    char action = command.charAt(2);
+    if (command.length() == 4 && action == 'L') {
+        char level = command.charAt(3);
+        if (level < '0' || level > '4') {
+            sendSerialError("Invalid log level. Use <24L0> to <24L4>");
+            return;
+        }
+        logLevel = level - '0';
+        sendLogStatus();
+        return;
+    }
+    
+    if (command.length() == 4 && action == 'T') {
+        char mode = command.charAt(3);
+        if (mode != '0' && mode != '1') {
+            sendSerialError("Invalid log mode. Use <24T0> (text) or <24T1> (trace)");
+            return;
+        }
+        logTraceMode = (mode == '1');
+        // Trace mode is quiet on the link, so it can stay on in normal use
+        if (logTraceMode) DEBUG_ENABLED = true;
+        sendLogStatus();
+        return;
+    }
+    
+    if (command.length() == 3 && action == 'D') {
+        if (isTraceDumpActive()) {
+            sendSerialError("Trace dump already in progress");
+            return;
+        }
+        // Frames follow the response; a traceDumpComplete notification ends the dump
+        TraceStats stats = getTraceStats();
+        JSONBuilder json;
+        json.add("bytes", (unsigned long)stats.bytes);
+        json.add("records", (unsigned long)stats.records);
+        json.add("overwritten", (unsigned long)stats.overwritten);
+        sendSerialJSONResponse(json.build());
+        startTraceDump();
+        return;
+    }
+    
+    sendSerialError("Invalid log command format. Use <24>, <24LN>, <24TM> or <24D>");
+}
+
+static void sendSampleReplayStatus() {
+    const SampleReplayStats& stats = getSampleReplayStats();
+    JSONBuilder json;
+    json.add("recording", stats.recording);
+    json.add("recorded", (unsigned long)stats.recorded);
+    json.add("recordDropped", (unsigned long)stats.recordDropped);
+    json.add("replaying", stats.replaying);
+    json.add("replayed", (unsigned long)stats.replayed);
+    json.add("replayTime", (unsigned long)stats.replayTimeMs);
+    sendSerialJSONResponse(json.build());
+}
+
+static String floatTripleJSON(const float values[3], int decimals) {
+    return "[" + String(values[0], decimals) + "," + String(values[1], decimals) + "," +
+           String(values[2], decimals) + "]";
+}
+
+static void sendPipelineState() {
+    PipelineState state = getPipelineState();
+    JSONBuilder json;
+    json.add("time", (unsigned long)state.sampleMs);
+    json.addRaw("counts", "[" + String(state.counts[0]) + "," + String(state.counts[1]) + "," +
+                String(state.counts[2]) + "]");
+    json.add("failed", state.failed);
+    json.addRaw("accel", floatTripleJSON(state.accel, 5));
+    json.addRaw("filtered", floatTripleJSON(state.filtered, 5));
+    json.add("magnitude", state.magnitude, 5);
+    json.add("pitch", state.pitch, 4);
+    json.add("roll", state.roll, 4);
+    json.add("unfilteredPitch", state.unfilteredPitch, 4);
+    json.add("unfilteredRoll", state.unfilteredRoll, 4);
+    json.add("parked", state.parked);
+    json.add("pendingParked", state.pendingParked);
+    json.add("pendingMs", (unsigned long)state.pendingMs);
+    json.add("llr", state.sprtLlr, 4);
+    json.add("noiseSigma", state.noiseSigma, 5);
+    sendSerialJSONResponse(json.build());
+}
+
+static bool isHexField(const String& field) {
+    for (unsigned int i = 0; i < field.length(); i++) {
+        if (!isHexadecimalDigit(field.charAt(i))) return false;
+    }
+    return field.length() > 0;
+}
+
+// Recording header being uploaded in <25HOO...> chunks, applied by <25HA>
+static ReplayHeader uploadedHeader;
+
+void handleSampleReplayCommand(String command) {
+    // Formats: <25> status, <25RM> record, <25PM> replay mode, <25HOODD..> /
+    // <25HA> upload and apply the recording header,
+    // <25SXXXXYYYYZZZZTTTT> replay a sample, <25SETTTT> replay a failed read
+    if (command.length() == 2) {
+        sendSampleReplayStatus();
+        return;
+    }
+    
+    char action = command.charAt(2);
+    if (command.length() == 4 && action == 'R') {
+        char mode = command.charAt(3);
+        if (mode != '0' && mode != '1') {
+            sendSerialError("Invalid record mode. Use <25R1> (start) or <25R0> (stop)");
+            return;
+        }
+        if (mode == '1') {
+            if (isReplayActive()) {
+                sendSerialError("Cannot record while replaying. Use <25P0> first");
+                return;
+            }
+            // The header frame carries the calibration and decider state the samples start from
+            if (!startSampleRecording()) {
+                sendSerialError("TX buffer full, recording not started");
+                return;
+            }
+        } else {
+            stopSampleRecording();
+        }
+        sendSampleReplayStatus();
+        return;
+    }
+    
+    if (command.length() == 4 && action == 'P') {
+        char mode = command.charAt(3);
+        if (mode != '0' && mode != '1') {
+            sendSerialError("Invalid replay mode. Use <25P1> (enter) or <25P0> (leave)");
+            return;
+        }
+        if (mode == '1') {
+            stopSampleRecording();
+            startSampleReplay(millis());
+            memset(&uploadedHeader, 0, sizeof(uploadedHeader));
+        } else {
+            stopSampleReplay();
+        }
+        sendSampleReplayStatus();
+        return;
+    }
+    
+    if (action == 'H') {
+        if (!isReplayActive()) {
+            sendSerialError("Replay mode is off. Use <25P1> first");
+            return;
+        }
+        
+        if (command.length() == 4 && command.charAt(3) == 'A') {
+            if (!loadReplayHeader(uploadedHeader)) {
+                sendSerialError("Invalid replay header, or recorded with another accelerometer scale");
+                return;
+            }
+            sendSampleReplayStatus();
+            return;
+        }
+        
+        // Two hex digits of offset, then 1-12 bytes as hex pairs
+        String offsetStr = command.substring(3, 5);
+        String dataStr = command.length() > 5 ? command.substring(5) : "";
+        size_t offset = isHexField(offsetStr) ? (size_t)strtol(offsetStr.c_str(), NULL, 16) : REPLAY_HEADER_SIZE;
+        size_t length = dataStr.length() / 2;
+        if (command.length() < 7 || dataStr.length() % 2 != 0 || length > 12 || !isHexField(dataStr) ||
+            offset + length > REPLAY_HEADER_SIZE) {
+            sendSerialError("Invalid replay header chunk. Use <25HOODD..> (hex offset, up to 12 hex bytes) or <25HA>");
+            return;
+        }
+        uint8_t* bytes = (uint8_t*)&uploadedHeader;
+        for (size_t i = 0; i < length; i++) {
+            bytes[offset + i] = (uint8_t)strtol(dataStr.substring(i * 2, i * 2 + 2).c_str(), NULL, 16);
+        }
+        JSONBuilder json;
+        json.add("headerOffset", (unsigned long)offset);
+        json.add("headerBytes", (unsigned long)length);
+        sendSerialJSONResponse(json.build());
+        return;
+    }
+    
+    if (action == 'S' && (command.length() == 19 || command.length() == 8)) {
+        if (!isReplayActive()) {
+            sendSerialError("Replay mode is off. Use <25P1> first");
+            return;
+        }
+        
+        ReplaySample sample;
+        sample.failed = (command.length() == 8);
+        String countsStr = sample.failed ? "" : command.substring(3, 15);
+        String deltaStr = command.substring(command.length() - 4);
+        if ((sample.failed && command.charAt(3) != 'E') ||
+            (!sample.failed && !isHexField(countsStr)) || !isHexField(deltaStr)) {
+            sendSerialError("Invalid replay sample. Use <25SXXXXYYYYZZZZTTTT> or <25SETTTT> (hex)");
+            return;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            sample.counts[axis] = sample.failed ? 0 :
+                (int16_t)strtol(countsStr.substring(axis * 4, axis * 4 + 4).c_str(), NULL, 16);
+        }
+        sample.timeMs = getSampleReplayStats().replayTimeMs + (uint32_t)strtol(deltaStr.c_str(), NULL, 16);
+        
+        replaySample(sample);
+        sendPipelineState();
+        return;
+    }
+    
+    sendSerialError("Invalid replay command format. Use <25>, <25RM>, <25PM>, <25H...> or <25S...>");
+}
+
+#define BENCH_DEVICE_BATCHES 15
+#define BENCH_DEVICE_BATCH_US 2000      // Long enough to swamp the timer read, short enough to keep the loop responsive
+
+void handleBenchmarkCommand(String command) {
+    // Formats: <26> list, <26NN> run case NN
+    if (command.length() == 2) {
+        String cases = "[";
+        for (size_t i = 0; i < getBenchCaseCount(); i++) {
+            const BenchCase& bench = getBenchCase(i);
+            JSONBuilder entry;
+            entry.add("id", (int)i);
+            entry.add("name", bench.name);
+            entry.add("device", (bench.flags & BENCH_HOST_ONLY) == 0);
+            if (i > 0) cases += ",";
+            cases += entry.build();
+        }
+        JSONBuilder json;
+        json.addRaw("cases", cases + "]");
+        sendSerialJSONResponse(json.build());
+        return;
+    }
+    
+    String idStr = command.substring(2);
+    if (idStr.length() != 2 || !isHexadecimalDigit(idStr.charAt(0)) || !isHexadecimalDigit(idStr.charAt(1))) {
+        sendSerialError("Invalid benchmark command format. Use <26> or <26NN> (NN = hex case id)");
+        return;
+    }
+    size_t id = (size_t)strtol(idStr.c_str(), NULL, 16);
+    if (id >= getBenchCaseCount()) {
+        sendSerialError("Unknown benchmark case. Use <26> for the list");
+        return;
+    }
+    const BenchCase& bench = getBenchCase(id);
+    if (bench.flags & BENCH_HOST_ONLY) {
+        sendSerialError("Benchmark case runs on the host only (tools/bench)");
+        return;
+    }
+    
+    if (bench.setup != NULL) bench.setup();
+    uint32_t iterations = benchCalibrate(bench, (uint32_t)(BENCH_DEVICE_BATCH_US * PROFILE_TICKS_PER_US));
+    uint32_t batchTicks[BENCH_DEVICE_BATCHES];
+    benchMeasure(bench, iterations, batchTicks, BENCH_DEVICE_BATCHES);
+    if (bench.teardown != NULL) bench.teardown();
+    
+    // Median batch, which shrugs off the odd interrupt-heavy one
+    for (int i = 1; i < BENCH_DEVICE_BATCHES; i++) {
+        uint32_t value = batchTicks[i];
+        int j = i - 1;
+        while (j >= 0 && batchTicks[j] > value) {
+            batchTicks[j + 1] = batchTicks[j];
+            j--;
+        }
+        batchTicks[j + 1] = value;
+    }
+    
+    JSONBuilder json;
+    json.add("id", (int)id);
+    json.add("name", bench.name);
+    json.add("iterations", (unsigned long)iterations);
+    json.add("batches", BENCH_DEVICE_BATCHES);
+    json.add("ticksPerUs", PROFILE_TICKS_PER_US, 1);
+    json.add("minPerOp", (float)batchTicks[0] / iterations, 1);
+    json.add("medianPerOp", (float)batchTicks[BENCH_DEVICE_BATCHES / 2] / iterations, 1);
+    json.add("maxPerOp", (float)batchTicks[BENCH_DEVICE_BATCHES - 1] / iterations, 1);
+    json.add("medianUsPerOp", (float)batchTicks[BENCH_DEVICE_BATCHES / 2] / iterations / PROFILE_TICKS_PER_US, 3);
+    sendSerialJSONResponse(json.build());
+}
+
+void handleSessionsCommand() {
+    String list = "[";
+    for (int i = 0; i < sessionCount; i++) {
+        CommandSession& session = *sessions[i];
+        const TxBufferStats& tx = session.tx.getStats();
+        unsigned long dropped = 0;
+        for (int cls = 0; cls < TX_CLASS_COUNT; cls++) dropped += tx.messagesDropped[cls];
+        
+        JSONBuilder entry;
+        entry.add("id", i);
+        entry.add("transport", session.transport->name());
+        entry.add("connected", session.transport->connected());
+        entry.add("commands", session.commands);
+        entry.add("rxBytes", session.rxBytes);
+        entry.add("txPending", (unsigned long)session.tx.used());
+        entry.add("txFlushed", tx.bytesFlushed);
+        entry.add("txDropped", dropped);
+        if (i > 0) list += ",";
+        list += entry.build();
+    }
+    
+    JSONBuilder json;
+    json.add("current", SerialTx.getSelected());
+    json.add("maxSessions", MAX_COMMAND_SESSIONS);
+    json.addRaw("sessions", list + "]");
+    sendSerialJSONResponse(json.build());
+}
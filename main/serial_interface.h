@@ -4,6 +4,8 @@
 #include "Debug.h"
 #include "constants.h"
 #include "Arduino.h"
+#include "transport.h"
+#include "tx_buffer.h"
 
 // Command definitions (2-character hex codes) - Updated for XIAO Sense
 #define CMD_HELP "00"
@@ -29,14 +31,61 @@
 #define CMD_STORAGE_TEST "12"         // Test persistent storage
 #define CMD_SENSOR_DIAGNOSTIC "13"    // Comprehensive sensor diagnostic
 
+// Telemetry streaming commands
+#define CMD_SUBSCRIBE "14"            // Start unsolicited telemetry stream
+#define CMD_UNSUBSCRIBE "15"          // Stop telemetry stream and report counters
+#define CMD_TX_STATUS "16"            // TX buffer counters and full-buffer policy
+
+// Park detection tuning commands
+#define CMD_SET_HYSTERESIS "17"       // Set park exit hysteresis margin
+#define CMD_SET_PARK_DWELL "18"       // Set park enter/exit dwell times
+#define CMD_PARK_DECISION_MODE "19"   // Select threshold or sequential-test park decision
+
+// Storage commands
+#define CMD_STORAGE_SYNC "1A"         // Commit pending settings, write-behind mode, counters
+
+// Sample log commands
+#define CMD_SAMPLE_LOG "1B"           // Sample log status and decimation
+#define CMD_LOG_DOWNLOAD "1C"         // Stream sample log blocks as binary frames
+#define CMD_SAMPLE_HISTORY "1D"       // Recent samples from the RAM history ring
+#define CMD_BURST_CAPTURE "1E"        // Raw high-ODR accel/gyro capture
+#define CMD_VIBRATION_SPECTRUM "1F"   // On-device vibration spectrum
+#define CMD_NOISE_STATS "20"          // Windowed standard deviation and Allan deviation
+#define CMD_PROFILE "21"              // Main loop stage timing
+#define CMD_COMMAND_LATENCY "22"      // Per-opcode command latency percentiles
+#define CMD_MEMORY_STATS "23"         // Heap, stack and serial buffer usage
+#define CMD_LOG_CONTROL "24"          // Log level, binary trace mode and trace dump
+#define CMD_SAMPLE_REPLAY "25"        // Record raw samples / replay them through the pipeline
+#define CMD_BENCHMARK "26"            // Run a microbenchmark case, cycles per operation
+#define CMD_SESSIONS "27"             // Transports served and their session counters
+
 // Response codes
 #define RESP_OK "OK"
 #define RESP_ERROR "ERROR"
 #define RESP_INVALID "INVALID"
 
+// A link served by the command engine. Each session frames its own <...>
+// commands and queues its own output, so a command half-received on one
+// link never mixes with another and a slow link only fills its own ring.
+struct CommandSession {
+    Transport* transport;
+    TxBuffer tx;
+    String rxBuffer;
+    bool inCommand;
+    bool commandReady;
+    unsigned long rxBytes;
+    unsigned long commands;
+
+    CommandSession() : transport(NULL), inCommand(false), commandReady(false), rxBytes(0), commands(0) {}
+};
+
 // Function prototypes
 void initSerial();
 void handleSerialCommands();
+int addCommandSession(CommandSession& session, Transport& transport);  // Session index, -1 when full
+int getCommandSessionCount();
+CommandSession& getCommandSession(int index);
+bool hasTransport(const char* name);
 void processSerialCommand(String command);
 void sendSerialResponse(String response);
 void sendSerialError(String error);
@@ -67,4 +116,32 @@ void handleRawSensorDataCommand();    // Get raw sensor readings
 void handleStorageTestCommand();      // Test persistent storage
 void handleSensorDiagnosticCommand(); // Comprehensive sensor diagnostic
 
+// Telemetry streaming command handlers
+void handleSubscribeCommand(String command);  // Start telemetry stream
+void handleUnsubscribeCommand();              // Stop telemetry stream
+void handleTxStatusCommand(String command);   // TX buffer counters / policy
+
+// Park detection tuning command handlers
+void handleSetHysteresisCommand(String command);  // Set park exit hysteresis
+void handleSetParkDwellCommand(String command);   // Set park enter/exit dwell times
+void handleParkDecisionModeCommand(String command);  // Threshold vs sequential test
+
+// Storage command handlers
+void handleStorageSyncCommand(String command);  // Sync settings / write-behind mode
+
+// Sample log command handlers
+void handleSampleLogCommand(String command);    // Log status / set decimation
+void handleLogDownloadCommand(String command);  // Start a block download
+void handleSampleHistoryCommand(String command);  // Samples since a sequence / over the last T ms
+void handleBurstCaptureCommand(String command);   // Start / resend / status of a raw burst capture
+void handleVibrationCommand(String command);      // Start a spectrum / read the last one
+void handleNoiseStatsCommand(String command);     // Read / reset the noise statistics
+void handleProfileCommand(String command);        // Dump / dump and reset the stage profile
+void handleCommandLatencyCommand(String command); // Latency report / reset
+void handleMemoryStatsCommand(String command);    // Heap, stacks, buffers and per-command allocations
+void handleLogControlCommand(String command);     // Log level / trace mode / trace dump
+void handleSampleReplayCommand(String command);   // Record / replay raw accelerometer samples
+void handleBenchmarkCommand(String command);      // List / run microbenchmark cases
+void handleSessionsCommand();                     // Transports and per-session counters
+
 #endif // SERIAL_INTERFACE_H
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "settings_registry.h"
+#include "flash_storage.h"
+#include <string.h>
+#include <math.h>
+
+static_assert(SETTING_COUNT <= 32, "storedMask holds one bit per setting");
+
+SettingValue settingValues[SETTING_COUNT];
+static uint32_t storedMask = 0;
+
+static bool isValueInRange(SettingId id, SettingValue value) {
+    const SettingDescriptor& descriptor = SETTINGS_SCHEMA[id];
+    if (descriptor.type == SETTING_TYPE_FLOAT) {
+        return !isnan(value.f) && value.f >= descriptor.minValue.f && value.f <= descriptor.maxValue.f;
+    }
+    return value.u >= descriptor.minValue.u && value.u <= descriptor.maxValue.u;
+}
+
+static bool setSettingValue(SettingId id, SettingValue value) {
+    if (id >= SETTING_COUNT || !isValueInRange(id, value)) return false;
+    
+    storedMask |= (1UL << id);
+    if (settingValues[id].u == value.u) return true;  // Unchanged values never reach flash
+    
+    settingValues[id] = value;
+    return onSettingChanged(id);
+}
+
+float getSettingFloat(SettingId id) {
+    if (id >= SETTING_COUNT || SETTINGS_SCHEMA[id].type != SETTING_TYPE_FLOAT) return 0.0;
+    return settingValues[id].f;
+}
+
+uint32_t getSettingUint(SettingId id) {
+    if (id >= SETTING_COUNT || SETTINGS_SCHEMA[id].type != SETTING_TYPE_UINT32) return 0;
+    return settingValues[id].u;
+}
+
+bool setSettingFloat(SettingId id, float value) {
+    if (id >= SETTING_COUNT || SETTINGS_SCHEMA[id].type != SETTING_TYPE_FLOAT) return false;
+    return setSettingValue(id, SettingValue(value));
+}
+
+bool setSettingUint(SettingId id, uint32_t value) {
+    if (id >= SETTING_COUNT || SETTINGS_SCHEMA[id].type != SETTING_TYPE_UINT32) return false;
+    return setSettingValue(id, SettingValue(value));
+}
+
+bool isSettingStored(SettingId id) {
+    return id < SETTING_COUNT && (storedMask & (1UL << id)) != 0;
+}
+
+const char* getSettingName(SettingId id) {
+    return id < SETTING_COUNT ? SETTINGS_SCHEMA[id].name : "unknown";
+}
+
+void resetSettingsToDefaults() {
+    for (uint8_t id = 0; id < SETTING_COUNT; id++) {
+        settingValues[id] = SETTINGS_SCHEMA[id].defaultValue;
+    }
+    storedMask = 0;
+}
+
+size_t encodeSettingsPayload(uint8_t* payload, size_t capacity) {
+    size_t length = SETTING_COUNT * sizeof(SettingValue);
+    if (length > capacity) return 0;
+    memcpy(payload, settingValues, length);
+    return length;
+}
+
+// Load one stored word, falling back to the default if it is out of range
+static void loadStoredValue(SettingId id, SettingValue value) {
+    if (isValueInRange(id, value)) {
+        settingValues[id] = value;
+        storedMask |= (1UL << id);
+    } else {
+        settingValues[id] = SETTINGS_SCHEMA[id].defaultValue;
+    }
+}
+
+// v1: the TelescopeSettings struct image written by earlier firmware
+static bool migrateSettingsV1(const uint8_t* payload, size_t length) {
+    if (length != sizeof(TelescopeSettings)) return false;
+    
+    TelescopeSettings legacy;
+    memcpy(&legacy, payload, sizeof(legacy));
+    
+    loadStoredValue(SETTING_PARK_PITCH, SettingValue(legacy.parkPitch));
+    loadStoredValue(SETTING_PARK_ROLL, SettingValue(legacy.parkRoll));
+    loadStoredValue(SETTING_TOLERANCE, SettingValue(legacy.tolerance));
+    loadStoredValue(SETTING_CAL_AX_OFFSET, SettingValue(legacy.cal_ax_offset));
+    loadStoredValue(SETTING_CAL_AY_OFFSET, SettingValue(legacy.cal_ay_offset));
+    loadStoredValue(SETTING_CAL_AZ_OFFSET, SettingValue(legacy.cal_az_offset));
+    loadStoredValue(SETTING_CAL_GX_OFFSET, SettingValue(legacy.cal_gx_offset));
+    loadStoredValue(SETTING_CAL_GY_OFFSET, SettingValue(legacy.cal_gy_offset));
+    loadStoredValue(SETTING_CAL_GZ_OFFSET, SettingValue(legacy.cal_gz_offset));
+    loadStoredValue(SETTING_CAL_TIMESTAMP, SettingValue(legacy.cal_timestamp));
+    return true;
+}
+
+// v2: one 32-bit word per SettingId. Shorter payloads come from firmware
+// that had fewer settings; the missing ones keep their defaults.
+static bool decodeSettingsV2(const uint8_t* payload, size_t length) {
+    if (length % sizeof(SettingValue) != 0) return false;
+    
+    size_t count = length / sizeof(SettingValue);
+    if (count > SETTING_COUNT) count = SETTING_COUNT;
+    
+    for (size_t id = 0; id < count; id++) {
+        SettingValue value;
+        memcpy(&value, payload + id * sizeof(SettingValue), sizeof(SettingValue));
+        loadStoredValue((SettingId)id, value);
+    }
+    return true;
+}
+
+bool decodeSettingsPayload(uint16_t version, const uint8_t* payload, size_t length) {
+    resetSettingsToDefaults();
+    
+    switch (version) {
+        case 1:
+            return migrateSettingsV1(payload, length);
+        case SETTINGS_SCHEMA_VERSION:
+            return decodeSettingsV2(payload, length);
+        default:
+            // Written by newer firmware - leave it alone and use defaults
+            return false;
+    }
+}
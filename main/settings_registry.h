@@ -0,0 +1,126 @@
+#ifndef SETTINGS_REGISTRY_H
+#define SETTINGS_REGISTRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Typed settings registry. Each setting has a fixed numeric ID with its type,
+// default and valid range in SETTINGS_SCHEMA, so lookups are a plain array
+// index and typos are compile errors instead of silently ignored strings.
+//
+// IDs are part of the stored format: only ever append new IDs before
+// SETTING_COUNT. Records written before a setting existed load it with its
+// default. Removing or retyping a setting needs a new SETTINGS_SCHEMA_VERSION
+// and a migration step in decodeSettingsPayload().
+
+#define SETTINGS_SCHEMA_VERSION 2   // v1 was the TelescopeSettings struct image
+
+enum SettingId : uint8_t {
+    SETTING_PARK_PITCH = 0,
+    SETTING_PARK_ROLL,
+    SETTING_TOLERANCE,
+    SETTING_CAL_AX_OFFSET,
+    SETTING_CAL_AY_OFFSET,
+    SETTING_CAL_AZ_OFFSET,
+    SETTING_CAL_GX_OFFSET,
+    SETTING_CAL_GY_OFFSET,
+    SETTING_CAL_GZ_OFFSET,
+    SETTING_CAL_TIMESTAMP,
+    SETTING_PARK_HYSTERESIS,
+    SETTING_PARK_ENTER_DWELL,
+    SETTING_PARK_EXIT_DWELL,
+    SETTING_PARK_DECISION_MODE,
+    SETTING_SPRT_FALSE_UNPARK,
+    SETTING_SPRT_FALSE_PARK,
+    SETTING_FILTER_ENABLED,
+    SETTING_FILTER_ALPHA,
+    SETTING_STORAGE_TEST,
+    SETTING_LOG_DECIMATION,
+    SETTING_COUNT
+};
+
+enum SettingType : uint8_t {
+    SETTING_TYPE_FLOAT = 0,
+    SETTING_TYPE_UINT32 = 1
+};
+
+// One stored 32-bit word, interpreted according to the setting's type
+union SettingValue {
+    float f;
+    uint32_t u;
+    constexpr SettingValue() : u(0) {}
+    constexpr SettingValue(float value) : f(value) {}
+    constexpr SettingValue(double value) : f((float)value) {}
+    constexpr SettingValue(uint32_t value) : u(value) {}
+    constexpr SettingValue(int value) : u((uint32_t)value) {}
+};
+
+struct SettingDescriptor {
+    const char* name;
+    SettingType type;
+    SettingValue defaultValue;
+    SettingValue minValue;
+    SettingValue maxValue;
+};
+
+static constexpr SettingDescriptor SETTINGS_SCHEMA[] = {
+    // name                 type                 default   min       max
+    {"parkPitch",           SETTING_TYPE_FLOAT,  0.0,      -90.0,    90.0},
+    {"parkRoll",            SETTING_TYPE_FLOAT,  0.0,      -180.0,   180.0},
+    {"tolerance",           SETTING_TYPE_FLOAT,  2.0,      0.01,     9.99},
+    {"cal_ax_offset",       SETTING_TYPE_FLOAT,  0.0,      -10.0,    10.0},
+    {"cal_ay_offset",       SETTING_TYPE_FLOAT,  0.0,      -10.0,    10.0},
+    {"cal_az_offset",       SETTING_TYPE_FLOAT,  0.0,      -10.0,    10.0},
+    {"cal_gx_offset",       SETTING_TYPE_FLOAT,  0.0,      -2000.0,  2000.0},
+    {"cal_gy_offset",       SETTING_TYPE_FLOAT,  0.0,      -2000.0,  2000.0},
+    {"cal_gz_offset",       SETTING_TYPE_FLOAT,  0.0,      -2000.0,  2000.0},
+    {"cal_timestamp",       SETTING_TYPE_UINT32, 0u,       0u,       0xFFFFFFFFu},
+    {"parkHysteresis",      SETTING_TYPE_FLOAT,  0.10,     0.0,      9.99},
+    {"parkEnterDwell",      SETTING_TYPE_UINT32, 500u,     0u,       9999u},
+    {"parkExitDwell",       SETTING_TYPE_UINT32, 200u,     0u,       9999u},
+    {"parkDecisionMode",    SETTING_TYPE_UINT32, 0u,       0u,       1u},
+    {"sprtFalseUnpark",     SETTING_TYPE_FLOAT,  0.001,    0.001,    0.5},
+    {"sprtFalsePark",       SETTING_TYPE_FLOAT,  0.001,    0.001,    0.5},
+    {"filterEnabled",       SETTING_TYPE_UINT32, 1u,       0u,       1u},
+    {"filterAlpha",         SETTING_TYPE_FLOAT,  0.2,      0.0,      1.0},
+    {"storageTest",         SETTING_TYPE_FLOAT,  0.0,      -1.0e9,   1.0e9},
+    {"logDecimation",       SETTING_TYPE_UINT32, 20u,      0u,       1200u},
+};
+
+static_assert(sizeof(SETTINGS_SCHEMA) / sizeof(SETTINGS_SCHEMA[0]) == SETTING_COUNT,
+              "SETTINGS_SCHEMA must have one entry per SettingId");
+
+// Current values, indexed by SettingId
+extern SettingValue settingValues[SETTING_COUNT];
+
+// Runtime typed access (type is checked, out-of-range values are rejected)
+float getSettingFloat(SettingId id);
+uint32_t getSettingUint(SettingId id);
+bool setSettingFloat(SettingId id, float value);
+bool setSettingUint(SettingId id, uint32_t value);
+bool isSettingStored(SettingId id);     // Loaded from flash or set since boot
+const char* getSettingName(SettingId id);
+
+// Compile-time typed access for fixed IDs
+template <SettingId ID>
+inline float getSettingFloat() {
+    static_assert(SETTINGS_SCHEMA[ID].type == SETTING_TYPE_FLOAT, "Setting is not a float");
+    return settingValues[ID].f;
+}
+
+template <SettingId ID>
+inline uint32_t getSettingUint() {
+    static_assert(SETTINGS_SCHEMA[ID].type == SETTING_TYPE_UINT32, "Setting is not an integer");
+    return settingValues[ID].u;
+}
+
+// Called by the registry whenever a value actually changes. Implemented by
+// the storage layer, which decides when the change reaches flash.
+bool onSettingChanged(SettingId id);
+
+// Stored format
+void resetSettingsToDefaults();
+size_t encodeSettingsPayload(uint8_t* payload, size_t capacity);
+bool decodeSettingsPayload(uint16_t version, const uint8_t* payload, size_t length);
+
+#endif // SETTINGS_REGISTRY_H
@@ -0,0 +1,165 @@
+#include "telemetry_stream.h"
+#include "position_sensor.h"
+#include "helpers.h"
+#include "Debug.h"
+#include "tx_buffer.h"
+#include "profiler.h"
+
+// External variables
+extern bool isParked;
+extern float currentPitch, currentRoll;
+extern unsigned long sampleSequence;
+
+static TelemetryStreamStats streamStats = {false, false, 0, 0, 0, 0, 0, 0, 0};
+static unsigned long nextEmitTime = 0;
+static unsigned long samplesSinceEmit = 0;
+static int streamSession = TX_ALL_SESSIONS;   // Session that subscribed
+
+uint8_t calculateCRC8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void putBytes(uint8_t* frame, size_t& pos, const void* value, size_t size) {
+    // nRF52840 is little endian, so values go out in host order
+    memcpy(frame + pos, value, size);
+    pos += size;
+}
+
+static size_t buildBinaryFrame(uint8_t* frame, unsigned long timestamp, float temperature) {
+    size_t pos = 4;  // Sync, sync, type, length filled in below
+    uint8_t mask = streamStats.fieldMask;
+    uint32_t t = timestamp;
+
+    putBytes(frame, pos, &mask, 1);
+    putBytes(frame, pos, &t, 4);
+    if (mask & STREAM_FIELD_PITCH) putBytes(frame, pos, &currentPitch, 4);
+    if (mask & STREAM_FIELD_ROLL) putBytes(frame, pos, &currentRoll, 4);
+    if (mask & STREAM_FIELD_GRAVITY) putBytes(frame, pos, &lastAccelMagnitude, 4);
+    if (mask & STREAM_FIELD_PARKED) {
+        uint8_t parked = isParked ? 1 : 0;
+        putBytes(frame, pos, &parked, 1);
+    }
+    if (mask & STREAM_FIELD_TEMP) {
+        int16_t centiDegrees = (int16_t)round(temperature * 100.0);
+        putBytes(frame, pos, &centiDegrees, 2);
+    }
+    if (mask & STREAM_FIELD_SEQUENCE) {
+        uint32_t seq = sampleSequence;
+        putBytes(frame, pos, &seq, 4);
+    }
+
+    frame[0] = STREAM_SYNC_BYTE_1;
+    frame[1] = STREAM_SYNC_BYTE_2;
+    frame[2] = STREAM_FRAME_TELEMETRY;
+    frame[3] = (uint8_t)(pos - 4);
+    frame[pos] = calculateCRC8(frame + 2, pos - 2);
+    return pos + 1;
+}
+
+static String buildJSONFrame(unsigned long timestamp, float temperature) {
+    uint8_t mask = streamStats.fieldMask;
+
+    JSONBuilder json;
+    json.add("t", timestamp);
+    if (mask & STREAM_FIELD_SEQUENCE) json.add("seq", sampleSequence);
+    if (mask & STREAM_FIELD_PITCH) json.add("pitch", currentPitch);
+    if (mask & STREAM_FIELD_ROLL) json.add("roll", currentRoll);
+    if (mask & STREAM_FIELD_GRAVITY) json.add("gravity", lastAccelMagnitude, 4);
+    if (mask & STREAM_FIELD_PARKED) json.add("parked", isParked);
+    if (mask & STREAM_FIELD_TEMP) json.add("temperature", temperature, 2);
+
+    return "{\"telemetry\":" + json.build() + "}";
+}
+
+static void emitTelemetryFrame() {
+    unsigned long timestamp = millis();
+    float temperature = 0.0;
+    if (streamStats.fieldMask & STREAM_FIELD_TEMP) {
+        temperature = imu.readTempC();
+    }
+
+    // Telemetry yields to command responses when the TX ring runs low
+    if (streamStats.binary) {
+        uint8_t frame[STREAM_MAX_FRAME_SIZE];
+        size_t length = buildBinaryFrame(frame, timestamp, temperature);
+        if (!SerialTx.write(frame, length, TX_CLASS_TELEMETRY)) {
+            streamStats.framesDropped++;
+            return;
+        }
+        streamStats.bytesSent += length;
+    } else {
+        String line = buildJSONFrame(timestamp, temperature);
+        if (!SerialTx.println(line, TX_CLASS_TELEMETRY)) {
+            streamStats.framesDropped++;
+            return;
+        }
+        streamStats.bytesSent += line.length() + 2;
+    }
+    streamStats.framesSent++;
+}
+
+void startTelemetryStream(uint8_t fieldMask, bool binary, unsigned long periodMs, unsigned long decimation) {
+    streamStats.active = true;
+    streamStats.binary = binary;
+    streamStats.fieldMask = fieldMask & STREAM_FIELD_ALL;
+    streamStats.periodMs = periodMs;
+    streamStats.decimation = (periodMs > 0) ? 0 : decimation;
+    streamStats.framesSent = 0;
+    streamStats.framesDropped = 0;
+    streamStats.samplesMissed = 0;
+    streamStats.bytesSent = 0;
+
+    nextEmitTime = millis();
+    samplesSinceEmit = 0;
+    streamSession = SerialTx.getSelected();
+
+    if (periodMs > 0) {
+        LOG_INFO("Telemetry stream started: mask=0x%X %s every %lums", streamStats.fieldMask, binary ? "binary" : "JSON", periodMs);
+    } else {
+        LOG_INFO("Telemetry stream started: mask=0x%X %s every %lu samples", streamStats.fieldMask, binary ? "binary" : "JSON", decimation);
+    }
+}
+
+void stopTelemetryStream() {
+    streamStats.active = false;
+    LOG_INFO("Telemetry stream stopped: sent=%lu dropped=%lu", streamStats.framesSent, streamStats.framesDropped);
+}
+
+bool isTelemetryStreamActive() {
+    return streamStats.active;
+}
+
+const TelemetryStreamStats& getTelemetryStreamStats() {
+    return streamStats;
+}
+
+void serviceTelemetryStream() {
+    PROFILE_SCOPE(PROFILE_TELEMETRY);
+    if (!streamStats.active) return;
+
+    if (streamStats.periodMs > 0) {
+        unsigned long now = millis();
+        if ((long)(now - nextEmitTime) < 0) return;
+
+        // Keep emit times on a fixed grid so samples stay evenly spaced
+        nextEmitTime += streamStats.periodMs;
+        if ((long)(now - nextEmitTime) >= 0) {
+            unsigned long behind = now - nextEmitTime;
+            streamStats.samplesMissed += behind / streamStats.periodMs + 1;
+            nextEmitTime = now + streamStats.periodMs;
+        }
+    } else {
+        if (++samplesSinceEmit < streamStats.decimation) return;
+        samplesSinceEmit = 0;
+    }
+
+    SessionScope scope(streamSession);
+    emitTelemetryFrame();
+}
@@ -0,0 +1,48 @@
+#ifndef TELEMETRY_STREAM_H
+#define TELEMETRY_STREAM_H
+
+#include "Arduino.h"
+
+// Selectable telemetry fields (bit mask, also the order of fields in binary frames)
+#define STREAM_FIELD_PITCH    0x01
+#define STREAM_FIELD_ROLL     0x02
+#define STREAM_FIELD_GRAVITY  0x04  // Accelerometer magnitude in g
+#define STREAM_FIELD_PARKED   0x08
+#define STREAM_FIELD_TEMP     0x10
+#define STREAM_FIELD_SEQUENCE 0x20
+#define STREAM_FIELD_ALL      0x3F
+
+// Binary frame layout: A5 5A <type> <len> <payload...> <crc8>
+// CRC-8 (poly 0x07) covers type, len and payload
+#define STREAM_SYNC_BYTE_1 0xA5
+#define STREAM_SYNC_BYTE_2 0x5A
+#define STREAM_FRAME_TELEMETRY 0x01
+#define STREAM_FRAME_LOG_BLOCK 0x02   // Sample log download, see sample_log.h
+#define STREAM_FRAME_BURST 0x03       // Raw burst capture, see burst_capture.h
+#define STREAM_FRAME_TRACE 0x04       // Trace ring dump, see trace_buffer.h
+#define STREAM_FRAME_REPLAY 0x05      // Raw sample recording, see sample_replay.h
+#define STREAM_MAX_FRAME_SIZE 32
+
+// Telemetry stream configuration and counters
+struct TelemetryStreamStats {
+    bool active;
+    bool binary;
+    uint8_t fieldMask;
+    unsigned long periodMs;       // 0 when running in decimation mode
+    unsigned long decimation;     // 0 when running in period mode
+    unsigned long framesSent;
+    unsigned long framesDropped;  // Link could not accept the frame
+    unsigned long samplesMissed;  // Sample loop fell behind the requested period
+    unsigned long bytesSent;
+};
+
+// Function prototypes
+void startTelemetryStream(uint8_t fieldMask, bool binary, unsigned long periodMs, unsigned long decimation);
+void stopTelemetryStream();
+bool isTelemetryStreamActive();
+void serviceTelemetryStream();   // Call once per sensor sample
+const TelemetryStreamStats& getTelemetryStreamStats();
+
+uint8_t calculateCRC8(const uint8_t* data, size_t length);
+
+#endif // TELEMETRY_STREAM_H
@@ -0,0 +1,99 @@
+#include "trace_buffer.h"
+
+static uint8_t ring[TRACE_BUFFER_SIZE];
+static size_t head = 0;              // Next byte to write
+static size_t tail = 0;              // First byte of the oldest record
+static size_t used = 0;
+static uint32_t recordCount = 0;
+static uint32_t written = 0;
+static uint32_t overwritten = 0;
+static uint32_t dropped = 0;
+static bool paused = false;
+
+TraceRecord::TraceRecord(uint8_t level, uint32_t formatId, uint32_t timeUs) : length(0), truncated(false) {
+    uint8_t header[2] = {0, level};
+    put(header, 2);
+    put(&timeUs, 4);
+    put(&formatId, 4);
+}
+
+void TraceRecord::put(const void* data, size_t size) {
+    // Arguments that do not fit are left off; the decoder stops at the record end
+    if (truncated || length + size > TRACE_MAX_RECORD) {
+        truncated = true;
+        return;
+    }
+    memcpy(bytes + length, data, size);
+    length += size;
+    bytes[0] = (uint8_t)length;
+}
+
+void TraceRecord::add(const char* text) {
+    size_t size = text != NULL ? strlen(text) : 0;
+    if (size > TRACE_MAX_STRING) size = TRACE_MAX_STRING;
+    if (truncated || length + 1 + size > TRACE_MAX_RECORD) {
+        truncated = true;
+        return;
+    }
+    uint8_t prefix = (uint8_t)size;
+    put(&prefix, 1);
+    put(text, size);
+}
+
+void traceCommit(const TraceRecord& record) {
+    if (paused) {
+        dropped++;
+        return;
+    }
+
+    size_t size = record.size();
+    while (used + size > TRACE_BUFFER_SIZE) {
+        size_t oldest = ring[tail];
+        tail = (tail + oldest) % TRACE_BUFFER_SIZE;
+        used -= oldest;
+        recordCount--;
+        overwritten++;
+    }
+
+    const uint8_t* data = record.data();
+    size_t first = TRACE_BUFFER_SIZE - head;
+    if (first > size) first = size;
+    memcpy(ring + head, data, first);
+    memcpy(ring, data + first, size - first);
+    head = (head + size) % TRACE_BUFFER_SIZE;
+    used += size;
+    recordCount++;
+    written++;
+}
+
+void traceClear() {
+    head = tail = used = 0;
+    recordCount = 0;
+    written = 0;
+    overwritten = 0;
+    dropped = 0;
+}
+
+TraceStats getTraceStats() {
+    TraceStats stats;
+    stats.records = recordCount;
+    stats.bytes = (uint32_t)used;
+    stats.written = written;
+    stats.overwritten = overwritten;
+    stats.dropped = dropped;
+    return stats;
+}
+
+size_t traceRead(size_t offset, uint8_t* out, size_t maxLength) {
+    if (offset >= used) return 0;
+    size_t length = used - offset;
+    if (length > maxLength) length = maxLength;
+    for (size_t i = 0; i < length; i++) {
+        out[i] = ring[(tail + offset + i) % TRACE_BUFFER_SIZE];
+    }
+    return length;
+}
+
+void traceSetPaused(bool pause) {
+    paused = pause;
+}
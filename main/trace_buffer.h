@@ -0,0 +1,83 @@
+#ifndef TRACE_BUFFER_H
+#define TRACE_BUFFER_H
+
+// Binary trace ring for the LOG_* macros in Debug.h. Instead of formatting
+// text, a trace record keeps the format string's ID (FNV-1a of the literal,
+// computed at compile time) and the raw arguments; tools/trace_decode finds
+// the format strings in the sources and rebuilds the text on the host.
+// Kept free of Arduino dependencies like park_sprt so the decoder can share
+// the record layout.
+//
+// Record: length (u8, whole record), level (u8), timestamp (u32 us),
+// format ID (u32), then one entry per argument in format order:
+//   integer conversions (d i u x X c, with or without l)  4 bytes
+//   floating conversions (f e g)                           4-byte float
+//   %s                                                     length (u8) + bytes
+// All multi-byte values are little-endian. When the ring is full the oldest
+// whole records are overwritten.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define TRACE_BUFFER_SIZE 4096
+#define TRACE_RECORD_HEADER 10
+#define TRACE_MAX_RECORD 96
+#define TRACE_MAX_STRING 31          // Longer %s arguments are cut
+
+constexpr uint32_t traceFormatId(const char* format, uint32_t hash = 2166136261u) {
+    return *format ? traceFormatId(format + 1, (hash ^ (uint8_t)*format) * 16777619u) : hash;
+}
+
+struct TraceStats {
+    uint32_t records;            // Held in the ring now
+    uint32_t bytes;
+    uint32_t written;            // Since the last clear
+    uint32_t overwritten;        // Oldest records lost to newer ones
+    uint32_t dropped;            // Not recorded because a dump was in progress
+};
+
+// One record under construction, on the caller's stack
+class TraceRecord {
+public:
+    TraceRecord(uint8_t level, uint32_t formatId, uint32_t timeUs);
+    void add(int32_t value) { put(&value, 4); }
+    void add(uint32_t value) { put(&value, 4); }
+    void add(float value) { put(&value, 4); }
+    void add(const char* text);
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    void put(const void* data, size_t size);
+    uint8_t bytes[TRACE_MAX_RECORD];
+    size_t length;
+    bool truncated;
+};
+
+// Argument promotion mirrors printf's, so the decoder can go by the format
+inline void traceArg(TraceRecord& record, int value) { record.add((int32_t)value); }
+inline void traceArg(TraceRecord& record, unsigned int value) { record.add((uint32_t)value); }
+inline void traceArg(TraceRecord& record, long value) { record.add((int32_t)value); }
+inline void traceArg(TraceRecord& record, unsigned long value) { record.add((uint32_t)value); }
+inline void traceArg(TraceRecord& record, double value) { record.add((float)value); }
+inline void traceArg(TraceRecord& record, const char* value) { record.add(value); }
+
+void traceCommit(const TraceRecord& record);
+
+template <typename... Args>
+void traceLog(uint8_t level, uint32_t formatId, uint32_t timeUs, Args... args) {
+    TraceRecord record(level, formatId, timeUs);
+    int unpack[] = {0, (traceArg(record, args), 0)...};
+    (void)unpack;
+    traceCommit(record);
+}
+
+void traceClear();
+TraceStats getTraceStats();
+
+// Copies up to maxLength bytes of the ring, oldest first, starting at offset
+size_t traceRead(size_t offset, uint8_t* out, size_t maxLength);
+void traceSetPaused(bool paused);  // While paused (during a dump) new records are dropped
+
+#endif // TRACE_BUFFER_H
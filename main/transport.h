@@ -0,0 +1,79 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "Arduino.h"
+
+// Byte-stream link the command engine serves: USB CDC, a BLE UART service,
+// or a pty in the host build. The engine gives every transport its own
+// command session (see serial_interface.h) with its own command framing and
+// transmit ring, so several links can be served at once. Nothing here may
+// block: availableForWrite() says how much write() takes right now.
+
+class Transport {
+public:
+    explicit Transport(const char* name) : transportName(name) {}
+    virtual ~Transport() {}
+
+    const char* name() const { return transportName; }
+
+    virtual bool connected() = 0;              // A host has the link open
+    virtual int available() = 0;               // Received bytes waiting
+    virtual int read() = 0;                    // Next received byte, -1 if none
+    virtual int availableForWrite() = 0;       // Bytes write() accepts without blocking
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+
+private:
+    const char* transportName;
+};
+
+// Any Arduino stream with the usual `operator bool`: the USB CDC Serial on
+// the device, the pty or stdio Serial of the host build, or a BLE UART
+// service object
+template <class S>
+class StreamTransport : public Transport {
+public:
+    StreamTransport(const char* name, S& stream) : Transport(name), stream(stream) {}
+
+    bool connected() override { return (bool)stream; }
+    int available() override { return stream.available(); }
+    int read() override { return stream.read(); }
+    int availableForWrite() override { return stream.availableForWrite(); }
+    size_t write(const uint8_t* data, size_t length) override { return stream.write(data, length); }
+
+private:
+    S& stream;
+};
+
+// In-memory link for driving the engine with no board or host attached:
+// received bytes come from feed(), sent bytes are counted and discarded
+class LoopbackTransport : public Transport {
+public:
+    explicit LoopbackTransport(const char* name) : Transport(name), input(NULL), inputLength(0), inputPos(0),
+                                                   bytesWritten(0) {}
+
+    // The text must stay valid until it has been read
+    void feed(const char* text) {
+        input = text;
+        inputLength = strlen(text);
+        inputPos = 0;
+    }
+    unsigned long written() const { return bytesWritten; }
+
+    bool connected() override { return true; }
+    int available() override { return (int)(inputLength - inputPos); }
+    int read() override { return inputPos < inputLength ? (uint8_t)input[inputPos++] : -1; }
+    int availableForWrite() override { return 1024; }
+    size_t write(const uint8_t* data, size_t length) override {
+        (void)data;
+        bytesWritten += length;
+        return length;
+    }
+
+private:
+    const char* input;
+    size_t inputLength;
+    size_t inputPos;
+    unsigned long bytesWritten;
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,195 @@
+#include "tx_buffer.h"
+#include "profiler.h"
+
+TxBuffer::TxBuffer() : transport(NULL), head(0), tail(0), count(0), linkStalled(false) {
+    reserve[TX_CLASS_RESPONSE] = 0;
+    reserve[TX_CLASS_TELEMETRY] = (TX_BUFFER_SIZE * TX_DEFAULT_TELEMETRY_RESERVE) / 100;
+    reserve[TX_CLASS_DEBUG] = (TX_BUFFER_SIZE * TX_DEFAULT_DEBUG_RESERVE) / 100;
+    resetStats();
+}
+
+void TxBuffer::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    stats.highWater = count;
+}
+
+bool TxBuffer::setReserve(int debugPercent, int telemetryPercent) {
+    // Debug must always give way before telemetry does
+    if (debugPercent < 0 || debugPercent > 99 || telemetryPercent < 0 || telemetryPercent > debugPercent) {
+        return false;
+    }
+    reserve[TX_CLASS_TELEMETRY] = (TX_BUFFER_SIZE * telemetryPercent) / 100;
+    reserve[TX_CLASS_DEBUG] = (TX_BUFFER_SIZE * debugPercent) / 100;
+    return true;
+}
+
+int TxBuffer::getReservePercent(TxClass cls) const {
+    return (int)((reserve[cls] * 100 + TX_BUFFER_SIZE / 2) / TX_BUFFER_SIZE);
+}
+
+void TxBuffer::enqueue(const uint8_t* data, size_t length) {
+    size_t first = TX_BUFFER_SIZE - head;
+    if (first > length) first = length;
+    memcpy(buffer + head, data, first);
+    memcpy(buffer, data + first, length - first);
+
+    head = (head + length) % TX_BUFFER_SIZE;
+    count += length;
+    stats.bytesQueued += length;
+    if (count > stats.highWater) stats.highWater = count;
+}
+
+bool TxBuffer::admit(size_t length, TxClass cls) {
+    // Lower classes must leave their reserve free for higher classes
+    if (length + reserve[cls] <= available()) return true;
+    if (cls != TX_CLASS_RESPONSE || length > TX_BUFFER_SIZE) return false;
+
+    // A response that does not fit gets a short, bounded wait for the host to
+    // catch up. Once a wait has timed out the link is treated as stalled and
+    // further responses are dropped immediately until data moves again.
+    if (linkStalled) return false;
+
+    stats.responseWaits++;
+    unsigned long start = millis();
+    while (length > available()) {
+        if (millis() - start >= TX_RESPONSE_WAIT_MS) {
+            linkStalled = true;
+            return false;
+        }
+        if (service() == 0) delay(1);
+    }
+    return true;
+}
+
+bool TxBuffer::write(const uint8_t* data, size_t length, TxClass cls) {
+    if (length == 0) return true;
+
+    // Messages are queued whole or not at all so the host never sees a torn line
+    if (!admit(length, cls)) {
+        stats.bytesDropped[cls] += length;
+        stats.messagesDropped[cls]++;
+        return false;
+    }
+
+    enqueue(data, length);
+    return true;
+}
+
+bool TxBuffer::print(const String& msg, TxClass cls) {
+    return write((const uint8_t*)msg.c_str(), msg.length(), cls);
+}
+
+bool TxBuffer::println(const String& msg, TxClass cls) {
+    // Coalesce text and line ending into a single message
+    size_t length = msg.length();
+    if (length + 2 > TX_BUFFER_SIZE) {
+        stats.bytesDropped[cls] += length + 2;
+        stats.messagesDropped[cls]++;
+        return false;
+    }
+    if (!admit(length + 2, cls)) {
+        stats.bytesDropped[cls] += length + 2;
+        stats.messagesDropped[cls]++;
+        return false;
+    }
+
+    enqueue((const uint8_t*)msg.c_str(), length);
+    enqueue((const uint8_t*)"\r\n", 2);
+    return true;
+}
+
+bool TxBuffer::println(TxClass cls) {
+    return write((const uint8_t*)"\r\n", 2, cls);
+}
+
+size_t TxBuffer::service() {
+    PROFILE_SCOPE(PROFILE_USB_TX);
+    size_t flushed = 0;
+    if (transport == NULL) return 0;
+
+    // Only hand the link as many bytes as it can take without blocking
+    while (count > 0) {
+        int room = transport->availableForWrite();
+        if (room <= 0) break;
+
+        size_t chunk = count;
+        if (chunk > TX_FLUSH_CHUNK) chunk = TX_FLUSH_CHUNK;
+        if (chunk > (size_t)room) chunk = room;
+        if (chunk > TX_BUFFER_SIZE - tail) chunk = TX_BUFFER_SIZE - tail;
+
+        size_t written = transport->write(buffer + tail, chunk);
+        if (written == 0) break;
+
+        tail = (tail + written) % TX_BUFFER_SIZE;
+        count -= written;
+        flushed += written;
+    }
+
+    if (flushed > 0) {
+        stats.bytesFlushed += flushed;
+        linkStalled = false;
+    }
+    return flushed;
+}
+
+bool TxBuffer::drain(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    while (count > 0) {
+        if (millis() - start >= timeoutMs) return false;
+        if (service() == 0) delay(1);
+    }
+    return true;
+}
+
+int TxRouter::attach(TxBuffer& buffer) {
+    if (bufferCount == MAX_COMMAND_SESSIONS) return -1;
+    buffers[bufferCount] = &buffer;
+    return bufferCount++;
+}
+
+bool TxRouter::write(const uint8_t* data, size_t length, TxClass cls) {
+    if (selected >= 0) return buffers[selected]->write(data, length, cls);
+    // Each ring admits or drops the message by its own fill level
+    bool queued = bufferCount > 0;
+    for (int i = 0; i < bufferCount; i++) {
+        if (!buffers[i]->write(data, length, cls)) queued = false;
+    }
+    return queued;
+}
+
+bool TxRouter::print(const String& msg, TxClass cls) {
+    return write((const uint8_t*)msg.c_str(), msg.length(), cls);
+}
+
+bool TxRouter::println(const String& msg, TxClass cls) {
+    if (selected >= 0) return buffers[selected]->println(msg, cls);
+    bool queued = bufferCount > 0;
+    for (int i = 0; i < bufferCount; i++) {
+        if (!buffers[i]->println(msg, cls)) queued = false;
+    }
+    return queued;
+}
+
+bool TxRouter::println(TxClass cls) {
+    return write((const uint8_t*)"\r\n", 2, cls);
+}
+
+size_t TxRouter::service() {
+    size_t flushed = 0;
+    for (int i = 0; i < bufferCount; i++) flushed += buffers[i]->service();
+    return flushed;
+}
+
+bool TxRouter::drain(unsigned long timeoutMs) {
+    // All sessions at once, so one stalled link does not hold up the others
+    unsigned long start = millis();
+    for (;;) {
+        size_t pending = 0;
+        for (int i = 0; i < bufferCount; i++) pending += buffers[i]->used();
+        if (pending == 0) return true;
+        if (millis() - start >= timeoutMs) return false;
+        if (service() == 0) delay(1);
+    }
+}
+
+TxRouter SerialTx;
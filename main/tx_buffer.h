@@ -0,0 +1,119 @@
+#ifndef TX_BUFFER_H
+#define TX_BUFFER_H
+
+#include "Arduino.h"
+#include "transport.h"
+
+// Non-blocking transmit ring between the command handlers and one transport.
+// Handlers queue complete messages; the main loop flushes them out in
+// USB-packet-sized chunks only as fast as the host is reading.
+
+#define TX_BUFFER_SIZE 4096
+#define TX_FLUSH_CHUNK 64               // Full-speed USB bulk packet size
+#define TX_DEFAULT_DEBUG_RESERVE 50     // % of buffer kept free when queueing debug output
+#define TX_DEFAULT_TELEMETRY_RESERVE 25 // % of buffer kept free when queueing telemetry
+#define TX_RESPONSE_WAIT_MS 50          // Max time a command response waits for space
+#define MAX_COMMAND_SESSIONS 4          // Links served at once: USB, BLE, host ptys
+#define TX_ALL_SESSIONS -1              // Route output to every session
+
+// Traffic classes, highest priority first
+enum TxClass {
+    TX_CLASS_RESPONSE = 0,   // Command responses and notifications - never displaced
+    TX_CLASS_TELEMETRY = 1,  // Streamed samples
+    TX_CLASS_DEBUG = 2,      // Debug output - dropped first
+    TX_CLASS_COUNT = 3
+};
+
+struct TxBufferStats {
+    unsigned long bytesQueued;
+    unsigned long bytesFlushed;
+    unsigned long bytesDropped[TX_CLASS_COUNT];
+    unsigned long messagesDropped[TX_CLASS_COUNT];
+    unsigned long responseWaits;  // Responses that had to wait for the host
+    size_t highWater;             // Peak bytes waiting in the ring
+};
+
+class TxBuffer {
+private:
+    Transport* transport;
+    uint8_t buffer[TX_BUFFER_SIZE];
+    size_t head;      // Next byte to write
+    size_t tail;      // Next byte to flush
+    size_t count;     // Bytes waiting
+    size_t reserve[TX_CLASS_COUNT];
+    bool linkStalled; // Set when a response wait timed out, cleared once data moves
+    TxBufferStats stats;
+
+    void enqueue(const uint8_t* data, size_t length);
+    bool admit(size_t length, TxClass cls);
+
+public:
+    TxBuffer();
+    void attach(Transport* link) { transport = link; }
+    bool write(const uint8_t* data, size_t length, TxClass cls = TX_CLASS_RESPONSE);
+    bool print(const String& msg, TxClass cls = TX_CLASS_RESPONSE);
+    bool println(const String& msg, TxClass cls = TX_CLASS_RESPONSE);
+    bool println(TxClass cls = TX_CLASS_RESPONSE);
+
+    size_t service();                       // Flush what the host can take now
+    bool drain(unsigned long timeoutMs);    // Blocking flush, used before reset/halt
+
+    bool setReserve(int debugPercent, int telemetryPercent);
+    int getReservePercent(TxClass cls) const;
+    size_t used() const { return count; }
+    size_t available() const { return TX_BUFFER_SIZE - count; }
+    const TxBufferStats& getStats() const { return stats; }
+    void resetStats();
+};
+
+// What the firmware writes through. While a command runs, output goes to
+// the ring of the session that sent it; otherwise (park notifications, debug
+// from the main loop) every session gets a copy. Queries and settings made
+// outside a command apply to the first session, USB.
+class TxRouter {
+private:
+    TxBuffer* buffers[MAX_COMMAND_SESSIONS];
+    int bufferCount;
+    int selected;     // Session index, or TX_ALL_SESSIONS
+
+    TxBuffer& target() { return *buffers[selected >= 0 ? selected : 0]; }
+    const TxBuffer& target() const { return *buffers[selected >= 0 ? selected : 0]; }
+
+public:
+    TxRouter() : bufferCount(0), selected(TX_ALL_SESSIONS) {}
+    int attach(TxBuffer& buffer);           // Session index, -1 when full
+    int sessionCount() const { return bufferCount; }
+    void select(int session) { selected = session; }
+    int getSelected() const { return selected; }
+
+    bool write(const uint8_t* data, size_t length, TxClass cls = TX_CLASS_RESPONSE);
+    bool print(const String& msg, TxClass cls = TX_CLASS_RESPONSE);
+    bool println(const String& msg, TxClass cls = TX_CLASS_RESPONSE);
+    bool println(TxClass cls = TX_CLASS_RESPONSE);
+
+    size_t service();                       // Flush every session
+    bool drain(unsigned long timeoutMs);    // Every session, within one timeout
+
+    bool setReserve(int debugPercent, int telemetryPercent) { return target().setReserve(debugPercent, telemetryPercent); }
+    int getReservePercent(TxClass cls) const { return target().getReservePercent(cls); }
+    size_t used() const { return target().used(); }
+    size_t available() const { return target().available(); }
+    const TxBufferStats& getStats() const { return target().getStats(); }
+    void resetStats() { target().resetStats(); }
+};
+
+extern TxRouter SerialTx;
+
+// Routes SerialTx to one session (or TX_ALL_SESSIONS) for the rest of the scope.
+// Output that a command starts and the main loop finishes later (telemetry,
+// downloads, captures) keeps the session of that command this way.
+class SessionScope {
+public:
+    explicit SessionScope(int session) : previous(SerialTx.getSelected()) { SerialTx.select(session); }
+    ~SessionScope() { SerialTx.select(previous); }
+
+private:
+    int previous;
+};
+
+#endif // TX_BUFFER_H
@@ -0,0 +1,115 @@
+#include "vibration_analysis.h"
+#include "burst_capture.h"
+#include "position_sensor.h"
+#include "tx_buffer.h"
+#include "helpers.h"
+#include "Debug.h"
+#include "profiler.h"
+
+#define FIRST_ACCEL_AXIS 3              // Burst sample order is gx gy gz ax ay az
+#define ACCEL_CHANNELS 3
+
+static SpectrumAnalyzer analyzer;
+static SpectrumResult result;
+static VibrationState state = VIBRATION_IDLE;
+static bool haveResult = false;
+static uint8_t channel = 0;
+static unsigned long transformStartMs = 0;
+static unsigned long transformSteps = 0;
+static unsigned long transformMs = 0;
+static int resultSession = TX_ALL_SESSIONS;   // Session that asked for the spectrum
+
+bool startVibrationAnalysis(uint16_t odrHz) {
+    if (state != VIBRATION_IDLE) return false;
+    if (!startBurstCapture(odrHz, VIBRATION_FFT_SIZE, false)) return false;
+    resultSession = SerialTx.getSelected();
+    state = VIBRATION_CAPTURING;
+    return true;
+}
+
+VibrationState getVibrationState() {
+    return state;
+}
+
+bool hasVibrationResult() {
+    return haveResult;
+}
+
+static String floatArray(const float* values, size_t count, int decimals) {
+    String array = "[";
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) array += ",";
+        array += String(values[i], decimals);
+    }
+    return array + "]";
+}
+
+String buildVibrationJSON() {
+    float peakHz[VIBRATION_MAX_PEAKS];
+    float peakMg[VIBRATION_MAX_PEAKS];
+    for (uint8_t i = 0; i < result.peakCount; i++) {
+        peakHz[i] = result.peaks[i].frequencyHz;
+        peakMg[i] = result.peaks[i].amplitude;
+    }
+
+    JSONBuilder json;
+    json.add("sampleRateHz", result.sampleRateHz, 1);
+    json.add("resolutionHz", result.resolutionHz, 3);
+    json.add("windowSamples", VIBRATION_FFT_SIZE);
+    json.add("rmsMg", result.rms, 3);
+    json.addRaw("peakHz", floatArray(peakHz, result.peakCount, 2));
+    json.addRaw("peakMg", floatArray(peakMg, result.peakCount, 3));
+    json.addRaw("bandEdgesHz", floatArray(VIBRATION_BAND_EDGES_HZ, VIBRATION_BAND_COUNT + 1, 0));
+    json.addRaw("bandRmsMg", floatArray(result.bandRms, VIBRATION_BAND_COUNT, 3));
+    json.add("transformSteps", transformSteps);
+    json.add("transformMs", transformMs);
+    return json.build();
+}
+
+static void fail(const char* reason) {
+    state = VIBRATION_IDLE;
+    SerialTx.println(buildJSONError(String("Vibration analysis failed - ") + reason));
+}
+
+void serviceVibrationAnalysis() {
+    PROFILE_SCOPE(PROFILE_VIBRATION);
+    SessionScope scope(resultSession);
+    if (state == VIBRATION_CAPTURING) {
+        BurstInfo info = getBurstInfo();
+        if (info.state != BURST_IDLE) return;
+        if (info.capturedSamples < VIBRATION_FFT_SIZE || info.overrun) {
+            fail(info.overrun ? "IMU FIFO overrun" : "IMU stopped delivering samples");
+            return;
+        }
+
+        // Use the measured rate, the IMU clock is only good to a few percent
+        float sampleRate = info.measuredPeriodUs > 0.0 ? 1000000.0 / info.measuredPeriodUs : info.odrHz;
+        spectrumStart(analyzer, sampleRate);
+        channel = 0;
+        transformSteps = 0;
+        transformStartMs = millis();
+        state = VIBRATION_TRANSFORMING;
+        return;
+    }
+
+    if (state != VIBRATION_TRANSFORMING) return;
+
+    // One load or one FFT step per loop iteration
+    transformSteps++;
+    if (!analyzer.loaded) {
+        if (channel < ACCEL_CHANNELS) {
+            float mgPerCount = imu.calcAccel(1) * 1000.0;
+            spectrumLoadChannel(analyzer, getBurstSamples() + FIRST_ACCEL_AXIS + channel, BURST_AXES, mgPerCount);
+            return;
+        }
+
+        spectrumFinish(analyzer, result);
+        transformMs = millis() - transformStartMs;
+        haveResult = true;
+        state = VIBRATION_IDLE;
+        SerialTx.println(buildJSONNotification("vibrationSpectrum", buildVibrationJSON()));
+        return;
+    }
+
+    if (spectrumStep(analyzer)) channel++;
+}
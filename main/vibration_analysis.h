@@ -0,0 +1,26 @@
+#ifndef VIBRATION_ANALYSIS_H
+#define VIBRATION_ANALYSIS_H
+
+#include "Arduino.h"
+#include "vibration_fft.h"
+
+// On-device vibration spectrum. A burst capture of VIBRATION_FFT_SIZE
+// accelerometer samples is transformed one step per loop iteration (see
+// vibration_fft.h), so the serial loop and park monitoring never stall.
+// The result is sent as a vibrationSpectrum notification and kept for <1F>.
+
+#define VIBRATION_DEFAULT_ODR_HZ 833    // 416Hz Nyquist, 0.81Hz bins over a 1.2s window
+
+enum VibrationState {
+    VIBRATION_IDLE,
+    VIBRATION_CAPTURING,
+    VIBRATION_TRANSFORMING
+};
+
+bool startVibrationAnalysis(uint16_t odrHz);     // false if a capture or analysis is running
+VibrationState getVibrationState();
+void serviceVibrationAnalysis();                 // Call from loop()
+bool hasVibrationResult();
+String buildVibrationJSON();                     // Last result as a JSON object
+
+#endif // VIBRATION_ANALYSIS_H
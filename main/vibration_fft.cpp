@@ -0,0 +1,186 @@
+#include "vibration_fft.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(ARDUINO_ARCH_MBED) && defined(__has_include)
+#if __has_include(<arm_math.h>)
+#include <arm_math.h>
+#define VIBRATION_USE_CMSIS_DSP 1
+#endif
+#endif
+
+const float VIBRATION_BAND_EDGES_HZ[VIBRATION_BAND_COUNT + 1] = {
+    0.0f, 2.0f, 5.0f, 10.0f, 20.0f, 50.0f, 100.0f, 200.0f, 1000.0f
+};
+
+static const float TWO_PI_F = 6.28318530718f;
+
+// Parseval for a Hann-windowed single-sided spectrum: the window's sum of
+// squares is 3N/8, so RMS^2 = 16 * sum(|X|^2) / (3 N^2)
+static float powerToMeanSquare(float power) {
+    return 16.0f * power / (3.0f * (float)VIBRATION_FFT_SIZE * (float)VIBRATION_FFT_SIZE);
+}
+
+static void accumulatePower(SpectrumAnalyzer& analyzer) {
+#ifdef VIBRATION_USE_CMSIS_DSP
+    // arm_rfft_fast_f32 packs DC and Nyquist into the first complex pair
+    const float* out = analyzer.im;
+    analyzer.power[0] += out[0] * out[0];
+    analyzer.power[VIBRATION_FFT_SIZE / 2] += out[1] * out[1];
+    for (size_t k = 1; k < VIBRATION_FFT_SIZE / 2; k++) {
+        analyzer.power[k] += out[2 * k] * out[2 * k] + out[2 * k + 1] * out[2 * k + 1];
+    }
+#else
+    for (size_t k = 0; k <= VIBRATION_FFT_SIZE / 2; k++) {
+        analyzer.power[k] += analyzer.re[k] * analyzer.re[k] + analyzer.im[k] * analyzer.im[k];
+    }
+#endif
+    analyzer.channels++;
+}
+
+void spectrumStart(SpectrumAnalyzer& analyzer, float sampleRateHz) {
+    memset(analyzer.power, 0, sizeof(analyzer.power));
+    analyzer.sampleRateHz = sampleRateHz;
+    analyzer.stage = 0;
+    analyzer.loaded = false;
+    analyzer.channels = 0;
+}
+
+void spectrumLoadChannel(SpectrumAnalyzer& analyzer, const int16_t* data, size_t stride, float scale) {
+    // Gravity and offsets are DC; remove them before windowing so they do not leak into low bins
+    float mean = 0.0f;
+    for (size_t i = 0; i < VIBRATION_FFT_SIZE; i++) mean += data[i * stride];
+    mean /= VIBRATION_FFT_SIZE;
+
+    for (size_t i = 0; i < VIBRATION_FFT_SIZE; i++) {
+        float window = 0.5f - 0.5f * cosf(TWO_PI_F * i / VIBRATION_FFT_SIZE);
+        analyzer.re[i] = (data[i * stride] - mean) * scale * window;
+        analyzer.im[i] = 0.0f;
+    }
+    analyzer.stage = 0;
+    analyzer.loaded = true;
+}
+
+#ifdef VIBRATION_USE_CMSIS_DSP
+
+bool spectrumStep(SpectrumAnalyzer& analyzer) {
+    static arm_rfft_fast_instance_f32 instance;
+    static bool initialized = false;
+    if (!analyzer.loaded) return true;
+    if (!initialized) {
+        arm_rfft_fast_init_f32(&instance, VIBRATION_FFT_SIZE);
+        initialized = true;
+    }
+
+    // Well under a millisecond on the Cortex-M4F, so the whole transform is one step
+    arm_rfft_fast_f32(&instance, analyzer.re, analyzer.im, 0);
+    accumulatePower(analyzer);
+    analyzer.loaded = false;
+    return true;
+}
+
+#else
+
+static void bitReverse(float* re, float* im) {
+    for (size_t i = 1, j = 0; i < VIBRATION_FFT_SIZE; i++) {
+        size_t bit = VIBRATION_FFT_SIZE >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+}
+
+static void butterflyStage(float* re, float* im, uint8_t stage) {
+    size_t length = (size_t)1 << stage;
+    size_t half = length >> 1;
+    for (size_t j = 0; j < half; j++) {
+        float angle = -TWO_PI_F * j / length;
+        float wr = cosf(angle);
+        float wi = sinf(angle);
+        for (size_t i = j; i < VIBRATION_FFT_SIZE; i += length) {
+            size_t k = i + half;
+            float tr = wr * re[k] - wi * im[k];
+            float ti = wr * im[k] + wi * re[k];
+            re[k] = re[i] - tr;
+            im[k] = im[i] - ti;
+            re[i] += tr;
+            im[i] += ti;
+        }
+    }
+}
+
+bool spectrumStep(SpectrumAnalyzer& analyzer) {
+    if (!analyzer.loaded) return true;
+
+    // Stage 0 reorders the input, stages 1..N do the butterflies
+    if (analyzer.stage == 0) {
+        bitReverse(analyzer.re, analyzer.im);
+    } else {
+        butterflyStage(analyzer.re, analyzer.im, analyzer.stage);
+    }
+
+    if (analyzer.stage++ < VIBRATION_FFT_STAGES) return false;
+    accumulatePower(analyzer);
+    analyzer.loaded = false;
+    return true;
+}
+
+#endif
+
+void spectrumFinish(const SpectrumAnalyzer& analyzer, SpectrumResult& result) {
+    const size_t bins = VIBRATION_FFT_SIZE / 2;
+    memset(&result, 0, sizeof(result));
+    result.sampleRateHz = analyzer.sampleRateHz;
+    result.resolutionHz = analyzer.sampleRateHz / VIBRATION_FFT_SIZE;
+
+    float total = 0.0f;
+    float bandPower[VIBRATION_BAND_COUNT] = {0};
+    for (size_t k = 1; k <= bins; k++) {
+        total += analyzer.power[k];
+        float frequency = k * result.resolutionHz;
+        for (int band = 0; band < VIBRATION_BAND_COUNT; band++) {
+            if (frequency >= VIBRATION_BAND_EDGES_HZ[band] && frequency < VIBRATION_BAND_EDGES_HZ[band + 1]) {
+                bandPower[band] += analyzer.power[k];
+                break;
+            }
+        }
+    }
+    result.rms = sqrtf(powerToMeanSquare(total));
+    for (int band = 0; band < VIBRATION_BAND_COUNT; band++) {
+        result.bandRms[band] = sqrtf(powerToMeanSquare(bandPower[band]));
+    }
+
+    // Strongest local maxima, kept sorted by bin power
+    size_t peakBins[VIBRATION_MAX_PEAKS];
+    uint8_t count = 0;
+    for (size_t k = 1; k < bins; k++) {
+        const float* p = analyzer.power;
+        if (p[k] <= p[k - 1] || p[k] < p[k + 1] || p[k] <= 0.0f) continue;
+        if (count == VIBRATION_MAX_PEAKS && p[k] <= p[peakBins[count - 1]]) continue;
+
+        int slot = count < VIBRATION_MAX_PEAKS ? count++ : VIBRATION_MAX_PEAKS - 1;
+        while (slot > 0 && p[peakBins[slot - 1]] < p[k]) {
+            peakBins[slot] = peakBins[slot - 1];
+            slot--;
+        }
+        peakBins[slot] = k;
+    }
+
+    result.peakCount = count;
+    for (uint8_t i = 0; i < count; i++) {
+        size_t k = peakBins[i];
+        float a = sqrtf(analyzer.power[k - 1]);
+        float b = sqrtf(analyzer.power[k]);
+        float c = sqrtf(analyzer.power[k + 1]);
+        float denominator = a - 2.0f * b + c;
+        float offset = denominator != 0.0f ? 0.5f * (a - c) / denominator : 0.0f;
+
+        // The Hann main lobe puts a sinusoid's power in about three bins: A^2/2 = RMS^2
+        float lobe = analyzer.power[k - 1] + analyzer.power[k] + analyzer.power[k + 1];
+        result.peaks[i].frequencyHz = (k + offset) * result.resolutionHz;
+        result.peaks[i].amplitude = sqrtf(2.0f * powerToMeanSquare(lobe));
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef VIBRATION_FFT_H
+#define VIBRATION_FFT_H
+
+// Windowed real FFT and spectrum summary for vibration analysis. Kept free of
+// Arduino dependencies so tools/spectrum runs the same analysis on a host.
+//
+// Each channel (accelerometer axis) has its mean removed, is Hann windowed
+// and transformed; the power of all channels is summed, so the result
+// describes the total vibration regardless of direction. On the target the
+// transform uses CMSIS-DSP when it is available, otherwise (and on the host)
+// an iterative radix-2 FFT that advances one stage per spectrumStep() call so
+// the caller can spread it over loop iterations.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define VIBRATION_FFT_SIZE 1024
+#define VIBRATION_FFT_STAGES 10         // log2(VIBRATION_FFT_SIZE)
+#define VIBRATION_MAX_PEAKS 5
+#define VIBRATION_BAND_COUNT 8
+
+// Band edges in Hz; bands above the Nyquist frequency report 0
+extern const float VIBRATION_BAND_EDGES_HZ[VIBRATION_BAND_COUNT + 1];
+
+struct SpectrumPeak {
+    float frequencyHz;           // Interpolated between bins
+    float amplitude;             // Sinusoid amplitude, in the units of the loaded data
+};
+
+struct SpectrumResult {
+    float sampleRateHz;
+    float resolutionHz;          // Bin spacing
+    float rms;                   // Total AC RMS over all bins
+    uint8_t peakCount;
+    SpectrumPeak peaks[VIBRATION_MAX_PEAKS];   // Strongest first
+    float bandRms[VIBRATION_BAND_COUNT];
+};
+
+struct SpectrumAnalyzer {
+    float re[VIBRATION_FFT_SIZE];                // Windowed input, then transform output
+    float im[VIBRATION_FFT_SIZE];
+    float power[VIBRATION_FFT_SIZE / 2 + 1];     // |X|^2 summed over channels
+    float sampleRateHz;
+    uint8_t stage;                               // Next FFT stage of the loaded channel
+    bool loaded;
+    uint8_t channels;
+};
+
+void spectrumStart(SpectrumAnalyzer& analyzer, float sampleRateHz);
+
+// Loads VIBRATION_FFT_SIZE samples of one channel: data[i * stride] * scale
+void spectrumLoadChannel(SpectrumAnalyzer& analyzer, const int16_t* data, size_t stride, float scale);
+
+// Advances the transform of the loaded channel; returns true once it has been
+// added to the power spectrum and the next channel can be loaded
+bool spectrumStep(SpectrumAnalyzer& analyzer);
+
+void spectrumFinish(const SpectrumAnalyzer& analyzer, SpectrumResult& result);
+
+#endif // VIBRATION_FFT_H
@@ -0,0 +1,200 @@
+// flash_power_cut_test - power cuts at every byte of a settings save
+//
+// Runs the settings log of main/flash_storage.cpp against the simulated QSPI
+// flash and cuts the power after every possible number of bytes of a save:
+// the record program of an ordinary append, and the erase plus program of a
+// save that switches to the next sector of the ring. After each cut the boot
+// scan runs again and must find the record being written if it was complete,
+// the one before it otherwise, and the store must keep working. A save whose
+// program fails, or that finds the flash queue full, must stay pending and be
+// written from the loop, and nothing may wait behind a busy queue. A read
+// refused during the boot scan must leave the log untouched and lose nothing.
+//
+// Build: cmake -S . -B build && cmake --build build --target flash_power_cut_test
+// Usage: flash_power_cut_test (or ctest --test-dir build)
+
+#include "Arduino.h"
+#include "flash_storage.h"
+#include "settings_registry.h"
+#include "sim_clock.h"
+#include "sim_flash.h"
+#include "test_check.h"
+
+#include <string.h>
+#include <vector>
+
+#define RECORD_SIZE 128               // SETTINGS_RECORD_SIZE
+#define SECTOR_SIZE 4096
+#define LOG_RECORDS (4 * SECTOR_SIZE / RECORD_SIZE)   // Every slot of the settings log
+#define SNAPSHOT_SIZE 0x8000          // Legacy sector and settings log
+
+// Every saved record carries its number in the storageTest setting
+static void save(float marker) {
+    CHECK(setSettingFloat(SETTING_STORAGE_TEST, marker));
+    CHECK(waitForFlashIdle());
+}
+
+// A power-up: RAM state is gone, the boot scan loads the newest record
+static float reboot() {
+    simFlashRestorePower();
+    simFlashFailReadAfter(-1);
+    resetSettingsToDefaults();
+    CHECK(loadSettingsFromFlash());
+    return getSettingFloat(SETTING_STORAGE_TEST);
+}
+
+// Cuts the save of `marker` after 0..maxBytes bytes, starting each time from
+// the image in `snapshot` whose newest record is `previous`
+static void cutEveryByte(const std::vector<uint8_t>& snapshot, float previous, float marker, long maxBytes,
+                         long completeAfter) {
+    for (long cut = 0; cut <= maxBytes; cut++) {
+        memcpy(simFlashImage(), snapshot.data(), snapshot.size());
+        CHECK_EQ(reboot(), previous);
+
+        simFlashCutPowerAfter(cut);
+        setSettingFloat(SETTING_STORAGE_TEST, marker);
+        waitForFlashIdle();
+        CHECK(simFlashPowerIsCut() == (cut < completeAfter));
+
+        float expected = cut >= completeAfter ? marker : previous;
+        float recovered = reboot();
+        if (recovered != expected) {
+            fprintf(stderr, "cut after %ld bytes: recovered %.0f, expected %.0f\n", cut, recovered, expected);
+            CHECK_EQ(recovered, expected);
+        }
+
+        // The store carries on past whatever the cut left behind
+        save(marker + 1000);
+        CHECK_EQ(reboot(), marker + 1000);
+    }
+}
+
+static std::vector<uint8_t> snapshot() {
+    return std::vector<uint8_t>(simFlashImage(), simFlashImage() + SNAPSHOT_SIZE);
+}
+
+static void testAppend() {
+    CHECK(clearAllFlashSettings());
+    for (int i = 1; i <= 5; i++) save(i);
+    CHECK_EQ(reboot(), 5.0f);
+
+    cutEveryByte(snapshot(), 5, 6, RECORD_SIZE, RECORD_SIZE);
+}
+
+static void testSectorSwitch() {
+    // Fill the whole ring, so the next save erases the sector with the oldest records
+    CHECK(clearAllFlashSettings());
+    for (int i = 1; i <= LOG_RECORDS; i++) save(i);
+    CHECK_EQ(reboot(), (float)LOG_RECORDS);
+    SettingsLogInfo info = getSettingsLogInfo();
+    CHECK_EQ(info.nextSlot, info.slotsPerSector);
+
+    cutEveryByte(snapshot(), LOG_RECORDS, LOG_RECORDS + 1, SECTOR_SIZE + RECORD_SIZE, SECTOR_SIZE + RECORD_SIZE);
+}
+
+static void testFailedProgram() {
+    CHECK(clearAllFlashSettings());
+    save(1);
+    FlashStorageStats before = getFlashStorageStats();
+    uint32_t committed = getSettingsLogInfo().sequence;
+
+    // The record is not committed until its program completes
+    simFlashFailPrograms(1);
+    CHECK(setSettingFloat(SETTING_STORAGE_TEST, 2));
+    CHECK(waitForFlashIdle());
+    CHECK_EQ(getFlashStorageStats().failedCommits, before.failedCommits + 1);
+    CHECK_EQ(getFlashStorageStats().commits, before.commits);
+    CHECK_EQ(getSettingsLogInfo().sequence, committed);
+    CHECK(hasPendingSettings());
+
+    // The loop writes it again after a quiet period
+    serviceFlashStorage();
+    CHECK(hasPendingSettings());
+    delay(FLASH_WRITE_BEHIND_DELAY_MS);
+    serviceFlashStorage();
+    CHECK(waitForFlashIdle());
+    CHECK(!hasPendingSettings());
+    CHECK_EQ(getFlashStorageStats().commits, before.commits + 1);
+    CHECK_EQ(reboot(), 2.0f);
+}
+
+static void testBusyQueue() {
+    CHECK(clearAllFlashSettings());
+    CHECK(waitForFlashIdle());
+    while (canQueueFlashOps(1)) CHECK(eraseFlashSector(0x1000));
+
+    // A full queue refuses requests and reads instead of waiting
+    unsigned long refusals = getQspiFlashStats().queueFullRefusals;
+    CHECK(!eraseFlashSector(0x1000));
+    CHECK_EQ(getQspiFlashStats().queueFullRefusals, refusals + 1);
+    uint32_t word;
+    CHECK(isFlashBusy());
+    CHECK(!readFlash(0x2000, &word, sizeof(word)));
+    CHECK(mapFlash(0x2000, sizeof(word)) == NULL);
+
+    // A save is deferred, not failed, and goes out once the queue drains
+    unsigned long deferred = getFlashStorageStats().deferredSaves;
+    CHECK(setSettingFloat(SETTING_STORAGE_TEST, 3));
+    CHECK_EQ(getFlashStorageStats().deferredSaves, deferred + 1);
+    CHECK(hasPendingSettings());
+    CHECK(waitForFlashIdle());
+    serviceFlashStorage();
+    CHECK(waitForFlashIdle());
+    CHECK(!hasPendingSettings());
+    CHECK_EQ(reboot(), 3.0f);
+}
+
+static void testScanReadFailure() {
+    // Newest record in the second sector, and a legacy image that must not be imported over it
+    CHECK(clearAllFlashSettings());
+    for (int i = 1; i <= 40; i++) save(i);
+    TelescopeSettings legacy;
+    memset(&legacy, 0, sizeof(legacy));
+    legacy.magic = 0x54454C45;    // SETTINGS_MAGIC
+    legacy.checksum = calculateChecksum(legacy);
+    CHECK(programFlash(0x1000, &legacy, sizeof(legacy)));
+    CHECK(waitForFlashIdle());
+    CHECK_EQ(reboot(), 40.0f);
+    uint32_t newest = getSettingsLogInfo().sequence;
+    std::vector<uint8_t> image = snapshot();
+
+    // Refuse each read of the boot scan in turn, until the scan no longer reaches it
+    for (long failAt = 0;; failAt++) {
+        memcpy(simFlashImage(), image.data(), image.size());
+        simFlashRestorePower();
+        resetSettingsToDefaults();
+        simFlashFailReadAfter(failAt);
+        bool loaded = loadSettingsFromFlash();
+        bool refused = simFlashReadRefused();
+        simFlashFailReadAfter(-1);
+        if (!refused) {
+            CHECK(loaded);
+            CHECK_EQ(getSettingFloat(SETTING_STORAGE_TEST), 40.0f);
+            break;
+        }
+
+        // Defaults kept and nothing written, not even the legacy import
+        CHECK(!loaded);
+        CHECK(waitForFlashIdle());
+        CHECK_EQ(getSettingFloat(SETTING_STORAGE_TEST), 0.0f);
+        CHECK(memcmp(simFlashImage(), image.data(), image.size()) == 0);
+
+        // The next save finds the log position first, so it wins at the next boot
+        save(41);
+        CHECK_EQ(reboot(), 41.0f);
+        CHECK_EQ(getSettingsLogInfo().sequence, newest + 1);
+    }
+}
+
+int main() {
+    simClockSetMode(SIM_CLOCK_SIMULATED);
+    if (!simFlashOpen(NULL)) return 1;
+    CHECK(initFlashStorage());
+
+    RUN_TEST(testAppend);
+    RUN_TEST(testSectorSwitch);
+    RUN_TEST(testFailedProgram);
+    RUN_TEST(testBusyQueue);
+    RUN_TEST(testScanReadFailure);
+    return testSummary();
+}
@@ -0,0 +1,454 @@
+// sample_log_test - the on-flash sample log, its codec and log_decode
+//
+// Covers the delta/varint block codec on its own (extreme deltas, sign
+// flips, runs, time gaps, events with large values), then runs the sample
+// log of main/sample_log.cpp against the simulated QSPI flash: ring wrap at
+// SAMPLE_LOG_BLOCKS, the boot scan after a block torn by a power cut at every
+// byte, and downloads. A download that starts at a sequence already
+// overwritten must resume at the oldest block still in flash. The captured
+// download output is decoded with tools/log_decode.
+//
+// Build: cmake -S . -B build && cmake --build build --target sample_log_test log_decode
+// Usage: sample_log_test LOG_DECODE (ctest passes the log_decode binary)
+
+#include "Arduino.h"
+#include "flash_storage.h"
+#include "log_codec.h"
+#include "sample_log.h"
+#include "serial_interface.h"
+#include "sim_clock.h"
+#include "sim_flash.h"
+#include "test_check.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+extern float currentPitch, currentRoll;
+extern bool isParked;
+
+// Codec round trips
+
+struct TimedSample {
+    LogSample sample;
+    uint32_t timeMs;
+};
+
+struct TimedEvent {
+    uint8_t code;
+    uint32_t timeMs;
+    uint32_t value;
+};
+
+struct DecodedLog {
+    std::vector<TimedSample> samples;
+    std::vector<TimedEvent> events;
+    uint32_t nextSequence = 0;
+};
+
+static void collectRecord(const LogBlockHeader& header, const LogRecord& record, void* context) {
+    DecodedLog& log = *(DecodedLog*)context;
+    uint32_t timeMs = header.startMs + record.offsetMs;
+    if (record.type == LOG_RECORD_SAMPLE) {
+        log.samples.push_back({record.sample, timeMs});
+    } else {
+        log.events.push_back({record.eventCode, timeMs, record.eventValue});
+    }
+}
+
+static void finishBlock(LogEncoder& encoder, DecodedLog& log) {
+    const uint8_t* block = logEncoderFinish(encoder);
+    CHECK(logBlockIsValid(block));
+    CHECK(logDecodeBlock(block, collectRecord, &log));
+}
+
+// Encodes the way sample_log.cpp does: a full block is written and the
+// sample goes into a new one based on it
+static DecodedLog roundTrip(const std::vector<TimedSample>& samples, const std::vector<TimedEvent>& events,
+                            uint16_t periodMs) {
+    DecodedLog log;
+    LogEncoder encoder;
+    encoder.open = false;
+    size_t nextEvent = 0;
+
+    for (const TimedSample& input : samples) {
+        while (nextEvent < events.size() && events[nextEvent].timeMs <= input.timeMs) {
+            const TimedEvent& event = events[nextEvent++];
+            if (!encoder.open) logEncoderStart(encoder, log.nextSequence++, event.timeMs, 1, periodMs, input.sample);
+            if (!logEncoderAddEvent(encoder, event.code, event.timeMs, event.value)) {
+                finishBlock(encoder, log);
+                logEncoderStart(encoder, log.nextSequence++, event.timeMs, 1, periodMs, input.sample);
+                CHECK(logEncoderAddEvent(encoder, event.code, event.timeMs, event.value));
+            }
+        }
+        if (!encoder.open) logEncoderStart(encoder, log.nextSequence++, input.timeMs, 1, periodMs, input.sample);
+        if (!logEncoderAddSample(encoder, input.sample, input.timeMs)) {
+            finishBlock(encoder, log);
+            logEncoderStart(encoder, log.nextSequence++, input.timeMs, 1, periodMs, input.sample);
+            CHECK(logEncoderAddSample(encoder, input.sample, input.timeMs));
+        }
+    }
+    if (!logEncoderIsEmpty(encoder)) finishBlock(encoder, log);
+    return log;
+}
+
+static void checkRoundTrip(const std::vector<TimedSample>& samples, const std::vector<TimedEvent>& events,
+                           uint16_t periodMs) {
+    DecodedLog log = roundTrip(samples, events, periodMs);
+
+    CHECK_EQ(log.samples.size(), samples.size());
+    for (size_t i = 0; i < samples.size() && i < log.samples.size(); i++) {
+        const LogSample& expected = samples[i].sample;
+        const LogSample& decoded = log.samples[i].sample;
+        bool same = decoded.pitch == expected.pitch && decoded.roll == expected.roll &&
+                    decoded.temperature == expected.temperature && decoded.parked == expected.parked;
+        int32_t timeError = (int32_t)(log.samples[i].timeMs - samples[i].timeMs);
+        if (!same || timeError > LOG_TIME_TOLERANCE_MS || timeError < -LOG_TIME_TOLERANCE_MS) {
+            fprintf(stderr, "sample %zu: decoded %d/%d/%d/%u at %lu, expected %d/%d/%d/%u at %lu\n", i,
+                    decoded.pitch, decoded.roll, decoded.temperature, decoded.parked,
+                    (unsigned long)log.samples[i].timeMs, expected.pitch, expected.roll, expected.temperature,
+                    expected.parked, (unsigned long)samples[i].timeMs);
+            CHECK(false);
+            return;
+        }
+    }
+
+    CHECK_EQ(log.events.size(), events.size());
+    for (size_t i = 0; i < events.size() && i < log.events.size(); i++) {
+        CHECK_EQ(log.events[i].code, events[i].code);
+        CHECK_EQ(log.events[i].timeMs, events[i].timeMs);
+        CHECK_EQ(log.events[i].value, events[i].value);
+    }
+}
+
+static LogSample sample(int16_t pitch, int16_t roll, int16_t temperature = 250, uint8_t parked = 0) {
+    LogSample value = {pitch, roll, temperature, parked};
+    return value;
+}
+
+static void testCodecExtremes() {
+    const uint16_t period = 1000;
+    std::vector<TimedSample> samples;
+    uint32_t t = 5000;
+    auto add = [&](const LogSample& value) {
+        samples.push_back({value, t});
+        t += period;
+    };
+
+    // Full-scale swings and sign flips on each field, alone and together
+    const int16_t extremes[] = {0, 32767, -32768, 32767, -1, 1, -32768, 0};
+    for (int16_t pitch : extremes) add(sample(pitch, 0));
+    for (int16_t roll : extremes) add(sample(0, roll));
+    for (size_t i = 0; i < 8; i++) add(sample(extremes[i], extremes[7 - i]));
+    add(sample(32767, -32768, 32767, 1));
+    add(sample(-32768, 32767, -32768, 0));
+
+    // Nibble edges: zigzag 14 fits in a nibble, 15 needs a varint
+    const int16_t edges[] = {7, 0, -7, 0, 8, 0, -8, 0, 7, -1, 8, -8};
+    for (int16_t delta : edges) add(sample(samples.back().sample.pitch + delta, samples.back().sample.roll - delta));
+
+    // A long run, a state change inside it, then a gap that needs a time token
+    for (int i = 0; i < 1000; i++) add(samples.back().sample);
+    add(sample(samples.back().sample.pitch, samples.back().sample.roll, 251, 1));
+    for (int i = 0; i < 3; i++) add(samples.back().sample);
+    t += 3600000;
+    add(sample(100, -100));
+    t -= period / 2;   // Early sample
+    add(sample(100, -100));
+
+    std::vector<TimedEvent> events = {
+        {LOG_EVENT_BOOT, 5000, 0xFFFFFFFFu},
+        {LOG_EVENT_PARKED, 9000, 0},
+        {LOG_EVENT_DECIMATION, 9000, 1200},
+        {LOG_EVENT_SENSOR_ERROR, samples.back().timeMs, 0x80000000u},
+    };
+    checkRoundTrip(samples, events, period);
+}
+
+// Random walks with occasional jumps, enough to span many blocks
+static void testCodecRandom() {
+    uint32_t random = 12345;
+    auto next = [&]() {
+        random = random * 1664525u + 1013904223u;
+        return random >> 8;
+    };
+
+    for (int run = 0; run < 20; run++) {
+        std::vector<TimedSample> samples;
+        std::vector<TimedEvent> events;
+        LogSample current = sample(0, 0);
+        uint32_t t = next() % 100000;
+        for (int i = 0; i < 5000; i++) {
+            uint32_t choice = next() % 100;
+            if (choice < 40) {
+                // Unchanged
+            } else if (choice < 85) {
+                current.pitch += (int16_t)(next() % 31) - 15;
+                current.roll += (int16_t)(next() % 31) - 15;
+            } else if (choice < 95) {
+                current.pitch = (int16_t)next();
+                current.roll = (int16_t)next();
+            } else {
+                current.temperature += (int16_t)(next() % 5) - 2;
+                current.parked = next() % 2;
+            }
+            if (next() % 50 == 0) t += next() % 100000;
+            if (next() % 200 == 0) events.push_back({(uint8_t)(1 + next() % 7), t, next()});
+            samples.push_back({current, t});
+            t += 1000;
+        }
+        checkRoundTrip(samples, events, 1000);
+    }
+}
+
+// The sample log on the simulated flash
+
+static uint32_t slotAddress(uint32_t sequence) {
+    return SAMPLE_LOG_ADDRESS + (sequence % SAMPLE_LOG_BLOCKS) * LOG_BLOCK_SIZE;
+}
+
+// The block stored for this sequence, if its slot still holds it
+static bool blockInFlash(uint32_t sequence) {
+    uint8_t block[LOG_BLOCK_SIZE];
+    if (!readFlash(slotAddress(sequence), block, sizeof(block)) || !logBlockIsValid(block)) return false;
+    LogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    return header.sequence == sequence;
+}
+
+// A power-up: RAM state is gone, the boot scan finds the ring again
+static SampleLogInfo reboot() {
+    simFlashRestorePower();
+    initSampleLog();
+    return getSampleLogInfo();
+}
+
+// Every logged sensor error is flushed at once, so each call writes one block
+static void writeBlock(uint32_t value) {
+    logEvent(LOG_EVENT_SENSOR_ERROR, value);
+    CHECK(waitForFlashIdle());
+}
+
+static void testRingWrap() {
+    reboot();
+    uint32_t target = SAMPLE_LOG_BLOCKS + 3 * SAMPLE_LOG_BLOCKS_PER_SECTOR + 5;
+    for (uint32_t i = 0; i < target; i++) writeBlock(i);
+
+    SampleLogInfo info = getSampleLogInfo();
+    CHECK_EQ(info.writeFailures, 0u);
+    CHECK_EQ(info.newestSequence, target - 1);
+
+    // Entering a sector erased the oldest one: a whole sector of old blocks is gone
+    uint32_t oldestExpected = (info.newestSequence / SAMPLE_LOG_BLOCKS_PER_SECTOR + 1) * SAMPLE_LOG_BLOCKS_PER_SECTOR -
+                              SAMPLE_LOG_BLOCKS;
+    CHECK_EQ(info.oldestSequence, oldestExpected);
+    CHECK(!blockInFlash(info.oldestSequence - 1));
+
+    // Every block from the oldest on is in its slot, across the end of the region
+    uint32_t missing = 0;
+    for (uint32_t sequence = info.oldestSequence; sequence <= info.newestSequence; sequence++) {
+        if (!blockInFlash(sequence)) missing++;
+    }
+    CHECK_EQ(missing, 0u);
+    CHECK(blockInFlash(SAMPLE_LOG_BLOCKS - 1));
+    CHECK(blockInFlash(SAMPLE_LOG_BLOCKS));
+
+    SampleLogInfo rebooted = reboot();
+    CHECK_EQ(rebooted.oldestSequence, info.oldestSequence);
+    CHECK_EQ(rebooted.newestSequence, info.newestSequence);
+}
+
+static void testTornBlock() {
+    SampleLogInfo info = reboot();
+    // A block in the middle of a sector, so no erase comes first
+    while ((info.newestSequence + 1) % SAMPLE_LOG_BLOCKS_PER_SECTOR < 2) {
+        writeBlock(0);
+        info = getSampleLogInfo();
+    }
+    uint32_t torn = info.newestSequence + 1;
+    std::vector<uint8_t> image(simFlashImage(), simFlashImage() + SIM_FLASH_SIZE);
+
+    for (long cut = 0; cut <= LOG_BLOCK_SIZE; cut++) {
+        memcpy(simFlashImage(), image.data(), image.size());
+        CHECK_EQ(reboot().newestSequence, torn - 1);
+
+        simFlashCutPowerAfter(cut);
+        writeBlock(1);
+        SampleLogInfo after = reboot();
+        bool complete = cut >= LOG_BLOCK_SIZE;
+        CHECK_EQ(after.newestSequence, complete ? torn : torn - 1);
+        CHECK_EQ(blockInFlash(torn), complete);
+
+        // The next block skips a dirty slot; an untouched one is used again
+        writeBlock(2);
+        uint32_t expected = cut == 0 ? torn : torn + 1;
+        after = getSampleLogInfo();
+        if (after.newestSequence != expected) {
+            fprintf(stderr, "cut after %ld bytes: next block %lu, expected %lu\n", cut,
+                    (unsigned long)after.newestSequence, (unsigned long)expected);
+            CHECK_EQ(after.newestSequence, expected);
+        }
+        CHECK(blockInFlash(expected));
+        CHECK_EQ(reboot().oldestSequence, info.oldestSequence);
+    }
+}
+
+// Download output goes to a session of its own and is kept here
+class CaptureTransport : public Transport {
+public:
+    CaptureTransport() : Transport("capture") {}
+    std::string output;
+
+    bool connected() override { return true; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int availableForWrite() override { return 4096; }
+    size_t write(const uint8_t* data, size_t length) override {
+        output.append((const char*)data, length);
+        return length;
+    }
+};
+
+static CaptureTransport capture;
+static CommandSession captureSession;
+static int captureIndex = -1;
+
+static std::string download(uint32_t fromSequence, uint16_t count, uint32_t& first) {
+    capture.output.clear();
+    {
+        SessionScope scope(captureIndex);
+        first = startSampleLogDownload(fromSequence, count);
+    }
+    for (int i = 0; i < 10000 && capture.output.find("logDownloadComplete") == std::string::npos; i++) {
+        serviceSampleLog();
+        SerialTx.service();
+    }
+    CHECK(capture.output.find("logDownloadComplete") != std::string::npos);
+    return capture.output;
+}
+
+struct DecodedRow {
+    uint32_t block;
+    uint32_t timeMs;
+    std::string type;
+    float pitch;
+    std::string event;
+};
+
+static const char* logDecode = NULL;
+
+static std::vector<DecodedRow> runLogDecode(const std::string& captured, int& status) {
+    char path[] = "/tmp/sample_log_test_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    CHECK_EQ(write(fd, captured.data(), captured.size()), (ssize_t)captured.size());
+    close(fd);
+
+    std::string command = std::string(logDecode) + " " + path + " 2>/dev/null";
+    FILE* pipe = popen(command.c_str(), "r");
+    std::vector<DecodedRow> rows;
+    char line[256];
+    while (pipe != NULL && fgets(line, sizeof(line), pipe) != NULL) {
+        // boot,block,time_ms,type,pitch,roll,temp_c,parked,event,value
+        std::vector<std::string> fields;
+        std::string field;
+        for (const char* c = line; *c != '\0' && *c != '\n'; c++) {
+            if (*c == ',') {
+                fields.push_back(field);
+                field.clear();
+            } else {
+                field += *c;
+            }
+        }
+        fields.push_back(field);
+        if (fields.size() != 10 || fields[0] == "boot") continue;
+        rows.push_back({(uint32_t)strtoul(fields[1].c_str(), NULL, 10), (uint32_t)strtoul(fields[2].c_str(), NULL, 10),
+                        fields[3], strtof(fields[4].c_str(), NULL), fields[8]});
+    }
+    status = pipe != NULL ? pclose(pipe) : -1;
+    unlink(path);
+    return rows;
+}
+
+static void testDownload() {
+    captureIndex = addCommandSession(captureSession, capture);
+    CHECK(captureIndex >= 0);
+    SampleLogInfo info = reboot();
+
+    // Samples with a known pitch each, in their own blocks at the head of the ring
+    setSampleLogDecimation(1);
+    std::vector<float> pitches;
+    for (int i = 0; i < 400; i++) {
+        currentPitch = (i % 50) * 0.37f - (i / 50) * 3.5f;
+        currentRoll = -currentPitch;
+        isParked = (i / 100) % 2;
+        logSample();
+        pitches.push_back(roundf(currentPitch * LOG_ANGLE_SCALE) / LOG_ANGLE_SCALE);
+        delay(SAMPLE_LOG_SAMPLE_INTERVAL_MS);
+    }
+    CHECK(flushSampleLog());
+    CHECK(waitForFlashIdle());
+    info = getSampleLogInfo();
+    CHECK(info.oldestSequence > 0);
+
+    // Resuming from a sequence that has been overwritten starts at the oldest block
+    uint32_t first;
+    std::string captured = download(0, 20, first);
+    CHECK_EQ(first, info.oldestSequence);
+    int status;
+    std::vector<DecodedRow> rows = runLogDecode(captured, status);
+    CHECK_EQ(status, 0);
+    CHECK(!rows.empty());
+    uint32_t minBlock = 0xFFFFFFFF, maxBlock = 0;
+    for (const DecodedRow& row : rows) {
+        if (row.block < minBlock) minBlock = row.block;
+        if (row.block > maxBlock) maxBlock = row.block;
+    }
+    CHECK_EQ(minBlock, info.oldestSequence);
+    CHECK_EQ(maxBlock, info.oldestSequence + 19);
+
+    // The newest blocks decode to exactly the samples logged
+    uint32_t from = info.newestSequence > 20 ? info.newestSequence - 20 : 0;
+    captured = download(from, SAMPLE_LOG_MAX_DOWNLOAD, first);
+    rows = runLogDecode(captured, status);
+    CHECK_EQ(status, 0);
+    std::vector<float> decoded;
+    for (const DecodedRow& row : rows) {
+        if (row.type == "sample") decoded.push_back(row.pitch);
+    }
+    CHECK(decoded.size() >= pitches.size());
+    size_t offset = decoded.size() >= pitches.size() ? decoded.size() - pitches.size() : 0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pitches.size() && offset + i < decoded.size(); i++) {
+        if (fabsf(decoded[offset + i] - pitches[i]) > 0.001f) mismatches++;
+    }
+    CHECK_EQ(mismatches, 0u);
+
+    // A download entirely past the newest block completes with nothing sent
+    captured = download(info.newestSequence + 100, 10, first);
+    rows = runLogDecode(captured, status);
+    CHECK(rows.empty());
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s LOG_DECODE\n", argv[0]);
+        return 2;
+    }
+
+    logDecode = argv[1];
+
+    RUN_TEST(testCodecExtremes);
+    RUN_TEST(testCodecRandom);
+
+    simClockSetMode(SIM_CLOCK_SIMULATED);
+    if (!simFlashOpen(NULL)) return 1;
+    CHECK(initFlashStorage());
+    RUN_TEST(testRingWrap);
+    RUN_TEST(testTornBlock);
+    RUN_TEST(testDownload);
+    return testSummary();
+}
@@ -0,0 +1,40 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+
+// Minimal checks for the host tests: a failed check is reported with its
+// location and fails the test binary, the remaining checks still run.
+
+static int testFailures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++;                                                           \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                    \
+    do {                                                                              \
+        if (!((actual) == (expected))) {                                              \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed\n", __FILE__, __LINE__,   \
+                    #actual, #expected);                                              \
+            testFailures++;                                                           \
+        }                                                                             \
+    } while (0)
+
+#define RUN_TEST(test)                                                                \
+    do {                                                                              \
+        int failuresBefore = testFailures;                                            \
+        test();                                                                       \
+        fprintf(stderr, "%-32s %s\n", #test, testFailures == failuresBefore ? "ok" : "FAILED"); \
+    } while (0)
+
+static int testSummary() {
+    if (testFailures > 0) fprintf(stderr, "%d check(s) failed\n", testFailures);
+    return testFailures > 0 ? 1 : 0;
+}
+
+#endif // TEST_CHECK_H
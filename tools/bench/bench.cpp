@@ -0,0 +1,247 @@
+// bench - host runner for the firmware microbenchmark suite
+//
+// Runs the cases in main/microbench.cpp (the same table <26> runs on the
+// device) against the firmware linked from the host build, after a normal
+// setup() on the simulated board. Each case is warmed up, its batch size
+// chosen so one batch takes --batch-ms, and --batches batches are timed.
+// Results are per operation: the median with a distribution-free 95%
+// confidence interval (order statistics), MAD, mean, standard deviation,
+// range and the number of batches more than 3 MADs from the median.
+//
+// --json writes the results for regression tracking; --baseline compares
+// against an earlier --json file and flags cases whose confidence intervals
+// no longer overlap and whose median moved by more than --threshold percent
+// (exit status 1 on a regression). Run on an idle machine, ideally pinned
+// (taskset -c 2 build/bench ...), and compare like with like builds.
+//
+// Build: cmake --build build --target bench
+// Usage: bench [--filter TEXT] [--batches N] [--batch-ms MS] [--warmup-ms MS]
+//              [--json] [--baseline FILE] [--threshold PCT] [--list]
+
+#include "microbench.h"
+#include "profiler.h"
+#include "sim_board.h"
+#include "sim_clock.h"
+#include "sim_flash.h"
+#include "sim_serial.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+extern const char* DEVICE_VERSION;
+
+struct BenchOptions {
+    const char* filter = nullptr;
+    int batches = 31;
+    double batchMs = 5.0;
+    double warmupMs = 50.0;
+    bool json = false;
+    const char* baselinePath = nullptr;
+    double thresholdPct = 5.0;
+    bool list = false;
+};
+
+struct CaseResult {
+    std::string name;
+    uint32_t iterations = 0;
+    double median = 0, ciLow = 0, ciHigh = 0;
+    double mean = 0, stddev = 0, mad = 0, min = 0, max = 0;
+    int outliers = 0;
+};
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--filter TEXT] [--batches N] [--batch-ms MS] [--warmup-ms MS]\n"
+                    "          [--json] [--baseline FILE] [--threshold PCT] [--list]\n", program);
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--filter") && hasValue) opt.filter = argv[++i];
+        else if (!strcmp(arg, "--batches") && hasValue) opt.batches = atoi(argv[++i]);
+        else if (!strcmp(arg, "--batch-ms") && hasValue) opt.batchMs = atof(argv[++i]);
+        else if (!strcmp(arg, "--warmup-ms") && hasValue) opt.warmupMs = atof(argv[++i]);
+        else if (!strcmp(arg, "--json")) opt.json = true;
+        else if (!strcmp(arg, "--baseline") && hasValue) opt.baselinePath = argv[++i];
+        else if (!strcmp(arg, "--threshold") && hasValue) opt.thresholdPct = atof(argv[++i]);
+        else if (!strcmp(arg, "--list")) opt.list = true;
+        else return false;
+    }
+    return opt.batches >= 5 && opt.batchMs > 0 && opt.batchMs < 4000;  // profileNow() wraps after 4.3s
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static CaseResult runCase(const BenchCase& bench, const BenchOptions& opt) {
+    CaseResult result;
+    result.name = bench.name;
+    if (bench.setup != nullptr) bench.setup();
+
+    // Warm caches, branch predictors and lazily grown buffers first
+    auto warmupStart = std::chrono::steady_clock::now();
+    uint32_t warmupIterations = 1;
+    while (elapsedMs(warmupStart) < opt.warmupMs) {
+        bench.run(bench.arg, warmupIterations);
+        if (warmupIterations < (1u << 20)) warmupIterations *= 2;
+    }
+
+    uint32_t targetTicks = (uint32_t)(opt.batchMs * 1000.0 * PROFILE_TICKS_PER_US);
+    result.iterations = benchCalibrate(bench, targetTicks);
+    std::vector<uint32_t> batchTicks(opt.batches);
+    benchMeasure(bench, result.iterations, batchTicks.data(), batchTicks.size());
+    if (bench.teardown != nullptr) bench.teardown();
+
+    std::vector<double> perOp;
+    for (uint32_t ticks : batchTicks) {
+        perOp.push_back(ticks * (1000.0 / PROFILE_TICKS_PER_US) / result.iterations);
+    }
+    std::sort(perOp.begin(), perOp.end());
+    size_t n = perOp.size();
+    result.median = n % 2 ? perOp[n / 2] : (perOp[n / 2 - 1] + perOp[n / 2]) / 2;
+    result.min = perOp.front();
+    result.max = perOp.back();
+
+    // Ranks bounding the median with 95% confidence (normal approximation to the binomial)
+    double spread = 1.96 * sqrt((double)n) / 2;
+    long low = (long)floor(n / 2.0 - spread) - 1;
+    long high = (long)ceil(n / 2.0 + spread);
+    result.ciLow = perOp[std::max(0L, low)];
+    result.ciHigh = perOp[std::min((long)n - 1, high)];
+
+    double sum = 0;
+    for (double value : perOp) sum += value;
+    result.mean = sum / n;
+    double squares = 0;
+    for (double value : perOp) squares += (value - result.mean) * (value - result.mean);
+    result.stddev = sqrt(squares / (n - 1));
+
+    std::vector<double> deviations;
+    for (double value : perOp) deviations.push_back(fabs(value - result.median));
+    std::sort(deviations.begin(), deviations.end());
+    result.mad = deviations[n / 2] * 1.4826;   // Scaled to match a standard deviation for normal data
+    for (double value : perOp) {
+        if (result.mad > 0 && fabs(value - result.median) > 3 * result.mad) result.outliers++;
+    }
+    return result;
+}
+
+static void printTable(const std::vector<CaseResult>& results) {
+    fprintf(stderr, "%-26s %10s %12s %23s %7s %5s\n", "case", "iters", "ns/op", "95% CI", "MAD%", "out");
+    for (const CaseResult& r : results) {
+        char ci[48];
+        snprintf(ci, sizeof(ci), "[%.1f, %.1f]", r.ciLow, r.ciHigh);
+        fprintf(stderr, "%-26s %10lu %12.1f %23s %6.2f%% %5d\n", r.name.c_str(), (unsigned long)r.iterations,
+                r.median, ci, r.median > 0 ? 100.0 * r.mad / r.median : 0.0, r.outliers);
+    }
+}
+
+static void printJSON(const std::vector<CaseResult>& results, const BenchOptions& opt) {
+    printf("{\"suite\":\"park_sensor_microbench\",\"firmware\":\"%s\",\"unit\":\"ns\",\"batches\":%d,\"batchMs\":%.1f,\"cases\":[",
+           DEVICE_VERSION, opt.batches, opt.batchMs);
+    for (size_t i = 0; i < results.size(); i++) {
+        const CaseResult& r = results[i];
+        printf("%s\n{\"name\":\"%s\",\"iterations\":%lu,\"median\":%.3f,\"ciLow\":%.3f,\"ciHigh\":%.3f,"
+               "\"mean\":%.3f,\"stddev\":%.3f,\"mad\":%.3f,\"min\":%.3f,\"max\":%.3f,\"outliers\":%d}",
+               i > 0 ? "," : "", r.name.c_str(), (unsigned long)r.iterations, r.median, r.ciLow, r.ciHigh,
+               r.mean, r.stddev, r.mad, r.min, r.max, r.outliers);
+    }
+    printf("\n]}\n");
+}
+
+static bool jsonNumber(const std::string& text, size_t from, const char* key, double& value) {
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t pos = text.find(pattern, from);
+    size_t end = text.find('}', from);
+    if (pos == std::string::npos || pos > end) return false;
+    value = atof(text.c_str() + pos + pattern.size());
+    return true;
+}
+
+// Cases in both runs, flagged when the intervals separate by more than the threshold
+static int compareBaseline(const std::vector<CaseResult>& results, const BenchOptions& opt) {
+    FILE* file = fopen(opt.baselinePath, "rb");
+    if (file == nullptr) {
+        perror(opt.baselinePath);
+        return 2;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, count);
+    fclose(file);
+
+    int regressions = 0;
+    fprintf(stderr, "\n%-26s %12s %12s %9s  %s\n", "case", "base ns/op", "ns/op", "change", "verdict");
+    for (const CaseResult& r : results) {
+        size_t pos = text.find("\"name\":\"" + r.name + "\"");
+        double median, ciLow, ciHigh;
+        if (pos == std::string::npos || !jsonNumber(text, pos, "median", median) ||
+            !jsonNumber(text, pos, "ciLow", ciLow) || !jsonNumber(text, pos, "ciHigh", ciHigh)) {
+            fprintf(stderr, "%-26s %12s %12.1f %9s  new\n", r.name.c_str(), "-", r.median, "-");
+            continue;
+        }
+        double change = median > 0 ? 100.0 * (r.median - median) / median : 0.0;
+        const char* verdict = "same";
+        if (r.ciLow > ciHigh && change > opt.thresholdPct) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (r.ciHigh < ciLow && change < -opt.thresholdPct) {
+            verdict = "faster";
+        }
+        fprintf(stderr, "%-26s %12.1f %12.1f %+8.1f%%  %s\n", r.name.c_str(), median, r.median, change, verdict);
+    }
+    return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (opt.list) {
+        for (size_t i = 0; i < getBenchCaseCount(); i++) {
+            const BenchCase& bench = getBenchCase(i);
+            printf("%02X %-26s %s\n", (unsigned)i, bench.name, (bench.flags & BENCH_HOST_ONLY) ? "host" : "host, device");
+        }
+        return 0;
+    }
+
+    // Boot the firmware on the simulated board. Its serial output goes to
+    // /dev/null through a copy of stdout, which keeps the results.
+    int resultsFd = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+    simBoardInit(argc, argv);
+    simClockSetMode(SIM_CLOCK_SIMULATED);
+    if (!simFlashOpen(nullptr)) return 1;
+    Serial.attachStdio(false);
+    setup();
+
+    std::vector<CaseResult> results;
+    for (size_t i = 0; i < getBenchCaseCount(); i++) {
+        const BenchCase& bench = getBenchCase(i);
+        if (opt.filter != nullptr && strstr(bench.name, opt.filter) == nullptr) continue;
+        results.push_back(runCase(bench, opt));
+    }
+
+    fflush(stdout);
+    dup2(resultsFd, STDOUT_FILENO);
+    close(resultsFd);
+    printTable(results);
+    if (opt.json) printJSON(results, opt);
+    return opt.baselinePath != nullptr ? compareBaseline(results, opt) : 0;
+}
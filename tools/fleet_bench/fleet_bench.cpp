@@ -0,0 +1,563 @@
+// fleet_bench - scale benchmark for fleet_monitor
+//
+// Emulates a fleet of park sensors on pseudo-terminals and runs fleet_monitor
+// against it, one fleet size after another. The emulators all live on this
+// process's epoll loop and speak enough of the protocol for the monitor: the
+// <01>, <03>, <14>, <15> commands with acks, JSON telemetry at the subscribed
+// period, and parked/unparked notifications. For each size the benchmark
+// reports:
+//
+//   - startup: time until the monitor reports every device healthy
+//   - CPU: the monitor's CPU time over a steady window (from /proc),
+//     per device-second and per telemetry line; flat across sizes if the
+//     per-device cost does not grow with the fleet
+//   - reaction: from writing a park change notification on one device's pty
+//     to receiving the matching event on the monitor's /events stream
+//
+// Build: cmake --build build --target fleet_bench fleet_monitor
+// Usage: fleet_bench [--monitor PATH] [--sizes 50,100,200,500] [--workers N] [--stream-ms MS]
+//                    [--measure-s S] [--changes N] [--listen-port PORT] [--json] [--verbose]
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <queue>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    std::string monitor;
+    std::vector<int> sizes = {50, 100, 200, 500};
+    int workers = 0;
+    int streamMs = 200;
+    int measureS = 10;
+    int changes = 40;
+    int listenPort = 11290;
+    bool json = false;
+    bool verbose = false;
+};
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[std::min(rank, values.size() - 1)];
+}
+
+// Integer value of "key": in a JSON text, or -1
+static long jsonNumber(const std::string& text, const char* key) {
+    std::string needle = std::string("\"") + key + "\":";
+    size_t pos = text.find(needle);
+    if (pos == std::string::npos) return -1;
+    return atol(text.c_str() + pos + needle.size());
+}
+
+// --- Emulated devices ---
+
+struct EmulatedDevice {
+    int master = -1;
+    int slave = -1;                   // Held open so the master never reads EIO between monitor opens
+    std::string path;
+    int index = 0;
+    std::string rx;
+    bool parked = true;
+    float pitch = 0.1f, roll = -0.2f;
+    unsigned long seq = 0, eventSeq = 0;
+    int periodMs = 0;                 // 0 when not subscribed
+    double nextTelemetryMs = 0;
+    unsigned long commands = 0, telemetryLines = 0;
+};
+
+class Fleet {
+public:
+    explicit Fleet(const Options& opt) : opt(opt) { epollFd = epoll_create1(EPOLL_CLOEXEC); }
+
+    std::vector<EmulatedDevice> devices;
+    int epollFd;
+
+    bool create(int count) {
+        devices.resize(count);
+        for (int i = 0; i < count; i++) {
+            EmulatedDevice& device = devices[i];
+            device.index = i;
+            device.master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+            if (device.master < 0 || grantpt(device.master) < 0 || unlockpt(device.master) < 0) {
+                perror("posix_openpt");
+                return false;
+            }
+            device.path = ptsname(device.master);
+            device.slave = open(device.path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+            struct termios settings;
+            tcgetattr(device.slave, &settings);
+            cfmakeraw(&settings);
+            tcsetattr(device.slave, TCSANOW, &settings);
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u32 = i;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, device.master, &event);
+        }
+        return true;
+    }
+
+    void destroy() {
+        for (EmulatedDevice& device : devices) {
+            close(device.master);
+            close(device.slave);
+        }
+        devices.clear();
+        while (!telemetryQueue.empty()) telemetryQueue.pop();
+    }
+
+    bool writePortsFile(const char* path) {
+        FILE* file = fopen(path, "w");
+        if (file == nullptr) return false;
+        for (const EmulatedDevice& device : devices) fprintf(file, "scope%03d %s\n", device.index, device.path.c_str());
+        fclose(file);
+        return true;
+    }
+
+    // Services commands and telemetry; extra is polled too and its readiness returned
+    bool poll(int timeoutMs, int extraFd = -1) {
+        double now = nowMs();
+        if (!telemetryQueue.empty()) {
+            timeoutMs = std::min(timeoutMs, (int)std::max(0.0, telemetryQueue.top().first - now));
+        }
+        if (extraFd >= 0 && !extraWatched) {
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u32 = EXTRA;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, extraFd, &event);
+            extraWatched = true;
+        }
+        struct epoll_event ready[256];
+        int count = epoll_wait(epollFd, ready, 256, timeoutMs);
+        bool extraReady = false;
+        now = nowMs();
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.u32 == EXTRA) extraReady = true;
+            else readDevice(devices[ready[i].data.u32], now);
+        }
+        sendTelemetry(now);
+        return extraReady;
+    }
+
+    void forgetExtra(int fd) {
+        if (!extraWatched) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        extraWatched = false;
+    }
+
+    void changePark(EmulatedDevice& device, bool parked) {
+        device.parked = parked;
+        device.eventSeq++;
+        device.pitch = parked ? 0.1f : 32.5f;
+        char line[320];
+        snprintf(line, sizeof(line),
+                 "{\"notification\":\"%s\",\"data\":{\"parked\":%s,\"reason\":\"%s\",\"timestamp\":%lu,"
+                 "\"eventSeq\":%lu,\"sampleSeq\":%lu,\"pitch\":%.2f,\"roll\":%.2f}}\r\n",
+                 parked ? "parked" : "unparked", parked ? "true" : "false", parked ? "position" : "moved",
+                 (unsigned long)nowMs(), device.eventSeq, device.seq, device.pitch, device.roll);
+        send(device, line);
+    }
+
+    unsigned long telemetryLines() const {
+        unsigned long total = 0;
+        for (const EmulatedDevice& device : devices) total += device.telemetryLines;
+        return total;
+    }
+
+private:
+    const Options& opt;
+    typedef std::pair<double, int> Due;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> telemetryQueue;
+    bool extraWatched = false;
+    static const uint32_t EXTRA = 0xFFFFFFFF;
+
+    void send(EmulatedDevice& device, const char* line) {
+        ssize_t ignored = write(device.master, line, strlen(line));
+        (void)ignored;
+    }
+
+    void readDevice(EmulatedDevice& device, double now) {
+        char buffer[1024];
+        ssize_t count;
+        while ((count = read(device.master, buffer, sizeof(buffer))) > 0) device.rx.append(buffer, count);
+        for (;;) {
+            size_t start = device.rx.find('<');
+            size_t end = device.rx.find('>', start);
+            if (start == std::string::npos || end == std::string::npos) break;
+            std::string command = device.rx.substr(start + 1, end - start - 1);
+            device.rx.erase(0, end + 1);
+            if (!command.empty()) handleCommand(device, command, now);
+        }
+        if (device.rx.find('<') == std::string::npos) device.rx.clear();
+    }
+
+    void handleCommand(EmulatedDevice& device, const std::string& command, double now) {
+        device.commands++;
+        char line[512];
+        snprintf(line, sizeof(line), "{\"status\":\"ack\",\"command\":\"%s\"}\r\n", command.c_str());
+        send(device, line);
+
+        std::string code = command.substr(0, 2);
+        if (code == "01") {
+            snprintf(line, sizeof(line),
+                     "{\"status\":\"ok\",\"data\":{\"deviceName\":\"Telescope Park Sensor\",\"version\":\"1.0.0\","
+                     "\"manufacturer\":\"Emulated\",\"parked\":%s,\"uptime\":%lu}}\r\n",
+                     device.parked ? "true" : "false", (unsigned long)now);
+        } else if (code == "03") {
+            snprintf(line, sizeof(line),
+                     "{\"status\":\"ok\",\"data\":{\"parked\":%s,\"currentPitch\":%.2f,\"currentRoll\":%.2f,"
+                     "\"parkPitch\":0.00,\"parkRoll\":0.00,\"positionTolerance\":2.00}}\r\n",
+                     device.parked ? "true" : "false", device.pitch, device.roll);
+        } else if (code == "14" && command.size() == 10) {
+            device.periodMs = std::max(50, atoi(command.c_str() + 6));
+            // Phase the fleet's streams like independently booted devices
+            device.nextTelemetryMs = now + (device.index * 7919 % 1000) / 1000.0 * device.periodMs;
+            telemetryQueue.push(Due(device.nextTelemetryMs, device.index));
+            snprintf(line, sizeof(line), "{\"status\":\"ok\",\"data\":{\"subscribed\":true,\"periodMs\":%d}}\r\n",
+                     device.periodMs);
+        } else if (code == "15") {
+            device.periodMs = 0;
+            snprintf(line, sizeof(line), "{\"status\":\"ok\",\"data\":{\"subscribed\":false}}\r\n");
+        } else {
+            snprintf(line, sizeof(line), "{\"status\":\"error\",\"message\":\"Unknown command\"}\r\n");
+        }
+        send(device, line);
+    }
+
+    void sendTelemetry(double now) {
+        while (!telemetryQueue.empty() && telemetryQueue.top().first <= now) {
+            Due due = telemetryQueue.top();
+            telemetryQueue.pop();
+            EmulatedDevice& device = devices[due.second];
+            // Resubscribing queues a second entry; only the current schedule fires
+            if (device.periodMs == 0 || due.first != device.nextTelemetryMs) continue;
+            device.seq += device.periodMs / 10;
+            device.telemetryLines++;
+            char line[256];
+            snprintf(line, sizeof(line),
+                     "{\"telemetry\":{\"t\":%lu,\"seq\":%lu,\"pitch\":%.2f,\"roll\":%.2f,\"parked\":%s}}\r\n",
+                     (unsigned long)now, device.seq, device.pitch, device.roll, device.parked ? "true" : "false");
+            send(device, line);
+            device.nextTelemetryMs += device.periodMs;
+            if (device.nextTelemetryMs < now) device.nextTelemetryMs = now + device.periodMs;
+            telemetryQueue.push(Due(device.nextTelemetryMs, device.index));
+        }
+    }
+};
+
+// --- Monitor process ---
+
+static pid_t startMonitor(const Options& opt, const char* portsFile) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    prctl(PR_SET_PDEATHSIG, SIGTERM);   // Never outlive an interrupted benchmark
+    std::string listen = "127.0.0.1:" + std::to_string(opt.listenPort);
+    std::string workers = std::to_string(opt.workers);
+    std::string streamMs = std::to_string(opt.streamMs);
+    if (!opt.verbose) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDERR_FILENO);
+    }
+    execl(opt.monitor.c_str(), opt.monitor.c_str(), "--ports", portsFile, "--listen", listen.c_str(), "--workers",
+          workers.c_str(), "--stream-ms", streamMs.c_str(), opt.verbose ? "--verbose" : (char*)nullptr, (char*)nullptr);
+    perror(opt.monitor.c_str());
+    _exit(127);
+}
+
+// CPU seconds of a process and all its threads: nanoseconds from schedstat,
+// else clock ticks of user+system time
+static double processCpuS(pid_t pid) {
+    char path[300], text[1024];
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    DIR* tasks = opendir(path);
+    unsigned long long totalNs = 0;
+    bool haveSchedstat = tasks != nullptr;
+    for (struct dirent* task; haveSchedstat && (task = readdir(tasks)) != nullptr;) {
+        if (task->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "/proc/%d/task/%s/schedstat", (int)pid, task->d_name);
+        FILE* file = fopen(path, "r");
+        unsigned long long runNs = 0;
+        if (file == nullptr) continue;   // The thread just exited
+        haveSchedstat = fscanf(file, "%llu", &runNs) == 1;
+        fclose(file);
+        totalNs += runNs;
+    }
+    if (tasks != nullptr) closedir(tasks);
+    if (haveSchedstat) return totalNs / 1e9;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) return 0;
+    size_t length = fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    text[length] = '\0';
+    // Fields after the parenthesised command name; utime and stime are the 14th and 15th
+    const char* p = strrchr(text, ')');
+    if (p == nullptr) return 0;
+    unsigned long utime = 0, stime = 0;
+    sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime);
+    return (utime + stime) / (double)sysconf(_SC_CLK_TCK);
+}
+
+static int connectMonitor(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Body of a GET, or empty if the monitor does not answer
+static std::string httpGet(int port, const char* path) {
+    int fd = connectMonitor(port);
+    if (fd < 0) return std::string();
+    std::string request = std::string("GET ") + path + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    ssize_t ignored = write(fd, request.data(), request.size());
+    (void)ignored;
+    std::string response;
+    char buffer[8192];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) response.append(buffer, count);
+    close(fd);
+    size_t body = response.find("\r\n\r\n");
+    return body == std::string::npos ? std::string() : response.substr(body + 4);
+}
+
+struct Result {
+    int devices = 0;
+    double startupS = 0;
+    double cpuPercent = 0;
+    double cpuUsPerDeviceS = 0;
+    double cpuUsPerLine = 0;
+    unsigned long lines = 0;
+    std::vector<double> reactionsMs;
+    int lost = 0;
+    long parseErrors = 0;
+    long timeouts = 0;
+    bool ok = false;
+};
+
+// Services the fleet for a while, keeping the monitor fed
+static void runFor(Fleet& fleet, double ms) {
+    double until = nowMs() + ms;
+    while (nowMs() < until) fleet.poll((int)std::max(0.0, until - nowMs()));
+}
+
+static bool waitHealthy(const Options& opt, Fleet& fleet, int count, double timeoutMs) {
+    double deadline = nowMs() + timeoutMs;
+    while (nowMs() < deadline) {
+        runFor(fleet, 100);
+        std::string fleetJSON = httpGet(opt.listenPort, "/fleet");
+        if (jsonNumber(fleetJSON, "ok") == count && jsonNumber(fleetJSON, "unknown") == 0) return true;
+    }
+    return false;
+}
+
+static Result benchmarkSize(const Options& opt, int count) {
+    Result result;
+    result.devices = count;
+    Fleet fleet(opt);
+    if (!fleet.create(count)) return result;
+    char portsFile[] = "/tmp/fleet_bench_portsXXXXXX";
+    int portsFd = mkstemp(portsFile);
+    close(portsFd);
+    fleet.writePortsFile(portsFile);
+
+    double startMs = nowMs();
+    pid_t monitor = startMonitor(opt, portsFile);
+    if (!waitHealthy(opt, fleet, count, 30000 + count * 100.0)) {
+        fprintf(stderr, "%d devices: monitor did not report the fleet healthy\n", count);
+        kill(monitor, SIGTERM);
+        waitpid(monitor, nullptr, 0);
+        fleet.destroy();
+        unlink(portsFile);
+        return result;
+    }
+    result.startupS = (nowMs() - startMs) / 1000.0;
+
+    // Steady state: telemetry only
+    runFor(fleet, 1000);
+    unsigned long linesBefore = fleet.telemetryLines();
+    double cpuBefore = processCpuS(monitor);
+    double windowStart = nowMs();
+    runFor(fleet, opt.measureS * 1000.0);
+    double windowS = (nowMs() - windowStart) / 1000.0;
+    double cpuS = processCpuS(monitor) - cpuBefore;
+    result.lines = fleet.telemetryLines() - linesBefore;
+    result.cpuPercent = cpuS / windowS * 100.0;
+    result.cpuUsPerDeviceS = cpuS * 1e6 / (count * windowS);
+    result.cpuUsPerLine = result.lines ? cpuS * 1e6 / result.lines : 0;
+
+    // Reaction: one park change at a time, watched on the event stream
+    int events = connectMonitor(opt.listenPort);
+    const char* subscribe = "GET /events HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ssize_t ignored = write(events, subscribe, strlen(subscribe));
+    (void)ignored;
+    fcntl(events, F_SETFL, O_NONBLOCK);
+    std::string stream;
+    runFor(fleet, 200);
+    unsigned int seed = 12345;
+    for (int i = 0; i < opt.changes; i++) {
+        EmulatedDevice& device = fleet.devices[rand_r(&seed) % count];
+        bool parked = !device.parked;
+        char expected[128];
+        snprintf(expected, sizeof(expected), "\"device\":\"scope%03d\",\"parked\":%s", device.index,
+                 parked ? "true" : "false");
+        double sentMs = nowMs();
+        fleet.changePark(device, parked);
+        bool seen = false;
+        while (!seen && nowMs() - sentMs < 2000) {
+            if (!fleet.poll(50, events)) continue;
+            char buffer[8192];
+            ssize_t received;
+            while ((received = read(events, buffer, sizeof(buffer))) > 0) stream.append(buffer, received);
+            size_t found = stream.find(expected);
+            if (found != std::string::npos) {
+                result.reactionsMs.push_back(nowMs() - sentMs);
+                stream.erase(0, found);
+                seen = true;
+            }
+        }
+        if (!seen) result.lost++;
+        runFor(fleet, 50 + rand_r(&seed) % 100);   // Changes land at random points of the stream period
+    }
+    fleet.forgetExtra(events);
+    close(events);
+
+    std::string fleetJSON = httpGet(opt.listenPort, "/fleet");
+    result.parseErrors = jsonNumber(fleetJSON, "parseErrors");
+    result.timeouts = jsonNumber(fleetJSON, "timeouts");
+    result.ok = true;
+
+    kill(monitor, SIGTERM);
+    waitpid(monitor, nullptr, 0);
+    fleet.destroy();
+    unlink(portsFile);
+    return result;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--monitor PATH] [--sizes 50,100,200,500] [--workers N] [--stream-ms MS]\n"
+            "          [--measure-s S] [--changes N] [--listen-port PORT] [--json] [--verbose]\n", program);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--monitor") && hasValue) opt.monitor = argv[++i];
+        else if (!strcmp(arg, "--sizes") && hasValue) {
+            opt.sizes.clear();
+            for (char* size = strtok(argv[++i], ","); size != nullptr; size = strtok(nullptr, ",")) {
+                opt.sizes.push_back(atoi(size));
+            }
+        }
+        else if (!strcmp(arg, "--workers") && hasValue) opt.workers = atoi(argv[++i]);
+        else if (!strcmp(arg, "--stream-ms") && hasValue) opt.streamMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--measure-s") && hasValue) opt.measureS = atoi(argv[++i]);
+        else if (!strcmp(arg, "--changes") && hasValue) opt.changes = atoi(argv[++i]);
+        else if (!strcmp(arg, "--listen-port") && hasValue) opt.listenPort = atoi(argv[++i]);
+        else if (!strcmp(arg, "--json")) opt.json = true;
+        else if (!strcmp(arg, "--verbose")) opt.verbose = true;
+        else return false;
+    }
+    for (int size : opt.sizes) {
+        if (size <= 0 || size > 1000) return false;   // scope%03d names
+    }
+    return !opt.sizes.empty() && opt.streamMs >= 50 && opt.measureS > 0 && opt.changes >= 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (opt.monitor.empty()) {
+        // Built next to this tool by default
+        std::string self = argv[0];
+        size_t slash = self.rfind('/');
+        opt.monitor = (slash == std::string::npos ? std::string(".") : self.substr(0, slash)) + "/fleet_monitor";
+    }
+
+    // Two descriptors per emulated device
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Result> results;
+    if (!opt.json) {
+        printf("%d worker%s, telemetry every %d ms, %d s CPU window, %d park changes per size\n\n", opt.workers,
+               opt.workers == 1 ? "" : "s", opt.streamMs, opt.measureS, opt.changes);
+        printf("%8s %10s %8s %14s %10s %13s %13s %13s %6s %8s\n", "devices", "startup_s", "cpu_%", "cpu_us/dev/s",
+               "us/line", "react_p50_ms", "react_p99_ms", "react_max_ms", "lost", "errors");
+        fflush(stdout);
+    }
+    for (int size : opt.sizes) {
+        Result result = benchmarkSize(opt, size);
+        results.push_back(result);
+        if (!opt.json) {
+            if (!result.ok) {
+                printf("%8d %10s\n", size, "failed");
+                continue;
+            }
+            printf("%8d %10.2f %8.2f %14.1f %10.1f %13.2f %13.2f %13.2f %6d %8ld\n", size, result.startupS,
+                   result.cpuPercent, result.cpuUsPerDeviceS, result.cpuUsPerLine,
+                   percentile(result.reactionsMs, 50), percentile(result.reactionsMs, 99),
+                   percentile(result.reactionsMs, 100), result.lost, result.parseErrors + result.timeouts);
+            fflush(stdout);
+        }
+    }
+
+    if (opt.json) {
+        printf("{\"workers\":%d,\"streamMs\":%d,\"measureS\":%d,\"results\":[", opt.workers, opt.streamMs,
+               opt.measureS);
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            printf("%s{\"devices\":%d,\"ok\":%s,\"startupS\":%.3f,\"cpuPercent\":%.3f,\"cpuUsPerDeviceS\":%.2f,"
+                   "\"cpuUsPerLine\":%.2f,\"lines\":%lu,\"reactionMs\":{\"n\":%zu,\"p50\":%.3f,\"p99\":%.3f,"
+                   "\"max\":%.3f},\"lost\":%d,\"parseErrors\":%ld,\"timeouts\":%ld}",
+                   i ? "," : "", result.devices, result.ok ? "true" : "false", result.startupS, result.cpuPercent,
+                   result.cpuUsPerDeviceS, result.cpuUsPerLine, result.lines, result.reactionsMs.size(),
+                   percentile(result.reactionsMs, 50), percentile(result.reactionsMs, 99),
+                   percentile(result.reactionsMs, 100), result.lost, result.parseErrors, result.timeouts);
+        }
+        printf("]}\n");
+    }
+    for (const Result& result : results) {
+        if (!result.ok || result.lost > 0) return 1;
+    }
+    return 0;
+}
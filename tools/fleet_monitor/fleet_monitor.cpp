@@ -0,0 +1,1272 @@
+// fleet_monitor - one daemon watching the park sensors of a whole observatory
+//
+// Opens every sensor port (or simulator pty) non-blocking on one epoll loop,
+// subscribes each to JSON telemetry and keeps per-device state: park state,
+// position, identity, health and the latency of a periodic <03> probe. With
+// --workers N the devices are split over N threads, each with its own epoll
+// loop; without it everything runs on the main loop.
+//
+// Device lines are read straight into a fixed per-device buffer and scanned
+// in place: complete lines are found incrementally (bytes are looked at once)
+// and walked by a small JSON scanner that reports members as spans of the
+// buffer, so steady-state processing neither copies nor allocates. Per-device
+// work therefore depends on that device's traffic, not on the fleet size;
+// timers live in a heap, so idle devices cost nothing.
+//
+// Aggregate queries, over HTTP on localhost:
+//   GET /fleet                  counts by health and park state, unparked devices, probe latency
+//   GET /devices[?health=H&parked=true|false]   every device's state
+//   GET /devices/NAME           one device
+//   GET /events                 Server-Sent Events: park changes and health changes
+//
+// Health is "ok" while telemetry arrives, "stale" when it has stopped for three
+// periods (the subscription is renewed), "silent" when nothing at all has been
+// heard for --timeout, and "disconnected" while the port cannot be opened.
+// Devices are unsubscribed with <15> on SIGINT/SIGTERM.
+// tools/fleet_bench measures the daemon against hundreds of emulated devices.
+//
+// Build: cmake --build build --target fleet_monitor
+// Usage: fleet_monitor (--port [NAME=]PATH ... | --ports FILE) [--listen ADDR:PORT] [--workers N]
+//                      [--stream-ms MS] [--probe-ms MS] [--timeout MS] [--verbose]
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <queue>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#define FRAME_SYNC_1 0xA5
+#define FRAME_SYNC_2 0x5A
+#define RX_BUFFER_SIZE 4096           // Longer than any device line
+#define MAX_PENDING_COMMANDS 8
+#define LATENCY_BUCKETS 96            // Quarter octaves from 1us to 16s
+#define MAX_JSON_DEPTH 16
+#define MAX_HTTP_REQUEST 16384
+#define MAX_CLIENT_BACKLOG 1048576    // Unsent bytes before a slow event subscriber is dropped
+#define REOPEN_INTERVAL_MS 2000
+#define KEEPALIVE_INTERVAL_MS 15000
+#define STREAM_FIELDS "2B"            // pitch, roll, parked, sequence
+
+struct Options {
+    std::vector<std::pair<std::string, std::string>> ports;   // Name, path
+    std::string listenAddress = "127.0.0.1";
+    int listenPort = 11112;
+    int workers = 0;
+    int streamMs = 1000;
+    int probeMs = 10000;
+    int timeoutMs = 3000;
+    bool verbose = false;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+static sigset_t waitMask;             // SIGINT/SIGTERM are only delivered inside epoll_pwait
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static double wallMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// --- Zero-copy JSON scanner ---
+
+struct Span {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    bool is(const char* text) const {
+        size_t length = strlen(text);
+        return length == size && memcmp(data, text, length) == 0;
+    }
+    bool empty() const { return size == 0; }
+};
+
+enum JsonType { JSON_STRING, JSON_NUMBER, JSON_TRUE, JSON_FALSE, JSON_NULL };
+
+// Walks one JSON text in place and calls visit(parent, key, value, type) for
+// every scalar member, where parent is the key of the enclosing object (empty
+// at the top level). Strings are reported without their quotes and with any
+// escapes left as they are. Returns false on malformed input.
+template <class Visitor>
+class JsonScanner {
+public:
+    JsonScanner(const char* begin, const char* end, Visitor& visit) : p(begin), end(end), visit(visit) {}
+
+    bool scan() {
+        skipSpace();
+        if (!object(Span(), 0)) return false;
+        skipSpace();
+        return p == end;
+    }
+
+private:
+    const char* p;
+    const char* end;
+    Visitor& visit;
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    }
+
+    bool string(Span& out) {
+        if (p >= end || *p != '"') return false;
+        const char* start = ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') p++;
+            p++;
+        }
+        if (p >= end) return false;
+        out.data = start;
+        out.size = p - start;
+        p++;
+        return true;
+    }
+
+    bool literal(const char* text) {
+        size_t length = strlen(text);
+        if ((size_t)(end - p) < length || memcmp(p, text, length) != 0) return false;
+        p += length;
+        return true;
+    }
+
+    bool object(Span parent, int depth) {
+        if (p >= end || *p != '{' || depth > MAX_JSON_DEPTH) return false;
+        p++;
+        skipSpace();
+        if (p < end && *p == '}') {
+            p++;
+            return true;
+        }
+        for (;;) {
+            Span key;
+            skipSpace();
+            if (!string(key)) return false;
+            skipSpace();
+            if (p >= end || *p != ':') return false;
+            p++;
+            skipSpace();
+            if (!value(parent, key, depth)) return false;
+            skipSpace();
+            if (p < end && *p == ',') {
+                p++;
+                continue;
+            }
+            if (p < end && *p == '}') {
+                p++;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    bool array(Span parent, Span key, int depth) {
+        if (depth > MAX_JSON_DEPTH) return false;
+        p++;
+        skipSpace();
+        if (p < end && *p == ']') {
+            p++;
+            return true;
+        }
+        for (;;) {
+            skipSpace();
+            if (!value(parent, key, depth)) return false;   // Elements are reported under the array's key
+            skipSpace();
+            if (p < end && *p == ',') {
+                p++;
+                continue;
+            }
+            if (p < end && *p == ']') {
+                p++;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    bool value(Span parent, Span key, int depth) {
+        if (p >= end) return false;
+        Span span;
+        switch (*p) {
+            case '{': return object(key, depth + 1);
+            case '[': return array(parent, key, depth + 1);
+            case '"':
+                if (!string(span)) return false;
+                visit(parent, key, span, JSON_STRING);
+                return true;
+            case 't':
+            case 'f':
+            case 'n': {
+                span.data = p;
+                JsonType type = *p == 't' ? JSON_TRUE : *p == 'f' ? JSON_FALSE : JSON_NULL;
+                if (!literal(type == JSON_TRUE ? "true" : type == JSON_FALSE ? "false" : "null")) return false;
+                span.size = p - span.data;
+                visit(parent, key, span, type);
+                return true;
+            }
+            default: {
+                span.data = p;
+                while (p < end && (isdigit((unsigned char)*p) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' ||
+                                   *p == 'E')) {
+                    p++;
+                }
+                span.size = p - span.data;
+                if (span.size == 0) return false;
+                visit(parent, key, span, JSON_NUMBER);
+                return true;
+            }
+        }
+    }
+};
+
+// Decimal number of a span, without the NUL terminator strtod needs
+static double spanNumber(Span span) {
+    const char* p = span.data;
+    const char* end = p + span.size;
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) p++;
+    double value = 0;
+    while (p < end && isdigit((unsigned char)*p)) value = value * 10 + (*p++ - '0');
+    if (p < end && *p == '.') {
+        double scale = 0.1;
+        for (p++; p < end && isdigit((unsigned char)*p); p++, scale *= 0.1) value += (*p - '0') * scale;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = p < end && *p == '-';
+        if (negativeExponent || (p < end && *p == '+')) p++;
+        int exponent = 0;
+        while (p < end && isdigit((unsigned char)*p)) exponent = exponent * 10 + (*p++ - '0');
+        value *= pow(10.0, negativeExponent ? -exponent : exponent);
+    }
+    return negative ? -value : value;
+}
+
+static void copySpan(char* out, size_t size, Span span) {
+    size_t length = std::min(span.size, size - 1);
+    memcpy(out, span.data, length);
+    out[length] = '\0';
+}
+
+static std::string jsonString(const char* value) {
+    std::string out = "\"";
+    for (const char* c = value; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+            out += *c;
+        } else if ((unsigned char)*c >= 32) {
+            out += *c;
+        }
+    }
+    return out + "\"";
+}
+
+// --- Devices ---
+
+enum Health { HEALTH_OK, HEALTH_STALE, HEALTH_SILENT, HEALTH_DISCONNECTED, HEALTH_COUNT };
+static const char* HEALTH_NAMES[HEALTH_COUNT] = {"ok", "stale", "silent", "disconnected"};
+
+struct LatencyHistogram {
+    uint32_t buckets[LATENCY_BUCKETS] = {};
+    uint32_t count = 0;
+    double maxUs = 0;
+
+    void add(double us) {
+        int bucket = us < 1 ? 0 : (int)(4 * log2(us));
+        buckets[std::min(bucket, LATENCY_BUCKETS - 1)]++;
+        count++;
+        maxUs = std::max(maxUs, us);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < LATENCY_BUCKETS; i++) buckets[i] += other.buckets[i];
+        count += other.count;
+        maxUs = std::max(maxUs, other.maxUs);
+    }
+
+    // Upper edge of the bucket holding the percentile, within a quarter octave
+    double percentile(double p) const {
+        if (count == 0) return 0;
+        uint32_t rank = (uint32_t)ceil(p / 100.0 * count);
+        uint32_t seen = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) return std::min(maxUs, pow(2.0, (i + 1) / 4.0));
+        }
+        return maxUs;
+    }
+};
+
+struct PendingCommand {
+    char command[16];
+    double sentMs;
+    bool acked;
+};
+
+struct Device {
+    // Configuration
+    char name[64];
+    std::string path;
+    int index = 0;
+
+    // Link
+    int fd = -1;
+    char rx[RX_BUFFER_SIZE];
+    size_t fill = 0;                  // Bytes in rx
+    size_t scanned = 0;               // Bytes of rx already searched for a line end
+    bool discarding = false;          // Dropping the rest of an overlong line
+    PendingCommand pending[MAX_PENDING_COMMANDS];
+    int pendingCount = 0;
+
+    // State
+    bool stateKnown = false;
+    bool parked = false;
+    float pitch = 0, roll = 0;
+    unsigned long sampleSeq = 0, eventSeq = 0;
+    char reason[24] = "";
+    char deviceName[48] = "";
+    char version[16] = "";
+    double changedWallMs = 0;
+    Health health = HEALTH_DISCONNECTED;
+
+    // Timing
+    double openedMs = 0, lastRxMs = 0, lastTelemetryMs = 0;
+    double nextProbeMs = 0, reopenAtMs = 0;
+    double timerMs = 0;               // Earliest deadline, as queued in the shard's heap
+
+    // Counters
+    unsigned long rxBytes = 0, lines = 0, telemetry = 0, notifications = 0, parseErrors = 0;
+    unsigned long commands = 0, timeouts = 0, opens = 0, resubscribes = 0, txDropped = 0;
+    LatencyHistogram latency;
+};
+
+struct FleetEvent {
+    std::string name;                 // SSE event name
+    std::string data;
+};
+
+class EventQueue {
+public:
+    EventQueue() : fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+    void push(const char* name, std::string data) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back({name, std::move(data)});
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(fd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    std::vector<FleetEvent> take() {
+        uint64_t count;
+        ssize_t ignored = read(fd, &count, sizeof(count));
+        (void)ignored;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<FleetEvent> taken;
+        taken.swap(events);
+        return taken;
+    }
+
+    int fd;
+
+private:
+    std::mutex mutex;
+    std::vector<FleetEvent> events;
+};
+
+// A group of devices on one epoll loop. The main thread runs shard 0 inline
+// when there are no workers; otherwise each shard has its own thread.
+class Shard {
+public:
+    Shard(const Options& opt, EventQueue& events, int stopFd) : opt(opt), events(events) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;     // Stop signal
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &event);
+    }
+
+    std::vector<Device*> devices;
+    std::mutex mutex;                 // Held while device state changes; queries take it to read
+    int epollFd;
+    unsigned long wakeups = 0, readyEvents = 0;
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        double now = nowMs();
+        for (Device* device : devices) openPort(*device, now);
+    }
+
+    // Services ready devices and due timers; returns false once stopped
+    bool poll(int timeoutMs) {
+        struct epoll_event ready[128];
+        int count = epoll_wait(epollFd, ready, 128, timeoutMs);
+        if (count < 0 && errno != EINTR) return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeups++;
+        double now = nowMs();
+        for (int i = 0; i < count; i++) {
+            Device* device = (Device*)ready[i].data.ptr;
+            if (device == nullptr) return false;
+            readyEvents++;
+            readDevice(*device, now);
+        }
+        serviceTimers(now);
+        return true;
+    }
+
+    void run() {
+        while (poll(timeoutMs())) {}
+    }
+
+    // Leaves the devices as found: not streaming to a port nobody reads
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Device* device : devices) {
+            if (device->fd >= 0) writeDevice(*device, "<15>");
+        }
+    }
+
+    int timeoutMs() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (timers.empty()) return 1000;
+        return (int)std::max(0.0, std::min(1000.0, timers.top().first - nowMs() + 1));
+    }
+
+private:
+    const Options& opt;
+    EventQueue& events;
+    typedef std::pair<double, Device*> Timer;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+
+    void schedule(Device& device, double when) {
+        if (device.timerMs != 0 && device.timerMs <= when) return;
+        device.timerMs = when;
+        timers.push(Timer(when, &device));
+    }
+
+    void log(const Device& device, const char* message) {
+        if (opt.verbose) fprintf(stderr, "%s: %s\n", device.name, message);
+    }
+
+    void openPort(Device& device, double now) {
+        device.fd = open(device.path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (device.fd < 0) {
+            if (device.reopenAtMs == 0) log(device, strerror(errno));   // Once, not every retry
+            device.reopenAtMs = now + REOPEN_INTERVAL_MS;
+            schedule(device, device.reopenAtMs);
+            return;
+        }
+        struct termios settings;
+        if (tcgetattr(device.fd, &settings) == 0) {
+            cfmakeraw(&settings);
+            cfsetispeed(&settings, B115200);
+            cfsetospeed(&settings, B115200);
+            settings.c_cflag |= CLOCAL | CREAD;
+            tcsetattr(device.fd, TCSANOW, &settings);
+        }
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &device;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, device.fd, &event);
+
+        device.opens++;
+        device.fill = device.scanned = 0;
+        device.discarding = false;
+        device.pendingCount = 0;
+        device.openedMs = device.lastRxMs = device.lastTelemetryMs = now;
+        // Spread the probes of a fleet started together
+        device.nextProbeMs = now + opt.probeMs * (0.5 + (device.index % 97) / 194.0);
+        setHealth(device, HEALTH_SILENT);
+        log(device, "opened");
+
+        // Close any frame an earlier owner left open, then identify and subscribe
+        writeDevice(device, ">");
+        sendCommand(device, "01", now);
+        subscribe(device, now);
+    }
+
+    void closePort(Device& device, double now) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, device.fd, nullptr);
+        close(device.fd);
+        device.fd = -1;
+        device.pendingCount = 0;
+        setHealth(device, HEALTH_DISCONNECTED);
+        device.reopenAtMs = now + REOPEN_INTERVAL_MS;
+        schedule(device, device.reopenAtMs);
+        log(device, "lost");
+    }
+
+    void writeDevice(Device& device, const char* data) {
+        size_t length = strlen(data);
+        ssize_t written = write(device.fd, data, length);
+        if (written != (ssize_t)length) device.txDropped++;   // A device that does not read is not waited for
+    }
+
+    void sendCommand(Device& device, const char* command, double now) {
+        if (device.fd < 0) return;
+        if (device.pendingCount == MAX_PENDING_COMMANDS) return;
+        PendingCommand& pending = device.pending[device.pendingCount++];
+        snprintf(pending.command, sizeof(pending.command), "%s", command);
+        pending.sentMs = now;
+        pending.acked = false;
+        device.commands++;
+        char frame[24];
+        snprintf(frame, sizeof(frame), "<%s>", command);
+        writeDevice(device, frame);
+        schedule(device, now + opt.timeoutMs);
+    }
+
+    void subscribe(Device& device, double now) {
+        char command[16];
+        snprintf(command, sizeof(command), "14%sJM%04d", STREAM_FIELDS, opt.streamMs);
+        sendCommand(device, command, now);
+        device.lastTelemetryMs = now;     // A full period to start streaming
+        schedule(device, now + 3 * opt.streamMs + opt.timeoutMs);
+    }
+
+    void popPending(Device& device, int count) {
+        memmove(device.pending, device.pending + count, (device.pendingCount - count) * sizeof(PendingCommand));
+        device.pendingCount -= count;
+    }
+
+    void setHealth(Device& device, Health health) {
+        if (device.health == health) return;
+        Health previous = device.health;
+        device.health = health;
+        std::string data = "{\"device\":" + jsonString(device.name) + ",\"health\":\"" + HEALTH_NAMES[health] +
+                           "\",\"previous\":\"" + HEALTH_NAMES[previous] + "\"}";
+        events.push("health", std::move(data));
+    }
+
+    // Reads everything available into the device buffer and handles each complete line
+    void readDevice(Device& device, double now) {
+        if (device.fd < 0) return;
+        for (;;) {
+            ssize_t count = read(device.fd, device.rx + device.fill, RX_BUFFER_SIZE - device.fill);
+            if (count <= 0) {
+                // A pty whose master went away reads EIO; a vanished USB device reads 0 or EIO
+                if (count == 0 || (errno != EAGAIN && errno != EINTR)) closePort(device, now);
+                return;
+            }
+            device.rxBytes += count;
+            device.fill += count;
+            device.lastRxMs = now;
+            scanLines(device, now);
+        }
+    }
+
+    void scanLines(Device& device, double now) {
+        size_t start = 0;
+        for (;;) {
+            char* base = device.rx + start;
+            size_t available = device.fill - start;
+            if (available >= 2 && (uint8_t)base[0] == FRAME_SYNC_1 && (uint8_t)base[1] == FRAME_SYNC_2 &&
+                !device.discarding) {
+                // Binary frames belong to other tools; skip them whole
+                if (available < 4 || available < 5 + (size_t)(uint8_t)base[3]) break;
+                start += 5 + (uint8_t)base[3];
+                device.scanned = start;
+                continue;
+            }
+            // Only bytes not searched on an earlier read are searched now
+            size_t from = std::max(device.scanned, start);
+            char* newline = (char*)memchr(device.rx + from, '\n', device.fill - from);
+            if (newline == nullptr) {
+                device.scanned = device.fill;
+                break;
+            }
+            size_t end = newline - device.rx;
+            if (device.discarding) device.discarding = false;
+            else handleLine(device, base, newline, now);
+            start = end + 1;
+            device.scanned = start;
+        }
+
+        if (start > 0) {
+            // Keep only the partial line
+            memmove(device.rx, device.rx + start, device.fill - start);
+            device.fill -= start;
+            device.scanned -= start;
+        }
+        if (device.fill == RX_BUFFER_SIZE) {
+            device.parseErrors++;
+            device.discarding = true;
+            device.fill = device.scanned = 0;
+        }
+    }
+
+    struct LineVisitor {
+        Span notification, status, command, reason, deviceName, version;
+        bool telemetry = false, hasParked = false, parked = false;
+        bool hasPitch = false, hasRoll = false;
+        double pitch = 0, roll = 0;
+        unsigned long seq = 0, eventSeq = 0;
+
+        void operator()(Span parent, Span key, Span value, JsonType type) {
+            if (parent.empty()) {
+                if (key.is("notification")) notification = value;
+                else if (key.is("status")) status = value;
+                else if (key.is("command")) command = value;
+                return;
+            }
+            if (parent.is("telemetry")) telemetry = true;
+            if (key.is("parked")) {
+                hasParked = true;
+                parked = type == JSON_TRUE;
+            } else if (key.is("pitch") || key.is("currentPitch")) {
+                hasPitch = true;
+                pitch = spanNumber(value);
+            } else if (key.is("roll") || key.is("currentRoll")) {
+                hasRoll = true;
+                roll = spanNumber(value);
+            } else if (key.is("seq")) {
+                seq = (unsigned long)spanNumber(value);
+            } else if (key.is("eventSeq")) {
+                eventSeq = (unsigned long)spanNumber(value);
+            } else if (key.is("reason")) {
+                reason = value;
+            } else if (key.is("deviceName")) {
+                deviceName = value;
+            } else if (key.is("version")) {
+                version = value;
+            }
+        }
+    };
+
+    void handleLine(Device& device, const char* begin, const char* end, double now) {
+        if (end > begin && end[-1] == '\r') end--;
+        if (begin == end || *begin != '{') return;   // Debug text
+        device.lines++;
+
+        LineVisitor line;
+        JsonScanner<LineVisitor> scanner(begin, end, line);
+        if (!scanner.scan()) {
+            device.parseErrors++;
+            return;
+        }
+
+        if (line.telemetry) {
+            device.telemetry++;
+            device.lastTelemetryMs = now;
+            if (line.seq) device.sampleSeq = line.seq;
+            if (line.hasParked) updateState(device, line, "observed");
+            setHealth(device, HEALTH_OK);
+            return;
+        }
+        if (line.notification.is("parked") || line.notification.is("unparked")) {
+            device.notifications++;
+            device.eventSeq = line.eventSeq;
+            if (line.hasParked) updateState(device, line, nullptr);
+            return;
+        }
+
+        if (line.status.is("ack")) {
+            int match = 0;
+            while (match < device.pendingCount &&
+                   (device.pending[match].acked || !line.command.is(device.pending[match].command))) {
+                match++;
+            }
+            if (match == device.pendingCount) return;
+            popPending(device, match);       // Commands ahead of it were lost
+            device.pending[0].acked = true;
+            return;
+        }
+        if (!line.status.is("ok") && !line.status.is("error")) return;
+        if (device.pendingCount == 0 || !device.pending[0].acked) return;
+        PendingCommand answered = device.pending[0];
+        popPending(device, 1);
+
+        if (!line.status.is("ok")) return;
+        if (!strcmp(answered.command, "03")) {
+            device.latency.add((now - answered.sentMs) * 1000.0);
+            if (line.hasParked) updateState(device, line, "observed");
+        } else if (!strcmp(answered.command, "01")) {
+            copySpan(device.deviceName, sizeof(device.deviceName), line.deviceName);
+            copySpan(device.version, sizeof(device.version), line.version);
+        }
+    }
+
+    // reason is null for a notification, which carries its own
+    void updateState(Device& device, const LineVisitor& line, const char* reason) {
+        bool first = !device.stateKnown;
+        bool changed = first || device.parked != line.parked;
+        if (line.hasPitch) device.pitch = line.pitch;
+        if (line.hasRoll) device.roll = line.roll;
+        if (!changed) return;
+
+        device.stateKnown = true;
+        device.parked = line.parked;
+        device.changedWallMs = wallMs();
+        if (reason == nullptr) copySpan(device.reason, sizeof(device.reason), line.reason);
+        else snprintf(device.reason, sizeof(device.reason), "%s", first ? "initial" : reason);
+
+        char numbers[128];
+        snprintf(numbers, sizeof(numbers), ",\"pitch\":%.2f,\"roll\":%.2f,\"eventSeq\":%lu,\"wallMs\":%.0f}",
+                 device.pitch, device.roll, device.eventSeq, device.changedWallMs);
+        std::string data = "{\"device\":" + jsonString(device.name) + ",\"parked\":" +
+                           (device.parked ? "true" : "false") + ",\"reason\":" + jsonString(device.reason) + numbers;
+        events.push(device.parked ? "parked" : "unparked", std::move(data));
+    }
+
+    void serviceTimers(double now) {
+        while (!timers.empty() && timers.top().first <= now) {
+            Timer timer = timers.top();
+            timers.pop();
+            Device& device = *timer.second;
+            if (timer.first != device.timerMs) continue;   // Superseded by an earlier deadline
+            device.timerMs = 0;
+            checkDevice(device, now);
+        }
+    }
+
+    void checkDevice(Device& device, double now) {
+        if (device.fd < 0) {
+            if (now >= device.reopenAtMs) openPort(device, now);
+            else schedule(device, device.reopenAtMs);
+            return;
+        }
+
+        while (device.pendingCount > 0 && now - device.pending[0].sentMs >= opt.timeoutMs) {
+            device.timeouts++;
+            popPending(device, 1);
+        }
+        if (now - device.lastRxMs >= opt.timeoutMs) setHealth(device, HEALTH_SILENT);
+
+        double staleAfter = device.lastTelemetryMs + 3 * opt.streamMs + opt.timeoutMs;
+        if (now >= staleAfter) {
+            // The device rebooted or someone unsubscribed it
+            if (device.health == HEALTH_OK) setHealth(device, HEALTH_STALE);
+            device.resubscribes++;
+            subscribe(device, now);
+            staleAfter = device.lastTelemetryMs + 3 * opt.streamMs + opt.timeoutMs;
+        }
+        if (now >= device.nextProbeMs) {
+            // A device still booting when opened missed the identity request
+            if (device.deviceName[0] == '\0') sendCommand(device, "01", now);
+            sendCommand(device, "03", now);
+            device.nextProbeMs = now + opt.probeMs;
+        }
+
+        double next = std::min(staleAfter, device.nextProbeMs);
+        if (device.pendingCount > 0) next = std::min(next, device.pending[0].sentMs + opt.timeoutMs);
+        if (device.health == HEALTH_OK) next = std::min(next, device.lastRxMs + opt.timeoutMs);
+        schedule(device, next);
+    }
+};
+
+// --- Queries ---
+
+struct HttpClient {
+    int fd = -1;
+    std::string in, out;
+    bool events = false;
+    bool closeAfterWrite = false;
+    bool closed = false;
+};
+
+class Monitor {
+public:
+    explicit Monitor(const Options& opt) : opt(opt) {}
+
+    bool start() {
+        stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (!listen()) return false;
+        watch(events.fd, TAG_EVENTS);
+
+        int shardCount = std::max(1, opt.workers);
+        for (int i = 0; i < shardCount; i++) shards.push_back(new Shard(opt, events, stopFd));
+        for (size_t i = 0; i < opt.ports.size(); i++) {
+            Device* device = new Device();
+            snprintf(device->name, sizeof(device->name), "%s", opt.ports[i].first.c_str());
+            device->path = opt.ports[i].second;
+            device->index = (int)i;
+            devices.push_back(device);
+            shards[i % shardCount]->devices.push_back(device);
+            deviceIndex[device->name] = device;
+        }
+        for (Shard* shard : shards) shard->start();
+        if (opt.workers == 0) watch(shards[0]->epollFd, TAG_SHARD);
+        else {
+            for (Shard* shard : shards) threads.emplace_back([shard]() { shard->run(); });
+        }
+        startedMs = nowMs();
+        fprintf(stderr, "Watching %zu devices on %d %s; queries on http://%s:%d/fleet\n", devices.size(), shardCount,
+                opt.workers ? "worker threads" : "loop", opt.listenAddress.c_str(), opt.listenPort);
+        return true;
+    }
+
+    void run() {
+        struct epoll_event ready[256];
+        double nextKeepaliveMs = nowMs() + KEEPALIVE_INTERVAL_MS;
+        while (!stopRequested) {
+            int timeout = opt.workers == 0 ? shards[0]->timeoutMs() : 1000;
+            int count = epoll_pwait(epollFd, ready, 256, timeout, &waitMask);
+            if (count < 0 && errno != EINTR) break;
+            bool shardReady = false;
+            for (int i = 0; i < count; i++) {
+                int tag = (int)(int64_t)ready[i].data.u64;
+                if (tag == TAG_LISTEN) acceptClients();
+                else if (tag == TAG_EVENTS) publishEvents();
+                else if (tag == TAG_SHARD) shardReady = true;
+                else serviceClient(tag, ready[i].events);
+            }
+            // Inline shard: its devices and timers, then the events they raised
+            if (opt.workers == 0 && (shardReady || shards[0]->timeoutMs() == 0)) {
+                shards[0]->poll(0);
+                publishEvents();
+            }
+            if (nowMs() >= nextKeepaliveMs) {
+                nextKeepaliveMs = nowMs() + KEEPALIVE_INTERVAL_MS;
+                for (auto& entry : clients) {
+                    if (entry.second.events) send(entry.second, ": keepalive\n\n");
+                }
+            }
+            reapClients();
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(stopFd, &one, sizeof(one));
+        (void)ignored;
+        for (std::thread& thread : threads) thread.join();
+        for (Shard* shard : shards) shard->stop();
+    }
+
+private:
+    const Options& opt;
+    int epollFd = -1, listenFd = -1, stopFd = -1;
+    EventQueue events;
+    std::vector<Shard*> shards;
+    std::vector<std::thread> threads;
+    std::vector<Device*> devices;
+    std::map<std::string, Device*> deviceIndex;
+    std::map<int, HttpClient> clients;
+    std::vector<int> closedClients;
+    unsigned long eventId = 0, httpRequests = 0, eventsSent = 0, droppedSubscribers = 0;
+    double startedMs = 0;
+
+    enum { TAG_LISTEN = -1, TAG_EVENTS = -2, TAG_SHARD = -3 };
+
+    void watch(int fd, int tag, uint32_t mask = EPOLLIN, int op = EPOLL_CTL_ADD) {
+        struct epoll_event event = {};
+        event.events = mask;
+        event.data.u64 = (uint64_t)(int64_t)tag;
+        epoll_ctl(epollFd, op, fd, &event);
+    }
+
+    bool listen() {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int yes = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(opt.listenPort);
+        if (inet_pton(AF_INET, opt.listenAddress.c_str(), &address.sin_addr) != 1 ||
+            bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || ::listen(listenFd, 512) < 0) {
+            perror("listen");
+            return false;
+        }
+        watch(listenFd, TAG_LISTEN);
+        return true;
+    }
+
+    void publishEvents() {
+        std::vector<FleetEvent> taken = events.take();
+        for (const FleetEvent& event : taken) {
+            eventId++;
+            if (opt.verbose) fprintf(stderr, "%s %s\n", event.name.c_str(), event.data.c_str());
+            std::string text = "event: " + event.name + "\nid: " + std::to_string(eventId) + "\ndata: " + event.data +
+                               "\n\n";
+            for (auto& entry : clients) {
+                if (entry.second.events && !entry.second.closed) {
+                    eventsSent++;
+                    send(entry.second, text);
+                }
+            }
+        }
+    }
+
+    // --- HTTP ---
+
+    void acceptClients() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+            HttpClient client;
+            client.fd = fd;
+            clients[fd] = client;
+            watch(fd, fd);
+        }
+    }
+
+    void dropClient(HttpClient& client) {
+        if (client.closed) return;
+        client.closed = true;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+        close(client.fd);
+        closedClients.push_back(client.fd);
+    }
+
+    void reapClients() {
+        for (int fd : closedClients) {
+            // A client accepted since may already have been given the same descriptor
+            auto it = clients.find(fd);
+            if (it != clients.end() && it->second.closed) clients.erase(it);
+        }
+        closedClients.clear();
+    }
+
+    void serviceClient(int fd, uint32_t mask) {
+        auto it = clients.find(fd);
+        if (it == clients.end() || it->second.closed) return;
+        HttpClient& client = it->second;
+        if (mask & EPOLLOUT) flush(client);
+        if (client.closed || !(mask & (EPOLLIN | EPOLLHUP | EPOLLERR))) return;
+
+        char buffer[4096];
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof(buffer))) > 0) client.in.append(buffer, count);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+            dropClient(client);
+            return;
+        }
+        if (client.events) client.in.clear();
+
+        while (!client.events && !client.closeAfterWrite && !client.closed) {
+            size_t headerEnd = client.in.find("\r\n\r\n");
+            if (headerEnd == std::string::npos) {
+                if (client.in.size() > MAX_HTTP_REQUEST) respond(client, 431, "text/plain", "Request too large", true);
+                return;
+            }
+            std::string head = client.in.substr(0, headerEnd);
+            client.in.erase(0, headerEnd + 4);   // Queries have no body
+            httpRequests++;
+            handleRequest(client, head);
+        }
+    }
+
+    void handleRequest(HttpClient& client, const std::string& head) {
+        size_t first = head.find(' ');
+        size_t second = head.find(' ', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            respond(client, 400, "text/plain", "Bad Request", true);
+            return;
+        }
+        std::string method = head.substr(0, first);
+        std::string target = head.substr(first + 1, second - first - 1);
+        std::string lowerHead = head;
+        for (char& c : lowerHead) c = (char)tolower((unsigned char)c);
+        bool closeAfter = head.compare(second + 1, 8, "HTTP/1.1") != 0 ||
+                          lowerHead.find("\r\nconnection: close") != std::string::npos;
+        if (method != "GET") {
+            respond(client, 405, "text/plain", "Method Not Allowed", closeAfter);
+            return;
+        }
+        size_t query = target.find('?');
+        std::string path = target.substr(0, query);
+        std::map<std::string, std::string> params;
+        if (query != std::string::npos) parseQuery(target.substr(query + 1), params);
+
+        if (path == "/events") {
+            client.events = true;
+            send(client, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                         "Connection: keep-alive\r\n\r\n");
+        } else if (path == "/fleet") {
+            respond(client, 200, "application/json", fleetJSON(), closeAfter);
+        } else if (path == "/devices") {
+            respond(client, 200, "application/json", devicesJSON(params), closeAfter);
+        } else if (path.compare(0, 9, "/devices/") == 0) {
+            auto it = deviceIndex.find(path.substr(9));
+            if (it == deviceIndex.end()) respond(client, 404, "text/plain", "Unknown device", closeAfter);
+            else respond(client, 200, "application/json", deviceJSON(*it->second), closeAfter);
+        } else {
+            respond(client, 404, "text/plain", "Not Found", closeAfter);
+        }
+    }
+
+    static void parseQuery(const std::string& text, std::map<std::string, std::string>& params) {
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find('&', pos);
+            if (end == std::string::npos) end = text.size();
+            std::string item = text.substr(pos, end - pos);
+            size_t equals = item.find('=');
+            params[item.substr(0, equals)] = equals == std::string::npos ? std::string() : item.substr(equals + 1);
+            pos = end + 1;
+        }
+    }
+
+    void respond(HttpClient& client, int status, const char* type, const std::string& body, bool closeAfter) {
+        const char* reason = status == 200   ? "OK"
+                             : status == 400 ? "Bad Request"
+                             : status == 404 ? "Not Found"
+                             : status == 405 ? "Method Not Allowed"
+                                             : "Request Header Fields Too Large";
+        client.closeAfterWrite = closeAfter;
+        send(client, "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\nContent-Type: " + type +
+                         "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" +
+                         (closeAfter ? "Connection: close\r\n" : "") + "\r\n" + body);
+    }
+
+    void send(HttpClient& client, const std::string& data) {
+        if (client.closed) return;
+        bool wasIdle = client.out.empty();
+        client.out += data;
+        if (client.out.size() > MAX_CLIENT_BACKLOG) {
+            droppedSubscribers++;
+            dropClient(client);
+            return;
+        }
+        if (wasIdle) flush(client);
+    }
+
+    void flush(HttpClient& client) {
+        while (!client.out.empty()) {
+            ssize_t count = write(client.fd, client.out.data(), client.out.size());
+            if (count > 0) {
+                client.out.erase(0, count);
+            } else if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+                watch(client.fd, client.fd, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+                return;
+            } else {
+                dropClient(client);
+                return;
+            }
+        }
+        watch(client.fd, client.fd, EPOLLIN, EPOLL_CTL_MOD);
+        if (client.closeAfterWrite) dropClient(client);
+    }
+
+    // --- JSON views; each reads a device under its shard's lock ---
+
+    Shard& shardOf(const Device& device) {
+        return *shards[device.index % shards.size()];
+    }
+
+    std::string deviceJSON(Device& device) {
+        std::lock_guard<std::mutex> lock(shardOf(device).mutex);
+        double now = nowMs();
+        char text[1024];
+        snprintf(text, sizeof(text),
+                 "{\"name\":%s,\"port\":%s,\"health\":\"%s\",\"parked\":%s,\"pitch\":%.2f,\"roll\":%.2f,"
+                 "\"reason\":%s,\"eventSeq\":%lu,\"sampleSeq\":%lu,\"changedWallMs\":%.0f,\"deviceName\":%s,"
+                 "\"version\":%s,\"lastRxAgeMs\":%.0f,\"telemetryAgeMs\":%.0f,"
+                 "\"latencyUs\":{\"n\":%u,\"p50\":%.0f,\"p99\":%.0f,\"max\":%.0f},"
+                 "\"counters\":{\"rxBytes\":%lu,\"lines\":%lu,\"telemetry\":%lu,\"notifications\":%lu,"
+                 "\"parseErrors\":%lu,\"commands\":%lu,\"timeouts\":%lu,\"opens\":%lu,\"resubscribes\":%lu,"
+                 "\"txDropped\":%lu}}",
+                 jsonString(device.name).c_str(), jsonString(device.path.c_str()).c_str(),
+                 HEALTH_NAMES[device.health], device.stateKnown ? (device.parked ? "true" : "false") : "null",
+                 device.pitch, device.roll, jsonString(device.reason).c_str(), device.eventSeq, device.sampleSeq,
+                 device.changedWallMs, jsonString(device.deviceName).c_str(), jsonString(device.version).c_str(),
+                 device.fd >= 0 ? now - device.lastRxMs : -1.0, device.fd >= 0 ? now - device.lastTelemetryMs : -1.0,
+                 device.latency.count, device.latency.percentile(50), device.latency.percentile(99),
+                 device.latency.maxUs, device.rxBytes, device.lines, device.telemetry, device.notifications,
+                 device.parseErrors, device.commands, device.timeouts, device.opens, device.resubscribes,
+                 device.txDropped);
+        return text;
+    }
+
+    std::string devicesJSON(const std::map<std::string, std::string>& params) {
+        auto health = params.find("health");
+        auto parked = params.find("parked");
+        std::string json = "[";
+        for (Device* device : devices) {
+            if (health != params.end() || parked != params.end()) {
+                std::lock_guard<std::mutex> lock(shardOf(*device).mutex);
+                if (health != params.end() && health->second != HEALTH_NAMES[device->health]) continue;
+                if (parked != params.end() &&
+                    (!device->stateKnown || (parked->second == "true") != device->parked)) {
+                    continue;
+                }
+            }
+            if (json.size() > 1) json += ",";
+            json += deviceJSON(*device);
+        }
+        return json + "]";
+    }
+
+    std::string fleetJSON() {
+        unsigned long byHealth[HEALTH_COUNT] = {};
+        unsigned long parked = 0, unparked = 0, unknown = 0, telemetry = 0, parseErrors = 0, timeouts = 0;
+        unsigned long wakeups = 0, readyEvents = 0;
+        LatencyHistogram latency;
+        std::string unparkedNames, unhealthyNames;
+        for (Shard* shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            wakeups += shard->wakeups;
+            readyEvents += shard->readyEvents;
+            for (Device* device : shard->devices) {
+                byHealth[device->health]++;
+                if (!device->stateKnown) unknown++;
+                else if (device->parked) parked++;
+                else {
+                    unparked++;
+                    unparkedNames += (unparkedNames.empty() ? "" : ",") + jsonString(device->name);
+                }
+                if (device->health != HEALTH_OK) {
+                    unhealthyNames += (unhealthyNames.empty() ? "" : ",") + jsonString(device->name);
+                }
+                telemetry += device->telemetry;
+                parseErrors += device->parseErrors;
+                timeouts += device->timeouts;
+                latency.merge(device->latency);
+            }
+        }
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        double cpuS = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec +
+                      usage.ru_stime.tv_usec / 1e6;
+        size_t subscribers = 0;
+        for (const auto& entry : clients) subscribers += entry.second.events && !entry.second.closed ? 1 : 0;
+
+        char text[1024];
+        snprintf(text, sizeof(text),
+                 "{\"devices\":%zu,\"workers\":%d,\"streamMs\":%d,\"probeMs\":%d,\"uptimeS\":%.1f,\"cpuS\":%.3f,"
+                 "\"health\":{\"ok\":%lu,\"stale\":%lu,\"silent\":%lu,\"disconnected\":%lu},"
+                 "\"parked\":%lu,\"unparked\":%lu,\"unknown\":%lu,\"telemetry\":%lu,\"parseErrors\":%lu,"
+                 "\"timeouts\":%lu,\"latencyUs\":{\"n\":%u,\"p50\":%.0f,\"p99\":%.0f,\"max\":%.0f},"
+                 "\"loop\":{\"wakeups\":%lu,\"readyEvents\":%lu},"
+                 "\"http\":{\"requests\":%lu,\"subscribers\":%zu,\"events\":%lu,\"droppedSubscribers\":%lu},",
+                 devices.size(), opt.workers, opt.streamMs, opt.probeMs, (nowMs() - startedMs) / 1000.0, cpuS,
+                 byHealth[HEALTH_OK], byHealth[HEALTH_STALE], byHealth[HEALTH_SILENT], byHealth[HEALTH_DISCONNECTED],
+                 parked, unparked, unknown, telemetry, parseErrors, timeouts, latency.count, latency.percentile(50),
+                 latency.percentile(99), latency.maxUs, wakeups, readyEvents, httpRequests, subscribers, eventsSent,
+                 droppedSubscribers);
+        return std::string(text) + "\"unparkedDevices\":[" + unparkedNames + "],\"unhealthyDevices\":[" +
+               unhealthyNames + "]}";
+    }
+};
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s (--port [NAME=]PATH ... | --ports FILE) [--listen ADDR:PORT] [--workers N]\n"
+            "          [--stream-ms MS] [--probe-ms MS] [--timeout MS] [--verbose]\n"
+            "FILE has one device per line: PATH or NAME PATH; # starts a comment\n", program);
+}
+
+static void addPort(Options& opt, const std::string& name, const std::string& path) {
+    std::string deviceName = name;
+    if (deviceName.empty()) {
+        size_t slash = path.rfind('/');
+        deviceName = slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+    opt.ports.push_back(std::make_pair(deviceName, path));
+}
+
+static bool readPortsFile(const char* path, Options& opt) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char* comment = strchr(line, '#');
+        if (comment != nullptr) *comment = '\0';
+        char first[256], second[256];
+        int fields = sscanf(line, "%255s %255s", first, second);
+        if (fields == 1) addPort(opt, std::string(), first);
+        else if (fields == 2) addPort(opt, first, second);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--port") && hasValue) {
+            std::string value = argv[++i];
+            size_t equals = value.find('=');
+            if (equals == std::string::npos) addPort(opt, std::string(), value);
+            else addPort(opt, value.substr(0, equals), value.substr(equals + 1));
+        }
+        else if (!strcmp(arg, "--ports") && hasValue) {
+            if (!readPortsFile(argv[++i], opt)) return false;
+        }
+        else if (!strcmp(arg, "--listen") && hasValue) {
+            std::string value = argv[++i];
+            size_t colon = value.rfind(':');
+            if (colon == std::string::npos) return false;
+            opt.listenAddress = value.substr(0, colon);
+            opt.listenPort = atoi(value.c_str() + colon + 1);
+        }
+        else if (!strcmp(arg, "--workers") && hasValue) opt.workers = atoi(argv[++i]);
+        else if (!strcmp(arg, "--stream-ms") && hasValue) opt.streamMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--probe-ms") && hasValue) opt.probeMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--timeout") && hasValue) opt.timeoutMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--verbose")) opt.verbose = true;
+        else return false;
+    }
+    // The device streams no faster than every 50ms and takes 4 digits
+    if (opt.streamMs < 50 || opt.streamMs > 9999 || opt.probeMs <= 0 || opt.timeoutMs <= 0) return false;
+    return !opt.ports.empty() && opt.workers >= 0 && opt.workers <= 64 && opt.listenPort > 0 && opt.listenPort < 65536;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Two descriptors per device at most, plus the query clients
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigprocmask(SIG_BLOCK, &blocked, &waitMask);   // Worker threads inherit the block
+
+    Monitor monitor(opt);
+    if (!monitor.start()) return 1;
+    monitor.run();
+    return 0;
+}
@@ -0,0 +1,753 @@
+// loadgen - load generator and latency harness for the <XX> serial protocol
+//
+// Drives a park sensor (a real tty such as /dev/ttyACM0, or the pty of
+// build/park_sensor_sim) with a weighted mix of commands and measures what
+// its clients would see. Every command is answered by an ack echoing it and
+// then one {"status":"ok"|"error"} line, in order, so responses are matched
+// to commands without any help from the device.
+//
+// Patterns:
+//   --mode single     one command outstanding at a time
+//   --mode pipeline   up to --depth commands outstanding, written back to back
+//   --mode clients    --clients pollers, each single outstanding at --rate, sharing
+//                     one connection as a hub would; with --separate each opens
+//                     the port itself, like independent processes on one tty
+//
+// Reports throughput, latency percentiles (from the write, and from the
+// scheduled send time when --rate is given, which is free of coordinated
+// omission), lost, garbled and misrouted responses, notifications and the
+// debug output that arrived alongside. --debug on|off sets the device's
+// debug output for the run and restores it afterwards.
+//
+// --fuzz N sends N malformed frames instead (random bytes, overlong and
+// unterminated frames, stray delimiters, control characters, unknown opcodes
+// and bad arguments to read-only opcodes, frames split across writes),
+// probing with <08> every --probe-every frames. The device's own serialRx
+// and command stage maxima from <21> give the parser's worst-case cost.
+// Fuzz frames never form a command that changes settings.
+//
+// Build: cmake --build build --target loadgen
+// Usage: loadgen --port PATH [--mode single|pipeline|clients] [--depth N] [--clients N]
+//                [--separate] [--rate HZ] [--mix 01:4,02:2,03:4] [--duration S | --count N]
+//                [--timeout MS] [--debug on|off] [--json]
+//        loadgen --port PATH --fuzz N [--seed N] [--probe-every N]
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#define FRAME_SYNC_1 0xA5
+#define FRAME_SYNC_2 0x5A
+#define MAX_RX_LINE 4096          // Longer than any response; a line this long without a newline is garbage
+
+struct Options {
+    const char* port = nullptr;
+    std::string mode = "single";
+    int depth = 8;
+    int clients = 4;
+    bool separate = false;
+    double rateHz = 0;            // Per client; 0 = as fast as responses allow
+    std::string mix = "01:4,02:2,03:4,05:1,0B:1";
+    double durationS = 10;
+    long count = 0;
+    double timeoutMs = 2000;
+    std::string debug;            // "on", "off" or empty to leave it alone
+    bool json = false;
+    long fuzz = 0;
+    unsigned seed = 1;
+    int probeEvery = 16;
+};
+
+struct Pending {
+    int client;
+    std::string command;
+    double scheduledMs;           // When the schedule wanted it sent
+    double sentMs;
+    double ackMs = 0;
+    bool written = false;
+    bool acked = false;
+};
+
+struct Connection {
+    int fd = -1;
+    std::string rx;
+    std::deque<Pending> fifo;     // Commands in the order the device will answer them
+    std::string txBatch;          // Frames to write together, like a client that pipelines
+};
+
+struct Client {
+    int connection = 0;
+    int outstanding = 0;
+    double nextSendMs = 0;
+};
+
+struct Stats {
+    unsigned long sent = 0, acked = 0, answered = 0, errors = 0;
+    unsigned long lostAcks = 0, lostResponses = 0, timeouts = 0;
+    unsigned long garbled = 0, misrouted = 0, unmatched = 0;
+    unsigned long notifications = 0, unsolicitedJson = 0, binaryFrames = 0;
+    unsigned long debugLines = 0, debugBytes = 0, rxBytes = 0;
+    std::vector<double> latency;              // Write to response
+    std::vector<double> ackLatency;           // Write to ack
+    std::vector<double> responseTime;         // Scheduled send to response (with --rate)
+    std::map<std::string, std::vector<double>> perCommand;
+};
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s --port PATH [--mode single|pipeline|clients] [--depth N] [--clients N]\n"
+            "          [--separate] [--rate HZ] [--mix 01:4,02:2,03:4] [--duration S | --count N]\n"
+            "          [--timeout MS] [--debug on|off] [--json]\n"
+            "       %s --port PATH --fuzz N [--seed N] [--probe-every N]\n", program, program);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--port") && hasValue) opt.port = argv[++i];
+        else if (!strcmp(arg, "--mode") && hasValue) opt.mode = argv[++i];
+        else if (!strcmp(arg, "--depth") && hasValue) opt.depth = atoi(argv[++i]);
+        else if (!strcmp(arg, "--clients") && hasValue) opt.clients = atoi(argv[++i]);
+        else if (!strcmp(arg, "--separate")) opt.separate = true;
+        else if (!strcmp(arg, "--rate") && hasValue) opt.rateHz = atof(argv[++i]);
+        else if (!strcmp(arg, "--mix") && hasValue) opt.mix = argv[++i];
+        else if (!strcmp(arg, "--duration") && hasValue) opt.durationS = atof(argv[++i]);
+        else if (!strcmp(arg, "--count") && hasValue) opt.count = atol(argv[++i]);
+        else if (!strcmp(arg, "--timeout") && hasValue) opt.timeoutMs = atof(argv[++i]);
+        else if (!strcmp(arg, "--debug") && hasValue) opt.debug = argv[++i];
+        else if (!strcmp(arg, "--json")) opt.json = true;
+        else if (!strcmp(arg, "--fuzz") && hasValue) opt.fuzz = atol(argv[++i]);
+        else if (!strcmp(arg, "--seed") && hasValue) opt.seed = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(arg, "--probe-every") && hasValue) opt.probeEvery = atoi(argv[++i]);
+        else return false;
+    }
+    if (opt.mode != "single" && opt.mode != "pipeline" && opt.mode != "clients") return false;
+    if (!opt.debug.empty() && opt.debug != "on" && opt.debug != "off") return false;
+    return opt.port != nullptr && opt.depth > 0 && opt.clients > 0 && opt.probeEvery > 0;
+}
+
+static int openPort(const char* path) {
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    // Raw 8N1; the baud rate means nothing to USB CDC but a real UART wants it
+    struct termios settings;
+    if (tcgetattr(fd, &settings) == 0) {
+        cfmakeraw(&settings);
+        cfsetispeed(&settings, B115200);
+        cfsetospeed(&settings, B115200);
+        settings.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &settings);
+    }
+    return fd;
+}
+
+static bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t count = write(fd, data.data() + written, data.size() - written);
+        if (count > 0) {
+            written += count;
+        } else if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+            struct pollfd poller = {fd, POLLOUT, 0};
+            poll(&poller, 1, 10);
+        } else {
+            perror("write");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Command mix "01:4,02:2": opcode (and arguments) with a weight
+static bool parseMix(const std::string& text, std::vector<std::string>& commands, std::vector<double>& weights) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(pos, end - pos);
+        size_t colon = item.find(':');
+        std::string command = item.substr(0, colon);
+        double weight = colon == std::string::npos ? 1.0 : atof(item.c_str() + colon + 1);
+        for (char& c : command) c = (char)toupper((unsigned char)c);
+        if (command.size() < 2 || weight <= 0) {
+            fprintf(stderr, "Bad mix entry '%s'\n", item.c_str());
+            return false;
+        }
+        commands.push_back(command);
+        weights.push_back(weight);
+        pos = end + 1;
+    }
+    return !commands.empty();
+}
+
+// Quotes and braces balance and the line is one object
+static bool isWellFormedJSON(const std::string& line) {
+    if (line.size() < 2 || line.front() != '{' || line.back() != '}') return false;
+    int depth = 0;
+    bool inString = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (inString) {
+            if (c == '\\') i++;
+            else if (c == '"') inString = false;
+            continue;
+        }
+        if ((unsigned char)c < 32) return false;
+        if (c == '"') inString = true;
+        else if (c == '{' || c == '[') depth++;
+        else if (c == '}' || c == ']') {
+            if (--depth < 0) return false;
+            if (depth == 0 && i != line.size() - 1) return false;
+        }
+    }
+    return depth == 0 && !inString;
+}
+
+static bool startsWith(const std::string& line, const char* prefix) {
+    return line.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::string ackedCommand(const std::string& line) {
+    static const char prefix[] = "{\"status\":\"ack\",\"command\":\"";
+    if (!startsWith(line, prefix)) return std::string();
+    size_t end = line.find('"', sizeof(prefix) - 1);
+    return end == std::string::npos ? std::string() : line.substr(sizeof(prefix) - 1, end - (sizeof(prefix) - 1));
+}
+
+class Harness {
+public:
+    Harness(const Options& opt) : opt(opt) {}
+
+    std::vector<Connection> connections;
+    std::vector<Client> clients;
+    Stats stats;
+    std::string lastResponse;     // For transact()
+
+    // Classify everything received on a connection
+    void receive(int index) {
+        Connection& connection = connections[index];
+        char buffer[4096];
+        ssize_t count;
+        while ((count = read(connection.fd, buffer, sizeof(buffer))) > 0) {
+            connection.rx.append(buffer, count);
+            stats.rxBytes += count;
+        }
+
+        std::string& rx = connection.rx;
+        size_t pos = 0;
+        while (pos < rx.size()) {
+            if ((uint8_t)rx[pos] == FRAME_SYNC_1 && pos + 1 < rx.size() && (uint8_t)rx[pos + 1] == FRAME_SYNC_2) {
+                // Binary frame (telemetry, log blocks, captures): skip it whole
+                if (pos + 4 > rx.size()) break;
+                size_t length = 5 + (uint8_t)rx[pos + 3];
+                if (pos + length > rx.size()) break;
+                stats.binaryFrames++;
+                pos += length;
+                continue;
+            }
+            size_t end = rx.find('\n', pos);
+            if (end == std::string::npos) {
+                if (rx.size() - pos > MAX_RX_LINE) {
+                    stats.garbled++;
+                    pos = rx.size();
+                }
+                break;
+            }
+            std::string line = rx.substr(pos, end - pos);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            pos = end + 1;
+            handleLine(index, line);
+        }
+        rx.erase(0, pos);
+    }
+
+    void handleLine(int index, const std::string& line) {
+        if (line.empty()) return;
+        if (line[0] != '{') {
+            // Debug output, which echoes responses as text; a response that lost its start shows up as lost
+            stats.debugLines++;
+            stats.debugBytes += line.size() + 2;
+            return;
+        }
+        if (!isWellFormedJSON(line)) {
+            stats.garbled++;
+            return;
+        }
+
+        Connection& connection = connections[index];
+        double now = nowMs();
+        std::string acked = ackedCommand(line);
+        if (!acked.empty()) {
+            // The device answers in order: unacked commands ahead of this one were dropped
+            auto it = connection.fifo.begin();
+            while (it != connection.fifo.end() && (it->acked || it->command != acked)) ++it;
+            if (it == connection.fifo.end()) {
+                stats.misrouted++;        // Another client's command read off a shared tty, or a fuzz frame
+                return;
+            }
+            for (auto before = connection.fifo.begin(); before != it;) {
+                if (before->acked) stats.lostResponses++;
+                else stats.lostAcks++;
+                release(*before);
+                before = connection.fifo.erase(before);
+            }
+            it = connection.fifo.begin();
+            it->acked = true;
+            it->ackMs = now;
+            stats.acked++;
+            stats.ackLatency.push_back(now - it->sentMs);
+            return;
+        }
+
+        bool ok = startsWith(line, "{\"status\":\"ok\"");
+        bool error = startsWith(line, "{\"status\":\"error\"");
+        if (ok || error) {
+            if (connection.fifo.empty() || !connection.fifo.front().acked) {
+                stats.unmatched++;
+                return;
+            }
+            Pending pending = connection.fifo.front();
+            connection.fifo.pop_front();
+            stats.answered++;
+            if (error) stats.errors++;
+            if (pending.client >= 0) {
+                stats.latency.push_back(now - pending.sentMs);
+                if (opt.rateHz > 0) stats.responseTime.push_back(now - pending.scheduledMs);
+                stats.perCommand[pending.command].push_back(now - pending.sentMs);
+            } else {
+                lastResponse = line;
+            }
+            release(pending);
+            return;
+        }
+
+        if (startsWith(line, "{\"notification\":")) stats.notifications++;
+        else stats.unsolicitedJson++;   // e.g. JSON telemetry lines
+    }
+
+    void release(const Pending& pending) {
+        if (pending.client >= 0) clients[pending.client].outstanding--;
+    }
+
+    void queue(int client, int index, const std::string& command, double scheduledMs) {
+        Connection& connection = connections[index];
+        Pending pending;
+        pending.client = client;
+        pending.command = command;
+        pending.scheduledMs = scheduledMs;
+        pending.sentMs = nowMs();
+        connection.fifo.push_back(pending);
+        connection.txBatch += "<" + command + ">";
+        if (client >= 0) {
+            clients[client].outstanding++;
+            stats.sent++;
+        }
+    }
+
+    bool flush(int index) {
+        Connection& connection = connections[index];
+        if (connection.txBatch.empty()) return true;
+        double now = nowMs();
+        for (Pending& pending : connection.fifo) {
+            if (!pending.written) pending.sentMs = now;
+            pending.written = true;
+        }
+        bool ok = writeAll(connection.fd, connection.txBatch);
+        connection.txBatch.clear();
+        return ok;
+    }
+
+    void expire() {
+        double now = nowMs();
+        for (Connection& connection : connections) {
+            while (!connection.fifo.empty() && now - connection.fifo.front().sentMs > opt.timeoutMs) {
+                stats.timeouts++;
+                release(connection.fifo.front());
+                connection.fifo.pop_front();
+            }
+        }
+    }
+
+    void wait(double ms) {
+        std::vector<struct pollfd> pollers;
+        for (Connection& connection : connections) pollers.push_back({connection.fd, POLLIN, 0});
+        poll(pollers.data(), pollers.size(), (int)std::max(0.0, ceil(ms)));
+        for (size_t i = 0; i < connections.size(); i++) {
+            if (pollers[i].revents & (POLLIN | POLLHUP | POLLERR)) receive(i);
+        }
+    }
+
+    // One command outside the measured load; returns the response line
+    bool transact(const std::string& command, std::string& response) {
+        lastResponse.clear();
+        queue(-1, 0, command, nowMs());
+        if (!flush(0)) return false;
+        double deadline = nowMs() + opt.timeoutMs;
+        while (lastResponse.empty() && nowMs() < deadline) {
+            wait(deadline - nowMs());
+            expire();
+        }
+        response = lastResponse;
+        return !response.empty();
+    }
+
+    void drainInput(double ms) {
+        double deadline = nowMs() + ms;
+        while (nowMs() < deadline) wait(deadline - nowMs());
+        for (Connection& connection : connections) connection.rx.clear();
+        stats = Stats();
+    }
+
+private:
+    const Options& opt;
+};
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)ceil(p / 100.0 * values.size());
+    return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static void printLatency(FILE* out, const char* label, const std::vector<double>& values) {
+    if (values.empty()) return;
+    fprintf(out, "%-16s n=%-7zu p50 %8.2f  p90 %8.2f  p99 %8.2f  p99.9 %8.2f  max %8.2f ms\n", label, values.size(),
+            percentile(values, 50), percentile(values, 90), percentile(values, 99), percentile(values, 99.9),
+            percentile(values, 100));
+}
+
+static void latencyJSON(const char* key, const std::vector<double>& values, bool comma) {
+    printf("\"%s\":{\"n\":%zu,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}%s", key,
+           values.size(), percentile(values, 50), percentile(values, 90), percentile(values, 99),
+           percentile(values, 99.9), percentile(values, 100), comma ? "," : "");
+}
+
+static bool debugEnabled(Harness& harness, bool& enabled) {
+    std::string response;
+    if (!harness.transact("24", response)) return false;
+    enabled = response.find("\"debugEnabled\":true") != std::string::npos;
+    return true;
+}
+
+static bool setDebug(Harness& harness, bool enable) {
+    bool enabled;
+    if (!debugEnabled(harness, enabled)) return false;
+    if (enabled == enable) return true;
+    std::string response;
+    return harness.transact("07", response);
+}
+
+static int runLoad(Harness& harness, const Options& opt) {
+    std::vector<std::string> commands;
+    std::vector<double> weights;
+    if (!parseMix(opt.mix, commands, weights)) return 2;
+    std::mt19937 rng(opt.seed);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+    int perClientDepth = opt.mode == "pipeline" ? opt.depth : 1;
+    double intervalMs = opt.rateHz > 0 ? 1000.0 / opt.rateHz : 0;
+    double start = nowMs();
+    double end = start + opt.durationS * 1000.0;
+    for (size_t i = 0; i < harness.clients.size(); i++) {
+        // Spread the clients' schedules over one interval
+        harness.clients[i].nextSendMs = start + intervalMs * i / harness.clients.size();
+    }
+
+    for (;;) {
+        double now = nowMs();
+        bool done = opt.count > 0 ? (long)harness.stats.sent >= opt.count : now >= end;
+        if (done) break;
+
+        double nextWake = now + 50;
+        for (size_t i = 0; i < harness.clients.size(); i++) {
+            Client& client = harness.clients[i];
+            while (client.outstanding < perClientDepth && (opt.count == 0 || (long)harness.stats.sent < opt.count)) {
+                if (intervalMs > 0 && now < client.nextSendMs) {
+                    nextWake = std::min(nextWake, client.nextSendMs);
+                    break;
+                }
+                double scheduled = intervalMs > 0 ? client.nextSendMs : now;
+                harness.queue((int)i, client.connection, commands[pick(rng)], scheduled);
+                if (intervalMs > 0) client.nextSendMs += intervalMs;
+            }
+        }
+        for (size_t i = 0; i < harness.connections.size(); i++) {
+            if (!harness.flush(i)) return 1;
+        }
+        harness.wait(std::max(0.0, nextWake - nowMs()));
+        harness.expire();
+    }
+
+    // Let the last answers arrive
+    double settle = nowMs() + std::min(opt.timeoutMs, 1000.0);
+    for (;;) {
+        bool pending = false;
+        for (Connection& connection : harness.connections) pending |= !connection.fifo.empty();
+        if (!pending || nowMs() >= settle) break;
+        harness.wait(settle - nowMs());
+    }
+    double elapsedS = (nowMs() - start) / 1000.0;
+    for (Connection& connection : harness.connections) {
+        harness.stats.timeouts += connection.fifo.size();
+        connection.fifo.clear();
+    }
+
+    const Stats& s = harness.stats;
+    unsigned long lost = s.lostAcks + s.lostResponses + s.timeouts;
+    if (opt.json) {
+        printf("{\"mode\":\"%s\",\"clients\":%zu,\"separate\":%s,\"depth\":%d,\"rateHz\":%.2f,\"seconds\":%.3f,",
+               opt.mode.c_str(), harness.clients.size(), opt.separate ? "true" : "false", perClientDepth,
+               opt.rateHz, elapsedS);
+        printf("\"sent\":%lu,\"acked\":%lu,\"answered\":%lu,\"errors\":%lu,\"lost\":%lu,\"lostAcks\":%lu,"
+               "\"lostResponses\":%lu,\"timeouts\":%lu,\"garbled\":%lu,\"misrouted\":%lu,\"unmatched\":%lu,",
+               s.sent, s.acked, s.answered, s.errors, lost, s.lostAcks, s.lostResponses, s.timeouts, s.garbled,
+               s.misrouted, s.unmatched);
+        printf("\"throughput\":%.2f,\"notifications\":%lu,\"binaryFrames\":%lu,\"debugLines\":%lu,\"debugBytes\":%lu,"
+               "\"rxBytes\":%lu,", s.answered / elapsedS, s.notifications, s.binaryFrames, s.debugLines,
+               s.debugBytes, s.rxBytes);
+        latencyJSON("latencyMs", s.latency, true);
+        latencyJSON("ackLatencyMs", s.ackLatency, true);
+        latencyJSON("responseTimeMs", s.responseTime, true);
+        printf("\"perCommand\":{");
+        bool first = true;
+        for (const auto& entry : s.perCommand) {
+            if (!first) printf(",");
+            first = false;
+            latencyJSON(entry.first.c_str(), entry.second, false);
+        }
+        printf("}}\n");
+    } else {
+        char rate[32] = "unthrottled";
+        if (opt.rateHz > 0) snprintf(rate, sizeof(rate), "%.1f Hz per client", opt.rateHz);
+        printf("%s, %zu client(s)%s, depth %d, %s, %.1f s\n", opt.mode.c_str(), harness.clients.size(),
+               opt.separate ? " on separate opens" : "", perClientDepth, rate, elapsedS);
+        printf("sent %lu  acked %lu  answered %lu (%lu errors)  lost %lu (acks %lu, responses %lu, timeouts %lu)\n",
+               s.sent, s.acked, s.answered, s.errors, lost, s.lostAcks, s.lostResponses, s.timeouts);
+        printf("garbled %lu  misrouted %lu  unmatched %lu  notifications %lu  binary frames %lu\n", s.garbled,
+               s.misrouted, s.unmatched, s.notifications, s.binaryFrames);
+        printf("throughput %.1f responses/s, %.0f bytes/s received, debug %lu lines (%.0f bytes/s)\n",
+               s.answered / elapsedS, s.rxBytes / elapsedS, s.debugLines, s.debugBytes / elapsedS);
+        printLatency(stdout, "latency", s.latency);
+        printLatency(stdout, "ack latency", s.ackLatency);
+        printLatency(stdout, "response time", s.responseTime);
+        for (const auto& entry : s.perCommand) printLatency(stdout, ("  <" + entry.first + ">").c_str(), entry.second);
+    }
+    return lost > 0 || s.garbled > 0 ? 1 : 0;
+}
+
+// Malformed input that can never frame a command with side effects
+static std::string fuzzFrame(std::mt19937& rng, bool& split) {
+    // No space: the device trims frames, which could expose the bytes after it
+    static const char symbols[] = "!#$%&'()*+,-./:;=?@[]^_`{|}~";
+    auto symbol = [&]() { return symbols[rng() % (sizeof(symbols) - 1)]; };
+    auto printable = [&]() {
+        // Every framed command starts with a symbol, so nothing after it can form an opcode
+        char c = (char)(33 + rng() % 94);
+        return (isalnum((unsigned char)c) || c == '<' || c == '>') ? symbol() : c;
+    };
+    static const char* readOnly[] = {"21", "22", "24", "25", "26"};
+
+    std::string frame;
+    split = false;
+    switch (rng() % 9) {
+        case 0:   // Random bytes, brackets stripped so they cannot frame anything
+            for (int i = 0, n = 1 + rng() % 256; i < n; i++) {
+                char c = (char)(rng() & 0xFF);
+                frame += (c == '<' || c == '>') ? '~' : c;
+            }
+            break;
+        case 1:   // Overlong frame, truncated at 31 characters by the device
+            frame = "<";
+            for (int i = 0, n = 32 + rng() % 480; i < n; i++) frame += printable();
+            frame += ">";
+            break;
+        case 2:   // Unterminated frame, closed by the next one
+            frame = "<";
+            for (int i = 0, n = 1 + rng() % 64; i < n; i++) frame += printable();
+            break;
+        case 3:   // Stray delimiters
+            for (int i = 0, n = 1 + rng() % 64; i < n; i++) frame += (rng() % 2) ? '>' : symbol();
+            break;
+        case 4:   // Control characters and high bytes inside a frame
+            frame = "<";
+            for (int i = 0, n = 1 + rng() % 40; i < n; i++) {
+                frame += (rng() % 2) ? (char)(rng() % 32) : (char)(0x80 + rng() % 128);
+                if (rng() % 3 == 0) frame += symbol();
+            }
+            frame += ">";
+            break;
+        case 5:   // Unknown opcode
+            frame = "<";
+            frame += symbol();
+            for (int i = 0, n = rng() % 20; i < n; i++) frame += printable();
+            frame += ">";
+            break;
+        case 6:   // Known read-only opcode, arguments it rejects
+            frame = std::string("<") + readOnly[rng() % 5];
+            for (int i = 0, n = 1 + rng() % 20; i < n; i++) frame += symbol();
+            frame += ">";
+            break;
+        case 7:   // A run of opening brackets
+            frame.assign(1 + rng() % 256, '<');
+            frame += "~>";
+            break;
+        default:  // Unknown opcode split across writes
+            frame = "<";
+            for (int i = 0, n = 2 + rng() % 20; i < n; i++) frame += symbol();
+            frame += ">";
+            split = true;
+            break;
+    }
+    return frame;
+}
+
+static double jsonValue(const std::string& text, const std::string& object, const char* key) {
+    size_t pos = text.find("\"" + object + "\":{");
+    if (pos == std::string::npos) return -1;
+    size_t field = text.find(std::string("\"") + key + "\":", pos);
+    size_t end = text.find('}', pos);
+    if (field == std::string::npos || field > end) return -1;
+    return atof(text.c_str() + field + strlen(key) + 3);
+}
+
+static int runFuzz(Harness& harness, const Options& opt) {
+    std::string response;
+    if (!harness.transact("21R", response)) {
+        fprintf(stderr, "Device does not answer <21R>\n");
+        return 1;
+    }
+
+    std::mt19937 rng(opt.seed);
+    std::vector<double> probes;
+    unsigned long failedProbes = 0, bytes = 0;
+    double start = nowMs();
+    for (long i = 0; i < opt.fuzz; i++) {
+        bool split;
+        std::string frame = fuzzFrame(rng, split);
+        bytes += frame.size();
+        if (split) {
+            size_t half = frame.size() / 2;
+            writeAll(harness.connections[0].fd, frame.substr(0, half));
+            harness.wait(20);
+            writeAll(harness.connections[0].fd, frame.substr(half));
+        } else {
+            writeAll(harness.connections[0].fd, frame);
+        }
+        harness.wait(0);
+
+        if ((i + 1) % opt.probeEvery == 0) {
+            // Closes any frame left open, so the probe itself is parsed
+            writeAll(harness.connections[0].fd, ">");
+            double sent = nowMs();
+            if (harness.transact("08", response)) probes.push_back(nowMs() - sent);
+            else failedProbes++;
+        }
+    }
+    writeAll(harness.connections[0].fd, ">");
+    double elapsedS = (nowMs() - start) / 1000.0;
+    bool alive = harness.transact("08", response);
+
+    std::string profile;
+    harness.transact("21", profile);
+    double rxMaxUs = jsonValue(profile, "serialRx", "maxUs");
+    double commandMaxUs = jsonValue(profile, "command", "maxUs");
+    double loopMaxUs = jsonValue(profile, "loop", "maxUs");
+
+    const Stats& s = harness.stats;
+    if (opt.json) {
+        printf("{\"frames\":%ld,\"bytes\":%lu,\"seconds\":%.3f,\"framed\":%lu,\"answered\":%lu,\"garbled\":%lu,"
+               "\"failedProbes\":%lu,\"alive\":%s,\"serialRxMaxUs\":%.2f,\"commandMaxUs\":%.2f,\"loopMaxUs\":%.2f,",
+               opt.fuzz, bytes, elapsedS, s.misrouted, s.unmatched, s.garbled, failedProbes, alive ? "true" : "false", rxMaxUs,
+               commandMaxUs, loopMaxUs);
+        latencyJSON("probeLatencyMs", probes, false);
+        printf("}\n");
+    } else {
+        printf("fuzz: %ld frames, %lu bytes in %.1f s; %lu framed as commands, %lu answered, %lu garbled lines\n",
+               opt.fuzz, bytes, elapsedS, s.misrouted, s.unmatched, s.garbled);
+        printf("device: %s, serialRx max %.1f us, command max %.1f us, loop max %.1f us\n",
+               alive ? "alive" : "NOT RESPONDING", rxMaxUs, commandMaxUs, loopMaxUs);
+        printf("probes: %zu answered, %lu failed\n", probes.size(), failedProbes);
+        printLatency(stdout, "probe latency", probes);
+    }
+    return alive && failedProbes == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Harness harness(opt);
+    int connectionCount = opt.mode == "clients" && opt.separate ? opt.clients : 1;
+    for (int i = 0; i < connectionCount; i++) {
+        Connection connection;
+        connection.fd = openPort(opt.port);
+        if (connection.fd < 0) return 1;
+        harness.connections.push_back(connection);
+    }
+    int clientCount = opt.mode == "clients" ? opt.clients : 1;
+    for (int i = 0; i < clientCount; i++) {
+        Client client;
+        client.connection = connectionCount > 1 ? i : 0;
+        harness.clients.push_back(client);
+    }
+
+    // Start from a quiet link: a frame left open by an earlier client is closed
+    // first, and a device still booting is given time to answer
+    writeAll(harness.connections[0].fd, ">");
+    std::string response;
+    double readyDeadline = nowMs() + 15000;
+    while (!harness.transact("08", response)) {
+        if (nowMs() > readyDeadline) {
+            fprintf(stderr, "Device does not answer <08>\n");
+            return 1;
+        }
+    }
+    harness.drainInput(300);
+
+    bool restoreDebug = false, debugWas = false;
+    if (!opt.debug.empty()) {
+        if (!debugEnabled(harness, debugWas) || !setDebug(harness, opt.debug == "on")) {
+            fprintf(stderr, "Could not set debug output\n");
+            return 1;
+        }
+        restoreDebug = true;
+        harness.drainInput(100);
+    }
+
+    int status = opt.fuzz > 0 ? runFuzz(harness, opt) : runLoad(harness, opt);
+
+    if (restoreDebug) {
+        harness.drainInput(200);
+        setDebug(harness, debugWas);
+    }
+    for (Connection& connection : harness.connections) close(connection.fd);
+    return status;
+}
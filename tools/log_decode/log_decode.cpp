@@ -0,0 +1,202 @@
+// log_decode - host-side decoder for the on-flash sample log
+//
+// Reads a capture of the serial output taken while the device answered
+// <1C...> download commands, picks the log block frames (type 0x02) out of
+// the byte stream, reassembles the blocks and prints every sample and event
+// as CSV. JSON lines and telemetry frames in the capture are skipped.
+// With --raw the input is instead a plain image of consecutive 256-byte
+// blocks, e.g. a dump of the flash region.
+//
+// Build: g++ -O2 -std=c++17 -Imain tools/log_decode/log_decode.cpp main/log_codec.cpp main/crc32.cpp -o log_decode
+// Usage: log_decode [--raw] [--events] CAPTURE
+
+#include "log_codec.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#define FRAME_SYNC_1 0xA5
+#define FRAME_SYNC_2 0x5A
+#define FRAME_TYPE_LOG_BLOCK 0x02
+#define FRAME_PART_SIZE 128
+#define FRAME_PAYLOAD_SIZE (5 + FRAME_PART_SIZE)
+
+struct DecodeOptions {
+    bool raw = false;
+    bool eventsOnly = false;
+    const char* path = nullptr;
+};
+
+struct PartialBlock {
+    uint8_t data[LOG_BLOCK_SIZE];
+    uint8_t partsSeen = 0;      // Bit per frame part
+};
+
+struct DecodeStats {
+    unsigned long frames = 0;
+    unsigned long badFrames = 0;
+    unsigned long blocks = 0;
+    unsigned long badBlocks = 0;
+    unsigned long incompleteBlocks = 0;
+    unsigned long records = 0;
+};
+
+// Same CRC-8 (poly 0x07) as calculateCRC8() in the firmware
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0x00;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static const char* eventName(uint8_t code) {
+    switch (code) {
+        case LOG_EVENT_BOOT: return "boot";
+        case LOG_EVENT_PARKED: return "parked";
+        case LOG_EVENT_UNPARKED: return "unparked";
+        case LOG_EVENT_CALIBRATION: return "calibration";
+        case LOG_EVENT_RESET: return "reset";
+        case LOG_EVENT_SENSOR_ERROR: return "sensorError";
+        case LOG_EVENT_DECIMATION: return "decimation";
+        default: return "unknown";
+    }
+}
+
+static void printRecord(const LogBlockHeader& header, const LogRecord& record, void* context) {
+    const DecodeOptions& options = *(const DecodeOptions*)context;
+    unsigned long timeMs = (unsigned long)(header.startMs + record.offsetMs);
+
+    if (record.type == LOG_RECORD_EVENT) {
+        printf("%u,%lu,%lu,event,,,,,%s,%lu\n", header.bootCount, (unsigned long)header.sequence, timeMs,
+               eventName(record.eventCode), (unsigned long)record.eventValue);
+        return;
+    }
+    if (options.eventsOnly) return;
+
+    printf("%u,%lu,%lu,sample,%.2f,%.2f,%.1f,%u,,\n", header.bootCount, (unsigned long)header.sequence, timeMs,
+           record.sample.pitch / (double)LOG_ANGLE_SCALE, record.sample.roll / (double)LOG_ANGLE_SCALE,
+           record.sample.temperature / (double)LOG_TEMP_SCALE, record.sample.parked);
+}
+
+static void decodeBlock(const uint8_t* block, DecodeOptions& options, DecodeStats& stats) {
+    if (logBlockIsErased(block)) return;
+    if (!logDecodeBlock(block, printRecord, &options)) {
+        stats.badBlocks++;
+        return;
+    }
+    LogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    stats.blocks++;
+    stats.records += header.sampleCount;
+}
+
+static void decodeRawImage(const std::vector<uint8_t>& input, DecodeOptions& options, DecodeStats& stats) {
+    // Slots are in ring order; sort by sequence so the output is chronological
+    std::map<uint32_t, const uint8_t*> ordered;
+    for (size_t pos = 0; pos + LOG_BLOCK_SIZE <= input.size(); pos += LOG_BLOCK_SIZE) {
+        const uint8_t* block = input.data() + pos;
+        if (logBlockIsErased(block)) continue;
+        if (!logBlockIsValid(block)) {
+            stats.badBlocks++;
+            continue;
+        }
+        LogBlockHeader header;
+        memcpy(&header, block, sizeof(header));
+        ordered[header.sequence] = block;
+    }
+    for (const auto& entry : ordered) decodeBlock(entry.second, options, stats);
+}
+
+static void decodeCapture(const std::vector<uint8_t>& input, DecodeOptions& options, DecodeStats& stats) {
+    std::map<uint32_t, PartialBlock> pending;
+    const uint8_t allParts = (1 << (LOG_BLOCK_SIZE / FRAME_PART_SIZE)) - 1;
+
+    size_t pos = 0;
+    while (pos + 4 <= input.size()) {
+        if (input[pos] != FRAME_SYNC_1 || input[pos + 1] != FRAME_SYNC_2 ||
+            input[pos + 2] != FRAME_TYPE_LOG_BLOCK || input[pos + 3] != FRAME_PAYLOAD_SIZE) {
+            pos++;
+            continue;
+        }
+        size_t frameLength = 4 + FRAME_PAYLOAD_SIZE + 1;
+        if (pos + frameLength > input.size()) break;
+
+        const uint8_t* frame = input.data() + pos;
+        if (crc8(frame + 2, 2 + FRAME_PAYLOAD_SIZE) != frame[frameLength - 1]) {
+            stats.badFrames++;
+            pos++;  // Sync bytes inside text or another frame; keep scanning
+            continue;
+        }
+        stats.frames++;
+
+        uint32_t sequence;
+        memcpy(&sequence, frame + 4, 4);
+        uint8_t part = frame[8];
+        if (part < LOG_BLOCK_SIZE / FRAME_PART_SIZE) {
+            PartialBlock& partial = pending[sequence];
+            memcpy(partial.data + part * FRAME_PART_SIZE, frame + 9, FRAME_PART_SIZE);
+            partial.partsSeen |= (uint8_t)(1 << part);
+            if (partial.partsSeen == allParts) {
+                decodeBlock(partial.data, options, stats);
+                pending.erase(sequence);
+            }
+        }
+        pos += frameLength;
+    }
+    stats.incompleteBlocks = pending.size();
+}
+
+static bool parseArgs(int argc, char** argv, DecodeOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--raw") == 0) {
+            options.raw = true;
+        } else if (strcmp(argv[i], "--events") == 0) {
+            options.eventsOnly = true;
+        } else if (argv[i][0] != '-' && options.path == nullptr) {
+            options.path = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return options.path != nullptr;
+}
+
+int main(int argc, char** argv) {
+    DecodeOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--raw] [--events] CAPTURE\n", argv[0]);
+        return 2;
+    }
+
+    FILE* file = fopen(options.path, "rb");
+    if (file == nullptr) {
+        perror(options.path);
+        return 1;
+    }
+    std::vector<uint8_t> input;
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        input.insert(input.end(), buffer, buffer + count);
+    }
+    fclose(file);
+
+    printf("boot,block,time_ms,type,pitch,roll,temp_c,parked,event,value\n");
+    DecodeStats stats;
+    if (options.raw) {
+        decodeRawImage(input, options, stats);
+    } else {
+        decodeCapture(input, options, stats);
+    }
+
+    fprintf(stderr, "%lu blocks, %lu samples, %lu frames (%lu bad), %lu bad blocks, %lu incomplete\n",
+            stats.blocks, stats.records, stats.frames, stats.badFrames, stats.badBlocks, stats.incompleteBlocks);
+    return stats.badBlocks > 0 ? 1 : 0;
+}
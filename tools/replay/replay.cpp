@@ -0,0 +1,401 @@
+// replay - record/replay harness for the position pipeline
+//
+// Turns a serial capture taken during a <25R1> recording into a compact
+// recording file, then feeds the recorded raw samples through the firmware's
+// own readPosition() and updatePositionAndParkStatus() (linked from the host
+// build) on the simulated clock, as fast as the CPU allows. The header of the
+// recording restores the calibration, filter and park state the samples
+// started from, so every run of the same file gives the same decisions.
+//
+//   convert CAPTURE OUT          pick the replay frames (type 0x05) out of a capture
+//   run REC [--set NAME=VALUE]   CSV of every intermediate state, transitions on stderr
+//   compare REC --a NAME=VALUE... --b NAME=VALUE...
+//                                where two sets of filter/park settings decide differently
+//   upload REC [--set NAME=VALUE]
+//                                <25P1>, the header as <25H..>/<25HA>, <25S...>
+//                                per sample and <25P0>, to replay on a device
+//
+// NAME is a settings registry name: filterEnabled filterAlpha tolerance
+// parkHysteresis parkEnterDwell parkExitDwell parkDecisionMode parkPitch
+// parkRoll sprtFalseUnpark sprtFalsePark cal_ax_offset cal_ay_offset cal_az_offset
+//
+// Build: cmake --build build --target replay
+// Usage: replay convert capture.bin ride.rec
+//        replay run ride.rec --set filterAlpha=0.5 > states.csv
+//        replay compare ride.rec --a parkEnterDwell=500 --b parkDecisionMode=1
+
+#include "helpers.h"
+#include "position_sensor.h"
+#include "sample_replay.h"
+#include "sim_clock.h"
+#include "sim_serial.h"
+#include "telemetry_stream.h"
+#include "tx_buffer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct Recording {
+    ReplayHeader header;
+    std::vector<ReplaySample> samples;
+};
+
+struct Transition {
+    uint32_t timeMs;
+    bool parked;
+};
+
+struct RunResult {
+    std::vector<PipelineState> states;
+    std::vector<Transition> transitions;
+    double seconds = 0;
+};
+
+static bool readFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return true;
+}
+
+// Header and sample frames from a capture; text output around them is skipped
+static int convertCapture(const char* capturePath, const char* outPath) {
+    std::vector<uint8_t> input;
+    if (!readFile(capturePath, input)) return 1;
+
+    Recording recording;
+    bool haveHeader = false;
+    unsigned long frames = 0, badFrames = 0, gaps = 0, lost = 0;
+    uint16_t expectSeq = 0;
+
+    size_t pos = 0;
+    while (pos + 5 <= input.size()) {
+        if (input[pos] != STREAM_SYNC_BYTE_1 || input[pos + 1] != STREAM_SYNC_BYTE_2) {
+            pos++;
+            continue;
+        }
+        uint8_t type = input[pos + 2];
+        uint8_t length = input[pos + 3];
+        if (pos + 5 + length > input.size()) break;
+        const uint8_t* payload = input.data() + pos + 4;
+        if (calculateCRC8(input.data() + pos + 2, length + 2) != payload[length]) {
+            // A sync pattern inside text or another frame; resynchronize one byte on
+            if (type == STREAM_FRAME_REPLAY) badFrames++;
+            pos++;
+            continue;
+        }
+        pos += 5 + length;
+        if (type != STREAM_FRAME_REPLAY || length == 0) continue;
+        frames++;
+
+        if (payload[0] == REPLAY_FRAME_KIND_HEADER && length == 1 + REPLAY_HEADER_SIZE) {
+            if (haveHeader) {
+                fprintf(stderr, "Second recording in the capture, keeping the first\n");
+                break;
+            }
+            memcpy(&recording.header, payload + 1, REPLAY_HEADER_SIZE);
+            haveHeader = replayHeaderIsValid(recording.header);
+            expectSeq = 0;
+        } else if (payload[0] == REPLAY_FRAME_KIND_SAMPLE && length == REPLAY_SAMPLE_PAYLOAD && haveHeader) {
+            uint16_t seq;
+            ReplaySample sample;
+            memcpy(&seq, payload + 1, 2);
+            memcpy(&sample.timeMs, payload + 3, 4);
+            sample.failed = (payload[7] & 0x01) != 0;
+            memcpy(sample.counts, payload + 8, 6);
+            if (seq != expectSeq) {
+                gaps++;
+                lost += (uint16_t)(seq - expectSeq);
+            }
+            expectSeq = seq + 1;
+            recording.samples.push_back(sample);
+        }
+    }
+
+    if (!haveHeader) {
+        fprintf(stderr, "No recording header in %s\n", capturePath);
+        return 1;
+    }
+
+    FILE* out = fopen(outPath, "wb");
+    if (out == nullptr) {
+        perror(outPath);
+        return 1;
+    }
+    fwrite(&recording.header, REPLAY_HEADER_SIZE, 1, out);
+    ReplayCodecState codec;
+    replayCodecStart(codec, recording.header);
+    size_t bytes = REPLAY_HEADER_SIZE;
+    for (const ReplaySample& sample : recording.samples) {
+        uint8_t record[REPLAY_MAX_RECORD_SIZE];
+        size_t length = replayEncodeSample(codec, sample, record);
+        fwrite(record, 1, length, out);
+        bytes += length;
+    }
+    fclose(out);
+
+    fprintf(stderr, "%zu samples, %lu frames (%lu bad), %lu gaps (%lu samples lost), %zu bytes\n",
+            recording.samples.size(), frames, badFrames, gaps, lost, bytes);
+    if (gaps > 0) fprintf(stderr, "Warning: samples were lost, dwell timing across the gaps differs from the device\n");
+    return 0;
+}
+
+static bool loadRecording(const char* path, Recording& recording) {
+    std::vector<uint8_t> data;
+    if (!readFile(path, data)) return false;
+    if (data.size() < REPLAY_HEADER_SIZE) {
+        fprintf(stderr, "%s: too short for a recording\n", path);
+        return false;
+    }
+    memcpy(&recording.header, data.data(), REPLAY_HEADER_SIZE);
+    if (!replayHeaderIsValid(recording.header)) {
+        fprintf(stderr, "%s: not a recording (bad magic or version)\n", path);
+        return false;
+    }
+
+    ReplayCodecState codec;
+    replayCodecStart(codec, recording.header);
+    size_t pos = REPLAY_HEADER_SIZE;
+    while (pos < data.size()) {
+        ReplaySample sample;
+        size_t used = replayDecodeSample(codec, data.data() + pos, data.size() - pos, sample);
+        if (used == 0) {
+            fprintf(stderr, "%s: corrupt record at offset %zu, stopping there\n", path, pos);
+            break;
+        }
+        recording.samples.push_back(sample);
+        pos += used;
+    }
+    return true;
+}
+
+// NAME=VALUE against the settings the header carries
+static bool applyOverride(ReplayHeader& header, const char* assignment) {
+    const char* equals = strchr(assignment, '=');
+    if (equals == nullptr) {
+        fprintf(stderr, "Expected NAME=VALUE, got %s\n", assignment);
+        return false;
+    }
+    std::string name(assignment, equals - assignment);
+    double value = atof(equals + 1);
+
+    if (name == "filterEnabled") header.filterEnabled = value != 0 ? 1 : 0;
+    else if (name == "filterAlpha") header.filterAlpha = (float)value;
+    else if (name == "tolerance") header.tolerance = (float)value;
+    else if (name == "parkHysteresis") header.hysteresis = (float)value;
+    else if (name == "parkEnterDwell") header.enterDwellMs = (uint32_t)value;
+    else if (name == "parkExitDwell") header.exitDwellMs = (uint32_t)value;
+    else if (name == "parkDecisionMode") header.decisionMode = (uint8_t)value;
+    else if (name == "parkPitch") header.parkPitch = (float)value;
+    else if (name == "parkRoll") header.parkRoll = (float)value;
+    else if (name == "sprtFalseUnpark") header.sprtFalseUnpark = (float)value;
+    else if (name == "sprtFalsePark") header.sprtFalsePark = (float)value;
+    else if (name == "cal_ax_offset") header.offset[0] = (float)value;
+    else if (name == "cal_ay_offset") header.offset[1] = (float)value;
+    else if (name == "cal_az_offset") header.offset[2] = (float)value;
+    else {
+        fprintf(stderr, "Unknown setting %s\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The recording's samples through the firmware pipeline, from the recorded state
+static RunResult runRecording(const Recording& recording, const ReplayHeader& header) {
+    RunResult result;
+    result.states.reserve(recording.samples.size());
+
+    // Counts become g at the recorded full scale (calcAccel: 0.061 mg/LSB at +-2g)
+    imu.settings.accelRange = (uint16_t)(header.accelScale * 1000.0f / 0.061f * 2.0f + 0.5f);
+
+    startSampleReplay(header.startMs);
+    applyReplayHeader(header);
+    bool parked = isCurrentlyParked();
+
+    auto start = std::chrono::steady_clock::now();
+    for (const ReplaySample& sample : recording.samples) {
+        replaySample(sample);
+        PipelineState state = getPipelineState();
+        if (state.parked != parked) {
+            parked = state.parked;
+            result.transitions.push_back({sample.timeMs, parked});
+        }
+        result.states.push_back(state);
+        SerialTx.service();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stopSampleReplay();
+    return result;
+}
+
+static void printTransitions(const char* label, const Recording& recording, const RunResult& result) {
+    uint32_t startMs = recording.header.startMs;
+    fprintf(stderr, "%s%zu transitions\n", label, result.transitions.size());
+    for (const Transition& transition : result.transitions) {
+        fprintf(stderr, "  %10.3f s  (t=%lu ms)  %s\n", (transition.timeMs - startMs) / 1000.0,
+                (unsigned long)transition.timeMs, transition.parked ? "parked" : "unparked");
+    }
+}
+
+static void printSpeed(const Recording& recording, const RunResult& result) {
+    if (recording.samples.empty()) return;
+    double spanSeconds = (recording.samples.back().timeMs - recording.header.startMs) / 1000.0;
+    double rate = result.seconds > 0 ? recording.samples.size() / result.seconds : 0;
+    fprintf(stderr, "%zu samples (%.1f s recorded) in %.3f ms: %.0f samples/s, %.0fx real time\n",
+            recording.samples.size(), spanSeconds, result.seconds * 1000.0, rate,
+            result.seconds > 0 ? spanSeconds / result.seconds : 0);
+}
+
+static int runCommand(const Recording& recording, ReplayHeader header, FILE* out) {
+    RunResult result = runRecording(recording, header);
+
+    fprintf(out, "time_ms,x,y,z,failed,ax,ay,az,fx,fy,fz,magnitude,pitch,roll,"
+                 "unfiltered_pitch,unfiltered_roll,parked,pending_parked,pending_ms,llr,noise_sigma\n");
+    for (const PipelineState& s : result.states) {
+        fprintf(out, "%lu,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.4f,%.4f,%.4f,%.4f,%d,%d,%lu,%.4f,%.5f\n",
+                (unsigned long)s.sampleMs, s.counts[0], s.counts[1], s.counts[2], s.failed ? 1 : 0,
+                s.accel[0], s.accel[1], s.accel[2], s.filtered[0], s.filtered[1], s.filtered[2],
+                s.magnitude, s.pitch, s.roll, s.unfilteredPitch, s.unfilteredRoll,
+                s.parked ? 1 : 0, s.pendingParked ? 1 : 0, (unsigned long)s.pendingMs, s.sprtLlr, s.noiseSigma);
+    }
+    printTransitions("", recording, result);
+    printSpeed(recording, result);
+    return 0;
+}
+
+static int compareCommand(const Recording& recording, const ReplayHeader& a, const ReplayHeader& b, FILE* out) {
+    RunResult resultA = runRecording(recording, a);
+    RunResult resultB = runRecording(recording, b);
+
+    // Stretches where the two settings report a different park state
+    uint32_t startMs = recording.header.startMs;
+    unsigned long disagreeMs = 0;
+    size_t stretches = 0;
+    fprintf(out, "start_s,end_s,a_parked,b_parked\n");
+    for (size_t i = 0; i < recording.samples.size(); i++) {
+        if (resultA.states[i].parked == resultB.states[i].parked) continue;
+        size_t end = i;
+        while (end + 1 < recording.samples.size() && resultA.states[end + 1].parked != resultB.states[end + 1].parked) {
+            end++;
+        }
+        uint32_t endMs = end + 1 < recording.samples.size() ? recording.samples[end + 1].timeMs
+                                                            : recording.samples[end].timeMs;
+        fprintf(out, "%.3f,%.3f,%d,%d\n", (recording.samples[i].timeMs - startMs) / 1000.0,
+                (endMs - startMs) / 1000.0, resultA.states[i].parked ? 1 : 0, resultB.states[i].parked ? 1 : 0);
+        disagreeMs += endMs - recording.samples[i].timeMs;
+        stretches++;
+        i = end;
+    }
+
+    printTransitions("A: ", recording, resultA);
+    printTransitions("B: ", recording, resultB);
+    fprintf(stderr, "%zu stretches, %.3f s where A and B disagree\n", stretches, disagreeMs / 1000.0);
+    printSpeed(recording, resultA);
+    return 0;
+}
+
+// The header first, so the device starts from the recorded calibration,
+// filter and park settings and state like a host run does; then sample times
+// as deltas, so the device replays on the recorded time base
+static int uploadCommand(const Recording& recording, const ReplayHeader& header, FILE* out) {
+    fprintf(out, "<25P1>\n");
+    const uint8_t* bytes = (const uint8_t*)&header;
+    for (size_t offset = 0; offset < REPLAY_HEADER_SIZE; offset += 12) {
+        fprintf(out, "<25H%02X", (unsigned)offset);
+        for (size_t i = offset; i < offset + 12 && i < REPLAY_HEADER_SIZE; i++) fprintf(out, "%02X", bytes[i]);
+        fprintf(out, ">\n");
+    }
+    fprintf(out, "<25HA>\n");
+    uint32_t lastMs = header.startMs;
+    unsigned long clamped = 0;
+    for (const ReplaySample& sample : recording.samples) {
+        uint32_t delta = sample.timeMs - lastMs;
+        if (delta > 0xFFFF) {
+            delta = 0xFFFF;
+            clamped++;
+        }
+        lastMs = sample.timeMs;
+        if (sample.failed) {
+            fprintf(out, "<25SE%04X>\n", (unsigned)delta);
+        } else {
+            fprintf(out, "<25S%04X%04X%04X%04X>\n", (uint16_t)sample.counts[0], (uint16_t)sample.counts[1],
+                    (uint16_t)sample.counts[2], (unsigned)delta);
+        }
+    }
+    fprintf(out, "<25P0>\n");
+    if (clamped > 0) fprintf(stderr, "%lu gaps longer than 65.535 s were shortened\n", clamped);
+    return 0;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s convert CAPTURE OUT\n"
+                    "       %s run REC [--set NAME=VALUE]...\n"
+                    "       %s compare REC --a NAME=VALUE... --b NAME=VALUE...\n"
+                    "       %s upload REC [--set NAME=VALUE]...\n",
+            program, program, program, program);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::string command = argv[1];
+    if (command == "convert") {
+        if (argc != 4) {
+            usage(argv[0]);
+            return 2;
+        }
+        return convertCapture(argv[2], argv[3]);
+    }
+
+    Recording recording;
+    if (!loadRecording(argv[2], recording)) return 1;
+
+    ReplayHeader headerA = recording.header;
+    ReplayHeader headerB = recording.header;
+    ReplayHeader* target = &headerA;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--a") == 0 || strcmp(argv[i], "--set") == 0) {
+            target = &headerA;
+        } else if (strcmp(argv[i], "--b") == 0) {
+            target = &headerB;
+        } else if (!applyOverride(*target, argv[i])) {
+            return 2;
+        }
+    }
+
+    // Results go to a copy of stdout; the firmware's own output (park
+    // notifications, debug) goes to /dev/null through the simulated serial port
+    FILE* out = fdopen(dup(STDOUT_FILENO), "w");
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+    simClockSetMode(SIM_CLOCK_SIMULATED);
+    Serial.attachStdio(false);
+
+    int status;
+    if (command == "run") status = runCommand(recording, headerA, out);
+    else if (command == "compare") status = compareCommand(recording, headerA, headerB, out);
+    else if (command == "upload") status = uploadCommand(recording, headerA, out);
+    else {
+        usage(argv[0]);
+        status = 2;
+    }
+    fclose(out);
+    return status;
+}
@@ -0,0 +1,1044 @@
+// safety_bridge - Alpaca SafetyMonitor bridge that owns the park sensor's serial port
+//
+// One process holds the device connection and keeps a snapshot of position
+// and park state, from a JSON telemetry subscription (<14>, the default) or
+// by polling <03> (--poll-ms). Any number of local clients read it through
+// the ASCOM Alpaca SafetyMonitor API over HTTP, so the serial traffic is the
+// same for one client or a thousand:
+//
+//   GET /api/v1/safetymonitor/0/issafe        true when the telescope is parked
+//   GET /api/v1/safetymonitor/0/devicestate   IsSafe and its TimeStamp
+//   plus the common members (connected, name, description, driverinfo, ...)
+//   and /management/apiversions, /management/v1/description, configureddevices
+//
+// Reads are answered from the snapshot while it is younger than --max-age.
+// Older than that (a stalled stream, a device reset), the first request sends
+// one <03> and every request arriving before its answer waits for the same
+// answer; if the device does not answer within --timeout they all get
+// IsSafe false, as a disconnected SafetyMonitor must report.
+//
+// GET /events is a Server-Sent Events stream: the current state on connect,
+// then "parked"/"unparked" on every park change and "link" when the device
+// connection drops or returns. GET /bridge/status reports the snapshot, its
+// age and the serial and HTTP counters.
+//
+// The port is reopened after a disconnect (a USB replug, a simulator restart)
+// and the subscription renewed when telemetry stops. Listens on localhost
+// only unless told otherwise; --discovery also answers Alpaca UDP discovery.
+//
+// Build: cmake --build build --target safety_bridge
+// Usage: safety_bridge --port PATH [--listen ADDR:PORT] [--stream-ms MS | --poll-ms MS]
+//                      [--max-age MS] [--timeout MS] [--discovery] [--verbose]
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#define FRAME_SYNC_1 0xA5
+#define FRAME_SYNC_2 0x5A
+#define MAX_RX_LINE 4096              // Longer than any device line
+#define MAX_HTTP_REQUEST 16384        // Headers and body of one request
+#define MAX_CLIENT_BACKLOG 262144     // Unsent bytes before a slow event subscriber is dropped
+#define REOPEN_INTERVAL_MS 1000
+#define KEEPALIVE_INTERVAL_MS 15000   // SSE comment so proxies and clients see a live stream
+#define DISCOVERY_PORT 32227
+#define STREAM_FIELDS "2B"            // pitch, roll, parked, sequence
+
+static const char* DRIVER_NAME = "Telescope Park Sensor";
+static const char* DRIVER_VERSION = "1.0";
+static const int INTERFACE_VERSION = 3;
+
+// Alpaca error numbers
+#define ALPACA_NOT_IMPLEMENTED 0x400
+#define ALPACA_ACTION_NOT_IMPLEMENTED 0x40C
+
+struct Options {
+    const char* port = nullptr;
+    std::string listenAddress = "127.0.0.1";
+    int listenPort = 11111;
+    int streamMs = 200;
+    int pollMs = 0;                   // Poll <03> instead of subscribing
+    int maxAgeMs = 1000;
+    int timeoutMs = 1000;
+    bool discovery = false;
+    bool verbose = false;
+};
+
+struct Snapshot {
+    bool valid = false;
+    bool parked = false;
+    float pitch = 0, roll = 0;
+    unsigned long sampleSeq = 0;
+    unsigned long eventSeq = 0;
+    std::string reason;
+    double updatedMs = 0;             // Monotonic
+    double updatedWallMs = 0;         // For Alpaca timestamps
+    const char* source = "none";
+};
+
+struct SerialCommand {
+    std::string command;
+    double sentMs;
+    bool acked = false;
+};
+
+struct HttpRequest {
+    std::string method, path, version;
+    std::map<std::string, std::string> params;   // Query or form fields, keys lowercased
+    bool keepAlive = true;
+};
+
+struct HttpClient {
+    int fd = -1;
+    std::string in, out;
+    bool waiting = false;             // Request held for a snapshot refresh
+    HttpRequest pending;
+    bool events = false;
+    bool closeAfterWrite = false;
+    bool closed = false;              // Closed, removed after the current event
+};
+
+struct Counters {
+    unsigned long serialTxBytes = 0, serialRxBytes = 0, serialCommands = 0, serialTimeouts = 0;
+    unsigned long telemetryLines = 0, notifications = 0, reopens = 0, resubscribes = 0;
+    unsigned long refreshes = 0, coalesced = 0, staleAnswers = 0;
+    unsigned long httpRequests = 0, httpConnections = 0, eventsSent = 0, droppedSubscribers = 0;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+static sigset_t waitMask;             // SIGINT/SIGTERM are only delivered inside epoll_pwait
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static double wallMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static std::string isoTime(double wall) {
+    time_t seconds = (time_t)(wall / 1000.0);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char text[40];
+    size_t length = strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(text + length, sizeof(text) - length, ".%03dZ", (int)fmod(wall, 1000.0));
+    return text;
+}
+
+static std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 32) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Value of "key": in a device line; empty when absent
+static std::string jsonField(const std::string& line, const char* key) {
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) return std::string();
+    pos += pattern.size();
+    if (pos < line.size() && line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        return end == std::string::npos ? std::string() : line.substr(pos + 1, end - pos - 1);
+    }
+    size_t end = line.find_first_of(",}", pos);
+    return line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+static bool startsWith(const std::string& text, const char* prefix) {
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::string lowercase(std::string text) {
+    for (char& c : text) c = (char)tolower((unsigned char)c);
+    return text;
+}
+
+static std::string urlDecode(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '+') {
+            out += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && isxdigit((unsigned char)text[i + 1]) &&
+                   isxdigit((unsigned char)text[i + 2])) {
+            out += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+static void parseParams(const std::string& text, std::map<std::string, std::string>& params) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('&', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(pos, end - pos);
+        size_t equals = item.find('=');
+        if (!item.empty()) {
+            // Alpaca parameter names are case-insensitive
+            params[lowercase(urlDecode(item.substr(0, equals)))] =
+                equals == std::string::npos ? std::string() : urlDecode(item.substr(equals + 1));
+        }
+        pos = end + 1;
+    }
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s --port PATH [--listen ADDR:PORT] [--stream-ms MS | --poll-ms MS]\n"
+            "          [--max-age MS] [--timeout MS] [--discovery] [--verbose]\n", program);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--port") && hasValue) opt.port = argv[++i];
+        else if (!strcmp(arg, "--listen") && hasValue) {
+            std::string value = argv[++i];
+            size_t colon = value.rfind(':');
+            if (colon == std::string::npos) return false;
+            opt.listenAddress = value.substr(0, colon);
+            opt.listenPort = atoi(value.c_str() + colon + 1);
+        }
+        else if (!strcmp(arg, "--stream-ms") && hasValue) opt.streamMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--poll-ms") && hasValue) opt.pollMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--max-age") && hasValue) opt.maxAgeMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--timeout") && hasValue) opt.timeoutMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--discovery")) opt.discovery = true;
+        else if (!strcmp(arg, "--verbose")) opt.verbose = true;
+        else return false;
+    }
+    // The device streams no faster than every 50ms and takes 4 digits
+    if (opt.streamMs < 50 || opt.streamMs > 9999 || opt.pollMs < 0) return false;
+    return opt.port != nullptr && opt.listenPort > 0 && opt.listenPort < 65536 && opt.maxAgeMs > 0 && opt.timeoutMs > 0;
+}
+
+class Bridge {
+public:
+    explicit Bridge(const Options& opt) : opt(opt) {}
+
+    bool start() {
+        epollFd = epoll_create1(0);
+        if (epollFd < 0 || !listen()) return false;
+        if (opt.discovery && !openDiscovery()) return false;
+        openPort();
+        return true;
+    }
+
+    void run() {
+        std::vector<struct epoll_event> events(256);
+        while (!stopRequested) {
+            int count = epoll_pwait(epollFd, events.data(), events.size(), nextTimeoutMs(), &waitMask);
+            if (count < 0 && errno != EINTR) {
+                perror("epoll_pwait");
+                break;
+            }
+            for (int i = 0; i < count; i++) dispatch(events[i]);
+            serviceTimers();
+            reapClients();
+        }
+        if (serialFd >= 0 && opt.pollMs == 0) writeSerial("<15>");   // Leave the device quiet
+    }
+
+private:
+    const Options& opt;
+    int epollFd = -1, listenFd = -1, discoveryFd = -1, serialFd = -1;
+    std::string serialRx;
+    std::deque<SerialCommand> serialFifo;
+    bool deviceAlive = false;
+    double reopenAtMs = 0;
+    double lastTelemetryMs = 0;
+    double nextPollMs = 0;
+    double nextKeepaliveMs = 0;
+    bool refreshInFlight = false;
+    std::vector<int> refreshWaiters;
+    std::map<int, HttpClient> clients;
+    std::vector<int> closedClients;
+    Snapshot snapshot;
+    Counters counters;
+    unsigned long serverTransaction = 0;
+    unsigned long eventId = 0;
+
+    // Tags for epoll: listening socket, discovery socket, serial port; clients use their fd
+    enum { TAG_LISTEN = -1, TAG_DISCOVERY = -2, TAG_SERIAL = -3 };
+
+    void watch(int fd, int tag, uint32_t events) {
+        struct epoll_event event = {};
+        event.events = events;
+        event.data.u64 = (uint64_t)(int64_t)tag;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void rewatch(int fd, uint32_t events) {
+        struct epoll_event event = {};
+        event.events = events;
+        event.data.u64 = (uint64_t)(int64_t)fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    void log(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        if (!opt.verbose) return;
+        va_list args;
+        va_start(args, format);
+        fprintf(stderr, "[%s] ", isoTime(wallMs()).c_str());
+        vfprintf(stderr, format, args);
+        fputc('\n', stderr);
+        va_end(args);
+    }
+
+    bool listen() {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int yes = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(opt.listenPort);
+        if (inet_pton(AF_INET, opt.listenAddress.c_str(), &address.sin_addr) != 1) {
+            fprintf(stderr, "Bad listen address %s\n", opt.listenAddress.c_str());
+            return false;
+        }
+        if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || ::listen(listenFd, 512) < 0) {
+            perror("listen");
+            return false;
+        }
+        watch(listenFd, TAG_LISTEN, EPOLLIN);
+        fprintf(stderr, "Alpaca SafetyMonitor on http://%s:%d/api/v1/safetymonitor/0/\n", opt.listenAddress.c_str(),
+                opt.listenPort);
+        return true;
+    }
+
+    bool openDiscovery() {
+        discoveryFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int yes = 1;
+        setsockopt(discoveryFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(DISCOVERY_PORT);
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(discoveryFd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+            perror("discovery");
+            return false;
+        }
+        watch(discoveryFd, TAG_DISCOVERY, EPOLLIN);
+        return true;
+    }
+
+    // --- Device link ---
+
+    void openPort() {
+        serialFd = open(opt.port, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (serialFd < 0) {
+            reopenAtMs = nowMs() + REOPEN_INTERVAL_MS;
+            return;
+        }
+        struct termios settings;
+        if (tcgetattr(serialFd, &settings) == 0) {
+            cfmakeraw(&settings);
+            cfsetispeed(&settings, B115200);
+            cfsetospeed(&settings, B115200);
+            settings.c_cflag |= CLOCAL | CREAD;
+            tcsetattr(serialFd, TCSANOW, &settings);
+        }
+        watch(serialFd, TAG_SERIAL, EPOLLIN);
+        counters.reopens++;
+        serialRx.clear();
+        log("opened %s", opt.port);
+
+        // Close any frame an earlier owner left open, then start the snapshot
+        writeSerial(">");
+        if (opt.pollMs == 0) subscribe();
+        startRefresh();
+    }
+
+    void closePort() {
+        if (serialFd < 0) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, serialFd, nullptr);
+        close(serialFd);
+        serialFd = -1;
+        serialFifo.clear();
+        setDeviceAlive(false);
+        if (refreshInFlight) finishRefresh();
+        reopenAtMs = nowMs() + REOPEN_INTERVAL_MS;
+        log("lost %s, reopening", opt.port);
+    }
+
+    void setDeviceAlive(bool alive) {
+        if (alive == deviceAlive) return;
+        deviceAlive = alive;
+        broadcast("link", std::string("{\"connected\":") + (alive ? "true" : "false") + "}");
+    }
+
+    void writeSerial(const std::string& data) {
+        size_t written = 0;
+        double deadline = nowMs() + 50;
+        while (written < data.size() && nowMs() < deadline) {
+            ssize_t count = write(serialFd, data.data() + written, data.size() - written);
+            if (count > 0) written += count;
+            else if (count < 0 && errno != EAGAIN && errno != EINTR) break;
+        }
+        counters.serialTxBytes += written;
+    }
+
+    void sendCommand(const std::string& command) {
+        if (serialFd < 0) return;
+        SerialCommand pending;
+        pending.command = command;
+        pending.sentMs = nowMs();
+        serialFifo.push_back(pending);
+        counters.serialCommands++;
+        writeSerial("<" + command + ">");
+    }
+
+    void subscribe() {
+        char command[16];
+        snprintf(command, sizeof(command), "14%sJM%04d", STREAM_FIELDS, opt.streamMs);
+        sendCommand(command);
+        lastTelemetryMs = nowMs();    // Give the stream a full watchdog period to start
+    }
+
+    void readSerial() {
+        char buffer[4096];
+        ssize_t count;
+        while ((count = read(serialFd, buffer, sizeof(buffer))) > 0) {
+            serialRx.append(buffer, count);
+            counters.serialRxBytes += count;
+        }
+        // A pty whose master went away reads EIO; a vanished USB device reads 0 or EIO
+        bool lost = count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR);
+
+        size_t pos = 0;
+        while (pos < serialRx.size()) {
+            if ((uint8_t)serialRx[pos] == FRAME_SYNC_1 && pos + 1 < serialRx.size() &&
+                (uint8_t)serialRx[pos + 1] == FRAME_SYNC_2) {
+                // Binary frames belong to other tools; skip them whole
+                if (pos + 4 > serialRx.size()) break;
+                size_t length = 5 + (uint8_t)serialRx[pos + 3];
+                if (pos + length > serialRx.size()) break;
+                pos += length;
+                continue;
+            }
+            size_t end = serialRx.find('\n', pos);
+            if (end == std::string::npos) {
+                if (serialRx.size() - pos > MAX_RX_LINE) pos = serialRx.size();
+                break;
+            }
+            std::string line = serialRx.substr(pos, end - pos);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            pos = end + 1;
+            if (!line.empty() && line[0] == '{') handleLine(line);
+        }
+        serialRx.erase(0, pos);
+        if (lost) closePort();
+    }
+
+    void handleLine(const std::string& line) {
+        double now = nowMs();
+        if (startsWith(line, "{\"telemetry\":")) {
+            counters.telemetryLines++;
+            lastTelemetryMs = now;
+            std::string parked = jsonField(line, "parked");
+            if (parked.empty()) return;
+            updateSnapshot(parked == "true", atof(jsonField(line, "pitch").c_str()),
+                           atof(jsonField(line, "roll").c_str()), "telemetry");
+            snapshot.sampleSeq = strtoul(jsonField(line, "seq").c_str(), nullptr, 10);
+            setDeviceAlive(true);
+            return;
+        }
+        if (startsWith(line, "{\"notification\":\"parked\"") || startsWith(line, "{\"notification\":\"unparked\"")) {
+            counters.notifications++;
+            snapshot.eventSeq = strtoul(jsonField(line, "eventSeq").c_str(), nullptr, 10);
+            snapshot.reason = jsonField(line, "reason");
+            updateSnapshot(jsonField(line, "parked") == "true", atof(jsonField(line, "pitch").c_str()),
+                           atof(jsonField(line, "roll").c_str()), "notification");
+            setDeviceAlive(true);
+            return;
+        }
+
+        if (startsWith(line, "{\"status\":\"ack\"")) {
+            std::string command = jsonField(line, "command");
+            auto it = serialFifo.begin();
+            while (it != serialFifo.end() && (it->acked || it->command != command)) ++it;
+            if (it == serialFifo.end()) return;
+            serialFifo.erase(serialFifo.begin(), it);   // Commands ahead of it were lost
+            serialFifo.front().acked = true;
+            setDeviceAlive(true);
+            return;
+        }
+        bool ok = startsWith(line, "{\"status\":\"ok\"");
+        if (!ok && !startsWith(line, "{\"status\":\"error\"")) return;
+        if (serialFifo.empty() || !serialFifo.front().acked) return;
+        SerialCommand answered = serialFifo.front();
+        serialFifo.pop_front();
+
+        if (answered.command == "03") {
+            if (ok) {
+                updateSnapshot(jsonField(line, "parked") == "true", atof(jsonField(line, "currentPitch").c_str()),
+                               atof(jsonField(line, "currentRoll").c_str()), "poll");
+            }
+            finishRefresh();
+        } else if (startsWith(answered.command, "14") && !ok) {
+            fprintf(stderr, "Device refused the telemetry subscription: %s\n", line.c_str());
+        }
+    }
+
+    void updateSnapshot(bool parked, float pitch, float roll, const char* source) {
+        bool changed = snapshot.valid && parked != snapshot.parked;
+        bool first = !snapshot.valid;
+        snapshot.valid = true;
+        snapshot.parked = parked;
+        snapshot.pitch = pitch;
+        snapshot.roll = roll;
+        snapshot.updatedMs = nowMs();
+        snapshot.updatedWallMs = wallMs();
+        snapshot.source = source;
+        // Notifications come first; a change seen only in telemetry or a poll
+        // means the notification was missed (say, across a reconnect)
+        if (changed || first) {
+            if (strcmp(source, "notification") != 0) snapshot.reason = first ? "initial" : "observed";
+            log("%s (%s) pitch %.2f roll %.2f", parked ? "parked" : "unparked", snapshot.reason.c_str(), pitch, roll);
+            broadcast(parked ? "parked" : "unparked", snapshotJSON());
+        }
+    }
+
+    bool snapshotFresh() const {
+        return snapshot.valid && deviceAlive && nowMs() - snapshot.updatedMs <= opt.maxAgeMs;
+    }
+
+    // One <03> in flight at a time, whoever asked for it
+    void startRefresh() {
+        if (refreshInFlight) return;
+        if (serialFd < 0) {
+            finishRefresh();
+            return;
+        }
+        refreshInFlight = true;
+        counters.refreshes++;
+        sendCommand("03");
+    }
+
+    void finishRefresh() {
+        refreshInFlight = false;
+        std::vector<int> waiters;
+        waiters.swap(refreshWaiters);
+        for (int fd : waiters) {
+            auto it = clients.find(fd);
+            if (it == clients.end() || it->second.closed || !it->second.waiting) continue;
+            it->second.waiting = false;
+            HttpRequest request = it->second.pending;
+            respondAlpaca(it->second, request);
+            processInput(it->second);
+        }
+    }
+
+    void expireCommands() {
+        double now = nowMs();
+        while (!serialFifo.empty() && now - serialFifo.front().sentMs > opt.timeoutMs) {
+            SerialCommand expired = serialFifo.front();
+            serialFifo.pop_front();
+            counters.serialTimeouts++;
+            setDeviceAlive(false);
+            log("<%s> timed out", expired.command.c_str());
+            if (expired.command == "03") finishRefresh();
+        }
+    }
+
+    // --- Timers ---
+
+    int nextTimeoutMs() {
+        double now = nowMs();
+        double next = now + 1000;
+        if (serialFd < 0) next = std::min(next, reopenAtMs);
+        if (!serialFifo.empty()) next = std::min(next, serialFifo.front().sentMs + opt.timeoutMs);
+        if (opt.pollMs > 0 && serialFd >= 0) next = std::min(next, nextPollMs);
+        return (int)std::max(0.0, next - now + 1);
+    }
+
+    void serviceTimers() {
+        double now = nowMs();
+        if (serialFd < 0 && now >= reopenAtMs) openPort();
+        expireCommands();
+        if (serialFd >= 0 && opt.pollMs > 0 && now >= nextPollMs) {
+            nextPollMs = now + opt.pollMs;
+            startRefresh();
+        }
+        if (serialFd >= 0 && opt.pollMs == 0 && now - lastTelemetryMs > 3 * opt.streamMs + opt.timeoutMs) {
+            // The device rebooted or another program unsubscribed it
+            counters.resubscribes++;
+            log("telemetry stopped, subscribing again");
+            subscribe();
+            startRefresh();
+        }
+        if (now >= nextKeepaliveMs) {
+            nextKeepaliveMs = now + KEEPALIVE_INTERVAL_MS;
+            for (auto& entry : clients) {
+                if (entry.second.events) send(entry.second, ": keepalive\n\n");
+            }
+        }
+    }
+
+    // --- HTTP ---
+
+    void dispatch(const struct epoll_event& event) {
+        int tag = (int)(int64_t)event.data.u64;
+        if (tag == TAG_LISTEN) acceptClients();
+        else if (tag == TAG_DISCOVERY) answerDiscovery();
+        else if (tag == TAG_SERIAL) readSerial();
+        else {
+            auto it = clients.find(tag);
+            if (it == clients.end() || it->second.closed) return;
+            if (event.events & EPOLLOUT) flush(it->second);
+            if (!it->second.closed && (event.events & (EPOLLIN | EPOLLHUP | EPOLLERR))) readClient(it->second);
+        }
+    }
+
+    void acceptClients() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+            HttpClient client;
+            client.fd = fd;
+            clients[fd] = client;
+            watch(fd, fd, EPOLLIN);
+            counters.httpConnections++;
+        }
+    }
+
+    void answerDiscovery() {
+        char buffer[64];
+        struct sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t count;
+        while ((count = recvfrom(discoveryFd, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromLength)) > 0) {
+            if (count >= 16 && memcmp(buffer, "alpacadiscovery1", 16) == 0) {
+                std::string reply = "{\"AlpacaPort\":" + std::to_string(opt.listenPort) + "}";
+                sendto(discoveryFd, reply.data(), reply.size(), 0, (struct sockaddr*)&from, fromLength);
+            }
+            fromLength = sizeof(from);
+        }
+    }
+
+    // Closed now, erased once nothing up the call stack holds a reference
+    void dropClient(HttpClient& client) {
+        if (client.closed) return;
+        client.closed = true;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+        close(client.fd);
+        closedClients.push_back(client.fd);
+    }
+
+    void reapClients() {
+        for (int fd : closedClients) {
+            // A client accepted since may already have been given the same descriptor
+            auto it = clients.find(fd);
+            if (it != clients.end() && it->second.closed) clients.erase(it);
+        }
+        closedClients.clear();
+    }
+
+    void readClient(HttpClient& client) {
+        char buffer[4096];
+        ssize_t count;
+        while ((count = read(client.fd, buffer, sizeof(buffer))) > 0) client.in.append(buffer, count);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+            dropClient(client);
+            return;
+        }
+        if (client.events) client.in.clear();   // Nothing more is read from an event stream
+        processInput(client);
+    }
+
+    // Requests on one connection are answered in order; a held request holds the rest
+    void processInput(HttpClient& client) {
+        while (!client.waiting && !client.events && !client.closeAfterWrite && !client.closed) {
+            size_t headerEnd = client.in.find("\r\n\r\n");
+            if (headerEnd == std::string::npos) {
+                if (client.in.size() > MAX_HTTP_REQUEST) sendStatus(client, 431, "Request Header Fields Too Large", true);
+                return;
+            }
+            HttpRequest request;
+            size_t contentLength = 0;
+            if (!parseHead(client.in.substr(0, headerEnd), request, contentLength) ||
+                contentLength > MAX_HTTP_REQUEST) {
+                sendStatus(client, 400, "Bad Request", true);
+                return;
+            }
+            if (client.in.size() < headerEnd + 4 + contentLength) return;
+            std::string body = client.in.substr(headerEnd + 4, contentLength);
+            client.in.erase(0, headerEnd + 4 + contentLength);
+            if (request.method == "PUT") parseParams(body, request.params);
+            counters.httpRequests++;
+            handleRequest(client, request);
+        }
+    }
+
+    static bool parseHead(const std::string& head, HttpRequest& request, size_t& contentLength) {
+        size_t lineEnd = head.find("\r\n");
+        std::string requestLine = head.substr(0, lineEnd);
+        size_t first = requestLine.find(' ');
+        size_t second = requestLine.find(' ', first + 1);
+        if (first == std::string::npos || second == std::string::npos) return false;
+        request.method = requestLine.substr(0, first);
+        std::string target = requestLine.substr(first + 1, second - first - 1);
+        request.version = requestLine.substr(second + 1);
+        request.keepAlive = request.version == "HTTP/1.1";
+
+        size_t query = target.find('?');
+        request.path = lowercase(urlDecode(target.substr(0, query)));
+        if (query != std::string::npos) parseParams(target.substr(query + 1), request.params);
+
+        size_t pos = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+        while (pos < head.size()) {
+            size_t end = head.find("\r\n", pos);
+            if (end == std::string::npos) end = head.size();
+            std::string header = head.substr(pos, end - pos);
+            size_t colon = header.find(':');
+            if (colon != std::string::npos) {
+                std::string name = lowercase(header.substr(0, colon));
+                std::string value = header.substr(colon + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                if (name == "content-length") contentLength = strtoul(value.c_str(), nullptr, 10);
+                else if (name == "connection") {
+                    std::string token = lowercase(value);
+                    if (token == "close") request.keepAlive = false;
+                    else if (token == "keep-alive") request.keepAlive = true;
+                }
+            }
+            pos = end + 2;
+        }
+        return true;
+    }
+
+    void handleRequest(HttpClient& client, const HttpRequest& request) {
+        if (request.path == "/events") {
+            if (request.method != "GET") {
+                sendStatus(client, 405, "Method Not Allowed", !request.keepAlive);
+                return;
+            }
+            client.events = true;
+            send(client, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                         "Connection: keep-alive\r\n\r\n");
+            sendEvent(client, "state", stateJSON());
+            return;
+        }
+        if (request.path == "/bridge/status") {
+            sendJSON(client, 200, statusJSON(), !request.keepAlive);
+            return;
+        }
+        if (startsWith(request.path, "/management/")) {
+            respondManagement(client, request);
+            return;
+        }
+        if (!startsWith(request.path, "/api/v1/")) {
+            sendStatus(client, 404, "Not Found", !request.keepAlive);
+            return;
+        }
+
+        // /api/v1/{type}/{number}/{member}
+        std::vector<std::string> parts;
+        size_t pos = strlen("/api/v1/");
+        while (pos <= request.path.size()) {
+            size_t end = request.path.find('/', pos);
+            if (end == std::string::npos) end = request.path.size();
+            parts.push_back(request.path.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        if (parts.size() != 3 || parts[0] != "safetymonitor" || parts[1] != "0") {
+            sendText(client, 400, "Bad Request", "Unknown device " + request.path, !request.keepAlive);
+            return;
+        }
+        std::string member = parts[2];
+        bool reads = member == "issafe" || member == "devicestate" || member == "connected";
+        if (request.method == "GET" && reads && !snapshotFresh()) {
+            // Hold the request for the refresh everyone shares
+            if (refreshInFlight) counters.coalesced++;
+            client.waiting = true;
+            client.pending = request;
+            refreshWaiters.push_back(client.fd);
+            startRefresh();
+            return;
+        }
+        respondAlpaca(client, request);
+    }
+
+    void respondManagement(HttpClient& client, const HttpRequest& request) {
+        if (request.method != "GET") {
+            sendStatus(client, 405, "Method Not Allowed", !request.keepAlive);
+            return;
+        }
+        if (request.path == "/management/apiversions") {
+            sendAlpaca(client, request, "[1]");
+        } else if (request.path == "/management/v1/description") {
+            sendAlpaca(client, request,
+                       std::string("{\"ServerName\":\"Park Sensor Safety Bridge\",\"Manufacturer\":\"Corey Smart\","
+                                   "\"ManufacturerVersion\":\"") + DRIVER_VERSION + "\",\"Location\":" +
+                           jsonString(opt.port) + "}");
+        } else if (request.path == "/management/v1/configureddevices") {
+            sendAlpaca(client, request,
+                       std::string("[{\"DeviceName\":\"") + DRIVER_NAME + "\",\"DeviceType\":\"SafetyMonitor\","
+                       "\"DeviceNumber\":0,\"UniqueID\":" + jsonString(uniqueId()) + "}]");
+        } else {
+            sendStatus(client, 404, "Not Found", !request.keepAlive);
+        }
+    }
+
+    void respondAlpaca(HttpClient& client, const HttpRequest& request) {
+        std::string member = request.path.substr(request.path.rfind('/') + 1);
+        bool get = request.method == "GET";
+        bool put = request.method == "PUT";
+        bool fresh = snapshotFresh();
+        if (!fresh && get && (member == "issafe" || member == "devicestate")) counters.staleAnswers++;
+
+        if (get && member == "issafe") {
+            // A SafetyMonitor that cannot see the device reports unsafe
+            sendAlpaca(client, request, fresh && snapshot.parked ? "true" : "false");
+        } else if (get && member == "devicestate") {
+            double stamp = snapshot.valid ? snapshot.updatedWallMs : wallMs();
+            sendAlpaca(client, request,
+                       std::string("[{\"Name\":\"IsSafe\",\"Value\":") + (fresh && snapshot.parked ? "true" : "false") +
+                           "},{\"Name\":\"TimeStamp\",\"Value\":\"" + isoTime(stamp) + "\"}]");
+        } else if (get && member == "connected") {
+            sendAlpaca(client, request, fresh ? "true" : "false");
+        } else if (get && member == "connecting") {
+            sendAlpaca(client, request, "false");
+        } else if (get && member == "name") {
+            sendAlpaca(client, request, jsonString(DRIVER_NAME));
+        } else if (get && member == "description") {
+            sendAlpaca(client, request, jsonString(std::string(DRIVER_NAME) + " (telescope parked = safe)"));
+        } else if (get && member == "driverinfo") {
+            sendAlpaca(client, request, jsonString("Park sensor safety bridge on " + std::string(opt.port)));
+        } else if (get && member == "driverversion") {
+            sendAlpaca(client, request, jsonString(DRIVER_VERSION));
+        } else if (get && member == "interfaceversion") {
+            sendAlpaca(client, request, std::to_string(INTERFACE_VERSION));
+        } else if (get && member == "supportedactions") {
+            sendAlpaca(client, request, "[]");
+        } else if (put && member == "connected") {
+            // The bridge keeps the device link for every client; connecting is a no-op
+            auto it = request.params.find("connected");
+            std::string value = it == request.params.end() ? std::string() : lowercase(it->second);
+            if (value != "true" && value != "false") {
+                sendText(client, 400, "Bad Request", "Connected must be true or false", !request.keepAlive);
+                return;
+            }
+            sendAlpaca(client, request, std::string());
+        } else if (put && (member == "connect" || member == "disconnect")) {
+            sendAlpaca(client, request, std::string());
+        } else if (put && member == "action") {
+            sendAlpacaError(client, request, ALPACA_ACTION_NOT_IMPLEMENTED, "No actions are supported");
+        } else if (put && (member == "commandblind" || member == "commandbool" || member == "commandstring")) {
+            sendAlpacaError(client, request, ALPACA_NOT_IMPLEMENTED, "Raw device commands are not supported");
+        } else {
+            sendText(client, 400, "Bad Request", "Unknown member " + request.method + " " + member, !request.keepAlive);
+        }
+    }
+
+    static uint32_t transactionId(const HttpRequest& request) {
+        auto it = request.params.find("clienttransactionid");
+        if (it == request.params.end()) return 0;
+        char* end;
+        unsigned long value = strtoul(it->second.c_str(), &end, 10);
+        return *end == '\0' ? (uint32_t)value : 0;
+    }
+
+    std::string alpacaEnvelope(const HttpRequest& request, const std::string& value, int error,
+                               const std::string& message) {
+        std::string json = "{";
+        if (!value.empty()) json += "\"Value\":" + value + ",";
+        json += "\"ClientTransactionID\":" + std::to_string(transactionId(request)) +
+                ",\"ServerTransactionID\":" + std::to_string(++serverTransaction) +
+                ",\"ErrorNumber\":" + std::to_string(error) + ",\"ErrorMessage\":" + jsonString(message) + "}";
+        return json;
+    }
+
+    void sendAlpaca(HttpClient& client, const HttpRequest& request, const std::string& value) {
+        sendJSON(client, 200, alpacaEnvelope(request, value, 0, std::string()), !request.keepAlive);
+    }
+
+    void sendAlpacaError(HttpClient& client, const HttpRequest& request, int error, const std::string& message) {
+        sendJSON(client, 200, alpacaEnvelope(request, std::string(), error, message), !request.keepAlive);
+    }
+
+    void sendJSON(HttpClient& client, int status, const std::string& body, bool closeAfter) {
+        sendResponse(client, status, status == 200 ? "OK" : "Error", "application/json", body, closeAfter);
+    }
+
+    void sendText(HttpClient& client, int status, const char* reason, const std::string& body, bool closeAfter) {
+        sendResponse(client, status, reason, "text/plain", body, closeAfter);
+    }
+
+    void sendStatus(HttpClient& client, int status, const char* reason, bool closeAfter) {
+        sendText(client, status, reason, reason, closeAfter);
+    }
+
+    void sendResponse(HttpClient& client, int status, const char* reason, const char* type, const std::string& body,
+                      bool closeAfter) {
+        std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\nContent-Type: " + type +
+                               "; charset=utf-8\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" +
+                               (closeAfter ? "Connection: close\r\n" : "") + "\r\n" + body;
+        client.closeAfterWrite = closeAfter;
+        send(client, response);
+    }
+
+    void send(HttpClient& client, const std::string& data) {
+        bool wasIdle = client.out.empty();
+        client.out += data;
+        if (client.closed) return;
+        if (client.out.size() > MAX_CLIENT_BACKLOG) {
+            counters.droppedSubscribers++;
+            dropClient(client);
+            return;
+        }
+        if (wasIdle) flush(client);
+    }
+
+    void flush(HttpClient& client) {
+        int fd = client.fd;
+        while (!client.out.empty() && !client.closed) {
+            ssize_t count = write(fd, client.out.data(), client.out.size());
+            if (count > 0) {
+                client.out.erase(0, count);
+            } else if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+                rewatch(fd, EPOLLIN | EPOLLOUT);
+                return;
+            } else {
+                dropClient(client);
+                return;
+            }
+        }
+        if (client.closed) return;
+        rewatch(fd, EPOLLIN);
+        if (client.closeAfterWrite) dropClient(client);
+    }
+
+    // --- Events ---
+
+    void sendEvent(HttpClient& client, const char* name, const std::string& data) {
+        counters.eventsSent++;
+        send(client, "event: " + std::string(name) + "\nid: " + std::to_string(eventId) + "\ndata: " + data + "\n\n");
+    }
+
+    void broadcast(const char* name, const std::string& data) {
+        eventId++;
+        std::vector<int> subscribers;
+        for (auto& entry : clients) {
+            if (entry.second.events && !entry.second.closed) subscribers.push_back(entry.first);
+        }
+        for (int fd : subscribers) sendEvent(clients[fd], name, data);
+    }
+
+    std::string snapshotJSON() const {
+        char numbers[160];
+        snprintf(numbers, sizeof(numbers), ",\"pitch\":%.2f,\"roll\":%.2f,\"eventSeq\":%lu,\"time\":", snapshot.pitch,
+                 snapshot.roll, snapshot.eventSeq);
+        return std::string("{\"parked\":") + (snapshot.parked ? "true" : "false") + ",\"reason\":" +
+               jsonString(snapshot.reason) + numbers + jsonString(isoTime(snapshot.updatedWallMs)) + "}";
+    }
+
+    std::string stateJSON() const {
+        bool fresh = snapshotFresh();
+        return std::string("{\"connected\":") + (deviceAlive ? "true" : "false") + ",\"isSafe\":" +
+               (fresh && snapshot.parked ? "true" : "false") + ",\"snapshot\":" +
+               (snapshot.valid ? snapshotJSON() : "null") + "}";
+    }
+
+    std::string statusJSON() const {
+        size_t subscribers = 0;
+        for (const auto& entry : clients) subscribers += entry.second.events && !entry.second.closed ? 1 : 0;
+        char text[1024];
+        snprintf(text, sizeof(text),
+                 "{\"port\":%s,\"open\":%s,\"deviceAlive\":%s,\"mode\":\"%s\",\"periodMs\":%d,\"maxAgeMs\":%d,"
+                 "\"ageMs\":%.0f,\"source\":\"%s\",\"sampleSeq\":%lu,"
+                 "\"serial\":{\"txBytes\":%lu,\"rxBytes\":%lu,\"commands\":%lu,\"timeouts\":%lu,\"telemetry\":%lu,"
+                 "\"notifications\":%lu,\"opens\":%lu,\"resubscribes\":%lu},"
+                 "\"cache\":{\"refreshes\":%lu,\"coalesced\":%lu,\"staleAnswers\":%lu},"
+                 "\"http\":{\"requests\":%lu,\"connections\":%lu,\"open\":%zu,\"subscribers\":%zu,\"events\":%lu,"
+                 "\"droppedSubscribers\":%lu},\"state\":",
+                 jsonString(opt.port).c_str(), serialFd >= 0 ? "true" : "false", deviceAlive ? "true" : "false",
+                 opt.pollMs > 0 ? "poll" : "stream", opt.pollMs > 0 ? opt.pollMs : opt.streamMs, opt.maxAgeMs,
+                 snapshot.valid ? nowMs() - snapshot.updatedMs : -1.0, snapshot.source, snapshot.sampleSeq,
+                 counters.serialTxBytes, counters.serialRxBytes, counters.serialCommands, counters.serialTimeouts,
+                 counters.telemetryLines, counters.notifications, counters.reopens, counters.resubscribes,
+                 counters.refreshes, counters.coalesced, counters.staleAnswers, counters.httpRequests,
+                 counters.httpConnections, clients.size(), subscribers, counters.eventsSent,
+                 counters.droppedSubscribers);
+        return text + stateJSON() + "}";
+    }
+
+    std::string uniqueId() const {
+        // Stable per port path, so clients keep their configuration across restarts
+        uint32_t hash = 2166136261u;
+        for (const char* p = opt.port; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+        char id[48];
+        snprintf(id, sizeof(id), "park-sensor-safety-%08x", hash);
+        return id;
+    }
+};
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigprocmask(SIG_BLOCK, &blocked, &waitMask);
+
+    Bridge bridge(opt);
+    if (!bridge.start()) return 1;
+    bridge.run();
+    return 0;
+}
@@ -0,0 +1,186 @@
+// spectrum - host-side vibration spectrum of a burst capture
+//
+// Runs main/vibration_fft.cpp (the reference FFT path) over a capture of the
+// serial output taken during a <1E> burst capture, one report per full
+// 1024-sample window, so on-device <1F> results can be checked against raw
+// data. The sample period is taken from the burstCaptured notification and
+// the accelerometer scale from a <1E> status response if the capture contains
+// them; otherwise give them on the command line. --sine runs a synthetic
+// sinusoid through the same path instead.
+//
+// Build: g++ -O2 -std=c++17 -Imain tools/spectrum/spectrum.cpp main/vibration_fft.cpp -o spectrum
+// Usage: spectrum [--period-us US] [--mg-per-count MG] CAPTURE
+//        spectrum --sine HZ AMPLITUDE_MG RATE_HZ
+
+#include "vibration_fft.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define FRAME_SYNC_1 0xA5
+#define FRAME_SYNC_2 0x5A
+#define FRAME_TYPE_BURST 0x03
+#define BURST_AXES 6
+#define FIRST_ACCEL_AXIS 3
+
+struct SpectrumOptions {
+    double periodUs = 0;
+    double mgPerCount = 0;
+    bool sine = false;
+    double sineHz = 0;
+    double sineMg = 0;
+    double sineRate = 0;
+    const char* path = nullptr;
+};
+
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0x00;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Numeric value of "key": in the text portions of the capture, 0 if absent
+static double findJsonNumber(const std::vector<uint8_t>& input, const char* key) {
+    std::string text(input.begin(), input.end());
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t pos = text.rfind(pattern);
+    if (pos == std::string::npos) return 0;
+    return atof(text.c_str() + pos + pattern.size());
+}
+
+static std::vector<int16_t> parseBurstFrames(const std::vector<uint8_t>& input) {
+    std::vector<int16_t> samples;
+    size_t pos = 0;
+    while (pos + 5 <= input.size()) {
+        if (input[pos] != FRAME_SYNC_1 || input[pos + 1] != FRAME_SYNC_2 || input[pos + 2] != FRAME_TYPE_BURST) {
+            pos++;
+            continue;
+        }
+        size_t length = input[pos + 3];
+        if (pos + 4 + length + 1 > input.size()) break;
+        const uint8_t* frame = input.data() + pos;
+        if (length < 3 || crc8(frame + 2, 2 + length) != frame[4 + length]) {
+            pos++;
+            continue;
+        }
+
+        uint16_t first;
+        memcpy(&first, frame + 4, 2);
+        size_t count = frame[6];
+        if (3 + count * BURST_AXES * 2 == length) {
+            samples.resize(((size_t)first + count) * BURST_AXES > samples.size() ? ((size_t)first + count) * BURST_AXES
+                                                                               : samples.size());
+            memcpy(&samples[(size_t)first * BURST_AXES], frame + 7, count * BURST_AXES * 2);
+        }
+        pos += 4 + length + 1;
+    }
+    return samples;
+}
+
+static void printResult(const SpectrumResult& result) {
+    printf("  rate %.1f Hz, resolution %.3f Hz, rms %.3f mg\n", result.sampleRateHz, result.resolutionHz,
+           result.rms);
+    for (uint8_t i = 0; i < result.peakCount; i++) {
+        printf("  peak %u: %8.2f Hz  %8.3f mg\n", i + 1, result.peaks[i].frequencyHz, result.peaks[i].amplitude);
+    }
+    for (int band = 0; band < VIBRATION_BAND_COUNT; band++) {
+        printf("  band %4.0f-%4.0f Hz: %8.3f mg rms\n", VIBRATION_BAND_EDGES_HZ[band],
+               VIBRATION_BAND_EDGES_HZ[band + 1], result.bandRms[band]);
+    }
+}
+
+static void analyzeWindow(SpectrumAnalyzer& analyzer, const int16_t* samples, float rate, float scale) {
+    spectrumStart(analyzer, rate);
+    for (int channel = 0; channel < 3; channel++) {
+        spectrumLoadChannel(analyzer, samples + FIRST_ACCEL_AXIS + channel, BURST_AXES, scale);
+        while (!spectrumStep(analyzer)) {
+        }
+    }
+    SpectrumResult result;
+    spectrumFinish(analyzer, result);
+    printResult(result);
+}
+
+static bool parseArgs(int argc, char** argv, SpectrumOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--period-us") == 0 && i + 1 < argc) {
+            options.periodUs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--mg-per-count") == 0 && i + 1 < argc) {
+            options.mgPerCount = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sine") == 0 && i + 3 < argc) {
+            options.sine = true;
+            options.sineHz = atof(argv[++i]);
+            options.sineMg = atof(argv[++i]);
+            options.sineRate = atof(argv[++i]);
+        } else if (argv[i][0] != '-' && options.path == nullptr) {
+            options.path = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return options.sine || options.path != nullptr;
+}
+
+int main(int argc, char** argv) {
+    SpectrumOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--period-us US] [--mg-per-count MG] CAPTURE\n", argv[0]);
+        fprintf(stderr, "       %s --sine HZ AMPLITUDE_MG RATE_HZ\n", argv[0]);
+        return 2;
+    }
+
+    static SpectrumAnalyzer analyzer;
+
+    if (options.sine) {
+        // 0.01 mg per count keeps quantization out of the check
+        std::vector<int16_t> samples(VIBRATION_FFT_SIZE * BURST_AXES, 0);
+        for (size_t i = 0; i < VIBRATION_FFT_SIZE; i++) {
+            double value = options.sineMg * sin(2.0 * M_PI * options.sineHz * i / options.sineRate);
+            samples[i * BURST_AXES + FIRST_ACCEL_AXIS] = (int16_t)lround(value * 100.0);
+        }
+        printf("sine %.2f Hz, %.3f mg at %.1f Hz\n", options.sineHz, options.sineMg, options.sineRate);
+        analyzeWindow(analyzer, samples.data(), options.sineRate, 0.01f);
+        return 0;
+    }
+
+    FILE* file = fopen(options.path, "rb");
+    if (file == nullptr) {
+        perror(options.path);
+        return 1;
+    }
+    std::vector<uint8_t> input;
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        input.insert(input.end(), buffer, buffer + count);
+    }
+    fclose(file);
+
+    if (options.periodUs <= 0) options.periodUs = findJsonNumber(input, "periodUs");
+    if (options.mgPerCount <= 0) options.mgPerCount = findJsonNumber(input, "accelScaleG") * 1000.0;
+    if (options.periodUs <= 0 || options.mgPerCount <= 0) {
+        fprintf(stderr, "Sample period or accelerometer scale not in the capture; use --period-us and --mg-per-count\n");
+        return 1;
+    }
+
+    std::vector<int16_t> samples = parseBurstFrames(input);
+    size_t sampleCount = samples.size() / BURST_AXES;
+    size_t windows = sampleCount / VIBRATION_FFT_SIZE;
+    printf("%zu samples, %zu windows of %d\n", sampleCount, windows, VIBRATION_FFT_SIZE);
+    for (size_t w = 0; w < windows; w++) {
+        printf("window %zu:\n", w);
+        analyzeWindow(analyzer, &samples[w * VIBRATION_FFT_SIZE * BURST_AXES], (float)(1e6 / options.periodUs),
+                      (float)options.mgPerCount);
+    }
+    return windows > 0 ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+// sprt_sim - host-side simulation of the park decision logic
+//
+// Feeds synthetic noisy samples through main/park_sprt.cpp and through a
+// model of the threshold decider (EMA filter + tolerance + dwell) and reports
+// decision latency and false-decision rates for both. A second table starts the
+// SPRT cold, as after a restart, with and without the noise warm-up.
+//
+// Build: g++ -O2 -std=c++17 -Imain tools/sprt_sim/sprt_sim.cpp main/park_sprt.cpp -o sprt_sim
+// Usage: sprt_sim [--sigma DEG] [--tolerance DEG] [--trials N] [--alpha A] [--beta B]
+//                 [--ema ALPHA] [--dwell SAMPLES] [--warmup SAMPLES] [--seed N]
+
+#include "park_sprt.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+struct SimOptions {
+    double sigma = 0.05;        // Per-sample angle noise (degrees)
+    double tolerance = 2.0;     // Park tolerance (degrees)
+    int trials = 2000;
+    double alpha = SPRT_DEFAULT_FALSE_UNPARK_RATE;
+    double beta = SPRT_DEFAULT_FALSE_PARK_RATE;
+    double ema = 0.2;           // Firmware default filter alpha
+    int dwellSamples = 10;      // 500ms enter dwell at 20Hz
+    int warmup = SPRT_DEFAULT_WARMUP_SAMPLES;
+    unsigned seed = 1;
+    int horizon = 400;          // Samples observed per trial (20s at 20Hz)
+};
+
+struct SimStats {
+    double meanLatency = 0;
+    int maxLatency = 0;
+    int undecided = 0;
+    int wrong = 0;
+};
+
+// Telescope stops after a slew at trueDeviation; count samples to the first
+// decision and whether that decision (or any later one) is wrong. A cold start
+// is a restart at rest instead: no noise history, `warmup` samples to learn it.
+static SimStats runSprt(const SimOptions& opt, double trueDeviation, std::mt19937& rng, bool coldStart,
+                        int warmup) {
+    std::normal_distribution<double> noise(0.0, opt.sigma);
+    SprtConfig config;
+    sprtDefaultConfig(config);
+    config.falseUnparkRate = opt.alpha;
+    config.falseParkRate = opt.beta;
+    config.warmupSamples = (uint8_t)warmup;
+
+    bool truthParked = trueDeviation <= opt.tolerance;
+    SimStats stats;
+    long latencySum = 0;
+    int decided = 0;
+
+    for (int t = 0; t < opt.trials; t++) {
+        SprtState state;
+        sprtReset(state);
+        // The noise estimate persists between tests, so run a stretch at rest
+        // away from park, then a 2 second slew onto the park position
+        double start = opt.tolerance + 5.0;
+        for (int i = 0; i < 100 && !coldStart; i++) {
+            sprtUpdate(state, config, (float)fabs(start + noise(rng)), (float)opt.tolerance);
+        }
+        for (int i = 0; i < 40 && !coldStart; i++) {
+            double position = start + (trueDeviation - start) * i / 40.0;
+            sprtUpdate(state, config, (float)fabs(position + noise(rng)), (float)opt.tolerance);
+        }
+        sprtRestart(state);
+
+        int firstDecision = -1;
+        bool wrong = false;
+        for (int i = 0; i < opt.horizon; i++) {
+            double x = fabs(trueDeviation + noise(rng));
+            SprtResult r = sprtUpdate(state, config, (float)x, (float)opt.tolerance);
+            if (r.decision == PARK_DECISION_NONE) continue;
+            if (firstDecision < 0) firstDecision = i + 1;
+            if ((r.decision == PARK_DECISION_PARKED) != truthParked) wrong = true;
+        }
+
+        if (firstDecision < 0) {
+            stats.undecided++;
+            continue;
+        }
+        decided++;
+        latencySum += firstDecision;
+        if (firstDecision > stats.maxLatency) stats.maxLatency = firstDecision;
+        if (wrong) stats.wrong++;
+    }
+    stats.meanLatency = decided ? (double)latencySum / decided : 0;
+    return stats;
+}
+
+static SimStats runThreshold(const SimOptions& opt, double trueDeviation, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0.0, opt.sigma);
+    bool truthParked = trueDeviation <= opt.tolerance;
+    SimStats stats;
+    long latencySum = 0;
+    int decided = 0;
+
+    for (int t = 0; t < opt.trials; t++) {
+        double filtered = opt.tolerance + 5.0;  // Filter state left over from the slew
+        bool parked = false;
+        int pendingCount = 0;
+        int firstDecision = -1;
+        bool wrong = false;
+
+        for (int i = 0; i < opt.horizon; i++) {
+            double x = trueDeviation + noise(rng);
+            filtered = opt.ema * filtered + (1.0 - opt.ema) * x;
+            bool candidate = fabs(filtered) <= opt.tolerance;
+            if (candidate == parked) {
+                pendingCount = 0;
+                continue;
+            }
+            if (++pendingCount < opt.dwellSamples) continue;
+            parked = candidate;
+            pendingCount = 0;
+            if (firstDecision < 0) firstDecision = i + 1;
+            if (parked != truthParked) wrong = true;
+        }
+
+        // Staying unparked is the correct answer when the truth is unparked
+        if (firstDecision < 0 && !truthParked) firstDecision = opt.dwellSamples;
+        if (firstDecision < 0) {
+            stats.undecided++;
+            continue;
+        }
+        decided++;
+        latencySum += firstDecision;
+        if (firstDecision > stats.maxLatency) stats.maxLatency = firstDecision;
+        if (wrong) stats.wrong++;
+    }
+    stats.meanLatency = decided ? (double)latencySum / decided : 0;
+    return stats;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "Usage: %s [--sigma DEG] [--tolerance DEG] [--trials N] [--alpha A] [--beta B]\n"
+                    "          [--ema ALPHA] [--dwell SAMPLES] [--warmup SAMPLES] [--seed N]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    SimOptions opt;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const char* arg = argv[i];
+        const char* value = argv[++i];
+        if (!strcmp(arg, "--sigma")) opt.sigma = atof(value);
+        else if (!strcmp(arg, "--tolerance")) opt.tolerance = atof(value);
+        else if (!strcmp(arg, "--trials")) opt.trials = atoi(value);
+        else if (!strcmp(arg, "--alpha")) opt.alpha = atof(value);
+        else if (!strcmp(arg, "--beta")) opt.beta = atof(value);
+        else if (!strcmp(arg, "--ema")) opt.ema = atof(value);
+        else if (!strcmp(arg, "--dwell")) opt.dwellSamples = atoi(value);
+        else if (!strcmp(arg, "--warmup")) opt.warmup = atoi(value);
+        else if (!strcmp(arg, "--seed")) opt.seed = (unsigned)atoi(value);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(opt.seed);
+    printf("sigma=%.3f deg  tolerance=%.2f deg  trials=%d  alpha=%.4f  beta=%.4f  ema=%.2f  dwell=%d samples\n",
+           opt.sigma, opt.tolerance, opt.trials, opt.alpha, opt.beta, opt.ema, opt.dwellSamples);
+    printf("Latency in samples (20Hz) from the end of the slew to the first decision.\n");
+    printf("'wrong' counts trials with any wrong decision in %d samples; offsets within\n", opt.horizon);
+    printf("+/-%.2f deg of the tolerance are inside the SPRT indifference zone.\n\n", SPRT_DEFAULT_INDIFFERENCE);
+    printf("%10s | %-28s | %-28s\n", "offset", "SPRT mean/max  wrong undec", "threshold mean/max  wrong");
+
+    const double offsets[] = {-1.0, -0.5, -0.2, -0.1, -0.05, 0.05, 0.1, 0.2, 0.5, 1.0};
+    for (double offset : offsets) {
+        double trueDeviation = opt.tolerance + offset;
+        SimStats s = runSprt(opt, trueDeviation, rng, false, opt.warmup);
+        SimStats t = runThreshold(opt, trueDeviation, rng);
+        printf("%+9.2f  | %6.1f/%-4d %6.3f%% %5d | %6.1f/%-4d %9.3f%%\n", offset,
+               s.meanLatency, s.maxLatency, 100.0 * s.wrong / opt.trials, s.undecided,
+               t.meanLatency, t.maxLatency, 100.0 * t.wrong / opt.trials);
+    }
+
+    // Right after a restart the noise estimate is empty; without the warm-up
+    // the minSigma floor stands in and the first samples decide on their own
+    printf("\nCold start at rest (restart, no noise history), SPRT with a %d-sample warm-up and without.\n",
+           opt.warmup);
+    printf("%10s | %-28s | %-28s\n", "offset", "warm-up mean/max  wrong", "no warm-up mean/max  wrong");
+    for (double offset : offsets) {
+        double trueDeviation = opt.tolerance + offset;
+        SimStats w = runSprt(opt, trueDeviation, rng, true, opt.warmup);
+        SimStats c = runSprt(opt, trueDeviation, rng, true, 0);
+        printf("%+9.2f  | %6.1f/%-4d %9.3f%% | %6.1f/%-4d %12.3f%%\n", offset,
+               w.meanLatency, w.maxLatency, 100.0 * w.wrong / opt.trials,
+               c.meanLatency, c.maxLatency, 100.0 * c.wrong / opt.trials);
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+// trace_decode - host-side decoder for the binary trace ring
+//
+// Reads a capture of the serial output taken while the device answered a
+// <24D> trace dump, picks the trace frames (type 0x04) out of the byte
+// stream and reassembles the ring. Records only carry a hash of their format
+// string, so the firmware sources are scanned for LOG_ERROR/WARN/INFO/DEBUG
+// calls and their literals hashed the same way (traceFormatId() in
+// trace_buffer.h); the arguments are then formatted with the matching
+// string. Pass the sources the capture's firmware was built from.
+//
+// Build: g++ -O2 -std=c++17 -Imain tools/trace_decode/trace_decode.cpp -o trace_decode
+// Usage: trace_decode CAPTURE SOURCE...
+
+#include "trace_buffer.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#define FRAME_SYNC_1 0xA5
+#define FRAME_SYNC_2 0x5A
+#define FRAME_TYPE_TRACE 0x04
+
+struct DecodeStats {
+    unsigned long frames = 0;
+    unsigned long badFrames = 0;
+    unsigned long records = 0;
+    unsigned long unknownFormats = 0;
+    unsigned long collisions = 0;
+};
+
+// Same CRC-8 (poly 0x07) as calculateCRC8() in the firmware
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0x00;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return true;
+}
+
+// Parses one C string literal starting at the opening quote; returns the
+// position after the closing quote, or 0 if the literal is not terminated
+static size_t parseLiteral(const std::string& text, size_t pos, std::string& value) {
+    for (pos++; pos < text.size(); pos++) {
+        char c = text[pos];
+        if (c == '"') return pos + 1;
+        if (c != '\\') {
+            value += c;
+            continue;
+        }
+        if (++pos >= text.size()) return 0;
+        c = text[pos];
+        switch (c) {
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': {
+                int code = 0;
+                for (int digits = 0; digits < 3 && pos < text.size() && text[pos] >= '0' && text[pos] <= '7'; digits++) {
+                    code = code * 8 + (text[pos++] - '0');
+                }
+                pos--;
+                value += (char)code;
+                break;
+            }
+            case 'x': {
+                int code = 0;
+                while (pos + 1 < text.size() && isxdigit((unsigned char)text[pos + 1])) {
+                    char digit = text[++pos];
+                    code = code * 16 + (isdigit((unsigned char)digit) ? digit - '0' : (tolower(digit) - 'a' + 10));
+                }
+                value += (char)code;
+                break;
+            }
+            default: value += c; break;  // \\ \" \' \?
+        }
+    }
+    return 0;
+}
+
+static size_t skipSpace(const std::string& text, size_t pos) {
+    while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+    return pos;
+}
+
+// Every LOG_<LEVEL>("..." "...", ...) format string in a source file. Calls
+// whose format is not a literal (the macro definitions) are skipped.
+static void scanSource(const std::string& text, std::map<uint32_t, std::string>& formats, DecodeStats& stats) {
+    static const char* macros[] = {"LOG_ERROR", "LOG_WARN", "LOG_INFO", "LOG_DEBUG"};
+    for (const char* macro : macros) {
+        size_t macroLength = strlen(macro);
+        for (size_t pos = text.find(macro); pos != std::string::npos; pos = text.find(macro, pos + 1)) {
+            if (pos > 0 && (isalnum((unsigned char)text[pos - 1]) || text[pos - 1] == '_')) continue;
+            size_t next = skipSpace(text, pos + macroLength);
+            if (next >= text.size() || text[next] != '(') continue;
+            next = skipSpace(text, next + 1);
+
+            std::string format;
+            bool literal = false;
+            while (next < text.size() && text[next] == '"') {
+                next = parseLiteral(text, next, format);
+                if (next == 0) break;
+                literal = true;
+                next = skipSpace(text, next);
+            }
+            if (!literal || next == 0) continue;
+
+            uint32_t id = traceFormatId(format.c_str());
+            auto existing = formats.find(id);
+            if (existing != formats.end() && existing->second != format) stats.collisions++;
+            formats[id] = format;
+        }
+    }
+}
+
+static bool readValue(const uint8_t* args, size_t length, size_t& pos, void* out) {
+    if (pos + 4 > length) return false;
+    memcpy(out, args + pos, 4);
+    pos += 4;
+    return true;
+}
+
+// Formats the arguments the way the firmware's text mode would have
+static std::string formatRecord(const std::string& format, const uint8_t* args, size_t length) {
+    std::string out;
+    size_t pos = 0;
+    for (size_t i = 0; i < format.size(); i++) {
+        if (format[i] != '%') {
+            out += format[i];
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%') {
+            out += '%';
+            i++;
+            continue;
+        }
+
+        // Conversion spec: flags, width, precision, length modifier, conversion
+        size_t start = i++;
+        while (i < format.size() && strchr("-+ #0123456789.", format[i])) i++;
+        std::string spec = format.substr(start, i - start);
+        while (i < format.size() && strchr("hlzjt", format[i])) i++;
+        if (i >= format.size()) break;
+        char conversion = format[i];
+
+        char text[128];
+        text[0] = '\0';
+        if (strchr("di", conversion)) {
+            int32_t value;
+            if (!readValue(args, length, pos, &value)) return out + " <truncated>";
+            snprintf(text, sizeof(text), (spec + "ld").c_str(), (long)value);
+        } else if (strchr("uxXoc", conversion)) {
+            uint32_t value;
+            if (!readValue(args, length, pos, &value)) return out + " <truncated>";
+            if (conversion == 'c') {
+                snprintf(text, sizeof(text), (spec + "c").c_str(), (int)value);
+            } else {
+                snprintf(text, sizeof(text), (spec + "l" + conversion).c_str(), (unsigned long)value);
+            }
+        } else if (strchr("feEgGaA", conversion)) {
+            float value;
+            if (!readValue(args, length, pos, &value)) return out + " <truncated>";
+            snprintf(text, sizeof(text), (spec + conversion).c_str(), (double)value);
+        } else if (conversion == 's') {
+            if (pos >= length || pos + 1 + args[pos] > length) return out + " <truncated>";
+            std::string value((const char*)args + pos + 1, args[pos]);
+            pos += 1 + args[pos];
+            snprintf(text, sizeof(text), (spec + "s").c_str(), value.c_str());
+        } else {
+            out += spec + conversion;  // Not recorded by the firmware either
+            continue;
+        }
+        out += text;
+    }
+    return out;
+}
+
+static const char* levelName(uint8_t level) {
+    switch (level) {
+        case 1: return "ERROR";
+        case 2: return "WARN";
+        case 3: return "INFO";
+        case 4: return "DEBUG";
+        default: return "?";
+    }
+}
+
+// Frame payload: dump offset (u16) then ring bytes; returns the reassembled dump
+static std::vector<uint8_t> extractDump(const std::vector<uint8_t>& input, DecodeStats& stats) {
+    std::vector<uint8_t> dump;
+    size_t pos = 0;
+    while (pos + 4 <= input.size()) {
+        if (input[pos] != FRAME_SYNC_1 || input[pos + 1] != FRAME_SYNC_2 || input[pos + 2] != FRAME_TYPE_TRACE ||
+            input[pos + 3] < 2) {
+            pos++;
+            continue;
+        }
+        size_t payloadLength = input[pos + 3];
+        size_t frameLength = 4 + payloadLength + 1;
+        if (pos + frameLength > input.size()) break;
+
+        const uint8_t* frame = input.data() + pos;
+        if (crc8(frame + 2, 2 + payloadLength) != frame[frameLength - 1]) {
+            stats.badFrames++;
+            pos++;  // Sync bytes inside text or another frame; keep scanning
+            continue;
+        }
+        stats.frames++;
+
+        uint16_t offset;
+        memcpy(&offset, frame + 4, 2);
+        size_t count = payloadLength - 2;
+        if (dump.size() < offset + count) dump.resize(offset + count);
+        memcpy(dump.data() + offset, frame + 6, count);
+        pos += frameLength;
+    }
+    return dump;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s CAPTURE SOURCE...\n", argv[0]);
+        return 2;
+    }
+
+    DecodeStats stats;
+    std::map<uint32_t, std::string> formats;
+    for (int i = 2; i < argc; i++) {
+        std::vector<uint8_t> source;
+        if (!readFile(argv[i], source)) return 1;
+        scanSource(std::string(source.begin(), source.end()), formats, stats);
+    }
+
+    std::vector<uint8_t> input;
+    if (!readFile(argv[1], input)) return 1;
+    std::vector<uint8_t> dump = extractDump(input, stats);
+
+    size_t pos = 0;
+    while (pos + TRACE_RECORD_HEADER <= dump.size()) {
+        const uint8_t* record = dump.data() + pos;
+        uint8_t length = record[0];
+        if (length < TRACE_RECORD_HEADER || pos + length > dump.size()) {
+            fprintf(stderr, "Corrupt record at offset %zu\n", pos);
+            break;
+        }
+        uint32_t timeUs, id;
+        memcpy(&timeUs, record + 2, 4);
+        memcpy(&id, record + 6, 4);
+        stats.records++;
+
+        auto format = formats.find(id);
+        std::string message;
+        if (format != formats.end()) {
+            message = formatRecord(format->second, record + TRACE_RECORD_HEADER, length - TRACE_RECORD_HEADER);
+        } else {
+            stats.unknownFormats++;
+            char text[48];
+            snprintf(text, sizeof(text), "<unknown format 0x%08lx>", (unsigned long)id);
+            message = text;
+        }
+        printf("%10.6f %-5s %s\n", timeUs / 1e6, levelName(record[1]), message.c_str());
+        pos += length;
+    }
+
+    fprintf(stderr, "%lu records, %lu frames (%lu bad), %zu formats, %lu unknown, %lu hash collisions\n",
+            stats.records, stats.frames, stats.badFrames, formats.size(), stats.unknownFormats, stats.collisions);
+    return stats.unknownFormats > 0 ? 1 : 0;
+}